@@ -0,0 +1,415 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cch_routing_data.hh"
+#include "ch_contracted_graph.hh"
+
+#include <fstream>
+#include <algorithm>
+
+namespace Tempus
+{
+
+namespace
+{
+
+// cells smaller than that are not dissected
+const size_t ND_LEAF_SIZE = 16;
+
+struct Dissection
+{
+    const std::vector<Point2D>& coordinates;
+    // undirected adjacency
+    const std::vector<uint32_t>& first_neighbor;
+    const std::vector<uint32_t>& neighbors;
+    // vertex -> stamp of the last cell it has been marked in
+    std::vector<uint32_t> mark;
+    uint32_t stamp;
+    std::vector<uint32_t>& order;
+
+    ///
+    /// Orders the cell [begin, end): vertices of the two halves first, then the separator
+    void dissect( std::vector<uint32_t>::iterator begin, std::vector<uint32_t>::iterator end )
+    {
+        const size_t size = end - begin;
+        if ( size <= ND_LEAF_SIZE ) {
+            order.insert( order.end(), begin, end );
+            return;
+        }
+
+        // split along the largest extent
+        float min_x = std::numeric_limits<float>::max(), max_x = -min_x;
+        float min_y = min_x, max_y = -min_x;
+        for ( auto it = begin; it != end; it++ ) {
+            min_x = std::min( min_x, coordinates[*it].x() );
+            max_x = std::max( max_x, coordinates[*it].x() );
+            min_y = std::min( min_y, coordinates[*it].y() );
+            max_y = std::max( max_y, coordinates[*it].y() );
+        }
+        const bool split_x = ( max_x - min_x ) >= ( max_y - min_y );
+        auto middle = begin + size / 2;
+        std::nth_element( begin, middle, end, [this, split_x]( uint32_t a, uint32_t b ) {
+                return split_x ? coordinates[a].x() < coordinates[b].x() : coordinates[a].y() < coordinates[b].y();
+            });
+
+        // the separator is made of the vertices of the first half linked to the second half
+        stamp++;
+        for ( auto it = middle; it != end; it++ ) {
+            mark[*it] = stamp;
+        }
+        auto separator = std::stable_partition( begin, middle, [this]( uint32_t v ) {
+                for ( uint32_t i = first_neighbor[v]; i < first_neighbor[v+1]; i++ ) {
+                    if ( mark[neighbors[i]] == stamp ) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+        // keep the separator apart, since recursive calls will reorder the cells
+        const std::vector<uint32_t> separator_vertices( separator, middle );
+
+        dissect( begin, separator );
+        dissect( middle, end );
+        order.insert( order.end(), separator_vertices.begin(), separator_vertices.end() );
+    }
+};
+
+}
+
+const uint32_t CCHTopology::NoEdge;
+
+CCHTopology::CCHTopology( const std::vector<Point2D>& coordinates, const std::vector<std::pair<uint32_t, uint32_t>>& edges, const std::vector<db_id_t>& node_id ) :
+    RoutingData( "cch_topology" )
+{
+    const uint32_t n = coordinates.size();
+
+    //
+    // Nested dissection order
+    std::vector<uint32_t> first_neighbor( n + 1 );
+    std::vector<uint32_t> neighbors( edges.size() * 2 );
+    for ( const auto& e : edges ) {
+        first_neighbor[e.first + 1]++;
+        first_neighbor[e.second + 1]++;
+    }
+    for ( uint32_t v = 0; v < n; v++ ) {
+        first_neighbor[v + 1] += first_neighbor[v];
+    }
+    {
+        std::vector<uint32_t> pos( first_neighbor.begin(), first_neighbor.end() - 1 );
+        for ( const auto& e : edges ) {
+            neighbors[pos[e.first]++] = e.second;
+            neighbors[pos[e.second]++] = e.first;
+        }
+    }
+
+    std::vector<uint32_t> cell( n );
+    for ( uint32_t v = 0; v < n; v++ ) {
+        cell[v] = v;
+    }
+    order_.reserve( n );
+    Dissection dissection{ coordinates, first_neighbor, neighbors, std::vector<uint32_t>( n, 0 ), 0, order_ };
+    dissection.dissect( cell.begin(), cell.end() );
+    BOOST_ASSERT( order_.size() == n );
+
+    rank_.resize( n );
+    node_id_.resize( n );
+    for ( uint32_t r = 0; r < n; r++ ) {
+        rank_[order_[r]] = r;
+        node_id_[r] = node_id[order_[r]];
+    }
+
+    build_topology_( edges );
+}
+
+void CCHTopology::build_topology_( const std::vector<std::pair<uint32_t, uint32_t>>& edges )
+{
+    const uint32_t n = order_.size();
+
+    //
+    // Contraction without witness search: the neighbours of a vertex are linked together.
+    // Higher neighbours of a vertex are merged into its lowest higher neighbour (its parent
+    // in the elimination tree), which gives the same result.
+    std::vector<std::vector<uint32_t>> up( n );
+    for ( const auto& e : edges ) {
+        if ( e.first == e.second ) {
+            continue;
+        }
+        uint32_t a = rank_[e.first];
+        uint32_t b = rank_[e.second];
+        up[std::min( a, b )].push_back( std::max( a, b ) );
+    }
+    for ( uint32_t u = 0; u < n; u++ ) {
+        std::sort( up[u].begin(), up[u].end() );
+        up[u].erase( std::unique( up[u].begin(), up[u].end() ), up[u].end() );
+        if ( !up[u].empty() ) {
+            auto& parent = up[up[u][0]];
+            parent.insert( parent.end(), up[u].begin() + 1, up[u].end() );
+        }
+    }
+
+    first_up_.resize( n + 1 );
+    for ( uint32_t u = 0; u < n; u++ ) {
+        first_up_[u] = up_target_.size();
+        up_target_.insert( up_target_.end(), up[u].begin(), up[u].end() );
+        std::vector<uint32_t>().swap( up[u] );
+    }
+    first_up_[n] = up_target_.size();
+    const uint32_t m = up_target_.size();
+
+    //
+    // Lower triangles
+    // (lower vertex, edge) for each vertex, sorted by lower vertex
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> down( n );
+    for ( uint32_t u = 0; u < n; u++ ) {
+        for ( uint32_t e = first_up_[u]; e < first_up_[u+1]; e++ ) {
+            down[up_target_[e]].push_back( std::make_pair( u, e ) );
+        }
+    }
+    first_triangle_.resize( m + 1 );
+    for ( uint32_t u = 0; u < n; u++ ) {
+        for ( uint32_t e = first_up_[u]; e < first_up_[u+1]; e++ ) {
+            first_triangle_[e] = triangles_.size();
+            const auto& du = down[u];
+            const auto& dw = down[up_target_[e]];
+            auto it1 = du.begin();
+            auto it2 = dw.begin();
+            while ( it1 != du.end() && it2 != dw.end() && it2->first < u ) {
+                if ( it1->first < it2->first ) {
+                    it1++;
+                }
+                else if ( it2->first < it1->first ) {
+                    it2++;
+                }
+                else {
+                    triangles_.push_back( Triangle{ it1->second, it2->second, it1->first } );
+                    it1++;
+                    it2++;
+                }
+            }
+        }
+    }
+    first_triangle_[m] = triangles_.size();
+
+    //
+    // Levels
+    std::vector<uint32_t> level( n, 0 );
+    uint32_t num_levels = 0;
+    for ( uint32_t u = 0; u < n; u++ ) {
+        num_levels = std::max( num_levels, level[u] + 1 );
+        for ( uint32_t e = first_up_[u]; e < first_up_[u+1]; e++ ) {
+            level[up_target_[e]] = std::max( level[up_target_[e]], level[u] + 1 );
+        }
+    }
+    first_level_edge_.assign( num_levels + 1, 0 );
+    for ( uint32_t u = 0; u < n; u++ ) {
+        first_level_edge_[level[u] + 1] += first_up_[u+1] - first_up_[u];
+    }
+    for ( uint32_t l = 0; l < num_levels; l++ ) {
+        first_level_edge_[l + 1] += first_level_edge_[l];
+    }
+    level_edges_.resize( m );
+    std::vector<uint32_t> pos( first_level_edge_.begin(), first_level_edge_.end() - 1 );
+    for ( uint32_t u = 0; u < n; u++ ) {
+        for ( uint32_t e = first_up_[u]; e < first_up_[u+1]; e++ ) {
+            level_edges_[pos[level[u]]++] = e;
+        }
+    }
+}
+
+uint32_t CCHTopology::edge_index( uint32_t u, uint32_t w ) const
+{
+    auto b = up_target_.begin() + first_up_[u];
+    auto e = up_target_.begin() + first_up_[u+1];
+    auto it = std::lower_bound( b, e, w );
+    if ( it != e && *it == w ) {
+        return it - up_target_.begin();
+    }
+    return NoEdge;
+}
+
+const uint32_t CCHMetric::Infinity;
+const uint32_t CCHMetric::NoMiddle;
+
+CCHMetric::CCHMetric( const CCHTopology& topology, const std::vector<CCHArc>& arcs ) :
+    topology_( topology ),
+    upward_( topology.num_edges(), Weight{ Infinity, NoMiddle, 0 } ),
+    downward_( topology.num_edges(), Weight{ Infinity, NoMiddle, 0 } )
+{
+    // costs must fit in CHEdgeProperty
+    const uint64_t max_cost = ( uint64_t(1) << 31 ) - 1;
+
+    for ( const CCHArc& a : arcs ) {
+        if ( a.source == a.target ) {
+            continue;
+        }
+        uint32_t u = topology.rank( a.source );
+        uint32_t w = topology.rank( a.target );
+        Weight& weight = u < w ? upward_[topology.edge_index( u, w )] : downward_[topology.edge_index( w, u )];
+        if ( a.cost < weight.cost ) {
+            weight = Weight{ uint32_t( std::min( uint64_t( a.cost ), max_cost ) ), NoMiddle, a.db_id };
+        }
+    }
+
+    const std::vector<uint32_t>& level_edges = topology.level_edges();
+    for ( uint32_t l = 0; l < topology.num_levels(); l++ ) {
+        const int first = topology.first_level_edge( l );
+        const int last = topology.first_level_edge( l + 1 );
+        #pragma omp parallel for schedule(dynamic, 256)
+        for ( int i = first; i < last; i++ ) {
+            const uint32_t e = level_edges[i];
+            Weight& up = upward_[e];
+            Weight& down = downward_[e];
+            for ( auto t = topology.triangles_begin( e ); t != topology.triangles_end( e ); t++ ) {
+                // u -> v -> w
+                const uint64_t c1 = uint64_t( downward_[t->lower_first].cost ) + upward_[t->lower_second].cost;
+                if ( c1 < up.cost && c1 <= max_cost ) {
+                    up = Weight{ uint32_t( c1 ), t->middle, 0 };
+                }
+                // w -> v -> u
+                const uint64_t c2 = uint64_t( downward_[t->lower_second].cost ) + upward_[t->lower_first].cost;
+                if ( c2 < down.cost && c2 <= max_cost ) {
+                    down = Weight{ uint32_t( c2 ), t->middle, 0 };
+                }
+            }
+        }
+    }
+}
+
+std::unique_ptr<CHRoutingData> CCHMetric::routing_data() const
+{
+    const uint32_t n = topology_.num_vertices();
+    // both use uint32_t(-1) for "no middle vertex"
+    static_assert( NoMiddle == CHContractedEdge::NoMiddle, "Inconsistent NoMiddle" );
+    std::vector<CHContractedEdge> edges;
+    for ( uint32_t u = 0; u < n; u++ ) {
+        for ( uint32_t e = topology_.first_edge( u ); e < topology_.last_edge( u ); e++ ) {
+            const uint32_t w = topology_.edge_target( e );
+            if ( upward_[e].cost != Infinity ) {
+                edges.push_back( { u, w, upward_[e].cost, upward_[e].middle, upward_[e].db_id } );
+            }
+            if ( downward_[e].cost != Infinity ) {
+                edges.push_back( { w, u, downward_[e].cost, downward_[e].middle, downward_[e].db_id } );
+            }
+        }
+    }
+
+    std::vector<db_id_t> node_id( n );
+    for ( uint32_t r = 0; r < n; r++ ) {
+        node_id[r] = topology_.vertex_id( r );
+    }
+    std::unique_ptr<RoutingData> rd = ch_routing_data_from_contraction( n, edges, std::move( node_id ) );
+    return std::unique_ptr<CHRoutingData>( static_cast<CHRoutingData*>( rd.release() ) );
+}
+
+std::unique_ptr<MultiProfileCHRoutingData> multi_profile_routing_data( const CCHTopology& topology, std::vector<CHProfile>&& profiles, const std::vector<const CCHMetric*>& metrics )
+{
+    BOOST_ASSERT( profiles.size() == metrics.size() );
+    const uint32_t n = topology.num_vertices();
+    std::vector<std::pair<CHVertex, CHVertex>> vertices;
+    std::vector<MultiProfileCHEdgeProperty> properties;
+    std::vector<uint32_t> up_degrees( n, 0 );
+
+    // an edge is kept if it can be used by at least one profile
+    auto add_edge = [&]( CHVertex u, CHVertex w, bool upward, uint32_t e ) {
+        bool used = false;
+        for ( const CCHMetric* m : metrics ) {
+            used = used || ( upward ? m->upward_[e] : m->downward_[e] ).cost != CCHMetric::Infinity;
+        }
+        if ( !used ) {
+            return false;
+        }
+        MultiProfileCHEdgeProperty p;
+        p.index = properties.size();
+        vertices.push_back( std::make_pair( u, w ) );
+        properties.push_back( p );
+        for ( size_t i = 0; i < profiles.size(); i++ ) {
+            const CCHMetric::Weight& weight = upward ? metrics[i]->upward_[e] : metrics[i]->downward_[e];
+            profiles[i].cost.push_back( weight.cost == CCHMetric::Infinity ? CHProfile::Infinity : weight.cost );
+            profiles[i].middle.push_back( weight.middle == CCHMetric::NoMiddle ? CHProfile::NoMiddle : weight.middle );
+            profiles[i].db_id.push_back( weight.db_id );
+        }
+        return true;
+    };
+
+    for ( uint32_t u = 0; u < n; u++ ) {
+        // upward edges first, then downward edges
+        for ( uint32_t e = topology.first_edge( u ); e < topology.last_edge( u ); e++ ) {
+            if ( add_edge( u, topology.edge_target( e ), true, e ) ) {
+                up_degrees[u]++;
+            }
+        }
+        for ( uint32_t e = topology.first_edge( u ); e < topology.last_edge( u ); e++ ) {
+            add_edge( u, topology.edge_target( e ), false, e );
+        }
+    }
+
+    std::unique_ptr<MultiProfileCHQuery> query( new MultiProfileCHQuery( vertices.begin(), vertices.end(), n, up_degrees.begin(), properties.begin() ) );
+    std::vector<db_id_t> node_id( n );
+    for ( uint32_t r = 0; r < n; r++ ) {
+        node_id[r] = topology.vertex_id( r );
+    }
+    return std::unique_ptr<MultiProfileCHRoutingData>( new MultiProfileCHRoutingData( std::move( query ), std::move( profiles ), std::move( node_id ) ) );
+}
+
+std::unique_ptr<RoutingData> CCHTopologyBuilder::pg_import( const std::string& /*pg_options*/, ProgressionCallback&, const VariantMap& /*options*/ ) const
+{
+    throw std::runtime_error( "CCH topologies can only be loaded from a dump file produced by cch_preprocess" );
+}
+
+std::unique_ptr<RoutingData> CCHTopologyBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ifstream ifs( filename, std::ios::binary );
+    if ( ifs.fail() ) {
+        throw std::runtime_error( "Problem opening input file " + filename );
+    }
+
+    read_header( ifs );
+
+    std::unique_ptr<CCHTopology> t( new CCHTopology() );
+    unserialize( ifs, t->order_, binary_serialization_t() );
+    unserialize( ifs, t->rank_, binary_serialization_t() );
+    unserialize( ifs, t->node_id_, binary_serialization_t() );
+    unserialize( ifs, t->first_up_, binary_serialization_t() );
+    unserialize( ifs, t->up_target_, binary_serialization_t() );
+    unserialize( ifs, t->first_triangle_, binary_serialization_t() );
+    unserialize( ifs, t->triangles_, binary_serialization_t() );
+    unserialize( ifs, t->level_edges_, binary_serialization_t() );
+    unserialize( ifs, t->first_level_edge_, binary_serialization_t() );
+
+    return std::unique_ptr<RoutingData>( t.release() );
+}
+
+void CCHTopologyBuilder::file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ofstream ofs( filename, std::ios::binary );
+
+    write_header( ofs );
+
+    const CCHTopology* t = static_cast<const CCHTopology*>( rd );
+    serialize( ofs, t->order_, binary_serialization_t() );
+    serialize( ofs, t->rank_, binary_serialization_t() );
+    serialize( ofs, t->node_id_, binary_serialization_t() );
+    serialize( ofs, t->first_up_, binary_serialization_t() );
+    serialize( ofs, t->up_target_, binary_serialization_t() );
+    serialize( ofs, t->first_triangle_, binary_serialization_t() );
+    serialize( ofs, t->triangles_, binary_serialization_t() );
+    serialize( ofs, t->level_edges_, binary_serialization_t() );
+    serialize( ofs, t->first_level_edge_, binary_serialization_t() );
+}
+
+REGISTER_BUILDER( CCHTopologyBuilder )
+
+} // namespace Tempus
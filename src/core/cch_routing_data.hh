@@ -0,0 +1,200 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CCH_ROUTING_DATA_HH
+#define TEMPUS_CCH_ROUTING_DATA_HH
+
+#include <vector>
+
+#include "ch_routing_data.hh"
+#include "multi_profile_ch_routing_data.hh"
+#include "point.hh"
+
+namespace Tempus
+{
+
+///
+/// Metric-independent part of a customizable contraction hierarchy (CCH).
+///
+/// The node order is computed by a nested dissection of the graph, based on vertex coordinates,
+/// and every possible shortcut is added (no witness search), so that the resulting topology
+/// does not depend on edge weights. New weights are then applied by a customization (see CCHMetric).
+///
+/// Vertices are represented by their rank in the order. An edge links a lower vertex u to
+/// a higher vertex w and is identified by its index.
+class CCHTopology : public RoutingData
+{
+public:
+    static const uint32_t NoEdge = uint32_t(-1);
+
+    CCHTopology() : RoutingData( "cch_topology" ) {}
+
+    ///
+    /// Computes the order and the topology
+    /// \param[in] coordinates Coordinates of each vertex
+    /// \param[in] edges Edges of the graph, in any direction
+    /// \param[in] node_id Id of each vertex
+    CCHTopology( const std::vector<Point2D>& coordinates, const std::vector<std::pair<uint32_t, uint32_t>>& edges, const std::vector<db_id_t>& node_id );
+
+    uint32_t num_vertices() const { return order_.size(); }
+    uint32_t num_edges() const { return up_target_.size(); }
+
+    /// input vertex -> rank
+    uint32_t rank( uint32_t v ) const { return rank_[v]; }
+    /// rank -> id of the vertex
+    db_id_t vertex_id( uint32_t r ) const { return node_id_[r]; }
+
+    /// index of the edge between ranks u < w, or NoEdge
+    uint32_t edge_index( uint32_t u, uint32_t w ) const;
+
+    /// range of the edges of the lower vertex u, [first, last)
+    uint32_t first_edge( uint32_t u ) const { return first_up_[u]; }
+    uint32_t last_edge( uint32_t u ) const { return first_up_[u+1]; }
+    /// higher vertex of an edge
+    uint32_t edge_target( uint32_t e ) const { return up_target_[e]; }
+
+    ///
+    /// A lower triangle (v, u, w) of an edge (u, w), with v < u < w
+    struct Triangle
+    {
+        /// index of the edge (v, u)
+        uint32_t lower_first;
+        /// index of the edge (v, w)
+        uint32_t lower_second;
+        /// v
+        uint32_t middle;
+
+        void serialize( std::ostream& ostr, binary_serialization_t t ) const
+        {
+            Tempus::serialize( ostr, lower_first, t );
+            Tempus::serialize( ostr, lower_second, t );
+            Tempus::serialize( ostr, middle, t );
+        }
+        void unserialize( std::istream& istr, binary_serialization_t t )
+        {
+            Tempus::unserialize( istr, lower_first, t );
+            Tempus::unserialize( istr, lower_second, t );
+            Tempus::unserialize( istr, middle, t );
+        }
+    };
+    const Triangle* triangles_begin( uint32_t e ) const { return triangles_.data() + first_triangle_[e]; }
+    const Triangle* triangles_end( uint32_t e ) const { return triangles_.data() + first_triangle_[e+1]; }
+
+    ///
+    /// Edges are grouped by levels: every lower triangle of an edge of a level is made of edges of
+    /// lower levels. Edges of a same level can then be customized in parallel.
+    uint32_t num_levels() const { return first_level_edge_.empty() ? 0 : first_level_edge_.size() - 1; }
+    const std::vector<uint32_t>& level_edges() const { return level_edges_; }
+    uint32_t first_level_edge( uint32_t level ) const { return first_level_edge_[level]; }
+
+private:
+    // rank -> input vertex
+    std::vector<uint32_t> order_;
+    // input vertex -> rank
+    std::vector<uint32_t> rank_;
+    // rank -> vertex id
+    std::vector<db_id_t> node_id_;
+
+    // upward adjacency, sorted by target
+    std::vector<uint32_t> first_up_;
+    std::vector<uint32_t> up_target_;
+
+    // lower triangles of each edge
+    std::vector<uint32_t> first_triangle_;
+    std::vector<Triangle> triangles_;
+
+    // edges, by level
+    std::vector<uint32_t> level_edges_;
+    std::vector<uint32_t> first_level_edge_;
+
+    void build_topology_( const std::vector<std::pair<uint32_t, uint32_t>>& edges );
+
+    friend class CCHTopologyBuilder;
+};
+
+///
+/// Original arc of the graph used for a customization
+struct CCHArc
+{
+    /// input vertices
+    uint32_t source;
+    uint32_t target;
+    /// fixed point cost, as in CHEdgeProperty
+    uint32_t cost;
+    /// road section id
+    db_id_t db_id;
+};
+
+///
+/// Weights of a CCH for a given metric
+class CCHMetric
+{
+public:
+    ///
+    /// Customization: applies the cost of the original arcs and computes the cost of every shortcut.
+    /// Edges of each level are processed in parallel
+    CCHMetric( const CCHTopology& topology, const std::vector<CCHArc>& arcs );
+
+    ///
+    /// Builds CH routing data that can be used by CH queries
+    std::unique_ptr<CHRoutingData> routing_data() const;
+
+private:
+    const CCHTopology& topology_;
+
+    static const uint32_t Infinity = uint32_t(-1);
+    static const uint32_t NoMiddle = uint32_t(-1);
+
+    struct Weight
+    {
+        uint32_t cost;
+        /// middle vertex of the shortcut or NoMiddle
+        uint32_t middle;
+        db_id_t db_id;
+    };
+    /// cost from the lower to the higher vertex of each edge
+    std::vector<Weight> upward_;
+    /// cost from the higher to the lower vertex of each edge
+    std::vector<Weight> downward_;
+
+    friend std::unique_ptr<MultiProfileCHRoutingData> multi_profile_routing_data( const CCHTopology&, std::vector<CHProfile>&&, const std::vector<const CCHMetric*>& );
+};
+
+///
+/// Builds CH data where several customizations of the same topology share the query graph
+/// \param[in] topology The CCH topology
+/// \param[in] profiles Description of each profile (name, traffic rules, cost). Their weight arrays are filled here
+/// \param[in] metrics Customization of each profile, in the same order
+std::unique_ptr<MultiProfileCHRoutingData> multi_profile_routing_data( const CCHTopology& topology, std::vector<CHProfile>&& profiles, const std::vector<const CCHMetric*>& metrics );
+
+///
+/// Builder of CCH topologies, that can only be loaded from a dump file
+class CCHTopologyBuilder : public RoutingDataBuilder
+{
+public:
+    CCHTopologyBuilder() : RoutingDataBuilder( "cch_topology" ) {}
+
+    virtual std::unique_ptr<RoutingData> pg_import( const std::string& pg_options, ProgressionCallback&, const VariantMap& options = VariantMap() ) const override;
+
+    virtual std::unique_ptr<RoutingData> file_import( const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+    virtual void file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+
+    uint32_t version() const { return 1; }
+};
+
+} // namespace Tempus
+
+#endif
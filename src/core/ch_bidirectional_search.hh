@@ -0,0 +1,231 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CH_BIDIRECTIONAL_SEARCH_HH
+#define TEMPUS_CH_BIDIRECTIONAL_SEARCH_HH
+
+#include <list>
+#include <array>
+#include <limits>
+#include <utility>
+
+#include <boost/assert.hpp>
+
+#include "ch_query_graph.hh"
+#include "ch_query_workspace.hh"
+
+namespace Tempus
+{
+
+///
+/// Statistics about the search space of a CH query
+struct CHQueryStatistics
+{
+    /// number of vertices settled, per direction
+    size_t settled[2] = { 0, 0 };
+    /// number of settled vertices that have been stalled, per direction
+    size_t stalled[2] = { 0, 0 };
+};
+
+///
+/// Bidirectional CH query between two sets of vertices
+///
+/// Each direction starts from several seeds, given as a range of (vertex, initial cost) pairs. This is what
+/// an edge-based graph needs, where a road node is represented by the set of its incoming or outgoing road sections.
+///
+/// Each direction stops as soon as the minimum of its queue is not lower than the best path found so far.
+/// Stall-on-demand: a vertex u reached by the upward search through a suboptimal path is detected
+/// by looking at the edges coming from higher vertices (the downward edges of the other direction).
+/// If one of these higher vertices already gives a shorter path to u, the edges of u are not relaxed.
+///
+/// The edges of the next vertex of a queue are prefetched when ENABLE_CH_PREFETCH is set (see config.hh,
+/// that has then to be included before this file).
+///
+/// Returns the edges of the path in the query graph, the cost is set only if a path is found
+template <typename Graph, typename CostType, typename WeightMap, typename OriginSeeds, typename DestinationSeeds>
+std::list<typename Graph::edge_descriptor> bidirectional_ch_seeded_dijkstra( const Graph& graph,
+                                                                             const OriginSeeds& origins,
+                                                                             const DestinationSeeds& destinations,
+                                                                             WeightMap weight_map,
+                                                                             CostType& ret_cost,
+                                                                             CHQueryWorkspace<typename Graph::VertexIndex, CostType>& workspace,
+                                                                             CHQueryStatistics& stats )
+{
+    typedef typename Graph::VertexIndex Vertex;
+
+    std::list<typename Graph::edge_descriptor> returned_path;
+
+    const CostType infinity = std::numeric_limits<CostType>::max();
+
+    // no allocation here, only a new epoch for each search space
+    workspace.reset( num_vertices( graph ) );
+    CHSearchSpace<Vertex, CostType>* search = workspace.search;
+
+    auto add_seed = [&search]( int ldir, Vertex v, CostType c ) {
+        if ( c < search[ldir].cost( v ) ) {
+            search[ldir].set( v, c, search[ldir].no_edge() );
+            search[ldir].queue().push_or_decrease( v, c );
+        }
+    };
+    for ( const auto& seed : origins ) {
+        add_seed( 0, seed.first, seed.second );
+    }
+    for ( const auto& seed : destinations ) {
+        add_seed( 1, seed.first, seed.second );
+    }
+
+    // direction : 0 = forward, 1 = backward
+    int dir = 1;
+
+    Vertex top_node = 0;
+    CostType total_cost = infinity;
+    bool path_found = false;
+
+    // relax the edge of index e, from the vertex of cost min_pi to vv in the given direction
+    auto relax = [&search]( int ldir, CostType min_pi, Vertex vv, CostType cost, typename Graph::EdgeIndex e ) {
+        if ( min_pi + cost < search[ldir].cost( vv ) ) {
+            search[ldir].set( vv, min_pi + cost, e );
+            search[ldir].queue().push_or_decrease( vv, min_pi + cost );
+        }
+    };
+
+    // is v reached with a shorter path through an adjacent higher vertex ?
+    auto stalled = [&search, &graph, &weight_map]( int ldir, Vertex v, CostType pi ) {
+        if ( ldir == 0 ) {
+            for ( auto iei = in_edges( v, graph ).first; iei != in_edges( v, graph ).second; iei++ ) {
+                CostType w_pi = search[0].cost( source( *iei, graph ) );
+                if ( w_pi != std::numeric_limits<CostType>::max() && w_pi + get( weight_map, *iei ) < pi ) {
+                    return true;
+                }
+            }
+        }
+        else {
+            for ( auto oei = out_edges( v, graph ).first; oei != out_edges( v, graph ).second; oei++ ) {
+                CostType w_pi = search[1].cost( target( *oei, graph ) );
+                if ( w_pi != std::numeric_limits<CostType>::max() && w_pi + get( weight_map, *oei ) < pi ) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    // a direction is finished when its queue is empty or its minimum is not lower than the best cost
+    auto finished = [&search, &total_cost]( int ldir ) {
+        return search[ldir].queue().empty() || search[ldir].queue().top_key() >= total_cost;
+    };
+
+    while ( !finished( 0 ) || !finished( 1 ) ) {
+
+        // interleave directions
+        dir = 1 - dir;
+
+        if ( finished( dir ) )
+            dir = 1 - dir;
+
+        Vertex min_v = search[dir].queue().top();
+        CostType min_pi = search[dir].queue().top_key();
+        search[dir].queue().pop();
+        stats.settled[dir]++;
+
+#if defined(ENABLE_CH_PREFETCH) && ENABLE_CH_PREFETCH
+        // the edges of the next vertex of this direction are loaded while min_v is processed
+        if ( !search[dir].queue().empty() ) {
+            graph.prefetch_edges( search[dir].queue().top() );
+        }
+#endif
+
+        {
+            CostType min_pi2 = search[1-dir].cost( min_v );
+            // if min_pi2 is not infinity, it means this node has already been seen
+            // in the other direction
+            // so it is a candidate top node
+            if ( min_pi2 != infinity && min_pi + min_pi2 < total_cost ) {
+                top_node = min_v;
+                total_cost = min_pi + min_pi2;
+                path_found = true;
+            }
+        }
+
+        if ( stalled( dir, min_v, min_pi ) ) {
+            stats.stalled[dir]++;
+            continue;
+        }
+
+        if ( dir == 0 ) {
+            for ( auto oei = out_edges( min_v, graph ).first;
+                  oei != out_edges( min_v, graph ).second;
+                  oei++ ) {
+                relax( dir, min_pi, target( *oei, graph ), get( weight_map, *oei ), oei->index() );
+            }
+        }
+        else {
+            for ( auto iei = in_edges( min_v, graph ).first;
+                  iei != in_edges( min_v, graph ).second;
+                  iei++ ) {
+                relax( dir, min_pi, source( *iei, graph ), get( weight_map, *iei ), iei->index() );
+            }
+        }
+    }
+
+    if ( !path_found ) {
+        return returned_path;
+    }
+
+    // path from an origin (s) to top node (x), following the upward edges
+    // by which each vertex has been reached
+    Vertex x = top_node;
+    while ( search[0].predecessor_edge( x ) != search[0].no_edge() )
+    {
+        BOOST_ASSERT_MSG( search[0].reached( x ), "Can't find upward predecessor" );
+        auto e = graph.edge_from_index( search[0].predecessor_edge( x ) );
+        returned_path.push_front( e );
+        x = source( e, graph );
+    }
+
+    // path from top node (x) to a destination (t), following the downward edges
+    Vertex t = top_node;
+    while ( search[1].predecessor_edge( t ) != search[1].no_edge() )
+    {
+        BOOST_ASSERT_MSG( search[1].reached( t ), "Can't find downward predecessor" );
+        auto e = graph.edge_from_index( search[1].predecessor_edge( t ) );
+        returned_path.push_back( e );
+        t = target( e, graph );
+    }
+
+    ret_cost = total_cost;
+    return returned_path;
+}
+
+///
+/// Bidirectional CH query between two vertices
+template <typename Graph, typename CostType, typename WeightMap>
+std::list<typename Graph::edge_descriptor> bidirectional_ch_dijkstra( const Graph& graph,
+                                                                      typename Graph::VertexIndex origin,
+                                                                      typename Graph::VertexIndex destination,
+                                                                      WeightMap weight_map,
+                                                                      CostType& ret_cost,
+                                                                      CHQueryWorkspace<typename Graph::VertexIndex, CostType>& workspace,
+                                                                      CHQueryStatistics& stats )
+{
+    const std::array<std::pair<typename Graph::VertexIndex, CostType>, 1> origins = {{ std::make_pair( origin, CostType( 0 ) ) }};
+    const std::array<std::pair<typename Graph::VertexIndex, CostType>, 1> destinations = {{ std::make_pair( destination, CostType( 0 ) ) }};
+    return bidirectional_ch_seeded_dijkstra( graph, origins, destinations, weight_map, ret_cost, workspace, stats );
+}
+
+} // namespace Tempus
+
+#endif
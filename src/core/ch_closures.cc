@@ -0,0 +1,236 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ch_closures.hh"
+#include "ch_bidirectional_search.hh"
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/property_map/function_property_map.hpp>
+
+namespace Tempus
+{
+
+namespace
+{
+
+// counting sort of (key, value) pairs into a CSR structure
+template <typename T>
+void fill_csr( size_t n, const std::vector<std::pair<uint32_t, T>>& pairs, std::vector<uint32_t>& offsets, std::vector<T>& values )
+{
+    offsets.assign( n + 1, 0 );
+    for ( const auto& p : pairs ) {
+        offsets[p.first + 1]++;
+    }
+    for ( size_t i = 0; i < n; i++ ) {
+        offsets[i + 1] += offsets[i];
+    }
+    values.resize( pairs.size() );
+    std::vector<uint32_t> pos( offsets.begin(), offsets.end() - 1 );
+    for ( const auto& p : pairs ) {
+        values[pos[p.first]++] = p.second;
+    }
+}
+
+}
+
+CHClosureIndex::CHClosureIndex( const CHRoutingData& rd ) :
+    rd_( rd )
+{
+    const CHQuery& graph = rd.ch_query();
+    const size_t n = num_vertices( graph );
+
+    std::vector<std::pair<uint32_t, CHQuery::EdgeIndex>> parents;
+    std::vector<std::pair<uint32_t, AdjacentEdge>> downward, upward;
+    for ( CHVertex v = 0; v < n; v++ ) {
+        // upward edges (v, w)
+        for ( auto oei = out_edges( v, graph ).first; oei != out_edges( v, graph ).second; oei++ ) {
+            upward.push_back( std::make_pair( target( *oei, graph ), AdjacentEdge{ oei->index(), v } ) );
+        }
+        // downward edges (w, v)
+        for ( auto iei = in_edges( v, graph ).first; iei != in_edges( v, graph ).second; iei++ ) {
+            downward.push_back( std::make_pair( source( *iei, graph ), AdjacentEdge{ iei->index(), v } ) );
+        }
+    }
+    for ( CHQuery::EdgeIndex e = 0; e < graph.num_edges(); e++ ) {
+        if ( graph.edge_property( e ).b.is_shortcut ) {
+            parents.push_back( std::make_pair( rd.edge_origin( e ).child[0], e ) );
+            parents.push_back( std::make_pair( rd.edge_origin( e ).child[1], e ) );
+        }
+        else {
+            section_edges_.push_back( std::make_pair( rd.edge_origin( e ).db_id, e ) );
+        }
+    }
+    std::sort( section_edges_.begin(), section_edges_.end() );
+
+    fill_csr( graph.num_edges(), parents, parent_offsets_, parents_ );
+    fill_csr( n, downward, downward_offsets_, downward_out_ );
+    fill_csr( n, upward, upward_offsets_, upward_in_ );
+}
+
+std::shared_ptr<const CHClosure> CHClosureIndex::close( const std::vector<db_id_t>& sections ) const
+{
+    std::shared_ptr<CHClosure> closure( new CHClosure( rd_.ch_query().num_edges() ) );
+
+    std::vector<CHQuery::EdgeIndex> stack;
+    auto close_edge = [&closure, &stack]( CHQuery::EdgeIndex e ) {
+        if ( !closure->closed_[e] ) {
+            closure->closed_[e] = true;
+            closure->num_closed_edges_++;
+            stack.push_back( e );
+        }
+    };
+    for ( db_id_t section : sections ) {
+        auto range = std::equal_range( section_edges_.begin(), section_edges_.end(), std::make_pair( section, CHQuery::EdgeIndex( 0 ) ),
+                                       []( const std::pair<db_id_t, CHQuery::EdgeIndex>& a, const std::pair<db_id_t, CHQuery::EdgeIndex>& b ) {
+                                           return a.first < b.first;
+                                       });
+        for ( auto it = range.first; it != range.second; it++ ) {
+            close_edge( it->second );
+        }
+    }
+    // shortcuts that contain a closed edge, transitively
+    while ( !stack.empty() ) {
+        const CHQuery::EdgeIndex e = stack.back();
+        stack.pop_back();
+        for ( uint32_t i = parent_offsets_[e]; i < parent_offsets_[e + 1]; i++ ) {
+            close_edge( parents_[i] );
+        }
+    }
+    return closure;
+}
+
+CHClosureIndex::AdjacentEdgeRange CHClosureIndex::downward_out_edges( CHVertex v ) const
+{
+    return std::make_pair( downward_out_.data() + downward_offsets_[v], downward_out_.data() + downward_offsets_[v + 1] );
+}
+
+CHClosureIndex::AdjacentEdgeRange CHClosureIndex::upward_in_edges( CHVertex v ) const
+{
+    return std::make_pair( upward_in_.data() + upward_offsets_[v], upward_in_.data() + upward_offsets_[v + 1] );
+}
+
+std::list<CHEdge> ch_query_with_closure( const CHRoutingData& rd,
+                                         const CHClosureIndex& index,
+                                         const CHClosure& closure,
+                                         CHVertex origin,
+                                         CHVertex destination,
+                                         uint32_t& ret_cost,
+                                         bool* fallback )
+{
+    const CHQuery& graph = rd.ch_query();
+    const uint32_t infinity = std::numeric_limits<uint32_t>::max();
+    CHQueryWorkspace<CHVertex, uint32_t>& workspace = ch_query_workspace<CHVertex, uint32_t>();
+
+    if ( fallback ) {
+        *fallback = false;
+    }
+
+    // CH query, without closures
+    auto weight_map_fn = []( const CHEdge& e ) { return uint32_t( e.property().b.cost ); };
+    auto weight_map = boost::make_function_property_map<CHEdge, uint32_t, decltype(weight_map_fn)>( weight_map_fn );
+    CHQueryStatistics stats;
+    uint32_t cost = infinity;
+    std::list<CHEdge> path = bidirectional_ch_dijkstra( graph, origin, destination, weight_map, cost, workspace, stats );
+    if ( cost == infinity ) {
+        // no path without closures, none with
+        return path;
+    }
+    if ( std::none_of( path.begin(), path.end(), [&closure]( const CHEdge& e ) { return closure.is_closed( e.index() ); } ) ) {
+        ret_cost = cost;
+        return path;
+    }
+
+    //
+    // Fallback: bidirectional Dijkstra on the open edges, in every direction of the CH graph
+    if ( fallback ) {
+        *fallback = true;
+    }
+    path.clear();
+    workspace.reset( num_vertices( graph ) );
+    CHSearchSpace<CHVertex, uint32_t>* search = workspace.search;
+    search[0].set( origin, 0, search[0].no_edge() );
+    search[0].queue().push( origin, 0 );
+    search[1].set( destination, 0, search[1].no_edge() );
+    search[1].queue().push( destination, 0 );
+
+    uint64_t best = infinity;
+    CHVertex top_node = origin;
+    auto relax = [&]( int dir, uint32_t pi, CHVertex v, CHQuery::EdgeIndex e ) {
+        if ( closure.is_closed( e ) ) {
+            return;
+        }
+        const uint32_t c = pi + graph.edge_property( e ).b.cost;
+        if ( c < search[dir].cost( v ) ) {
+            search[dir].set( v, c, e );
+            search[dir].queue().push_or_decrease( v, c );
+            const uint32_t other = search[1 - dir].cost( v );
+            if ( other != infinity && uint64_t( c ) + other < best ) {
+                best = uint64_t( c ) + other;
+                top_node = v;
+            }
+        }
+    };
+    if ( origin == destination ) {
+        best = 0;
+    }
+
+    while ( !search[0].queue().empty() && !search[1].queue().empty() &&
+            uint64_t( search[0].queue().top_key() ) + search[1].queue().top_key() < best ) {
+        // expand the smallest queue
+        const int dir = search[0].queue().size() <= search[1].queue().size() ? 0 : 1;
+        const CHVertex u = search[dir].queue().top();
+        const uint32_t pi = search[dir].queue().top_key();
+        search[dir].queue().pop();
+
+        if ( dir == 0 ) {
+            for ( auto oei = out_edges( u, graph ).first; oei != out_edges( u, graph ).second; oei++ ) {
+                relax( 0, pi, target( *oei, graph ), oei->index() );
+            }
+            for ( auto it = index.downward_out_edges( u ).first; it != index.downward_out_edges( u ).second; it++ ) {
+                relax( 0, pi, it->vertex, it->edge );
+            }
+        }
+        else {
+            for ( auto iei = in_edges( u, graph ).first; iei != in_edges( u, graph ).second; iei++ ) {
+                relax( 1, pi, source( *iei, graph ), iei->index() );
+            }
+            for ( auto it = index.upward_in_edges( u ).first; it != index.upward_in_edges( u ).second; it++ ) {
+                relax( 1, pi, it->vertex, it->edge );
+            }
+        }
+    }
+
+    if ( best == infinity ) {
+        return path;
+    }
+
+    for ( CHVertex x = top_node; search[0].predecessor_edge( x ) != search[0].no_edge(); ) {
+        CHEdge e = graph.edge_from_index( search[0].predecessor_edge( x ) );
+        path.push_front( e );
+        x = source( e, graph );
+    }
+    for ( CHVertex x = top_node; search[1].predecessor_edge( x ) != search[1].no_edge(); ) {
+        CHEdge e = graph.edge_from_index( search[1].predecessor_edge( x ) );
+        path.push_back( e );
+        x = target( e, graph );
+    }
+    ret_cost = uint32_t( best );
+    return path;
+}
+
+} // namespace Tempus
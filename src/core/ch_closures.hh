@@ -0,0 +1,121 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CH_CLOSURES_HH
+#define TEMPUS_CH_CLOSURES_HH
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <utility>
+
+#include "ch_routing_data.hh"
+
+namespace Tempus
+{
+
+///
+/// Road sections closed on CH data: the original edges of the sections and every shortcut that contains one of them
+/// An instance is immutable once built by CHClosureIndex::close() and can be shared between queries.
+class CHClosure
+{
+public:
+    explicit CHClosure( size_t num_edges ) : closed_( num_edges, false ), num_closed_edges_( 0 ) {}
+
+    bool is_closed( CHQuery::EdgeIndex e ) const { return closed_[e]; }
+
+    /// Number of closed edges, original ones and shortcuts
+    size_t num_closed_edges() const { return num_closed_edges_; }
+
+    bool empty() const { return num_closed_edges_ == 0; }
+
+private:
+    std::vector<bool> closed_;
+    size_t num_closed_edges_;
+
+    friend class CHClosureIndex;
+};
+
+///
+/// Indices needed to close road sections on CH data without contracting the graph again
+///
+/// - road section id -> original edges
+/// - edge -> shortcuts that directly contain it (the ones of which it is a child edge)
+/// - for each vertex, its downward outgoing and upward incoming edges, that the CH query graph only stores on the other end
+class CHClosureIndex
+{
+public:
+    /// An edge seen from one of its ends: its index and the vertex at the other end
+    struct AdjacentEdge
+    {
+        CHQuery::EdgeIndex edge;
+        CHVertex vertex;
+    };
+    typedef std::pair<const AdjacentEdge*, const AdjacentEdge*> AdjacentEdgeRange;
+
+    explicit CHClosureIndex( const CHRoutingData& rd );
+
+    ///
+    /// Closes the given road sections. Shortcuts are found by following the parent index up from the original edges,
+    /// without any search on the graph.
+    std::shared_ptr<const CHClosure> close( const std::vector<db_id_t>& sections ) const;
+
+    /// Downward edges (v, w), w < v
+    AdjacentEdgeRange downward_out_edges( CHVertex v ) const;
+
+    /// Upward edges (w, v), w < v
+    AdjacentEdgeRange upward_in_edges( CHVertex v ) const;
+
+private:
+    const CHRoutingData& rd_;
+
+    // sorted by section id
+    std::vector<std::pair<db_id_t, CHQuery::EdgeIndex>> section_edges_;
+
+    // parents_[parent_offsets_[e] .. parent_offsets_[e+1]] are the shortcuts that have e as child
+    std::vector<uint32_t> parent_offsets_;
+    std::vector<CHQuery::EdgeIndex> parents_;
+
+    std::vector<uint32_t> downward_offsets_;
+    std::vector<AdjacentEdge> downward_out_;
+    std::vector<uint32_t> upward_offsets_;
+    std::vector<AdjacentEdge> upward_in_;
+};
+
+///
+/// Bidirectional CH query on data with closed road sections
+///
+/// A CH query that ignores the closures is run first. Closures can only make paths longer, so if its path does not
+/// use a closed edge, it is still a shortest path: unaffected routes keep the cost of a CH query.
+/// Otherwise, the path may need shortcuts that were never built because their witness went through a closed section.
+/// The query then falls back to a bidirectional Dijkstra on every open edge of the CH graph, shortcuts included.
+/// This search is not limited to the region of the closures: it costs as much as a plain Dijkstra between the two
+/// vertices, shortcuts only make it settle fewer vertices.
+///
+/// \param[out] cost Fixed point cost of the path, set only if a path is found
+/// \param[out] fallback If not null, tells whether the fallback search has been used
+/// \returns the edges of the path in the query graph
+std::list<CHEdge> ch_query_with_closure( const CHRoutingData& rd,
+                                         const CHClosureIndex& index,
+                                         const CHClosure& closure,
+                                         CHVertex origin,
+                                         CHVertex destination,
+                                         uint32_t& cost,
+                                         bool* fallback = nullptr );
+
+} // namespace Tempus
+
+#endif
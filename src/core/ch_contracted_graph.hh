@@ -0,0 +1,58 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CH_CONTRACTED_GRAPH_HH
+#define TEMPUS_CH_CONTRACTED_GRAPH_HH
+
+#include <vector>
+#include <memory>
+
+#include "routing_data.hh"
+
+namespace Tempus
+{
+
+///
+/// Edge of a contracted graph, original edge or shortcut.
+/// Vertices are given by their CH order
+struct CHContractedEdge
+{
+    static const uint32_t NoMiddle = uint32_t(-1);
+
+    uint32_t source;
+    uint32_t target;
+    /// fixed point cost
+    uint32_t cost;
+    /// middle vertex of a shortcut, or NoMiddle
+    uint32_t middle;
+    /// road section id, 0 if unknown. Not kept for shortcuts
+    db_id_t db_id;
+};
+
+///
+/// Builds CH routing data (a CHRoutingData) out of the edges of a contracted graph.
+/// When several edges link the same vertices in the same direction, only the cheapest one is kept.
+///
+/// This header does not depend on ch_routing_data.hh, so that it can be used along with the contraction code.
+/// \param[in] num_vertices Number of vertices
+/// \param[in,out] contracted_edges Edges of the graph. They are sorted and deduplicated in place
+/// so that the position of an edge is its index in the query graph
+/// \param[in] node_id Id of each vertex, by order
+std::unique_ptr<RoutingData> ch_routing_data_from_contraction( uint32_t num_vertices, std::vector<CHContractedEdge>& contracted_edges, std::vector<db_id_t>&& node_id );
+
+} // namespace Tempus
+
+#endif
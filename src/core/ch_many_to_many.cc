@@ -0,0 +1,90 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ch_many_to_many.hh"
+#include "ch_upward_search.hh"
+
+#include <algorithm>
+#include <limits>
+
+namespace Tempus
+{
+
+namespace
+{
+
+struct BucketEntry
+{
+    CHVertex vertex;
+    uint32_t target;
+    float cost;
+
+    bool operator<( const BucketEntry& other ) const
+    {
+        return vertex < other.vertex;
+    }
+};
+
+}
+
+std::vector<float> ch_many_to_many( const CHRoutingData& rd, const std::vector<CHVertex>& sources, const std::vector<CHVertex>& targets )
+{
+    const CHQuery& graph = rd.ch_query();
+    const size_t n_targets = targets.size();
+    std::vector<float> costs( sources.size() * n_targets, std::numeric_limits<float>::max() );
+
+    auto weight = []( const CHEdge& e ) {
+        return float( e.property().b.cost / 100.0 );
+    };
+
+    //
+    // Backward searches, fill buckets
+    std::vector<BucketEntry> buckets;
+    #pragma omp parallel
+    {
+        std::vector<BucketEntry> local_buckets;
+        #pragma omp for schedule(dynamic)
+        for ( int j = 0; j < int(n_targets); j++ ) {
+            CHSearchSpace<CHVertex, float>& search = ch_query_workspace<CHVertex, float>().search[1];
+            ch_upward_search( graph, targets[j], CHDirection::Backward, weight, search, [&]( CHVertex v, float cost ) {
+                    local_buckets.push_back( BucketEntry{ v, uint32_t(j), cost } );
+                });
+        }
+        #pragma omp critical
+        buckets.insert( buckets.end(), local_buckets.begin(), local_buckets.end() );
+    }
+    // buckets are grouped by vertex
+    std::sort( buckets.begin(), buckets.end() );
+
+    //
+    // Forward searches, scan buckets
+    #pragma omp parallel for schedule(dynamic)
+    for ( int i = 0; i < int(sources.size()); i++ ) {
+        float* row = &costs[i * n_targets];
+        CHSearchSpace<CHVertex, float>& search = ch_query_workspace<CHVertex, float>().search[0];
+        ch_upward_search( graph, sources[i], CHDirection::Forward, weight, search, [&]( CHVertex v, float cost ) {
+                BucketEntry key{ v, 0, 0.0 };
+                auto range = std::equal_range( buckets.begin(), buckets.end(), key );
+                for ( auto it = range.first; it != range.second; it++ ) {
+                    row[it->target] = std::min( row[it->target], cost + it->cost );
+                }
+            });
+    }
+
+    return costs;
+}
+
+} // namespace Tempus
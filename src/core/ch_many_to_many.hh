@@ -0,0 +1,45 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CH_MANY_TO_MANY_HH
+#define TEMPUS_CH_MANY_TO_MANY_HH
+
+#include <vector>
+
+#include "ch_routing_data.hh"
+
+namespace Tempus
+{
+
+///
+/// Many-to-many cost table on a CH graph (bucket-based algorithm).
+///
+/// A backward upward search is run from each target, and each settled vertex receives
+/// a (target, cost) entry in its bucket. Then a forward upward search is run from each source
+/// and buckets of the settled vertices are scanned.
+/// Searches are run in parallel (OpenMP) and use the per-thread CH query workspaces.
+///
+/// \param[in] rd The CH routing data
+/// \param[in] sources Source vertices
+/// \param[in] targets Target vertices
+/// \returns the cost matrix, stored row by row: the cost from sources[i] to targets[j] is
+///          at i * targets.size() + j. Costs are in the unit of the CH graph (see ch_query), unreachable targets
+///          have a cost of std::numeric_limits<float>::max()
+std::vector<float> ch_many_to_many( const CHRoutingData& rd, const std::vector<CHVertex>& sources, const std::vector<CHVertex>& targets );
+
+} // namespace Tempus
+
+#endif
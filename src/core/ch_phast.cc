@@ -0,0 +1,193 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ch_phast.hh"
+#include "ch_upward_search.hh"
+
+#include <algorithm>
+#include <limits>
+
+namespace Tempus
+{
+
+namespace
+{
+
+inline float edge_cost( const CHEdge& e )
+{
+    return float( e.property().b.cost / 100.0 );
+}
+
+}
+
+const size_t CHPhast::BatchSize;
+
+CHPhast::CHPhast( const CHRoutingData& rd ) : rd_( rd )
+{
+}
+
+void CHPhast::one_to_all( CHVertex origin, std::vector<float>& costs ) const
+{
+    const CHQuery& graph = rd_.ch_query();
+    const size_t n = num_vertices( graph );
+    const float infinity = std::numeric_limits<float>::max();
+    costs.assign( n, infinity );
+
+    CHSearchSpace<CHVertex, float>& search = ch_query_workspace<CHVertex, float>().search[0];
+    ch_upward_search( graph, origin, CHDirection::Forward, edge_cost, search, [&costs]( CHVertex v, float cost ) {
+            costs[v] = cost;
+        });
+
+    // downward sweep, by decreasing CH order
+    for ( size_t i = n; i-- > 0; ) {
+        const CHVertex v = CHVertex( i );
+        float c = costs[v];
+        for ( auto iei = in_edges( v, graph ).first; iei != in_edges( v, graph ).second; iei++ ) {
+            const float cu = costs[source( *iei, graph )];
+            if ( cu != infinity ) {
+                c = std::min( c, cu + edge_cost( *iei ) );
+            }
+        }
+        costs[v] = c;
+    }
+}
+
+void CHPhast::many_to_all( const std::vector<CHVertex>& sources, std::vector<float>& costs ) const
+{
+    const CHQuery& graph = rd_.ch_query();
+    const size_t n = num_vertices( graph );
+    const float infinity = std::numeric_limits<float>::max();
+    costs.assign( sources.size() * n, infinity );
+
+    // costs of a batch, stored by vertex: batch_costs[v * BatchSize + k]
+    std::vector<float> batch_costs;
+
+    for ( size_t first = 0; first < sources.size(); first += BatchSize ) {
+        const size_t batch = std::min( BatchSize, sources.size() - first );
+        batch_costs.assign( n * BatchSize, infinity );
+
+        for ( size_t k = 0; k < batch; k++ ) {
+            CHSearchSpace<CHVertex, float>& search = ch_query_workspace<CHVertex, float>().search[0];
+            ch_upward_search( graph, sources[first + k], CHDirection::Forward, edge_cost, search, [&]( CHVertex v, float cost ) {
+                    batch_costs[v * BatchSize + k] = cost;
+                });
+        }
+
+        // downward sweep, each edge is relaxed for the whole batch
+        for ( size_t i = n; i-- > 0; ) {
+            float* cv = &batch_costs[i * BatchSize];
+            for ( auto iei = in_edges( CHVertex( i ), graph ).first; iei != in_edges( CHVertex( i ), graph ).second; iei++ ) {
+                const float* cu = &batch_costs[source( *iei, graph ) * BatchSize];
+                const float w = edge_cost( *iei );
+                // no test needed for unreached vertices: max float + w is still max float
+                for ( size_t k = 0; k < BatchSize; k++ ) {
+                    cv[k] = std::min( cv[k], cu[k] + w );
+                }
+            }
+        }
+
+        for ( size_t k = 0; k < batch; k++ ) {
+            float* row = &costs[( first + k ) * n];
+            for ( size_t v = 0; v < n; v++ ) {
+                row[v] = batch_costs[v * BatchSize + k];
+            }
+        }
+    }
+}
+
+const uint32_t CHRestrictedPhast::NotSelected;
+
+CHRestrictedPhast::CHRestrictedPhast( const CHRoutingData& rd, const std::vector<CHVertex>& targets ) : rd_( rd )
+{
+    const CHQuery& graph = rd_.ch_query();
+    const size_t n = graph.num_vertices();
+
+    //
+    // Select every vertex that reaches a target through downward edges
+    local_index_.assign( n, NotSelected );
+    std::vector<CHVertex> stack( targets.begin(), targets.end() );
+    for ( CHVertex t : targets ) {
+        local_index_[t] = 0;
+    }
+    while ( !stack.empty() ) {
+        CHVertex v = stack.back();
+        stack.pop_back();
+        vertices_.push_back( v );
+        for ( auto iei = in_edges( v, graph ).first; iei != in_edges( v, graph ).second; iei++ ) {
+            CHVertex u = source( *iei, graph );
+            if ( local_index_[u] == NotSelected ) {
+                local_index_[u] = 0;
+                stack.push_back( u );
+            }
+        }
+    }
+
+    // decreasing CH order
+    std::sort( vertices_.begin(), vertices_.end(), std::greater<CHVertex>() );
+    for ( uint32_t i = 0; i < vertices_.size(); i++ ) {
+        local_index_[vertices_[i]] = i;
+    }
+
+    //
+    // Compact downward graph
+    first_edge_.reserve( vertices_.size() + 1 );
+    for ( CHVertex v : vertices_ ) {
+        first_edge_.push_back( edges_.size() );
+        for ( auto iei = in_edges( v, graph ).first; iei != in_edges( v, graph ).second; iei++ ) {
+            edges_.push_back( DownwardEdge{ local_index_[source( *iei, graph )], edge_cost( *iei ) } );
+        }
+    }
+    first_edge_.push_back( edges_.size() );
+
+    for ( CHVertex t : targets ) {
+        targets_.push_back( local_index_[t] );
+    }
+}
+
+void CHRestrictedPhast::one_to_many( CHVertex origin, std::vector<float>& costs ) const
+{
+    const CHQuery& graph = rd_.ch_query();
+    const float infinity = std::numeric_limits<float>::max();
+
+    std::vector<float> local_costs( vertices_.size(), infinity );
+
+    CHSearchSpace<CHVertex, float>& search = ch_query_workspace<CHVertex, float>().search[0];
+    ch_upward_search( graph, origin, CHDirection::Forward, edge_cost, search, [&]( CHVertex v, float cost ) {
+            const uint32_t l = local_index_[v];
+            if ( l != NotSelected ) {
+                local_costs[l] = cost;
+            }
+        });
+
+    // downward sweep on the restricted graph
+    for ( size_t i = 0; i < vertices_.size(); i++ ) {
+        float c = local_costs[i];
+        for ( uint32_t e = first_edge_[i]; e < first_edge_[i+1]; e++ ) {
+            const float cu = local_costs[edges_[e].source];
+            if ( cu != infinity ) {
+                c = std::min( c, cu + edges_[e].cost );
+            }
+        }
+        local_costs[i] = c;
+    }
+
+    costs.resize( targets_.size() );
+    for ( size_t j = 0; j < targets_.size(); j++ ) {
+        costs[j] = local_costs[targets_[j]];
+    }
+}
+
+} // namespace Tempus
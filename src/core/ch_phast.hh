@@ -0,0 +1,106 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CH_PHAST_HH
+#define TEMPUS_CH_PHAST_HH
+
+#include <vector>
+
+#include "ch_routing_data.hh"
+
+namespace Tempus
+{
+
+///
+/// One-to-all costs on a CH graph (PHAST algorithm).
+///
+/// A forward upward search is run from the source. Then vertices are scanned by decreasing CH order
+/// and their downward edges are relaxed. Since the downward edges of a vertex are stored together in
+/// CHQueryGraph (in_edges()), this sweep is a linear scan of the edge array, without any priority queue.
+///
+/// Costs are in the unit of the CH graph (see ch_query), unreachable vertices have a cost of std::numeric_limits<float>::max()
+class CHPhast
+{
+public:
+    /// Number of sources processed together by many_to_all()
+    static const size_t BatchSize = 8;
+
+    explicit CHPhast( const CHRoutingData& rd );
+
+    ///
+    /// Costs from origin to every vertex
+    /// \param[out] costs Costs indexed by CH vertex
+    void one_to_all( CHVertex origin, std::vector<float>& costs ) const;
+
+    ///
+    /// Costs from several sources to every vertex.
+    /// Sources are processed by batches of BatchSize: each edge of the downward sweep is then
+    /// relaxed for every source of the batch in an inner loop the compiler can vectorize.
+    /// \param[out] costs Costs of the i-th source to vertex v are stored at i * num_vertices + v
+    void many_to_all( const std::vector<CHVertex>& sources, std::vector<float>& costs ) const;
+
+private:
+    const CHRoutingData& rd_;
+};
+
+///
+/// One-to-many costs restricted to a fixed set of targets (RPHAST algorithm).
+///
+/// The downward sweep of PHAST is restricted to the vertices from which a target can be reached
+/// by downward edges. This subgraph is extracted once, when the targets are given, and stored in a compact form.
+/// Queries are then independent of the size of the whole graph.
+class CHRestrictedPhast
+{
+public:
+    CHRestrictedPhast( const CHRoutingData& rd, const std::vector<CHVertex>& targets );
+
+    ///
+    /// Costs from origin to each target
+    /// \param[out] costs Costs indexed like the targets given to the constructor
+    void one_to_many( CHVertex origin, std::vector<float>& costs ) const;
+
+    ///
+    /// Number of vertices of the restricted graph
+    size_t num_vertices() const { return vertices_.size(); }
+
+private:
+    const CHRoutingData& rd_;
+
+    // vertices of the restricted graph, by decreasing CH order
+    std::vector<CHVertex> vertices_;
+
+    // CH vertex -> index in vertices_, or NotSelected
+    std::vector<uint32_t> local_index_;
+    static const uint32_t NotSelected = uint32_t(-1);
+
+    struct DownwardEdge
+    {
+        // local index of the source (a higher vertex, thus a lower local index)
+        uint32_t source;
+        float cost;
+    };
+    // downward edges of the restricted graph, grouped by target
+    std::vector<DownwardEdge> edges_;
+    // first edge of each local vertex in edges_ (size = vertices_.size() + 1)
+    std::vector<uint32_t> first_edge_;
+
+    // local index of each target
+    std::vector<uint32_t> targets_;
+};
+
+} // namespace Tempus
+
+#endif
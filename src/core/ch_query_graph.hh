@@ -19,6 +19,7 @@
 
 #include <type_traits>
 #include <iterator>
+#include <algorithm>
 #include "serializers.hh"
 
 namespace Tempus
@@ -36,6 +37,9 @@ namespace Tempus
 // EdgeProperty: data type of each edge (usually a cost and a shortcut flag)
 // EdgeIndex: type of an index in the edge array
 //
+// Edges are also identified by their index in the edge array, which is stable once the graph is built.
+// Edge properties may then refer to other edges (e.g. the two edges a shortcut replaces)
+//
 // Vertex are represented by their CH ordering number
 template <typename EP,
           typename VI = uint32_t,
@@ -98,7 +102,7 @@ public:
 
             edge_index_[v].first_downward_edge = edges_.size();
             if ( vp != vp_end && vp->first == v ) {
-                for ( ; v == vp->first; vp++, ep++ ) {
+                for ( ; vp != vp_end && v == vp->first; vp++, ep++ ) {
                     BOOST_ASSERT( vp->first == v ); // check the downward degreee is ok
                     EdgeData data;
                     data.target = vp->second;
@@ -143,15 +147,18 @@ public:
     {
     public:
         EdgeDescriptor() : prop_(nullptr) {}
-        EdgeDescriptor( VertexIndex src, VertexIndex tgt, const EdgeProperty* prop, bool upward ) : source_(src), target_(tgt), prop_(prop), upward_(upward) {}
+        EdgeDescriptor( VertexIndex src, VertexIndex tgt, const EdgeProperty* prop, bool upward, EdgeIndex idx ) : source_(src), target_(tgt), prop_(prop), upward_(upward), index_(idx) {}
         VertexIndex source() const { return source_; }
         VertexIndex target() const { return target_; }
         const EdgeProperty& property() const { return *prop_; }
         bool is_upward() const { return upward_; }
+        /// index of the edge in the edge array
+        EdgeIndex index() const { return index_; }
     private:
         VertexIndex source_, target_;
         const EdgeProperty* prop_;
         bool upward_;
+        EdgeIndex index_;
     };
 
     typedef EdgeDescriptor edge_descriptor;
@@ -159,39 +166,41 @@ public:
     class OutEdgeIterator
     {
     public:
-        OutEdgeIterator( VertexIndex source, const EdgeData* data ) : source_(source), data_(data), v_( source, data->target, &data->property, true ) {}
+        OutEdgeIterator( VertexIndex source, const EdgeData* edges, EdgeIndex idx ) : source_(source), edges_(edges), idx_(idx), v_( source, edges[idx].target, &edges[idx].property, true, idx ) {}
         EdgeDescriptor operator*() { return v_; }
         EdgeDescriptor* operator->() { return &v_; }
-        void operator++() { data_++; v_ = EdgeDescriptor(source_, data_->target, &data_->property, true); }
+        void operator++() { idx_++; v_ = EdgeDescriptor(source_, edges_[idx_].target, &edges_[idx_].property, true, idx_); }
         void operator++(int) { this->operator++(); }
-        bool operator==( const OutEdgeIterator& other ) const { return other.source_ == source_ && other.data_ == data_; }
+        bool operator==( const OutEdgeIterator& other ) const { return other.source_ == source_ && other.idx_ == idx_; }
         bool operator!=( const OutEdgeIterator& other ) const { return !(*this == other); }
     private:
         VertexIndex source_;
-        const EdgeData* data_;
+        const EdgeData* edges_;
+        EdgeIndex idx_;
         EdgeDescriptor v_;
     };
 
     class InEdgeIterator
     {
     public:
-        InEdgeIterator( VertexIndex source, const EdgeData* data ) : source_(source), data_(data), v_( data->target, source_, &data_->property, false ) {}
+        InEdgeIterator( VertexIndex source, const EdgeData* edges, EdgeIndex idx ) : source_(source), edges_(edges), idx_(idx), v_( edges[idx].target, source, &edges[idx].property, false, idx ) {}
         EdgeDescriptor operator*() { return v_; }
         EdgeDescriptor* operator->() { return &v_; }
-        void operator++() { data_++; v_ = EdgeDescriptor(data_->target, source_, &data_->property, false ); }
+        void operator++() { idx_++; v_ = EdgeDescriptor(edges_[idx_].target, source_, &edges_[idx_].property, false, idx_ ); }
         void operator++(int) { this->operator++(); }
-        bool operator==( const InEdgeIterator& other ) const { return other.source_ == source_ && other.data_ == data_; }
+        bool operator==( const InEdgeIterator& other ) const { return other.source_ == source_ && other.idx_ == idx_; }
         bool operator!=( const InEdgeIterator& other ) const { return !(*this == other); }
     private:
         VertexIndex source_;
-        const EdgeData* data_;
+        const EdgeData* edges_;
+        EdgeIndex idx_;
         EdgeDescriptor v_;
     };
 
     std::pair<OutEdgeIterator, OutEdgeIterator> out_edges( VertexIndex v ) const
     {
-        return std::make_pair( OutEdgeIterator( v, &edges_[edge_index_[v].first_upward_edge] ),
-                               OutEdgeIterator( v, &edges_[edge_index_[v].first_downward_edge] ) );
+        return std::make_pair( OutEdgeIterator( v, edges_.data(), edge_index_[v].first_upward_edge ),
+                               OutEdgeIterator( v, edges_.data(), edge_index_[v].first_downward_edge ) );
     }
 
     size_t out_degree( VertexIndex v ) const
@@ -201,8 +210,8 @@ public:
 
     std::pair<InEdgeIterator, InEdgeIterator> in_edges( VertexIndex v ) const
     {
-        return std::make_pair( InEdgeIterator( v, &edges_[edge_index_[v].first_downward_edge] ),
-                               InEdgeIterator( v, &edges_[edge_index_[v+1].first_upward_edge] ) );
+        return std::make_pair( InEdgeIterator( v, edges_.data(), edge_index_[v].first_downward_edge ),
+                               InEdgeIterator( v, edges_.data(), edge_index_[v+1].first_upward_edge ) );
     }
 
     size_t in_degree( VertexIndex v ) const
@@ -212,13 +221,25 @@ public:
 
     size_t num_vertices() const { return edge_index_.size() - 1; }
 
+    ///
+    /// Hint the processor to load the edges of v, that will be read soon.
+    /// Upward and downward edges of a vertex are contiguous, only the first cache line is requested
+    void prefetch_edges( VertexIndex v ) const
+    {
+#if defined(__GNUC__)
+        __builtin_prefetch( &edges_[edge_index_[v].first_upward_edge] );
+#else
+        (void)v;
+#endif
+    }
+
     class EdgeIterator
     {
     public:
         EdgeIterator( VertexIndex source, EdgeIndex edge, CHQueryGraph<EdgeProperty, VertexIndex, EdgeIndex>& graph )
             :
             source_(source), edge_(edge), graph_(graph),
-            v_( source_, graph_.edges_[edge_].target, &graph_.edges_[edge_].property, true )
+            v_( source_, graph_.edges_[edge_].target, &graph_.edges_[edge_].property, true, edge_ )
         {
             update_();
         }
@@ -260,10 +281,10 @@ public:
             }
 
             if ( out ) {
-                v_ = EdgeDescriptor( source_, graph_.edges_[edge_].target, &graph_.edges_[edge_].property, true );
+                v_ = EdgeDescriptor( source_, graph_.edges_[edge_].target, &graph_.edges_[edge_].property, true, edge_ );
             }
             else {
-                v_ = EdgeDescriptor( graph_.edges_[edge_].target, source_, &graph_.edges_[edge_].property, false );
+                v_ = EdgeDescriptor( graph_.edges_[edge_].target, source_, &graph_.edges_[edge_].property, false, edge_ );
             }
         }
         VertexIndex source_;
@@ -284,7 +305,7 @@ public:
             EdgeIndex t = edge_index_[u].first_downward_edge;
             for ( EdgeIndex i = s; i < t; i++ ) {
                 if ( edges_[i].target == v ) {
-                    return std::make_pair(EdgeDescriptor( u, v, &edges_[i].property, true ), true);
+                    return std::make_pair(EdgeDescriptor( u, v, &edges_[i].property, true, i ), true);
                 }
             }
         }
@@ -293,11 +314,34 @@ public:
             EdgeIndex t = edge_index_[v+1].first_upward_edge;
             for ( EdgeIndex i = s; i < t; i++ ) {
                 if ( edges_[i].target == u ) {
-                    return std::make_pair(EdgeDescriptor( u, v, &edges_[i].property, false ), true);
+                    return std::make_pair(EdgeDescriptor( u, v, &edges_[i].property, false, i ), true);
                 }
             }
         }
-        return std::make_pair(EdgeDescriptor( u, v, nullptr, true ), false );
+        return std::make_pair(EdgeDescriptor( u, v, nullptr, true, 0 ), false );
+    }
+
+    size_t num_edges() const { return edges_.size(); }
+
+    ///
+    /// Property of the edge of the given index, in constant time
+    const EdgeProperty& edge_property( EdgeIndex i ) const { return edges_[i].property; }
+
+    ///
+    /// Descriptor of the edge of the given index
+    /// The vertex the edge is stored at is found by a binary search on the first edge indices
+    EdgeDescriptor edge_from_index( EdgeIndex i ) const
+    {
+        auto it = std::upper_bound( edge_index_.begin(), edge_index_.end(), i, []( EdgeIndex idx, const FirstEdgeIndex& f ) {
+                return idx < f.first_upward_edge;
+            });
+        BOOST_ASSERT( it != edge_index_.begin() );
+        --it;
+        const VertexIndex v = VertexIndex( it - edge_index_.begin() );
+        if ( i < it->first_downward_edge ) {
+            return EdgeDescriptor( v, edges_[i].target, &edges_[i].property, true, i );
+        }
+        return EdgeDescriptor( edges_[i].target, v, &edges_[i].property, false, i );
     }
 
     void serialize( std::ostream& ostr, binary_serialization_t t ) const
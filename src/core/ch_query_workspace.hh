@@ -0,0 +1,119 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CH_QUERY_WORKSPACE_HH
+#define TEMPUS_CH_QUERY_WORKSPACE_HH
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "utils/d_ary_heap.hh"
+
+namespace Tempus
+{
+
+///
+/// Memory used by one direction of a CH query.
+///
+/// Distance and predecessor arrays are allocated once for the whole graph and reused from one query
+/// to the next. A vertex is considered as reached during the current search only if its epoch matches
+/// the current one, so that starting a new search does not need to reinitialize the arrays.
+///
+/// The predecessor of a vertex is the index of the edge it has been reached by,
+/// see CHQueryGraph::edge_from_index()
+template <typename Vertex, typename Cost, typename EdgeIndex = uint32_t>
+class CHSearchSpace
+{
+public:
+    typedef uint32_t Epoch;
+
+    /// predecessor of the origin of a search
+    static EdgeIndex no_edge() { return std::numeric_limits<EdgeIndex>::max(); }
+
+    ///
+    /// Start a new search on a graph of n vertices
+    void reset( size_t n )
+    {
+        if ( epoch_.size() != n ) {
+            cost_.resize( n );
+            predecessor_.resize( n );
+            epoch_.assign( n, 0 );
+            current_epoch_ = 0;
+            queue_.resize( n );
+        }
+        queue_.clear();
+        current_epoch_++;
+        if ( current_epoch_ == 0 ) {
+            // wrap around
+            std::fill( epoch_.begin(), epoch_.end(), 0 );
+            current_epoch_ = 1;
+        }
+    }
+
+    bool reached( Vertex v ) const { return epoch_[v] == current_epoch_; }
+
+    ///
+    /// Cost of the vertex in the current search, infinity if it has not been reached
+    Cost cost( Vertex v ) const { return reached( v ) ? cost_[v] : std::numeric_limits<Cost>::max(); }
+
+    EdgeIndex predecessor_edge( Vertex v ) const { return predecessor_[v]; }
+
+    void set( Vertex v, Cost c, EdgeIndex pred )
+    {
+        epoch_[v] = current_epoch_;
+        cost_[v] = c;
+        predecessor_[v] = pred;
+    }
+
+    DAryHeap<Vertex, Cost>& queue() { return queue_; }
+
+private:
+    std::vector<Cost> cost_;
+    std::vector<EdgeIndex> predecessor_;
+    std::vector<Epoch> epoch_;
+    Epoch current_epoch_ = 0;
+    DAryHeap<Vertex, Cost> queue_;
+};
+
+///
+/// Memory of a bidirectional CH query.
+/// A workspace is not thread safe, see ch_query_workspace()
+template <typename Vertex, typename Cost>
+struct CHQueryWorkspace
+{
+    /// forward and backward search spaces
+    CHSearchSpace<Vertex, Cost> search[2];
+
+    void reset( size_t n )
+    {
+        search[0].reset( n );
+        search[1].reset( n );
+    }
+};
+
+///
+/// Returns the workspace of the calling thread
+template <typename Vertex, typename Cost>
+CHQueryWorkspace<Vertex, Cost>& ch_query_workspace()
+{
+    static thread_local CHQueryWorkspace<Vertex, Cost> workspace;
+    return workspace;
+}
+
+} // namespace Tempus
+
+#endif
@@ -15,18 +15,21 @@
  */
 
 #include "ch_routing_data.hh"
+#include "ch_contracted_graph.hh"
 #include "db.hh"
 
 #include <fstream>
+#include <tuple>
+#include <algorithm>
 #include <boost/format.hpp>
 
 namespace Tempus
 {
 
-CHRoutingData::CHRoutingData( std::unique_ptr<CHQuery> a_ch_query, MiddleNodeMap&& a_middle_node, std::vector<db_id_t>&& a_node_id) :
+CHRoutingData::CHRoutingData( std::unique_ptr<CHQuery> a_ch_query, std::vector<CHEdgeOrigin>&& a_edge_origin, std::vector<db_id_t>&& a_node_id) :
     RoutingData( "ch_graph" ),
     ch_query_( std::move(a_ch_query) ),
-    middle_node_( a_middle_node ),
+    edge_origin_( std::move( a_edge_origin ) ),
     node_id_( a_node_id )
 {
     // update the reverse id map
@@ -49,10 +52,108 @@ db_id_t CHRoutingData::vertex_id( CHVertex v ) const
     return node_id_[v];
 }
 
+const uint32_t CHContractedEdge::NoMiddle;
+
+std::unique_ptr<CHQuery> ch_query_from_contraction( uint32_t num_vertices, std::vector<CHContractedEdge>& contracted_edges, std::vector<CHEdgeOrigin>& origins )
+{
+    // order of the query graph: lower vertex, upward edges first, higher vertex
+    // and the cheapest edge first among duplicates
+    auto key = []( const CHContractedEdge& e ) {
+        return std::make_tuple( std::min( e.source, e.target ), e.source > e.target, std::max( e.source, e.target ), e.cost );
+    };
+    std::sort( contracted_edges.begin(), contracted_edges.end(), [&key]( const CHContractedEdge& a, const CHContractedEdge& b ) {
+            return key( a ) < key( b );
+        });
+
+    // we may have the same edges with different costs
+    // we then skip the duplicates and only take
+    // the first one (the one with the smallest weight)
+    contracted_edges.erase( std::unique( contracted_edges.begin(), contracted_edges.end(), []( const CHContractedEdge& a, const CHContractedEdge& b ) {
+                return a.source == b.source && a.target == b.target;
+            }), contracted_edges.end() );
+
+    // the position of an edge is now its index in the query graph
+    auto edge_index = [&contracted_edges, &key]( uint32_t u, uint32_t v ) {
+        CHContractedEdge e;
+        e.source = u;
+        e.target = v;
+        e.cost = 0;
+        auto it = std::lower_bound( contracted_edges.begin(), contracted_edges.end(), e, [&key]( const CHContractedEdge& a, const CHContractedEdge& b ) {
+                return key( a ) < key( b );
+            });
+        if ( it == contracted_edges.end() || it->source != u || it->target != v ) {
+            throw std::runtime_error( (boost::format( "Missing edge (%1%,%2%) of a shortcut" ) % u % v).str() );
+        }
+        return uint32_t( it - contracted_edges.begin() );
+    };
+
+    std::vector<std::pair<uint32_t,uint32_t>> targets;
+    std::vector<CHEdgeProperty> properties;
+    origins.clear();
+    std::vector<uint32_t> up_degrees( num_vertices, 0 );
+
+    for ( const CHContractedEdge& e : contracted_edges ) {
+        CHEdgeProperty p;
+        p.b.cost = e.cost;
+        p.b.is_shortcut = e.middle != CHContractedEdge::NoMiddle;
+        CHEdgeOrigin o;
+        if ( p.b.is_shortcut ) {
+            o.child[0] = edge_index( e.source, e.middle );
+            o.child[1] = edge_index( e.middle, e.target );
+        }
+        else {
+            o.db_id = e.db_id;
+        }
+        if ( e.source < e.target ) {
+            up_degrees[e.source]++;
+        }
+        properties.push_back( p );
+        origins.push_back( o );
+        targets.push_back( std::make_pair( std::min( e.source, e.target ), std::max( e.source, e.target ) ) );
+    }
+
+    std::unique_ptr<CHQuery> ch_query( new CHQuery( targets.begin(), targets.end(), num_vertices, up_degrees.begin(), properties.begin() ) );
+
+    // check consistency
+    {
+        const CHQuery& ch = *ch_query;
+        for ( CHVertex v = 0; v < num_vertices; v++ ) {
+            for ( auto oeit = out_edges( v, ch ).first; oeit != out_edges( v, ch ).second; oeit++ ) {
+                BOOST_ASSERT( target( *oeit, ch ) > v );
+            }
+            for ( auto ieit = in_edges( v, ch ).first; ieit != in_edges( v, ch ).second; ieit++ ) {
+                BOOST_ASSERT( source( *ieit, ch ) > v );
+            }
+        }
+    }
+    {
+        auto it_end = edges( *ch_query ).second;
+        for ( auto it = edges( *ch_query ).first; it != it_end; it++ ) {
+            CHVertex u = source( *it, *ch_query );
+            CHVertex v = target( *it, *ch_query );
+            bool found = false;
+            CHEdge e;
+            std::tie( e, found ) = edge( u, v, *ch_query );
+            BOOST_ASSERT( found );
+            BOOST_ASSERT( u == source( e, *ch_query ) );
+            BOOST_ASSERT( v == target( e, *ch_query ) );
+            BOOST_ASSERT( it->property().b.cost == e.property().b.cost );
+            BOOST_ASSERT( it->index() == e.index() );
+        }
+    }
+
+    return ch_query;
+}
+
+std::unique_ptr<RoutingData> ch_routing_data_from_contraction( uint32_t num_vertices, std::vector<CHContractedEdge>& contracted_edges, std::vector<db_id_t>&& node_id )
+{
+    std::vector<CHEdgeOrigin> origins;
+    std::unique_ptr<CHQuery> ch_query = ch_query_from_contraction( num_vertices, contracted_edges, origins );
+    return std::unique_ptr<RoutingData>( new CHRoutingData( std::move( ch_query ), std::move( origins ), std::move( node_id ) ) );
+}
+
 std::unique_ptr<RoutingData> CHRoutingDataBuilder::pg_import( const std::string& pg_options, ProgressionCallback&, const VariantMap& options ) const
 {
-    std::unique_ptr<CHQuery> ch_query;
-    MiddleNodeMap middle_node;
     std::vector<db_id_t> node_id;
 
     std::string schema = "ch";
@@ -69,6 +170,7 @@ std::unique_ptr<RoutingData> CHRoutingDataBuilder::pg_import( const std::string&
         BOOST_ASSERT( r.size() == 1 );
         r[0][0] >> num_nodes;
     }
+    std::vector<CHContractedEdge> contracted_edges;
     {
         Db::ResultIterator res_it = conn.exec_it( (boost::format( "select * from\n"
                                                                   "(\n"
@@ -96,48 +198,11 @@ std::unique_ptr<RoutingData> CHRoutingDataBuilder::pg_import( const std::string&
                                                   );
         Db::ResultIterator it_end;
 
-        std::vector<std::pair<uint32_t,uint32_t>> targets;
-        std::vector<CHEdgeProperty> properties;
-        std::vector<uint16_t> up_degrees;
-
-        uint16_t upd = 0;
-        uint32_t old_id1 = 0;
-        uint32_t old_id2 = 0;
-        int old_dir = 0;
-        bool first = true;
         for ( ; res_it != it_end; res_it++ ) {
             Db::RowValue res_i = *res_it;
             uint32_t id1 = res_i[0].as<uint32_t>();
             uint32_t id2 = res_i[1].as<uint32_t>();
             int dir = res_i[4];
-            if ( first ) {
-                first = false;
-            }
-            else {
-                if ( (id1 == old_id1) && (id2 == old_id2) && (dir == old_dir) ) {
-                    // we may have the same edges with different costs
-                    // we then skip the duplicates and only take
-                    // the first one (the one with the smallest weight)
-                    continue;
-                }
-                if ( id1 > old_id1 ) {
-                    up_degrees.push_back( upd );
-                    if ( id1 > old_id1 + 1 ) {
-                        // update up_degrees for vertex without outgoing edges
-                        for ( uint32_t i = 0; i < id1 - old_id1 - 1; i++ ) {
-                            up_degrees.push_back( 0 );
-                        }
-                    }
-                    upd = 0;
-                }
-            }
-            old_id1 = id1;
-            old_id2 = id2;
-            old_dir = dir;
-
-            db_id_t vid1, vid2;
-            res_i[7] >> vid1;
-            res_i[8] >> vid2;
 
             db_id_t eid = 0;
             if ( !res_i[5].is_null() ) {
@@ -146,35 +211,15 @@ std::unique_ptr<RoutingData> CHRoutingDataBuilder::pg_import( const std::string&
             else if ( !res_i[6].is_null() ) {
                 res_i[6] >> eid;
             }
-            if ( dir == 0 ) {
-                upd++;
-            }
-            CHEdgeProperty p;
-            p.b.cost = res_i[2];
-            p.db_id = eid;
-            p.b.is_shortcut = 0;
-            if ( !res_i[3].is_null() ) {
-                uint32_t middle = res_i[3].as<uint32_t>();
-                // we have a middle node, it is a shortcut
-                p.b.is_shortcut = 1;
-                if ( dir == 0 ) {
-                    middle_node[std::make_pair(id1, id2)] = middle;
-                }
-                else {
-                    middle_node[std::make_pair(id2, id1)] = middle;
-                }
-            }
-            properties.emplace_back( p );
-            targets.emplace_back( std::make_pair(id1, id2) );
+            CHContractedEdge e;
+            // dir = 0: upward edge id1 -> id2, dir = 1: downward edge id2 -> id1
+            e.source = dir == 0 ? id1 : id2;
+            e.target = dir == 0 ? id2 : id1;
+            e.cost = res_i[2].as<uint32_t>();
+            e.middle = res_i[3].is_null() ? CHContractedEdge::NoMiddle : res_i[3].as<uint32_t>();
+            e.db_id = eid;
+            contracted_edges.push_back( e );
         }
-        up_degrees.push_back( upd );
-
-        for ( uint32_t i = 0; i < num_nodes - up_degrees.size(); i++ ) {
-            up_degrees.push_back( 0 );
-        }
-
-        ch_query.reset( new CHQueryGraph<CHEdgeProperty>( targets.begin(), targets.end(), num_nodes, up_degrees.begin(), properties.begin() ) );
-        std::cout << "OK" << std::endl;
     }
     {
         node_id.resize( num_nodes );
@@ -189,35 +234,8 @@ std::unique_ptr<RoutingData> CHRoutingDataBuilder::pg_import( const std::string&
         }
     }
 
-    // check consistency
-    {
-        CHQuery& ch = *ch_query;
-        for ( CHVertex v = 0; v < num_vertices(ch); v++ ) {
-            for ( auto oeit = out_edges( v, ch ).first; oeit != out_edges( v, ch ).second; oeit++ ) {
-                BOOST_ASSERT( target( *oeit, ch ) > v );
-            }
-            for ( auto ieit = in_edges( v, ch ).first; ieit != in_edges( v, ch ).second; ieit++ ) {
-                BOOST_ASSERT( source( *ieit, ch ) > v );
-            }
-        }
-    }
-    {
-        CHQuery& ch = *ch_query;
-        auto it_end = edges( ch ).second;
-        for ( auto it = edges( ch ).first; it != it_end; it++ ) {
-            CHVertex u = source( *it, ch );
-            CHVertex v = target( *it, ch );
-            bool found = false;
-            CHEdge e;
-            std::tie( e, found ) = edge( u, v, ch );
-            BOOST_ASSERT( found );
-            BOOST_ASSERT( u == source( e, ch ) );
-            BOOST_ASSERT( v == target( e, ch ) );
-            BOOST_ASSERT( it->property().b.cost == e.property().b.cost );
-        }
-    }
-
-    std::unique_ptr<RoutingData> rd( new CHRoutingData( std::move(ch_query), std::move(middle_node), std::move(node_id) ) );
+    std::unique_ptr<RoutingData> rd = ch_routing_data_from_contraction( num_nodes, contracted_edges, std::move( node_id ) );
+    std::cout << "OK" << std::endl;
 
     // import transport modes
     RoutingData::TransportModes all_modes = load_transport_modes( conn );
@@ -226,7 +244,7 @@ std::unique_ptr<RoutingData> CHRoutingDataBuilder::pg_import( const std::string&
     modes[TransportModeWalking] = all_modes[TransportModeWalking];
     rd->set_transport_modes( modes );
 
-    return std::move( rd );
+    return rd;
 }
 
 std::unique_ptr<RoutingData> CHRoutingDataBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression**/, const VariantMap& /*options*/ ) const
@@ -236,21 +254,23 @@ std::unique_ptr<RoutingData> CHRoutingDataBuilder::file_import( const std::strin
         throw std::runtime_error( "Problem opening input file " + filename );
     }
 
-    read_header( ifs );
+    if ( read_header( ifs ) < 3 ) {
+        throw std::runtime_error( "CH dump file " + filename + " uses an obsolete format, it must be generated again" );
+    }
 
     std::cout << "read graph" << std::endl;
     std::unique_ptr<CHQuery> query( new CHQuery() );
     query->unserialize( ifs, binary_serialization_t() );
 
-    std::cout << "read middle node" << std::endl;
-    MiddleNodeMap middle_node;
-    unserialize( ifs, middle_node, binary_serialization_t() );
+    std::cout << "read edge origins" << std::endl;
+    std::vector<CHEdgeOrigin> edge_origin;
+    unserialize( ifs, edge_origin, binary_serialization_t() );
 
     std::cout << "read node id" << std::endl;
     std::vector<db_id_t> node_id;
     unserialize( ifs, node_id, binary_serialization_t() );
 
-    std::unique_ptr<RoutingData> rd( new CHRoutingData( std::move( query ), std::move( middle_node ), std::move( node_id ) ) );
+    std::unique_ptr<RoutingData> rd( new CHRoutingData( std::move( query ), std::move( edge_origin ), std::move( node_id ) ) );
     return rd;
 }
 
@@ -265,8 +285,7 @@ void CHRoutingDataBuilder::file_export( const RoutingData* rd, const std::string
     // serialize the graph
     mrd->ch_query_->serialize( ofs, binary_serialization_t() );
 
-    // middle node
-    serialize( ofs, mrd->middle_node_, binary_serialization_t() );
+    serialize( ofs, mrd->edge_origin_, binary_serialization_t() );
     serialize( ofs, mrd->node_id_, binary_serialization_t() );
 }
 
@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "ch_query_graph.hh"
+#include "ch_contracted_graph.hh"
 #include "routing_data.hh"
 #include "routing_data_builder.hh"
 #include "serializers.hh"
@@ -27,6 +28,9 @@
 namespace Tempus
 {
 
+///
+/// Edge of a CH query graph, as read during a query: only its cost and its shortcut flag.
+/// Everything else is stored apart, see CHEdgeOrigin
 struct CHEdgeProperty
 {
     union {
@@ -36,16 +40,37 @@ struct CHEdgeProperty
         } b;
         uint32_t data;
     };
-    db_id_t db_id;
 
     void serialize( std::ostream& ostr, binary_serialization_t t ) const
     {
         Tempus::serialize( ostr, data, t );
-        Tempus::serialize( ostr, db_id, t );
     }
     void unserialize( std::istream& istr, binary_serialization_t t )
     {
         Tempus::unserialize( istr, data, t );
+    }
+};
+
+///
+/// What a CH edge stands for, only needed once a path is found.
+/// An original edge stores its road section id. A shortcut stores instead the indices
+/// of the two edges it replaces in the edge array of the query graph, so that a path is unpacked
+/// without any vertex lookup.
+struct CHEdgeOrigin
+{
+    union {
+        /// road section id of an original edge
+        db_id_t db_id;
+        /// edges (u,m) and (m,v) of a shortcut (u,v) of middle vertex m
+        uint32_t child[2];
+    };
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const
+    {
+        Tempus::serialize( ostr, db_id, t );
+    }
+    void unserialize( std::istream& istr, binary_serialization_t t )
+    {
         Tempus::unserialize( istr, db_id, t );
     }
 };
@@ -58,20 +83,21 @@ inline std::ostream& operator<<( std::ostream& ostr, const CHEdgeProperty& e )
 
 using CHQuery = CHQueryGraph<CHEdgeProperty>;
 
+// a query reads two edges per 16 bytes
+static_assert( sizeof( CHQuery::EdgeData ) == 8, "CH query edges are expected to be 8 bytes long" );
+
 using CHVertex = uint32_t;
 using CHEdge = CHQueryGraph<CHEdgeProperty>::edge_descriptor;
 
-///
-/// storage of the "middle" node, i.e. the node involved
-/// in a shortcut
-using MiddleNodeMap = std::map<std::pair<CHVertex, CHVertex>, CHVertex>;
-
 ///
 /// Routing data out of a CH query graph
+///
+/// Edges are split in two: the query graph only holds what a query reads (hot data)
+/// and the origin of each edge is in a parallel array, indexed by the edge index (cold data).
 class CHRoutingData : public RoutingData
 {
 public:
-    CHRoutingData( std::unique_ptr<CHQuery> ch_query, MiddleNodeMap&& middle_node, std::vector<db_id_t>&& node_id);
+    CHRoutingData( std::unique_ptr<CHQuery> ch_query, std::vector<CHEdgeOrigin>&& edge_origin, std::vector<db_id_t>&& node_id);
 
     boost::optional<CHVertex> vertex_from_id( db_id_t id ) const;
 
@@ -79,14 +105,14 @@ public:
 
     const CHQuery& ch_query() const { return *ch_query_; }
 
-    const MiddleNodeMap& middle_node() const { return middle_node_; }
+    const CHEdgeOrigin& edge_origin( CHQuery::EdgeIndex e ) const { return edge_origin_[e]; }
 
 private:
     // the CH graph
     std::unique_ptr<CHQuery> ch_query_;
 
-    // middle node of a shortcut
-    MiddleNodeMap middle_node_;
+    // edge index -> road section or child edges
+    std::vector<CHEdgeOrigin> edge_origin_;
 
     // node index -> node id
     std::vector<db_id_t> node_id_;
@@ -95,6 +121,7 @@ private:
     std::map<db_id_t, size_t> rnode_id_;
 
     friend class CHRoutingDataBuilder;
+    friend class HubLabelRoutingDataBuilder;
 };
 
 class CHRoutingDataBuilder : public RoutingDataBuilder
@@ -107,9 +134,19 @@ public:
     virtual std::unique_ptr<RoutingData> file_import( const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
     virtual void file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
 
-    uint32_t version() const { return 1; }
+    /// version 2: shortcuts store their child edges instead of a middle node map
+    /// version 3: edge origins are stored apart from the query graph
+    uint32_t version() const { return 3; }
 };
 
+///
+/// Builds a CH query graph out of the edges of a contracted graph, see ch_routing_data_from_contraction().
+/// Routing data that add their own information to a CH query graph use it directly.
+/// \param[in] num_vertices Number of vertices
+/// \param[in,out] contracted_edges Edges of the graph, sorted and deduplicated in place
+/// \param[out] origins Origin of each edge of the query graph, by edge index
+std::unique_ptr<CHQuery> ch_query_from_contraction( uint32_t num_vertices, std::vector<CHContractedEdge>& contracted_edges, std::vector<CHEdgeOrigin>& origins );
+
 } // namespace Tempus
 
 #endif
@@ -0,0 +1,135 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_CH_UPWARD_SEARCH_HH
+#define TEMPUS_CH_UPWARD_SEARCH_HH
+
+#include <limits>
+
+#include "ch_query_graph.hh"
+#include "ch_query_workspace.hh"
+
+namespace Tempus
+{
+
+///
+/// Direction of a search in the upward graph
+enum class CHDirection
+{
+    /// search from a source, on upward edges (out_edges)
+    Forward,
+    /// search from a target, on the reverse of downward edges (in_edges)
+    Backward
+};
+
+///
+/// Dijkstra search in the upward graph, with stall-on-demand.
+///
+/// The search is not bounded by a target: every vertex of the upward search space that is not pruned is settled,
+/// which is what one-to-many algorithms (many-to-many, PHAST, transit nodes) need.
+/// \param[in] graph The CH query graph
+/// \param[in] origin The vertex the search starts from
+/// \param[in] dir Direction of the search
+/// \param[in] weight Function that gives the cost of an edge descriptor
+/// \param[inout] search Search space used to store costs. It is reset by this function
+/// \param[in] visitor Function called with (vertex, cost) on each settled vertex that is not stalled
+/// \param[in] prune Predicate on vertices. The edges of a visited vertex for which it is true are not relaxed,
+///                  which bounds the search (for instance below the transit nodes)
+/// \returns the number of settled vertices
+template <typename Graph, typename Cost, typename WeightFunction, typename Visitor, typename Prune>
+size_t ch_upward_search( const Graph& graph,
+                         typename Graph::VertexIndex origin,
+                         CHDirection dir,
+                         WeightFunction weight,
+                         CHSearchSpace<typename Graph::VertexIndex, Cost>& search,
+                         Visitor visitor,
+                         Prune prune )
+{
+    typedef typename Graph::VertexIndex Vertex;
+    const Cost infinity = std::numeric_limits<Cost>::max();
+
+    search.reset( num_vertices( graph ) );
+    search.set( origin, 0, search.no_edge() );
+    search.queue().push( origin, 0 );
+
+    auto relax = [&search]( Cost pi, Vertex v, Cost cost, typename Graph::EdgeIndex e ) {
+        if ( pi + cost < search.cost( v ) ) {
+            search.set( v, pi + cost, e );
+            search.queue().push_or_decrease( v, pi + cost );
+        }
+    };
+
+    size_t settled = 0;
+    while ( !search.queue().empty() ) {
+        Vertex u = search.queue().top();
+        Cost pi = search.queue().top_key();
+        search.queue().pop();
+        settled++;
+
+        // stall-on-demand, look for a shorter path through a higher vertex
+        bool stalled = false;
+        if ( dir == CHDirection::Forward ) {
+            for ( auto iei = in_edges( u, graph ).first; !stalled && iei != in_edges( u, graph ).second; iei++ ) {
+                Cost w_pi = search.cost( source( *iei, graph ) );
+                stalled = w_pi != infinity && w_pi + weight( *iei ) < pi;
+            }
+        }
+        else {
+            for ( auto oei = out_edges( u, graph ).first; !stalled && oei != out_edges( u, graph ).second; oei++ ) {
+                Cost w_pi = search.cost( target( *oei, graph ) );
+                stalled = w_pi != infinity && w_pi + weight( *oei ) < pi;
+            }
+        }
+        if ( stalled ) {
+            continue;
+        }
+
+        visitor( u, pi );
+
+        if ( prune( u ) ) {
+            continue;
+        }
+
+        if ( dir == CHDirection::Forward ) {
+            for ( auto oei = out_edges( u, graph ).first; oei != out_edges( u, graph ).second; oei++ ) {
+                relax( pi, target( *oei, graph ), weight( *oei ), oei->index() );
+            }
+        }
+        else {
+            for ( auto iei = in_edges( u, graph ).first; iei != in_edges( u, graph ).second; iei++ ) {
+                relax( pi, source( *iei, graph ), weight( *iei ), iei->index() );
+            }
+        }
+    }
+    return settled;
+}
+
+///
+/// Full Dijkstra search in the upward graph, with stall-on-demand and without pruning
+template <typename Graph, typename Cost, typename WeightFunction, typename Visitor>
+size_t ch_upward_search( const Graph& graph,
+                         typename Graph::VertexIndex origin,
+                         CHDirection dir,
+                         WeightFunction weight,
+                         CHSearchSpace<typename Graph::VertexIndex, Cost>& search,
+                         Visitor visitor )
+{
+    return ch_upward_search( graph, origin, dir, weight, search, visitor, []( typename Graph::VertexIndex ) { return false; } );
+}
+
+} // namespace Tempus
+
+#endif
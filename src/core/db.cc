@@ -22,7 +22,6 @@
 #include <libpq-fe.h>
 
 namespace Db {
-boost::mutex Connection::mutex;
 
 template <>
 bool Value::as<bool>() const
@@ -264,7 +263,7 @@ void Connection::connect( const std::string& db_options )
     timer_.start();
     boost::timer::nanosecond_type start = timer_.elapsed().wall;
 #endif
-    boost::lock_guard<boost::mutex> lock( mutex );
+    // libpq is thread-safe (see the constructor), connections can be opened in parallel
     conn_ = PQconnectdb( db_options.c_str() );
 
     if ( conn_ == NULL || PQstatus( conn_ ) != CONNECTION_OK ) {
@@ -319,6 +318,124 @@ Result Connection::exec( const std::string& query ) throw ( std::runtime_error )
     return res;
 }
 
+Result Connection::exec_prepared( const std::string& name, const std::string& query, const std::vector<std::string>& params ) throw ( std::runtime_error )
+{
+    if ( prepared_.find( name ) == prepared_.end() ) {
+        pg_result* res = PQprepare( conn_, name.c_str(), query.c_str(), int( params.size() ), NULL );
+        if ( PQresultStatus( res ) != PGRES_COMMAND_OK ) {
+            std::string msg = "Problem preparing statement " + name + ": ";
+            msg += PQresultErrorMessage( res );
+            PQclear( res );
+            throw std::runtime_error( msg.c_str() );
+        }
+        PQclear( res );
+        prepared_.insert( name );
+    }
+
+    std::vector<const char*> values( params.size() );
+    for ( size_t i = 0; i < params.size(); i++ ) {
+        values[i] = params[i].c_str();
+    }
+
+    pg_result* res = PQexecPrepared( conn_, name.c_str(), int( params.size() ), values.empty() ? NULL : &values[0], NULL, NULL, 0 );
+    ExecStatusType ret = PQresultStatus( res );
+
+    if ( ( ret != PGRES_COMMAND_OK ) && ( ret != PGRES_TUPLES_OK ) ) {
+        std::string msg = "Problem on database query: ";
+        msg += PQresultErrorMessage( res );
+        PQclear( res );
+        throw std::runtime_error( msg.c_str() );
+    }
+
+    return res;
+}
+
+bool Connection::is_usable()
+{
+    if ( !conn_ ) {
+        return false;
+    }
+    if ( PQstatus( conn_ ) != CONNECTION_OK ) {
+        // prepared statements do not survive a reset
+        prepared_.clear();
+        PQreset( conn_ );
+        if ( PQstatus( conn_ ) != CONNECTION_OK ) {
+            return false;
+        }
+    }
+    // a query still running (an unfinished cursor) or an open transaction would leak to the next user
+    return PQtransactionStatus( conn_ ) == PQTRANS_IDLE;
+}
+
+ConnectionPool& ConnectionPool::instance()
+{
+    static ConnectionPool pool;
+    return pool;
+}
+
+ConnectionPool::ConnectionPool( size_t max_idle )
+    : max_idle_( max_idle )
+{
+}
+
+std::unique_ptr<Connection> ConnectionPool::acquire( const std::string& db_options )
+{
+    for ( ;; ) {
+        std::unique_ptr<Connection> connection;
+        {
+            boost::lock_guard<boost::mutex> lock( mutex_ );
+            auto it = idle_.find( db_options );
+            if ( it == idle_.end() || it->second.empty() ) {
+                break;
+            }
+            connection = std::move( it->second.back() );
+            it->second.pop_back();
+        }
+        // the health check may reconnect, do it without the lock
+        if ( connection->is_usable() ) {
+            return connection;
+        }
+    }
+
+    return std::unique_ptr<Connection>( new Connection( db_options ) );
+}
+
+void ConnectionPool::release( const std::string& db_options, std::unique_ptr<Connection> connection )
+{
+    if ( !connection || !connection->is_usable() ) {
+        return;
+    }
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    std::vector<std::unique_ptr<Connection>>& idle = idle_[db_options];
+    if ( idle.size() < max_idle_ ) {
+        idle.push_back( std::move( connection ) );
+    }
+}
+
+size_t ConnectionPool::idle_connections( const std::string& db_options ) const
+{
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    auto it = idle_.find( db_options );
+    return it == idle_.end() ? 0 : it->second.size();
+}
+
+void ConnectionPool::clear()
+{
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    idle_.clear();
+}
+
+PooledConnection::PooledConnection( const std::string& db_options )
+    : db_options_( db_options ),
+      connection_( ConnectionPool::instance().acquire( db_options ) )
+{
+}
+
+PooledConnection::~PooledConnection()
+{
+    ConnectionPool::instance().release( db_options_, std::move( connection_ ) );
+}
+
 } // namespace Db
 
 
@@ -24,11 +24,16 @@
    * A Db::Result objet represents result of a query. It is a lightweighted objet that is reference-counted and thus can be copied safely.
    * A Db::RowValue object represents a row of a result and is obtained by Db::Result::operator[]
    * A Db::Value object represent a basic value. It is obtained by Db::RowValue::operator[]. It has templated conversion operators for common data types.
+   * A Db::PooledConnection object is a connection borrowed from the process-wide Db::ConnectionPool, given back when it is destroyed.
 
    These classes throw std::runtime_error on problem.
  */
 
 #include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
 #include <stdexcept>
 
 #ifdef _WIN32
@@ -206,14 +211,81 @@ public:
     /// Query execution using a cursor
     ResultIterator exec_it( const std::string& query ) throw ( std::runtime_error );
 
+    ///
+    /// Execution of a prepared statement. The statement is prepared on the first call with a given name,
+    /// and then reused for the lifetime of the connection.
+    /// \param[in] name Name of the statement, must always refer to the same query on a connection
+    /// \param[in] query The query, with $1, $2, ... as parameters
+    /// \param[in] params Values of the parameters, in text format
+    Result exec_prepared( const std::string& name, const std::string& query, const std::vector<std::string>& params ) throw ( std::runtime_error );
+
+    ///
+    /// Health check. Tries to reset a broken connection.
+    /// Returns true if the connection is usable for a new query: it is established and is not in the middle of a query
+    /// or a transaction.
+    bool is_usable();
+
 protected:
     pg_conn* conn_;
-    static boost::mutex mutex;
+    // names of the statements prepared on this connection
+    std::set<std::string> prepared_;
 
 #ifdef DB_TIMING
     boost::timer::cpu_timer timer_;
 #endif
 };
+
+///
+/// Thread-safe pool of connections, by connection string.
+///
+/// Connections are kept open between requests, along with their prepared statements.
+/// An idle connection is checked (see Connection::is_usable()) before being given again, broken ones are dropped.
+/// Connections are opened outside of any lock, so that a slow connection does not block other threads.
+class ConnectionPool: boost::noncopyable {
+public:
+    ///
+    /// The process-wide pool
+    static ConnectionPool& instance();
+
+    explicit ConnectionPool( size_t max_idle = 16 );
+
+    ///
+    /// Gets an idle connection or opens a new one. Throws std::runtime_error if the connection fails.
+    std::unique_ptr<Connection> acquire( const std::string& db_options );
+
+    ///
+    /// Gives back a connection. It is kept if it is usable and if there are less than max_idle idle connections
+    /// for these options, it is closed otherwise.
+    void release( const std::string& db_options, std::unique_ptr<Connection> connection );
+
+    ///
+    /// Number of idle connections for the given options
+    size_t idle_connections( const std::string& db_options ) const;
+
+    ///
+    /// Close all idle connections
+    void clear();
+
+private:
+    size_t max_idle_;
+    std::map<std::string, std::vector<std::unique_ptr<Connection>>> idle_;
+    mutable boost::mutex mutex_;
+};
+
+///
+/// A connection borrowed from ConnectionPool::instance() for the lifetime of this object
+class PooledConnection: boost::noncopyable {
+public:
+    explicit PooledConnection( const std::string& db_options );
+    ~PooledConnection();
+
+    Connection& operator*() { return *connection_; }
+    Connection* operator->() { return connection_.get(); }
+
+private:
+    std::string db_options_;
+    std::unique_ptr<Connection> connection_;
+};
 }
 
 #endif
@@ -0,0 +1,105 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_DEADLINE_HH
+#define TEMPUS_DEADLINE_HH
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+namespace Tempus
+{
+
+///
+/// Thrown by a search that has been interrupted, because its request has reached its deadline or has been cancelled
+class DeadlineExceeded : public std::runtime_error
+{
+public:
+    explicit DeadlineExceeded( const std::string& msg ) : std::runtime_error( msg ) {}
+};
+
+///
+/// Deadline and cancellation token of a request
+///
+/// Search loops call check() on each iteration. Only a decrement is done most of the time, the cancellation flag
+/// and the clock are looked at every CheckPeriod calls.
+/// cancel() may be called from any thread, the other methods from the thread that processes the request.
+class Deadline
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /// Number of calls to check() between two reads of the clock
+    static const unsigned CheckPeriod = 1024;
+
+    Deadline() : expiry_( Clock::time_point::max() ), cancelled_( false ), countdown_( CheckPeriod ) {}
+
+    ///
+    /// Start a new deadline, timeout_s seconds from now, and clear a previous cancellation
+    /// \param[in] timeout_s Timeout in seconds, no deadline if it is not positive
+    void start( double timeout_s )
+    {
+        if ( timeout_s > 0 ) {
+            expiry_ = Clock::now() + std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( timeout_s ) );
+        }
+        else {
+            expiry_ = Clock::time_point::max();
+        }
+        cancelled_.store( false, std::memory_order_relaxed );
+        countdown_ = CheckPeriod;
+    }
+
+    /// Whether a timeout has been set by start()
+    bool has_timeout() const { return expiry_ != Clock::time_point::max(); }
+
+    ///
+    /// Cancel the request. The search stops at its next clock read.
+    void cancel() { cancelled_.store( true, std::memory_order_relaxed ); }
+
+    bool cancelled() const { return cancelled_.load( std::memory_order_relaxed ); }
+
+    ///
+    /// Whether the request has been cancelled or has reached its deadline
+    bool expired() const
+    {
+        return cancelled() || ( has_timeout() && Clock::now() >= expiry_ );
+    }
+
+    ///
+    /// Throws DeadlineExceeded if the request has expired, this is only tested every CheckPeriod calls
+    void check()
+    {
+        if ( --countdown_ == 0 ) {
+            countdown_ = CheckPeriod;
+            if ( cancelled() ) {
+                throw DeadlineExceeded( "Request cancelled" );
+            }
+            if ( has_timeout() && Clock::now() >= expiry_ ) {
+                throw DeadlineExceeded( "Request timeout" );
+            }
+        }
+    }
+
+private:
+    Clock::time_point expiry_;
+    std::atomic<bool> cancelled_;
+    unsigned countdown_;
+};
+
+} // namespace Tempus
+
+#endif
@@ -0,0 +1,384 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hub_label_routing_data.hh"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace Tempus
+{
+
+const uint32_t HubLabels::Infinity;
+
+namespace
+{
+
+void write_varint( std::vector<uint8_t>& out, uint32_t x )
+{
+    while ( x >= 0x80 ) {
+        out.push_back( uint8_t( x | 0x80 ) );
+        x >>= 7;
+    }
+    out.push_back( uint8_t( x ) );
+}
+
+inline uint32_t read_varint( const uint8_t*& p )
+{
+    uint32_t x = 0;
+    int shift = 0;
+    uint8_t b;
+    do {
+        b = *p++;
+        x |= uint32_t( b & 0x7f ) << shift;
+        shift += 7;
+    } while ( b & 0x80 );
+    return x;
+}
+
+///
+/// Minimum cost through a common hub of two decoded labels
+uint64_t merge_cost( const std::vector<HubLabels::Entry>& a, const std::vector<HubLabels::Entry>& b )
+{
+    uint64_t best = HubLabels::Infinity;
+    auto ia = a.begin();
+    auto ib = b.begin();
+    while ( ia != a.end() && ib != b.end() ) {
+        if ( ia->hub < ib->hub ) {
+            ia++;
+        }
+        else if ( ib->hub < ia->hub ) {
+            ib++;
+        }
+        else {
+            best = std::min( best, uint64_t( ia->cost ) + ib->cost );
+            ia++;
+            ib++;
+        }
+    }
+    return best;
+}
+
+// number of 64 bit words before the offsets: number of vertices, size of the label data
+const size_t HEADER_WORDS = 2;
+
+}
+
+HubLabels::HubLabels( const Labels& forward, const Labels& backward )
+{
+    BOOST_ASSERT( forward.size() == backward.size() );
+    const uint64_t n = forward.size();
+
+    std::vector<uint64_t> offsets;
+    std::vector<uint8_t> data;
+    for ( const Labels* labels : { &forward, &backward } ) {
+        for ( const std::vector<Entry>& label : *labels ) {
+            offsets.push_back( data.size() );
+            uint32_t previous = 0;
+            for ( const Entry& e : label ) {
+                write_varint( data, e.hub - previous );
+                write_varint( data, e.cost );
+                previous = e.hub;
+            }
+        }
+        offsets.push_back( data.size() );
+    }
+
+    buffer_.resize( ( HEADER_WORDS + offsets.size() ) * sizeof( uint64_t ) + data.size() );
+    uint64_t* words = reinterpret_cast<uint64_t*>( &buffer_[0] );
+    words[0] = n;
+    words[1] = data.size();
+    std::copy( offsets.begin(), offsets.end(), words + HEADER_WORDS );
+    if ( !data.empty() ) {
+        std::memcpy( &buffer_[0] + ( HEADER_WORDS + offsets.size() ) * sizeof( uint64_t ), &data[0], data.size() );
+    }
+    size_ = buffer_.size();
+    set_pointers( &buffer_[0] );
+}
+
+HubLabels::HubLabels( const std::string& filename, uint64_t offset, uint64_t size )
+{
+    using namespace boost::interprocess;
+    // the region must lie in the file, then the header and the offsets array must fit in the region before they are read
+    std::ifstream ifs( filename, std::ios::binary | std::ios::ate );
+    const uint64_t file_size = ifs ? uint64_t( ifs.tellg() ) : 0;
+    if ( size < HEADER_WORDS * sizeof( uint64_t ) || offset > file_size || size > file_size - offset ) {
+        throw std::runtime_error( "Inconsistent hub labels in " + filename );
+    }
+    file_mapping file( filename.c_str(), read_only );
+    region_.reset( new mapped_region( file, read_only, offset, size ) );
+    size_ = size;
+    const uint64_t n = static_cast<const uint64_t*>( region_->get_address() )[0];
+    const uint64_t words = size / sizeof( uint64_t );
+    if ( n >= words || HEADER_WORDS + 2 * ( n + 1 ) > words ) {
+        throw std::runtime_error( "Inconsistent hub labels in " + filename );
+    }
+    set_pointers( static_cast<const char*>( region_->get_address() ) );
+    const uint64_t expected = ( HEADER_WORDS + 2 * ( num_vertices_ + 1 ) ) * sizeof( uint64_t ) + offsets_[2 * ( num_vertices_ + 1 ) - 1];
+    if ( expected != size ) {
+        throw std::runtime_error( "Inconsistent hub labels in " + filename );
+    }
+}
+
+HubLabels::~HubLabels()
+{
+}
+
+void HubLabels::set_pointers( const char* base )
+{
+    const uint64_t* words = reinterpret_cast<const uint64_t*>( base );
+    num_vertices_ = words[0];
+    offsets_ = words + HEADER_WORDS;
+    data_ = reinterpret_cast<const uint8_t*>( offsets_ + 2 * ( num_vertices_ + 1 ) );
+}
+
+uint32_t HubLabels::cost( uint32_t s, uint32_t t, uint32_t* hub ) const
+{
+    const uint8_t* a = data_ + offsets_[s];
+    const uint8_t* a_end = data_ + offsets_[s + 1];
+    const uint8_t* b = data_ + offsets_[num_vertices_ + 1 + t];
+    const uint8_t* b_end = data_ + offsets_[num_vertices_ + 1 + t + 1];
+    if ( a == a_end || b == b_end ) {
+        return Infinity;
+    }
+
+    uint64_t best = Infinity;
+    uint32_t hub_a = read_varint( a );
+    uint32_t cost_a = read_varint( a );
+    uint32_t hub_b = read_varint( b );
+    uint32_t cost_b = read_varint( b );
+    for ( ;; ) {
+        if ( hub_a < hub_b ) {
+            if ( a == a_end ) {
+                break;
+            }
+            hub_a += read_varint( a );
+            cost_a = read_varint( a );
+        }
+        else if ( hub_b < hub_a ) {
+            if ( b == b_end ) {
+                break;
+            }
+            hub_b += read_varint( b );
+            cost_b = read_varint( b );
+        }
+        else {
+            const uint64_t c = uint64_t( cost_a ) + cost_b;
+            if ( c < best ) {
+                best = c;
+                if ( hub ) {
+                    *hub = hub_a;
+                }
+            }
+            if ( a == a_end || b == b_end ) {
+                break;
+            }
+            hub_a += read_varint( a );
+            cost_a = read_varint( a );
+            hub_b += read_varint( b );
+            cost_b = read_varint( b );
+        }
+    }
+    return uint32_t( best );
+}
+
+std::vector<HubLabels::Entry> HubLabels::label( uint32_t v, CHDirection dir ) const
+{
+    const uint64_t idx = dir == CHDirection::Forward ? v : num_vertices_ + 1 + v;
+    const uint8_t* p = data_ + offsets_[idx];
+    const uint8_t* p_end = data_ + offsets_[idx + 1];
+    std::vector<Entry> label;
+    uint32_t hub = 0;
+    while ( p != p_end ) {
+        hub += read_varint( p );
+        uint32_t c = read_varint( p );
+        label.push_back( { hub, c } );
+    }
+    return label;
+}
+
+void HubLabels::write( std::ostream& ostr ) const
+{
+    ostr.write( reinterpret_cast<const char*>( offsets_ - HEADER_WORDS ), size_ );
+}
+
+std::unique_ptr<HubLabels> build_hub_labels( const CHQuery& ch_query )
+{
+    const uint32_t n = num_vertices( ch_query );
+
+    // level of a vertex: 0 without higher neighbours, one more than its highest neighbour otherwise
+    // the labels of a vertex only depend on vertices of lower levels
+    std::vector<uint32_t> level( n, 0 );
+    uint32_t num_levels = n ? 1 : 0;
+    for ( uint32_t v = n; v-- > 0; ) {
+        for ( auto oei = out_edges( v, ch_query ).first; oei != out_edges( v, ch_query ).second; oei++ ) {
+            level[v] = std::max( level[v], level[target( *oei, ch_query )] + 1 );
+        }
+        for ( auto iei = in_edges( v, ch_query ).first; iei != in_edges( v, ch_query ).second; iei++ ) {
+            level[v] = std::max( level[v], level[source( *iei, ch_query )] + 1 );
+        }
+        num_levels = std::max( num_levels, level[v] + 1 );
+    }
+    std::vector<uint32_t> first_of_level( num_levels + 1, 0 );
+    for ( uint32_t v = 0; v < n; v++ ) {
+        first_of_level[level[v] + 1]++;
+    }
+    for ( uint32_t l = 0; l < num_levels; l++ ) {
+        first_of_level[l + 1] += first_of_level[l];
+    }
+    std::vector<uint32_t> by_level( n );
+    {
+        std::vector<uint32_t> pos( first_of_level.begin(), first_of_level.end() - 1 );
+        for ( uint32_t v = 0; v < n; v++ ) {
+            by_level[pos[level[v]]++] = v;
+        }
+    }
+
+    HubLabels::Labels forward( n ), backward( n );
+
+    // labels of v in one direction, from the labels of its higher neighbours
+    auto compute_label = [&]( uint32_t v, CHDirection dir, std::vector<HubLabels::Entry>& tentative ) {
+        const HubLabels::Labels& neighbour_labels = dir == CHDirection::Forward ? forward : backward;
+        const HubLabels::Labels& other_labels = dir == CHDirection::Forward ? backward : forward;
+        auto add = [&tentative, &neighbour_labels]( uint32_t w, uint32_t c ) {
+            for ( const HubLabels::Entry& e : neighbour_labels[w] ) {
+                const uint64_t cost = uint64_t( e.cost ) + c;
+                if ( cost < HubLabels::Infinity ) {
+                    tentative.push_back( { e.hub, uint32_t( cost ) } );
+                }
+            }
+        };
+
+        tentative.clear();
+        tentative.push_back( { v, 0 } );
+        if ( dir == CHDirection::Forward ) {
+            for ( auto oei = out_edges( v, ch_query ).first; oei != out_edges( v, ch_query ).second; oei++ ) {
+                add( target( *oei, ch_query ), oei->property().b.cost );
+            }
+        }
+        else {
+            for ( auto iei = in_edges( v, ch_query ).first; iei != in_edges( v, ch_query ).second; iei++ ) {
+                add( source( *iei, ch_query ), iei->property().b.cost );
+            }
+        }
+        // keep the lowest cost of each hub
+        std::sort( tentative.begin(), tentative.end(), []( const HubLabels::Entry& a, const HubLabels::Entry& b ) {
+                return a.hub < b.hub || ( a.hub == b.hub && a.cost < b.cost );
+            });
+        tentative.erase( std::unique( tentative.begin(), tentative.end(), []( const HubLabels::Entry& a, const HubLabels::Entry& b ) {
+                    return a.hub == b.hub;
+                }), tentative.end() );
+
+        // pruning: the labels of h are final, a lower cost between v and h means h is not on a shortest path
+        std::vector<HubLabels::Entry> label;
+        for ( const HubLabels::Entry& e : tentative ) {
+            if ( e.hub == v || merge_cost( tentative, other_labels[e.hub] ) >= e.cost ) {
+                label.push_back( e );
+            }
+        }
+        label.shrink_to_fit();
+        return label;
+    };
+
+    for ( uint32_t l = 0; l < num_levels; l++ ) {
+        const int first = first_of_level[l];
+        const int last = first_of_level[l + 1];
+        #pragma omp parallel for schedule(dynamic, 64)
+        for ( int i = first; i < last; i++ ) {
+            const uint32_t v = by_level[i];
+            std::vector<HubLabels::Entry> tentative;
+            std::vector<HubLabels::Entry> f = compute_label( v, CHDirection::Forward, tentative );
+            std::vector<HubLabels::Entry> b = compute_label( v, CHDirection::Backward, tentative );
+            forward[v].swap( f );
+            backward[v].swap( b );
+        }
+    }
+
+    return std::unique_ptr<HubLabels>( new HubLabels( forward, backward ) );
+}
+
+HubLabelRoutingData::HubLabelRoutingData( std::unique_ptr<CHRoutingData> a_ch_data, std::unique_ptr<HubLabels> a_labels ) :
+    RoutingData( "hub_labels" ),
+    ch_data_( std::move( a_ch_data ) ),
+    labels_( std::move( a_labels ) )
+{
+}
+
+std::unique_ptr<RoutingData> HubLabelRoutingDataBuilder::pg_import( const std::string& /*pg_options*/, ProgressionCallback&, const VariantMap& /*options*/ ) const
+{
+    throw std::runtime_error( "Hub labels can only be loaded from a dump file produced by hl_preprocess" );
+}
+
+std::unique_ptr<RoutingData> HubLabelRoutingDataBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ifstream ifs( filename, std::ios::binary );
+    if ( ifs.fail() ) {
+        throw std::runtime_error( "Problem opening input file " + filename );
+    }
+
+    read_header( ifs );
+
+    uint64_t labels_size = 0;
+    ifs.read( reinterpret_cast<char*>( &labels_size ), sizeof( uint64_t ) );
+    const uint64_t labels_offset = ifs.tellg();
+
+    std::cout << "map labels" << std::endl;
+    std::unique_ptr<HubLabels> labels( new HubLabels( filename, labels_offset, labels_size ) );
+
+    ifs.seekg( labels_offset + labels_size );
+
+    std::cout << "read graph" << std::endl;
+    std::unique_ptr<CHQuery> query( new CHQuery() );
+    query->unserialize( ifs, binary_serialization_t() );
+
+    std::cout << "read edge origins" << std::endl;
+    std::vector<CHEdgeOrigin> edge_origin;
+    unserialize( ifs, edge_origin, binary_serialization_t() );
+
+    std::cout << "read node id" << std::endl;
+    std::vector<db_id_t> node_id;
+    unserialize( ifs, node_id, binary_serialization_t() );
+
+    std::unique_ptr<CHRoutingData> ch_data( new CHRoutingData( std::move( query ), std::move( edge_origin ), std::move( node_id ) ) );
+    return std::unique_ptr<RoutingData>( new HubLabelRoutingData( std::move( ch_data ), std::move( labels ) ) );
+}
+
+void HubLabelRoutingDataBuilder::file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ofstream ofs( filename, std::ios::binary );
+
+    write_header( ofs );
+
+    const HubLabelRoutingData* hrd = static_cast<const HubLabelRoutingData*>( rd );
+
+    // labels first, they stay 8 bytes aligned after the header
+    const uint64_t labels_size = hrd->labels().size();
+    ofs.write( reinterpret_cast<const char*>( &labels_size ), sizeof( uint64_t ) );
+    hrd->labels().write( ofs );
+
+    const CHRoutingData& ch_data = hrd->ch_data();
+    ch_data.ch_query_->serialize( ofs, binary_serialization_t() );
+    serialize( ofs, ch_data.edge_origin_, binary_serialization_t() );
+    serialize( ofs, ch_data.node_id_, binary_serialization_t() );
+}
+
+REGISTER_BUILDER( HubLabelRoutingDataBuilder )
+
+} // namespace Tempus
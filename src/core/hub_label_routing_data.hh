@@ -0,0 +1,155 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_HUB_LABEL_ROUTING_DATA_HH
+#define TEMPUS_HUB_LABEL_ROUTING_DATA_HH
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <iosfwd>
+
+#include "ch_routing_data.hh"
+#include "ch_upward_search.hh"
+
+namespace boost {
+namespace interprocess {
+class mapped_region;
+}
+}
+
+namespace Tempus
+{
+
+///
+/// Hub labels of a graph
+///
+/// Each vertex v has a forward label, a list of (hub, cost of v -> hub) and a backward label,
+/// a list of (hub, cost of hub -> v). The cost from s to t is the minimum of the sums over the hubs
+/// that are in both the forward label of s and the backward label of t.
+///
+/// Labels are sorted by hub and stored in a single, position independent, memory block, so that they can be
+/// mapped from a file as is. Entries are compressed: a hub is stored as the difference with the previous hub
+/// and costs are variable-length integers.
+class HubLabels
+{
+public:
+    static const uint32_t Infinity = uint32_t(-1);
+
+    struct Entry
+    {
+        uint32_t hub;
+        /// fixed point cost
+        uint32_t cost;
+    };
+
+    /// Labels of each vertex, sorted by hub
+    typedef std::vector<std::vector<Entry>> Labels;
+
+    ///
+    /// Encode labels in memory
+    HubLabels( const Labels& forward, const Labels& backward );
+
+    ///
+    /// Map labels from a file
+    /// \param[in] filename The file
+    /// \param[in] offset Position of the labels in the file, as written by write()
+    /// \param[in] size Size of the labels, in bytes
+    HubLabels( const std::string& filename, uint64_t offset, uint64_t size );
+
+    ~HubLabels();
+
+    uint32_t num_vertices() const { return uint32_t( num_vertices_ ); }
+
+    /// Size of the encoded labels, in bytes
+    uint64_t size() const { return size_; }
+
+    ///
+    /// Cost from s to t, Infinity if t cannot be reached
+    /// \param[out] hub If not null, the hub of the shortest path
+    uint32_t cost( uint32_t s, uint32_t t, uint32_t* hub = nullptr ) const;
+
+    ///
+    /// Decoded label of a vertex
+    std::vector<Entry> label( uint32_t v, CHDirection dir ) const;
+
+    ///
+    /// Write the encoded labels, size() bytes
+    void write( std::ostream& ostr ) const;
+
+private:
+    void set_pointers( const char* base );
+
+    // encoded labels, if they are not mapped from a file
+    std::vector<char> buffer_;
+    std::unique_ptr<boost::interprocess::mapped_region> region_;
+
+    uint64_t size_;
+    uint64_t num_vertices_;
+    // offsets of the forward labels then of the backward labels, in data_
+    const uint64_t* offsets_;
+    const uint8_t* data_;
+};
+
+///
+/// Computes the hub labels of a CH query graph
+///
+/// Vertices are processed from the highest one. The forward label of v is made of v itself and of the forward labels of
+/// its upward neighbours, the backward label of the backward labels of its downward neighbours. An entry (h, d) is then pruned
+/// if the labels already give a cost lower than d from v to h, since h is useless for v in this case.
+/// Vertices of the same level, that do not depend on each other, are processed in parallel.
+std::unique_ptr<HubLabels> build_hub_labels( const CHQuery& ch_query );
+
+///
+/// Routing data for cost queries by hub labels, along with the CH data they are computed from.
+///
+/// A cost is given by a merge of two labels only. Paths still need a CH query on ch_data().
+class HubLabelRoutingData : public RoutingData
+{
+public:
+    HubLabelRoutingData( std::unique_ptr<CHRoutingData> ch_data, std::unique_ptr<HubLabels> labels );
+
+    const CHRoutingData& ch_data() const { return *ch_data_; }
+
+    const HubLabels& labels() const { return *labels_; }
+
+    boost::optional<CHVertex> vertex_from_id( db_id_t id ) const { return ch_data_->vertex_from_id( id ); }
+
+private:
+    std::unique_ptr<CHRoutingData> ch_data_;
+    std::unique_ptr<HubLabels> labels_;
+};
+
+///
+/// Builder of hub labels.
+/// These data are produced by the hl_preprocess tool and can only be loaded from a dump file.
+/// Labels are mapped from the file (read-only), the CH data are read.
+class HubLabelRoutingDataBuilder : public RoutingDataBuilder
+{
+public:
+    HubLabelRoutingDataBuilder() : RoutingDataBuilder( "hub_labels" ) {}
+
+    virtual std::unique_ptr<RoutingData> pg_import( const std::string& pg_options, ProgressionCallback&, const VariantMap& options = VariantMap() ) const override;
+
+    virtual std::unique_ptr<RoutingData> file_import( const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+    virtual void file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+
+    uint32_t version() const { return 1; }
+};
+
+} // namespace Tempus
+
+#endif
@@ -0,0 +1,316 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ostream>
+#include <algorithm>
+
+#ifdef _WIN32
+#pragma warning(push, 0)
+#endif
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/tss.hpp>
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+#include "instrumentation.hh"
+
+namespace Tempus
+{
+
+LatencyHistogram::LatencyHistogram() :
+    count_( 0 ),
+    sum_( 0 ),
+    max_( 0 )
+{
+    for ( size_t i = 0; i < NumBuckets; i++ ) {
+        buckets_[i] = 0;
+    }
+}
+
+size_t LatencyHistogram::bucket( uint64_t us )
+{
+    if ( us < SubBuckets ) {
+        return size_t( us );
+    }
+    // most significant bit
+    size_t msb = 0;
+#ifdef __GNUC__
+    msb = 63 - __builtin_clzll( us );
+#else
+    for ( uint64_t v = us; v > 1; v >>= 1 ) {
+        msb++;
+    }
+#endif
+    const size_t shift = msb - SubBucketBits;
+    // SubBuckets <= top < 2 * SubBuckets
+    const size_t top = size_t( us >> shift );
+    return ( shift + 1 ) * SubBuckets + top - SubBuckets;
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound( size_t idx )
+{
+    if ( idx < SubBuckets ) {
+        return idx;
+    }
+    const size_t shift = idx / SubBuckets - 1;
+    const uint64_t top = idx % SubBuckets + SubBuckets;
+    // wraps to the largest value for the last bucket
+    return ( ( top + 1 ) << shift ) - 1;
+}
+
+void LatencyHistogram::record( uint64_t us )
+{
+    buckets_[bucket( us )].fetch_add( 1, std::memory_order_relaxed );
+    count_.fetch_add( 1, std::memory_order_relaxed );
+    sum_.fetch_add( us, std::memory_order_relaxed );
+    uint64_t m = max_.load( std::memory_order_relaxed );
+    while ( us > m && !max_.compare_exchange_weak( m, us, std::memory_order_relaxed ) ) {
+    }
+}
+
+uint64_t LatencyHistogram::quantile( double q ) const
+{
+    // the buckets may change while they are read, the total is computed on what is read
+    uint64_t snapshot[NumBuckets];
+    uint64_t total = 0;
+    for ( size_t i = 0; i < NumBuckets; i++ ) {
+        snapshot[i] = buckets_[i].load( std::memory_order_relaxed );
+        total += snapshot[i];
+    }
+    if ( total == 0 ) {
+        return 0;
+    }
+    uint64_t rank = uint64_t( q * total + 0.5 );
+    if ( rank < 1 ) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for ( size_t i = 0; i < NumBuckets; i++ ) {
+        seen += snapshot[i];
+        if ( seen >= rank ) {
+            return std::min( bucket_upper_bound( i ), max() );
+        }
+    }
+    return max();
+}
+
+namespace Instrumentation
+{
+
+const char* phase_name( Phase phase )
+{
+    switch ( phase ) {
+    case ParsePhase:
+        return "parse";
+    case SnapPhase:
+        return "snap";
+    case SearchPhase:
+        return "search";
+    case RoadmapPhase:
+        return "roadmap";
+    case SerializePhase:
+        return "serialize";
+    default:
+        return "unknown";
+    }
+}
+
+Counters::Counters( const std::string& a_label ) :
+    label( a_label ),
+    errors( 0 ),
+    next( nullptr )
+{
+}
+
+namespace
+{
+
+// list of counters, counters are only added at its head
+std::atomic<Counters*> g_counters( nullptr );
+boost::mutex g_counters_mutex;
+
+struct ThreadContext
+{
+    Counters* counters;
+    ScopedPhase* phase;
+    ThreadContext() : counters( nullptr ), phase( nullptr ) {}
+};
+
+ThreadContext& thread_context()
+{
+    static boost::thread_specific_ptr<ThreadContext> context;
+    if ( !context.get() ) {
+        context.reset( new ThreadContext() );
+    }
+    return *context;
+}
+
+Counters* find_counters( const std::string& label )
+{
+    for ( Counters* c = g_counters.load( std::memory_order_acquire ); c; c = c->next ) {
+        if ( c->label == label ) {
+            return c;
+        }
+    }
+    return nullptr;
+}
+
+uint64_t elapsed_us( std::chrono::steady_clock::duration d )
+{
+    return uint64_t( std::chrono::duration_cast<std::chrono::microseconds>( d ).count() );
+}
+
+std::string escape_label( const std::string& label )
+{
+    std::string escaped;
+    for ( char c : label ) {
+        if ( c == '"' || c == '\\' ) {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+void write_summary( std::ostream& ostr, const std::string& label, const char* phase, const LatencyHistogram& h )
+{
+    static const char* quantiles[] = { "0.5", "0.9", "0.99", "0.999" };
+    static const double quantile_values[] = { 0.5, 0.9, 0.99, 0.999 };
+    const std::string labels = "label=\"" + label + "\",phase=\"" + phase + "\"";
+    for ( size_t i = 0; i < 4; i++ ) {
+        ostr << "tempus_latency_seconds{" << labels << ",quantile=\"" << quantiles[i] << "\"} " << h.quantile( quantile_values[i] ) * 1e-6 << "\n";
+    }
+    ostr << "tempus_latency_seconds_sum{" << labels << "} " << h.sum() * 1e-6 << "\n";
+    ostr << "tempus_latency_seconds_count{" << labels << "} " << h.count() << "\n";
+}
+
+}
+
+Counters& counters( const std::string& label )
+{
+    Counters* c = find_counters( label );
+    if ( c ) {
+        return *c;
+    }
+
+    boost::lock_guard<boost::mutex> lock( g_counters_mutex );
+    // may have been added in between
+    c = find_counters( label );
+    if ( !c ) {
+        c = new Counters( label );
+        c->next = g_counters.load( std::memory_order_relaxed );
+        g_counters.store( c, std::memory_order_release );
+    }
+    return *c;
+}
+
+const Counters* first_counters()
+{
+    return g_counters.load( std::memory_order_acquire );
+}
+
+RequestScope::RequestScope( const std::string& label ) :
+    start_( std::chrono::steady_clock::now() ),
+    error_( false )
+{
+    ThreadContext& ctx = thread_context();
+    previous_counters_ = ctx.counters;
+    ctx.counters = &counters( label );
+}
+
+RequestScope::~RequestScope()
+{
+    ThreadContext& ctx = thread_context();
+    // the label may have been changed during the request
+    ctx.counters->requests.record( elapsed_us( std::chrono::steady_clock::now() - start_ ) );
+    if ( error_ ) {
+        ctx.counters->errors.fetch_add( 1, std::memory_order_relaxed );
+    }
+    ctx.counters = previous_counters_;
+}
+
+void set_label( const std::string& label )
+{
+    ThreadContext& ctx = thread_context();
+    if ( ctx.counters ) {
+        ctx.counters = &counters( label );
+    }
+}
+
+ScopedPhase::ScopedPhase( Phase phase ) :
+    phase_( phase ),
+    start_( std::chrono::steady_clock::now() ),
+    nested_( 0 )
+{
+    ThreadContext& ctx = thread_context();
+    parent_ = ctx.phase;
+    ctx.phase = this;
+}
+
+ScopedPhase::~ScopedPhase()
+{
+    ThreadContext& ctx = thread_context();
+    const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start_;
+    if ( ctx.counters ) {
+        ctx.counters->phases[phase_].record( elapsed_us( elapsed - nested_ ) );
+    }
+    if ( parent_ ) {
+        parent_->nested_ += elapsed;
+    }
+    ctx.phase = parent_;
+}
+
+void write_text( std::ostream& ostr )
+{
+    ostr << "# HELP tempus_requests_total Number of requests\n";
+    ostr << "# TYPE tempus_requests_total counter\n";
+    for ( const Counters* c = first_counters(); c; c = c->next ) {
+        ostr << "tempus_requests_total{label=\"" << escape_label( c->label ) << "\"} " << c->requests.count() << "\n";
+    }
+    ostr << "# HELP tempus_errors_total Number of failed requests\n";
+    ostr << "# TYPE tempus_errors_total counter\n";
+    for ( const Counters* c = first_counters(); c; c = c->next ) {
+        ostr << "tempus_errors_total{label=\"" << escape_label( c->label ) << "\"} " << c->errors.load( std::memory_order_relaxed ) << "\n";
+    }
+    ostr << "# HELP tempus_latency_seconds Latency of requests (phase \"request\") and of their phases\n";
+    ostr << "# TYPE tempus_latency_seconds summary\n";
+    for ( const Counters* c = first_counters(); c; c = c->next ) {
+        const std::string label = escape_label( c->label );
+        write_summary( ostr, label, "request", c->requests );
+        for ( int p = 0; p < PhaseCount; p++ ) {
+            if ( c->phases[p].count() ) {
+                write_summary( ostr, label, phase_name( Phase( p ) ), c->phases[p] );
+            }
+        }
+    }
+    ostr << "# HELP tempus_latency_max_seconds Largest latency of requests and of their phases\n";
+    ostr << "# TYPE tempus_latency_max_seconds gauge\n";
+    for ( const Counters* c = first_counters(); c; c = c->next ) {
+        const std::string label = escape_label( c->label );
+        ostr << "tempus_latency_max_seconds{label=\"" << label << "\",phase=\"request\"} " << c->requests.max() * 1e-6 << "\n";
+        for ( int p = 0; p < PhaseCount; p++ ) {
+            if ( c->phases[p].count() ) {
+                ostr << "tempus_latency_max_seconds{label=\"" << label << "\",phase=\"" << phase_name( Phase( p ) ) << "\"} " << c->phases[p].max() * 1e-6 << "\n";
+            }
+        }
+    }
+}
+
+} // namespace Instrumentation
+
+} // namespace Tempus
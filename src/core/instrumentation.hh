@@ -0,0 +1,180 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_INSTRUMENTATION_HH
+#define TEMPUS_INSTRUMENTATION_HH
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <iosfwd>
+#include <cstdint>
+
+namespace Tempus
+{
+
+///
+/// Histogram of latencies, in microseconds, that can be filled by several threads without locking.
+///
+/// Buckets are log-linear, as in HdrHistogram: values below 8 have their own bucket, then each power of two
+/// is split into 8 buckets. The relative error of a quantile is then at most 1/8.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    ///
+    /// Add a value, in microseconds
+    void record( uint64_t us );
+
+    uint64_t count() const { return count_.load( std::memory_order_relaxed ); }
+
+    /// Sum of the values, in microseconds
+    uint64_t sum() const { return sum_.load( std::memory_order_relaxed ); }
+
+    /// Largest value, in microseconds
+    uint64_t max() const { return max_.load( std::memory_order_relaxed ); }
+
+    ///
+    /// Value of a quantile, in microseconds: the upper bound of the bucket of the quantile
+    /// \param q The quantile, between 0 and 1
+    uint64_t quantile( double q ) const;
+
+    ///
+    /// Bucket index of a value
+    static size_t bucket( uint64_t us );
+
+    ///
+    /// Largest value of a bucket
+    static uint64_t bucket_upper_bound( size_t idx );
+
+private:
+    static const size_t SubBucketBits = 3;
+    static const size_t SubBuckets = 1 << SubBucketBits;
+    static const size_t NumBuckets = ( 64 - SubBucketBits + 1 ) * SubBuckets;
+
+    std::atomic<uint64_t> buckets_[NumBuckets];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+///
+/// Process-wide performance counters of requests.
+///
+/// Counters are grouped by label: the name of the plugin that processes a request, or the name of the WPS service
+/// for requests that do not involve a plugin. Each label has a latency histogram per phase of a request, a latency
+/// histogram of whole requests, a request counter and an error counter.
+///
+/// The label of the current request of a thread is given by a RequestScope. Phases are timed by ScopedPhase objects
+/// and recorded under the label of the thread when they end. Phases may be nested, the self time of each phase is
+/// recorded, i.e. nested phases are not counted twice.
+namespace Instrumentation
+{
+
+enum Phase {
+    /// parsing of the request
+    ParsePhase,
+    /// search of the road vertices of coordinates
+    SnapPhase,
+    /// path search, by the plugin
+    SearchPhase,
+    /// roadmap details retrieved from the database
+    RoadmapPhase,
+    /// writing of the response
+    SerializePhase,
+    PhaseCount
+};
+
+const char* phase_name( Phase phase );
+
+struct Counters
+{
+    explicit Counters( const std::string& a_label );
+
+    const std::string label;
+    LatencyHistogram phases[PhaseCount];
+    /// latency of whole requests
+    LatencyHistogram requests;
+    std::atomic<uint64_t> errors;
+    /// next counters of the registry
+    Counters* next;
+};
+
+///
+/// Counters of a label, created on first use.
+/// Counters are never destroyed, references stay valid.
+Counters& counters( const std::string& label );
+
+///
+/// First counters of the registry, the others follow the next pointers
+const Counters* first_counters();
+
+///
+/// Scope of a request processed by the current thread
+class RequestScope
+{
+public:
+    explicit RequestScope( const std::string& label );
+    ~RequestScope();
+
+    ///
+    /// The request has failed
+    void set_error() { error_ = true; }
+
+private:
+    RequestScope( const RequestScope& );
+    RequestScope& operator=( const RequestScope& );
+
+    Counters* previous_counters_;
+    std::chrono::steady_clock::time_point start_;
+    bool error_;
+};
+
+///
+/// Change the label of the current request of the thread, if any.
+/// Called by services once the plugin of a request is known.
+void set_label( const std::string& label );
+
+///
+/// Times a phase of the current request of the thread.
+/// Nothing is recorded if the thread has no current request.
+class ScopedPhase
+{
+public:
+    explicit ScopedPhase( Phase phase );
+    ~ScopedPhase();
+
+private:
+    ScopedPhase( const ScopedPhase& );
+    ScopedPhase& operator=( const ScopedPhase& );
+
+    Phase phase_;
+    ScopedPhase* parent_;
+    std::chrono::steady_clock::time_point start_;
+    // time spent in nested phases
+    std::chrono::steady_clock::duration nested_;
+};
+
+///
+/// Write all the counters in the Prometheus text format
+void write_text( std::ostream& ostr );
+
+} // namespace Instrumentation
+
+} // namespace Tempus
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "multi_profile_ch_routing_data.hh"
+
+#include <fstream>
+
+namespace Tempus
+{
+
+const uint32_t CHProfile::Infinity;
+const uint32_t CHProfile::NoMiddle;
+
+MultiProfileCHRoutingData::MultiProfileCHRoutingData( std::unique_ptr<MultiProfileCHQuery> a_query,
+                                                      std::vector<CHProfile>&& a_profiles,
+                                                      std::vector<db_id_t>&& a_node_id ) :
+    RoutingData( "multi_profile_ch_graph" ),
+    query_( std::move( a_query ) ),
+    profiles_( std::move( a_profiles ) ),
+    node_id_( std::move( a_node_id ) )
+{
+    // update the reverse id map
+    for ( size_t i = 0; i < node_id_.size(); i++ ) {
+        rnode_id_[node_id_[i]] = i;
+    }
+}
+
+boost::optional<CHVertex> MultiProfileCHRoutingData::vertex_from_id( db_id_t id ) const
+{
+    auto it = rnode_id_.find( id );
+    if ( it != rnode_id_.end() ) {
+        return CHVertex( it->second );
+    }
+    return boost::optional<CHVertex>();
+}
+
+db_id_t MultiProfileCHRoutingData::vertex_id( CHVertex v ) const
+{
+    return node_id_[v];
+}
+
+boost::optional<size_t> MultiProfileCHRoutingData::find_profile( const std::vector<db_id_t>& allowed_modes, CostId cost_id, db_id_t* mode_id ) const
+{
+    for ( size_t i = 0; i < profiles_.size(); i++ ) {
+        if ( profiles_[i].cost_id != cost_id ) {
+            continue;
+        }
+        for ( db_id_t allowed : allowed_modes ) {
+            boost::optional<TransportMode> mode = transport_mode( allowed );
+            if ( mode && ( mode->traffic_rules() & profiles_[i].traffic_rules ) ) {
+                if ( mode_id ) {
+                    *mode_id = allowed;
+                }
+                return i;
+            }
+        }
+    }
+    return boost::optional<size_t>();
+}
+
+std::unique_ptr<RoutingData> MultiProfileCHRoutingDataBuilder::pg_import( const std::string& /*pg_options*/, ProgressionCallback&, const VariantMap& /*options*/ ) const
+{
+    throw std::runtime_error( "Multi-profile CH data can only be loaded from a dump file produced by cch_preprocess" );
+}
+
+std::unique_ptr<RoutingData> MultiProfileCHRoutingDataBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ifstream ifs( filename, std::ios::binary );
+    if ( ifs.fail() ) {
+        throw std::runtime_error( "Problem opening input file " + filename );
+    }
+
+    read_header( ifs );
+
+    std::cout << "read transport modes" << std::endl;
+    RoutingData::TransportModes modes;
+    unserialize( ifs, modes, binary_serialization_t() );
+
+    std::cout << "read graph" << std::endl;
+    std::unique_ptr<MultiProfileCHQuery> query( new MultiProfileCHQuery() );
+    query->unserialize( ifs, binary_serialization_t() );
+
+    std::cout << "read profiles" << std::endl;
+    std::vector<CHProfile> profiles;
+    unserialize( ifs, profiles, binary_serialization_t() );
+
+    std::cout << "read node id" << std::endl;
+    std::vector<db_id_t> node_id;
+    unserialize( ifs, node_id, binary_serialization_t() );
+
+    std::unique_ptr<RoutingData> rd( new MultiProfileCHRoutingData( std::move( query ), std::move( profiles ), std::move( node_id ) ) );
+    rd->set_transport_modes( modes );
+    return rd;
+}
+
+void MultiProfileCHRoutingDataBuilder::file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ofstream ofs( filename, std::ios::binary );
+
+    write_header( ofs );
+
+    const MultiProfileCHRoutingData* mrd = static_cast<const MultiProfileCHRoutingData*>( rd );
+
+    serialize( ofs, mrd->transport_modes(), binary_serialization_t() );
+    mrd->query_->serialize( ofs, binary_serialization_t() );
+    serialize( ofs, mrd->profiles_, binary_serialization_t() );
+    serialize( ofs, mrd->node_id_, binary_serialization_t() );
+}
+
+REGISTER_BUILDER( MultiProfileCHRoutingDataBuilder )
+
+} // namespace Tempus
@@ -0,0 +1,154 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_MULTI_PROFILE_CH_ROUTING_DATA_HH
+#define TEMPUS_MULTI_PROFILE_CH_ROUTING_DATA_HH
+
+#include <vector>
+
+#include "ch_routing_data.hh"
+#include "cost.hh"
+
+namespace Tempus
+{
+
+///
+/// Edge of a CH graph shared by several profiles.
+/// Weights are stored apart, per profile
+struct MultiProfileCHEdgeProperty
+{
+    /// index of the edge in the weight arrays of each CHProfile
+    uint32_t index;
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const
+    {
+        Tempus::serialize( ostr, index, t );
+    }
+    void unserialize( std::istream& istr, binary_serialization_t t )
+    {
+        Tempus::unserialize( istr, index, t );
+    }
+};
+
+using MultiProfileCHQuery = CHQueryGraph<MultiProfileCHEdgeProperty>;
+using MultiProfileCHEdge = MultiProfileCHQuery::edge_descriptor;
+
+///
+/// Weights of the edges of a multi-profile CH graph for one cost profile
+/// (e.g. walking distance, cycling duration, car duration)
+struct CHProfile
+{
+    static const uint32_t Infinity = uint32_t(-1);
+    static const uint32_t NoMiddle = uint32_t(-1);
+
+    std::string name;
+    /// traffic rules (TransportModeTrafficRule) of the transport modes this profile is made for
+    unsigned traffic_rules;
+    /// cost computed by this profile
+    CostId cost_id;
+
+    /// fixed point cost of each edge (1/100 of the cost unit), Infinity if the edge cannot be used
+    std::vector<uint32_t> cost;
+    /// middle vertex of each edge, NoMiddle if the edge is not a shortcut in this profile
+    std::vector<CHVertex> middle;
+    /// road section of each edge, 0 for a shortcut
+    std::vector<db_id_t> db_id;
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const
+    {
+        Tempus::serialize( ostr, name, t );
+        Tempus::serialize( ostr, traffic_rules, t );
+        Tempus::serialize( ostr, int(cost_id), t );
+        Tempus::serialize( ostr, cost, t );
+        Tempus::serialize( ostr, middle, t );
+        Tempus::serialize( ostr, db_id, t );
+    }
+    void unserialize( std::istream& istr, binary_serialization_t t )
+    {
+        int c;
+        Tempus::unserialize( istr, name, t );
+        Tempus::unserialize( istr, traffic_rules, t );
+        Tempus::unserialize( istr, c, t );
+        cost_id = CostId( c );
+        Tempus::unserialize( istr, cost, t );
+        Tempus::unserialize( istr, middle, t );
+        Tempus::unserialize( istr, db_id, t );
+    }
+};
+
+///
+/// Routing data out of a CH query graph shared by several profiles.
+///
+/// The topology (vertex order, edges and shortcuts) is stored once. It comes from a
+/// metric-independent hierarchy (see CCHTopology), so that the shortcuts are valid for every profile.
+/// Each profile only adds its weight arrays. Vertices are represented by their CH order, as for CHRoutingData.
+class MultiProfileCHRoutingData : public RoutingData
+{
+public:
+    MultiProfileCHRoutingData( std::unique_ptr<MultiProfileCHQuery> query, std::vector<CHProfile>&& profiles, std::vector<db_id_t>&& node_id );
+
+    boost::optional<CHVertex> vertex_from_id( db_id_t id ) const;
+
+    db_id_t vertex_id( CHVertex ) const;
+
+    const MultiProfileCHQuery& ch_query() const { return *query_; }
+
+    size_t num_profiles() const { return profiles_.size(); }
+    const CHProfile& profile( size_t idx ) const { return profiles_[idx]; }
+
+    ///
+    /// Profile to use for a request: the first profile computing the given cost
+    /// with traffic rules of one of the allowed transport modes
+    /// \param[in] allowed_modes Ids of the allowed transport modes
+    /// \param[in] cost_id The optimized cost
+    /// \param[out] mode_id If not null, set to the id of the transport mode the profile has been chosen for
+    boost::optional<size_t> find_profile( const std::vector<db_id_t>& allowed_modes, CostId cost_id, db_id_t* mode_id = nullptr ) const;
+
+private:
+    // the CH graph
+    std::unique_ptr<MultiProfileCHQuery> query_;
+
+    // weights of each profile
+    std::vector<CHProfile> profiles_;
+
+    // node index -> node id
+    std::vector<db_id_t> node_id_;
+
+    // node id -> index
+    std::map<db_id_t, size_t> rnode_id_;
+
+    friend class MultiProfileCHRoutingDataBuilder;
+};
+
+///
+/// Builder of multi-profile CH data.
+/// These data are produced by the cch_preprocess tool and can only be loaded from a dump file.
+class MultiProfileCHRoutingDataBuilder : public RoutingDataBuilder
+{
+public:
+    MultiProfileCHRoutingDataBuilder() : RoutingDataBuilder( "multi_profile_ch_graph" ) {}
+
+    virtual std::unique_ptr<RoutingData> pg_import( const std::string& pg_options, ProgressionCallback&, const VariantMap& options = VariantMap() ) const override;
+
+    virtual std::unique_ptr<RoutingData> file_import( const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+    virtual void file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+
+    uint32_t version() const { return 1; }
+};
+
+} // namespace Tempus
+
+#endif
@@ -18,10 +18,19 @@
 #include <string>
 #include <iostream>
 #include <memory>
+#include <algorithm>
 
 #include <boost/format.hpp>
 
+#ifdef _OPENMP
+#include <omp.h>
+#else
+inline int omp_get_max_threads() { return 1; }
+#endif
+
 #include "plugin.hh"
+#include "result_cache.hh"
+#include "instrumentation.hh"
 #include "utils/graph_db_link.hh"
 #ifdef _WIN32
 #include <strsafe.h>
@@ -33,10 +42,27 @@ namespace Tempus
 {
 
 Plugin::Plugin( const std::string& nname, const VariantMap& options ) :
-    name_( nname )
+    name_( nname ),
+    request_timeout_( 0.0 )
 {
     schema_name_ = get_option_or_default( options, "db/schema" ).str();
     db_options_ = get_option_or_default( options, "db/options" ).str();
+    auto it = options.find( "request/timeout" );
+    if ( it != options.end() ) {
+        request_timeout_ = it->second.as<double>();
+    }
+}
+
+const RoutingData* Plugin::use_routing_data( const std::string& data_name, ProgressionCallback& progression, const VariantMap& options )
+{
+    RoutingDataUse use;
+    use.name = data_name;
+    use.options = options;
+    use.data = routing_data_handle( data_name, progression, options );
+    if ( use.data ) {
+        routing_data_uses_.push_back( use );
+    }
+    return use.data.get();
 }
 
 Plugin::OptionDescriptionList Plugin::common_option_descriptions()
@@ -44,6 +70,7 @@ Plugin::OptionDescriptionList Plugin::common_option_descriptions()
     Plugin::OptionDescriptionList opt;
     opt.declare_option( "db/options", "DB connection options", Variant::from_string(""));
     opt.declare_option( "db/schema", "DB schema name", Variant::from_string("tempus"));
+    opt.declare_option( "request/timeout", "Maximum processing time of a request, in seconds (0: the default of the server)", Variant::from_float(0.0));
     return opt;
 }
 
@@ -55,12 +82,102 @@ std::unique_ptr<Result> PluginRequest::process( const Request& /*request*/ )
     return std::unique_ptr<Result>( new Result );
 }
 
+std::unique_ptr<Result> PluginRequest::process_with_deadline( const Request& request )
+{
+    deadline_.start( timeout_s_ );
+    metrics_[ "timeout" ] = Variant::from_bool( false );
+    try {
+        return process( request );
+    }
+    catch ( DeadlineExceeded& ) {
+        metrics_[ "timeout" ] = Variant::from_bool( true );
+        throw;
+    }
+}
+
+std::shared_ptr<const Result> PluginRequest::process_cached( const Request& request )
+{
+    ResultCache& cache = ResultCache::instance();
+    if ( !cache.enabled() ) {
+        return std::shared_ptr<const Result>( process_with_deadline( request ).release() );
+    }
+
+    const std::string key = ResultCache::key( *plugin_, options_, request );
+    ResultCache::Entry entry;
+    if ( cache.find( key, entry ) ) {
+        metrics_ = entry.metrics;
+        metrics_[ "cached" ] = Variant::from_bool( true );
+        return entry.result;
+    }
+
+    // a request that times out throws, nothing is cached
+    entry.result.reset( process_with_deadline( request ).release() );
+    metrics_[ "cached" ] = Variant::from_bool( false );
+    entry.metrics = metrics_;
+    cache.insert( key, entry );
+    return entry.result;
+}
+
 PluginRequest::PluginRequest( const Plugin* plugin, const VariantMap& options ) :
-    plugin_(plugin), options_( options )
+    plugin_(plugin), options_( options ), timeout_s_( plugin->request_timeout() )
 {
     // default metrics
     metrics_[ "time_s" ] = Variant::from_float(0.0);
     metrics_[ "iterations" ] = Variant::from_int(0);
+
+    // the timeout of the request, if any, overrides the one of the plugin, but cannot exceed it:
+    // the timeout of the plugin is the maximum set by the server
+    auto it = options_.find( "request/timeout" );
+    if ( it != options_.end() && it->second.as<double>() > 0 ) {
+        const double requested = it->second.as<double>();
+        timeout_s_ = timeout_s_ > 0 ? std::min( requested, timeout_s_ ) : requested;
+    }
+}
+
+std::vector<Plugin::BatchResult> Plugin::process_batch( const std::vector<Request>& requests, const VariantMap& options, int num_threads ) const
+{
+    std::vector<BatchResult> results( requests.size() );
+    const int n = int( requests.size() );
+    if ( num_threads <= 0 ) {
+        num_threads = omp_get_max_threads();
+    }
+
+    #pragma omp parallel num_threads( num_threads )
+    {
+        // per thread request, for plugins whose requests can be reused
+        std::unique_ptr<PluginRequest> thread_request;
+
+        #pragma omp for schedule(dynamic)
+        for ( int i = 0; i < n; i++ ) {
+            // each request of the batch is counted as a request of the plugin
+            Instrumentation::RequestScope scope( name() );
+            // exceptions must not escape the parallel region
+            try {
+                Instrumentation::ScopedPhase search_phase( Instrumentation::SearchPhase );
+                std::unique_ptr<PluginRequest> local_request;
+                PluginRequest* plugin_request;
+                if ( reusable_requests() ) {
+                    if ( !thread_request ) {
+                        thread_request = request( options );
+                    }
+                    plugin_request = thread_request.get();
+                }
+                else {
+                    local_request = request( options );
+                    plugin_request = local_request.get();
+                }
+                results[i].result = plugin_request->process_cached( requests[i] );
+                results[i].metrics = plugin_request->metrics();
+            }
+            catch ( std::exception& e ) {
+                results[i].result.reset();
+                results[i].error = e.what();
+                scope.set_error();
+            }
+        }
+    }
+
+    return results;
 }
 
 Plugin::OptionDescriptionList option_descriptions( const Plugin* plugin )
@@ -149,6 +266,7 @@ std::string PluginRequest::metric_to_string( const std::string& nname ) const
 /// Text formatting and preparation of roadmap
 void simple_multimodal_roadmap( Result& result, Db::Connection& db, const Multimodal::Graph& graph )
 {
+    Instrumentation::ScopedPhase roadmap_phase( Instrumentation::RoadmapPhase );
     for ( Result::iterator rit = result.begin(); rit != result.end(); ++rit ) {
         Roadmap& roadmap = *rit;
         Roadmap new_roadmap;
@@ -36,6 +36,7 @@
 #include "db.hh"
 #include "application.hh"
 #include "variant.hh"
+#include "deadline.hh"
 
 #ifdef _WIN32
 #   define NOMINMAX
@@ -120,6 +121,25 @@ public:
     /// \return a result, set of paths
     virtual std::unique_ptr<Result> process( const Request& request );
 
+    ///
+    /// Process the user request, through the result cache (see ResultCache) if it is enabled.
+    /// On a cache hit, metrics are the ones of the request that has computed the result.
+    /// The "cached" metric tells whether the result comes from the cache.
+    std::shared_ptr<const Result> process_cached( const Request& request );
+
+    ///
+    /// Deadline of the request being processed.
+    /// process_cached() starts it with the "request/timeout" option of the request, in seconds, or else with the one
+    /// the plugin has been created with (see Plugin::request_timeout()). The timeout of the plugin is a maximum,
+    /// a request can only ask for a shorter one. When the deadline is reached, or when the
+    /// request is cancelled, the search throws DeadlineExceeded and the "timeout" metric is set.
+    Deadline& deadline() { return deadline_; }
+
+    ///
+    /// To be called by search loops on each iteration, throws DeadlineExceeded if the request has expired.
+    /// This is cheap, see Deadline::check().
+    void check_deadline() { deadline_.check(); }
+
 protected:
     /// The parent plugin
     const Plugin* plugin_;
@@ -130,7 +150,16 @@ protected:
     /// Plugin metrics
     MetricValueList metrics_;
 
+    /// Timeout of the request, in seconds, 0 if none
+    double timeout_s_;
+
+    Deadline deadline_;
+
 private:
+    ///
+    /// Start the deadline, then process the request
+    std::unique_ptr<Result> process_with_deadline( const Request& request );
+
     ///
     /// Method used to get an option value
     template <class T>
@@ -247,10 +276,50 @@ public:
     /// Create a PluginRequest object
     virtual std::unique_ptr<PluginRequest> request( const VariantMap& options = VariantMap() ) const = 0;
 
+    ///
+    /// Result of one request of a batch
+    struct BatchResult {
+        /// The result, null if the request failed
+        std::shared_ptr<const Result> result;
+        /// Metrics of the request
+        PluginRequest::MetricValueList metrics;
+        /// Error message, if the request failed
+        std::string error;
+    };
+
+    ///
+    /// Process a batch of requests sharing the same options.
+    /// Requests are processed in parallel. If reusable_requests() is true, each thread creates a single PluginRequest
+    /// for all its requests, otherwise one PluginRequest is created per request.
+    /// A request that fails does not stop the batch, its error is returned.
+    /// Results go through the result cache, see PluginRequest::process_cached().
+    /// \param[in] requests The requests
+    /// \param[in] options Option values of all the requests
+    /// \param[in] num_threads Number of threads, 0 for the default number of threads
+    /// \return The results, in the order of the requests
+    virtual std::vector<BatchResult> process_batch( const std::vector<Request>& requests, const VariantMap& options = VariantMap(), int num_threads = 0 ) const;
+
+    ///
+    /// Whether PluginRequest::process() can be called several times on a request of this plugin.
+    /// False by default.
+    virtual bool reusable_requests() const { return false; }
+
     ///
     /// Gets access to the underlying routing data
     virtual const RoutingData* routing_data() const = 0;
 
+    ///
+    /// Routing data loaded by the plugin with use_routing_data()
+    struct RoutingDataUse {
+        /// Name of the data builder
+        std::string name;
+        /// Loading options
+        VariantMap options;
+        /// The plugin keeps its data alive, even if they are reloaded
+        std::shared_ptr<const RoutingData> data;
+    };
+    const std::vector<RoutingDataUse>& routing_data_uses() const { return routing_data_uses_; }
+
     ///
     /// Gets an option value, or the default value if unavailable
     Variant get_option_or_default( const VariantMap& options, const std::string& key ) const;
@@ -258,6 +327,17 @@ public:
     std::string db_options() const { return db_options_; }
     std::string schema_name() const { return schema_name_; }
 
+    ///
+    /// Default timeout of the requests of this plugin, in seconds, 0 if none.
+    /// It is given by the "request/timeout" option the plugin has been created with.
+    double request_timeout() const { return request_timeout_; }
+
+protected:
+    ///
+    /// Load routing data (see load_routing_data()) and keep a handle on them for the lifetime of the plugin.
+    /// Data loaded this way are loaded again when the plugin is reloaded (see PluginFactory::reload_plugin()).
+    const RoutingData* use_routing_data( const std::string& data_name, ProgressionCallback& progression, const VariantMap& options = VariantMap() );
+
 private:
     /// Name of the dll this plugin comes from
     std::string name_;
@@ -267,6 +347,9 @@ private:
 
     std::string db_options_;
     std::string schema_name_;
+    double request_timeout_;
+
+    std::vector<RoutingDataUse> routing_data_uses_;
 };
 
 
@@ -298,6 +381,7 @@ public:
         ( plugin_->*VertexAccessorFunction )( v, PluginRequest::InitAccess );
     }
     void examine_vertex( const VDescriptor& v, const Graph& ) {
+        plugin_->check_deadline();
         ( plugin_->*VertexAccessorFunction )( v, PluginRequest::ExamineAccess );
     }
     void discover_vertex( const VDescriptor& v, const Graph& ) {
@@ -208,15 +208,51 @@ Plugin* PluginFactory::create_plugin( const std::string& dll_name, ProgressionCa
         it = dll_.find( dll_name );
     }
     if ( !it->second.plugin ) {
-        it->second.plugin.reset( (*it->second.create_fct)( progression, options ) );
+        std::shared_ptr<Plugin> new_plugin( (*it->second.create_fct)( progression, options ) );
+        boost::lock_guard<boost::mutex> lock( plugin_mutex_ );
+        it->second.plugin = new_plugin;
+        it->second.options = options;
     }
     return it->second.plugin.get();
 }
 
 Plugin* PluginFactory::plugin( const std::string& dll_name ) const
+{
+    return plugin_handle( dll_name ).get();
+}
+
+std::shared_ptr<Plugin> PluginFactory::plugin_handle( const std::string& dll_name ) const
 {
     const Dll* dll = test_if_loaded_( dll_name );
-    return dll->plugin.get();
+    boost::lock_guard<boost::mutex> lock( plugin_mutex_ );
+    return dll->plugin;
+}
+
+std::shared_ptr<Plugin> PluginFactory::reload_plugin( const std::string& dll_name, ProgressionCallback& progression )
+{
+    boost::lock_guard<boost::mutex> reload_lock( reload_mutex_ );
+
+    test_if_loaded_( dll_name );
+    Dll& dll = dll_.find( dll_name )->second;
+    std::shared_ptr<Plugin> old_plugin = plugin_handle( dll_name );
+    if ( !old_plugin ) {
+        throw std::runtime_error( "Plugin " + dll_name + " has not been created" );
+    }
+
+    // new data first, so that the new plugin finds them
+    for ( const Plugin::RoutingDataUse& use : old_plugin->routing_data_uses() ) {
+        COUT << "Reloading " << use.name << " for " << dll_name << std::endl;
+        if ( !reload_routing_data( use.name, progression, use.options ) ) {
+            throw std::runtime_error( "Cannot reload " + use.name );
+        }
+    }
+
+    // the current plugin goes on serving requests while the new one is created
+    std::shared_ptr<Plugin> new_plugin( (*dll.create_fct)( progression, dll.options ) );
+
+    boost::lock_guard<boost::mutex> lock( plugin_mutex_ );
+    dll.plugin = new_plugin;
+    return new_plugin;
 }
 
 std::vector<std::string> PluginFactory::plugin_list() const
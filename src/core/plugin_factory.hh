@@ -20,7 +20,16 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 #include <boost/noncopyable.hpp>
+#ifdef _WIN32
+#pragma warning(push, 0)
+#endif
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
 
 #include "plugin.hh"
 
@@ -58,10 +67,27 @@ struct PluginFactory: boost::noncopyable {
     /**
      * LReturn a preloaded plugin
      * throws std::runtime_error if dll cannot be found
-     * The returned pointer must not be deleted by the caller
+     * The returned pointer must not be deleted by the caller. It is invalidated when the plugin is reloaded.
      */
     Plugin* plugin( const std::string& dll_name ) const;
 
+    /**
+     * Return a preloaded plugin, or null if it has not been created.
+     * The handle keeps the plugin and its routing data alive, even if the plugin is reloaded in the meantime.
+     * throws std::runtime_error if dll cannot be found
+     */
+    std::shared_ptr<Plugin> plugin_handle( const std::string& dll_name ) const;
+
+    /**
+     * Reload a plugin along with its routing data.
+     * The routing data used by the plugin (see Plugin::use_routing_data()) are built again, then a new plugin is
+     * created with the options of the current one and replaces it.
+     * Requests that hold a handle on the previous plugin go on with it and its data, that are freed once the
+     * last handle is released. Reloads are serialized.
+     * throws std::runtime_error if the plugin has not been created
+     */
+    std::shared_ptr<Plugin> reload_plugin( const std::string& dll_name, ProgressionCallback& progression );
+
     static PluginFactory* instance();
 
 private:
@@ -76,7 +102,9 @@ private:
     struct Dll {
         HMODULE handle;
         PluginCreationFct create_fct;
-        std::unique_ptr<Plugin> plugin;
+        std::shared_ptr<Plugin> plugin;
+        /// options the plugin has been created with
+        VariantMap options;
         std::unique_ptr<const Plugin::OptionDescriptionList> option_descriptions;
         std::unique_ptr<const Plugin::Capabilities> plugin_capabilities;
     };
@@ -84,6 +112,10 @@ private:
     typedef std::map<std::string, Dll > DllMap;
     DllMap dll_;
 
+    // guards the plugin of each dll
+    mutable boost::mutex plugin_mutex_;
+    boost::mutex reload_mutex_;
+
     const Dll* test_if_loaded_( const std::string& ) const;
 };
 // use of volatile for shared resources is explaned here http://www.drdobbs.com/cpp/volatile-the-multithreaded-programmers-b/184403766
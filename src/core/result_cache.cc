@@ -0,0 +1,246 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+
+#ifdef _WIN32
+#pragma warning(push, 0)
+#endif
+#include <boost/functional/hash.hpp>
+#include <boost/thread/lock_guard.hpp>
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+#include "result_cache.hh"
+#include "plugin.hh"
+
+namespace Tempus
+{
+
+namespace
+{
+
+void write_date_time( std::ostream& ostr, const DateTime& dt )
+{
+    if ( dt.is_special() ) {
+        ostr << dt;
+        return;
+    }
+    // rounded down to the minute
+    const boost::posix_time::time_duration tod = dt.time_of_day();
+    ostr << DateTime( dt.date(), boost::posix_time::hours( tod.hours() ) + boost::posix_time::minutes( tod.minutes() ) );
+}
+
+}
+
+ResultCache::ResultCache( size_t max_bytes, double ttl_s, size_t num_shards ) :
+    max_bytes_( max_bytes ),
+    ttl_ms_( int64_t( ttl_s * 1000.0 ) )
+{
+    if ( num_shards == 0 ) {
+        throw std::invalid_argument( "ResultCache: the number of shards must be positive" );
+    }
+    for ( size_t i = 0; i < num_shards; i++ ) {
+        shards_.emplace_back( new Shard() );
+    }
+}
+
+ResultCache& ResultCache::instance()
+{
+    static ResultCache cache;
+    return cache;
+}
+
+void ResultCache::configure( size_t max_bytes, double ttl_s )
+{
+    max_bytes_ = max_bytes;
+    ttl_ms_ = int64_t( ttl_s * 1000.0 );
+    for ( auto& s : shards_ ) {
+        boost::lock_guard<boost::mutex> lock( s->mutex );
+        evict( *s, max_bytes / shards_.size() );
+    }
+}
+
+std::string ResultCache::key( const Plugin& plugin, const VariantMap& options, const Request& request )
+{
+    std::ostringstream ostr;
+    // new routing data (reloaded graph or timetables) have a new serial, their results never match older ones
+    const RoutingData* rd = plugin.routing_data();
+    ostr << plugin.name() << '\n' << ( rd ? rd->serial() : 0 ) << '\n';
+
+    // options are sorted by name, the timeout does not change the result
+    for ( const auto& p : options ) {
+        if ( p.first == "request/timeout" ) {
+            continue;
+        }
+        ostr << p.first << '=' << int( p.second.type() ) << ':' << p.second.str() << '\n';
+    }
+
+    for ( size_t i = 0; i < request.steps().size(); i++ ) {
+        const Request::Step& step = request.steps()[i];
+        ostr << 's' << step.location() << ',' << step.private_vehicule_at_destination();
+        // the time constraint of the origin is ignored
+        if ( i > 0 ) {
+            ostr << ',' << int( step.constraint().type() ) << ',';
+            write_date_time( ostr, step.constraint().date_time() );
+        }
+        ostr << '\n';
+    }
+
+    // allowed modes are sorted
+    ostr << 'm';
+    for ( db_id_t m : request.allowed_modes() ) {
+        ostr << m << ',';
+    }
+    ostr << "\nc";
+    for ( CostId c : request.optimizing_criteria() ) {
+        ostr << int( c ) << ',';
+    }
+    ostr << "\np";
+    if ( request.parking_location() ) {
+        ostr << request.parking_location().get();
+    }
+    return ostr.str();
+}
+
+ResultCache::Shard& ResultCache::shard( const std::string& key )
+{
+    return *shards_[ boost::hash<std::string>()( key ) % shards_.size() ];
+}
+
+bool ResultCache::find( const std::string& key, Entry& entry )
+{
+    Shard& s = shard( key );
+    boost::lock_guard<boost::mutex> lock( s.mutex );
+    auto it = s.index.find( key );
+    if ( it == s.index.end() ) {
+        s.misses++;
+        return false;
+    }
+    if ( ttl_ms_ > 0 && Clock::now() >= it->second->expiration ) {
+        s.bytes -= it->second->bytes;
+        s.lru.erase( it->second );
+        s.index.erase( it );
+        s.misses++;
+        return false;
+    }
+    // move to the front
+    s.lru.splice( s.lru.begin(), s.lru, it->second );
+    entry = it->second->entry;
+    s.hits++;
+    return true;
+}
+
+void ResultCache::insert( const std::string& key, const Entry& entry )
+{
+    const size_t shard_max_bytes = max_bytes_ / shards_.size();
+    // the key is stored twice
+    const size_t bytes = sizeof( Node ) + 2 * key.size() + result_size( *entry.result );
+    if ( bytes > shard_max_bytes ) {
+        return;
+    }
+
+    Shard& s = shard( key );
+    boost::lock_guard<boost::mutex> lock( s.mutex );
+    auto it = s.index.find( key );
+    if ( it != s.index.end() ) {
+        s.bytes -= it->second->bytes;
+        s.lru.erase( it->second );
+        s.index.erase( it );
+    }
+    evict( s, shard_max_bytes - bytes );
+
+    Node node;
+    node.key = key;
+    node.entry = entry;
+    node.bytes = bytes;
+    node.expiration = Clock::now() + std::chrono::milliseconds( ttl_ms_ );
+    s.lru.push_front( node );
+    s.index[key] = s.lru.begin();
+    s.bytes += bytes;
+}
+
+void ResultCache::evict( Shard& s, size_t max_bytes )
+{
+    while ( s.bytes > max_bytes && !s.lru.empty() ) {
+        s.bytes -= s.lru.back().bytes;
+        s.index.erase( s.lru.back().key );
+        s.lru.pop_back();
+        s.evictions++;
+    }
+}
+
+void ResultCache::clear()
+{
+    for ( auto& s : shards_ ) {
+        boost::lock_guard<boost::mutex> lock( s->mutex );
+        s->lru.clear();
+        s->index.clear();
+        s->bytes = 0;
+    }
+}
+
+ResultCache::Statistics ResultCache::statistics() const
+{
+    Statistics stats = { 0, 0, 0, 0, 0 };
+    for ( const auto& s : shards_ ) {
+        boost::lock_guard<boost::mutex> lock( s->mutex );
+        stats.hits += s->hits;
+        stats.misses += s->misses;
+        stats.evictions += s->evictions;
+        stats.entries += s->lru.size();
+        stats.bytes += s->bytes;
+    }
+    return stats;
+}
+
+size_t ResultCache::result_size( const Result& result )
+{
+    size_t bytes = 0;
+    for ( const Roadmap& roadmap : result ) {
+        // list node
+        bytes += sizeof( Roadmap ) + 2 * sizeof( void* );
+        for ( const Roadmap::Step& step : roadmap ) {
+            bytes += sizeof( void* ) + step.geometry_wkb().capacity() + step.costs().size() * ( sizeof( Costs::value_type ) + 3 * sizeof( void* ) );
+            switch ( step.step_type() ) {
+            case Roadmap::Step::RoadStep:
+                bytes += sizeof( Roadmap::RoadStep ) + static_cast<const Roadmap::RoadStep&>( step ).road_name().capacity();
+                break;
+            case Roadmap::Step::PublicTransportStep: {
+                const Roadmap::PublicTransportStep& pt_step = static_cast<const Roadmap::PublicTransportStep&>( step );
+                bytes += sizeof( Roadmap::PublicTransportStep ) + pt_step.departure_name().capacity() + pt_step.arrival_name().capacity() + pt_step.route().capacity();
+                break;
+            }
+            case Roadmap::Step::TransferStep: {
+                const Roadmap::TransferStep& transfer_step = static_cast<const Roadmap::TransferStep&>( step );
+                bytes += sizeof( Roadmap::TransferStep ) + transfer_step.initial_name().capacity() + transfer_step.final_name().capacity();
+                break;
+            }
+            }
+        }
+        bytes += roadmap.trace().capacity() * sizeof( ValuedEdge );
+        for ( const ValuedEdge& ve : roadmap.trace() ) {
+            bytes += ve.geometry_wkb().capacity();
+            for ( const auto& v : ve.values() ) {
+                bytes += sizeof( VariantMap::value_type ) + 3 * sizeof( void* ) + v.first.capacity() + v.second.str().size();
+            }
+        }
+    }
+    return bytes;
+}
+
+} // namespace Tempus
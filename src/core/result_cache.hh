@@ -0,0 +1,150 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_RESULT_CACHE_HH
+#define TEMPUS_RESULT_CACHE_HH
+
+#include <list>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#ifdef _WIN32
+#pragma warning(push, 0)
+#endif
+#include <boost/thread/mutex.hpp>
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+#include "roadmap.hh"
+#include "request.hh"
+#include "variant.hh"
+
+namespace Tempus
+{
+
+class Plugin;
+
+///
+/// Cache of results of identical requests, shared by all the threads of a process.
+///
+/// The cache is made of shards, each with its own lock and its own LRU list, the shard of a key
+/// being given by its hash. The memory budget and the time to live apply to each shard: the least recently
+/// used entries of a shard are evicted when its share of the budget is exceeded, an entry older than the time
+/// to live is never returned.
+///
+/// The cache is disabled (budget of 0) by default.
+class ResultCache
+{
+public:
+    ///
+    /// A cached result and the metrics of the request that has computed it
+    struct Entry {
+        std::shared_ptr<const Result> result;
+        VariantMap metrics;
+    };
+
+    struct Statistics {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t entries;
+        /// estimated size of the entries, in bytes
+        size_t bytes;
+    };
+
+    ///
+    /// \param[in] max_bytes Memory budget, in bytes. 0 disables the cache
+    /// \param[in] ttl_s Time to live of an entry, in seconds. 0 for no expiration
+    /// \param[in] num_shards Number of shards
+    explicit ResultCache( size_t max_bytes = 0, double ttl_s = 0.0, size_t num_shards = 16 );
+
+    ///
+    /// Process-wide cache
+    static ResultCache& instance();
+
+    ///
+    /// Change the memory budget and the time to live. Entries are evicted if needed.
+    void configure( size_t max_bytes, double ttl_s );
+
+    bool enabled() const { return max_bytes_ > 0; }
+
+    ///
+    /// Canonical key of a request.
+    /// It is made of the plugin name, the serial of its routing data, the options and the request contents.
+    /// Times of the request are rounded down to the minute, so that requests in the same minute share their result.
+    static std::string key( const Plugin& plugin, const VariantMap& options, const Request& request );
+
+    ///
+    /// Look for an entry
+    /// \return false if the key is not in the cache or if its entry has expired
+    bool find( const std::string& key, Entry& entry );
+
+    ///
+    /// Insert or replace an entry
+    void insert( const std::string& key, const Entry& entry );
+
+    ///
+    /// Remove all the entries
+    void clear();
+
+    Statistics statistics() const;
+
+    ///
+    /// Estimated memory footprint of a result, in bytes
+    static size_t result_size( const Result& result );
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Node {
+        std::string key;
+        Entry entry;
+        size_t bytes;
+        Clock::time_point expiration;
+    };
+
+    struct Shard {
+        boost::mutex mutex;
+        /// most recently used first
+        std::list<Node> lru;
+        std::unordered_map<std::string, std::list<Node>::iterator> index;
+        size_t bytes;
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        Shard() : bytes( 0 ), hits( 0 ), misses( 0 ), evictions( 0 ) {}
+    };
+
+    Shard& shard( const std::string& key );
+
+    // evict the least recently used entries of a shard until it holds at most max_bytes, the shard must be locked
+    void evict( Shard& shard, size_t max_bytes );
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    std::atomic<size_t> max_bytes_;
+    // time to live, in milliseconds, 0 for no expiration
+    std::atomic<int64_t> ttl_ms_;
+};
+
+} // namespace Tempus
+
+#endif
@@ -1,10 +1,21 @@
+#include <atomic>
+
+#ifdef _WIN32
+#pragma warning(push, 0)
+#endif
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
 #include "routing_data.hh"
 #include "routing_data_builder.hh"
 
 namespace Tempus
 {
 
-using RoutingDataRegistry = std::map<std::string, std::unique_ptr<RoutingData>>;
+using RoutingDataRegistry = std::map<std::string, std::shared_ptr<const RoutingData>>;
 
 static RoutingDataRegistry& instance()
 {
@@ -12,24 +23,29 @@ static RoutingDataRegistry& instance()
     return r;
 }
 
-const RoutingData* load_routing_data( const std::string& name, ProgressionCallback& progression, const VariantMap& options )
+static boost::mutex& registry_mutex()
+{
+    static boost::mutex m;
+    return m;
+}
+
+static std::string routing_data_key( const std::string& name, const VariantMap& options )
 {
     std::string key = name;
     for ( const auto& p : options ) {
         key += p.first + ":" + p.second.str();
     }
+    return key;
+}
 
-    auto it = instance().find( key );
-    if ( it != instance().end() ) {
-        return it->second.get();
-    }
-
+// load from the db or from a file, null if there is no builder of this name
+static std::unique_ptr<RoutingData> build_routing_data( const std::string& name, ProgressionCallback& progression, const VariantMap& options )
+{
     const RoutingDataBuilder* builder = RoutingDataBuilderRegistry::instance().builder( name );
     if ( !builder ) {
-        return nullptr;
+        return std::unique_ptr<RoutingData>();
     }
 
-    // load from the db or from a file
     // with priority given to the dump file
     std::unique_ptr<RoutingData> routing_data;
     if ( options.find( "from_file" ) != options.end() ) {
@@ -44,8 +60,54 @@ const RoutingData* load_routing_data( const std::string& name, ProgressionCallba
         }
         routing_data.reset( builder->pg_import( db_options, progression, options ).release() );
     }
-    instance()[key] = std::move( routing_data );
-    return instance()[key].get();
+    return routing_data;
+}
+
+RoutingData::RoutingData( const std::string& n ) : name_(n)
+{
+    static std::atomic<uint64_t> next_serial( 1 );
+    serial_ = next_serial++;
+}
+
+const RoutingData* load_routing_data( const std::string& name, ProgressionCallback& progression, const VariantMap& options )
+{
+    return routing_data_handle( name, progression, options ).get();
+}
+
+std::shared_ptr<const RoutingData> routing_data_handle( const std::string& name, ProgressionCallback& progression, const VariantMap& options )
+{
+    const std::string key = routing_data_key( name, options );
+    {
+        boost::lock_guard<boost::mutex> lock( registry_mutex() );
+        auto it = instance().find( key );
+        if ( it != instance().end() ) {
+            return it->second;
+        }
+    }
+
+    // data are built without holding the lock, other data can be accessed in the meantime
+    std::shared_ptr<const RoutingData> routing_data( build_routing_data( name, progression, options ).release() );
+    if ( !routing_data ) {
+        return routing_data;
+    }
+
+    boost::lock_guard<boost::mutex> lock( registry_mutex() );
+    // the first data built are kept, if the same data have been loaded in between
+    auto it = instance().insert( std::make_pair( key, routing_data ) ).first;
+    return it->second;
+}
+
+std::shared_ptr<const RoutingData> reload_routing_data( const std::string& name, ProgressionCallback& progression, const VariantMap& options )
+{
+    std::shared_ptr<const RoutingData> routing_data( build_routing_data( name, progression, options ).release() );
+    if ( !routing_data ) {
+        return routing_data;
+    }
+
+    boost::lock_guard<boost::mutex> lock( registry_mutex() );
+    // previous data are freed once their last handle is released
+    instance()[routing_data_key( name, options )] = routing_data;
+    return routing_data;
 }
 
 void dump_routing_data( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression )
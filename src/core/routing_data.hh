@@ -9,6 +9,7 @@
 #include "public_transport.hh"
 
 #include <boost/optional.hpp>
+#include <memory>
 
 namespace Tempus
 {
@@ -62,7 +63,7 @@ public:
 class RoutingData
 {
 public:
-    RoutingData( const std::string& n ) : name_(n) {}
+    RoutingData( const std::string& n );
 
     virtual ~RoutingData() {}
 
@@ -70,6 +71,11 @@ public:
     /// Name of the data
     std::string name() const { return name_; }
 
+    ///
+    /// Serial number of the data, unique in the process.
+    /// Data loaded again (graph or timetables) get a new serial, so that results computed on older data can be told apart.
+    uint64_t serial() const { return serial_; }
+
     typedef std::map<db_id_t, TransportMode> TransportModes;
     ///
     /// Access to transport modes
@@ -116,6 +122,8 @@ public:
 private:
     std::string name_;
 
+    uint64_t serial_;
+
 protected:
     ///
     /// Graph metadata
@@ -136,8 +144,21 @@ private:
 /// Load routing data given its name and options
 /// The name is the name of the data builder
 /// Routing data are stored globally
+/// The returned pointer stays valid as long as the data are not reloaded, see routing_data_handle()
 const RoutingData* load_routing_data( const std::string& data_name, ProgressionCallback& progression, const VariantMap& options = VariantMap() );
 
+///
+/// Load routing data given its name and options, as load_routing_data() does.
+/// The returned handle keeps the data alive, even if they are reloaded in the meantime.
+/// Null if there is no builder of this name.
+std::shared_ptr<const RoutingData> routing_data_handle( const std::string& data_name, ProgressionCallback& progression, const VariantMap& options = VariantMap() );
+
+///
+/// Build routing data again (from the db or from a file) and replace the ones stored for the same name and options.
+/// The previous data are not modified, they are freed once their last handle is released.
+/// \return A handle on the new data, null if there is no builder of this name
+std::shared_ptr<const RoutingData> reload_routing_data( const std::string& data_name, ProgressionCallback& progression, const VariantMap& options = VariantMap() );
+
 void dump_routing_data( const RoutingData* rd, const std::string& file_name, ProgressionCallback& progression );
 
 }
@@ -45,7 +45,7 @@ void RoutingDataBuilder::write_header( std::ostream& ostr ) const
     ostr.write( reinterpret_cast<const char*>( &v ), sizeof( uint32_t ) );
 }
 
-void RoutingDataBuilder::read_header( std::istream& istr ) const
+uint32_t RoutingDataBuilder::read_header( std::istream& istr ) const
 {
     char magic[5];
     istr.read( magic, 4 );
@@ -64,6 +64,7 @@ void RoutingDataBuilder::read_header( std::istream& istr ) const
         throw std::runtime_error( "Wrong version" );
     }
     std::cout << "Read header of type " << name() << std::endl;
+    return v;
 }
 
 std::unique_ptr<RoutingData> RoutingDataBuilder::pg_import( const std::string& /*pg_options*/, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
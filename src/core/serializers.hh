@@ -22,6 +22,7 @@
 #include <map>
 #include <set>
 #include <vector>
+#include <string>
 #include <type_traits>
 
 #include <boost/optional.hpp>
@@ -56,6 +57,8 @@ void serialize( std::ostream& ostr, const TransportMode& tm, binary_serializatio
 void unserialize( std::istream& istr, TransportMode& tm, binary_serialization_t t );
 void serialize( std::ostream& ostr, const Multimodal::Graph& g, binary_serialization_t t );
 void unserialize( std::istream& istr, Multimodal::Graph& g, binary_serialization_t t );
+void serialize( std::ostream& ostr, const std::string& s, binary_serialization_t t );
+void unserialize( std::istream& istr, std::string& s, binary_serialization_t t );
 
 
 void serialize( std::ostream& ostr, const char* ptr, size_t s, binary_serialization_t );
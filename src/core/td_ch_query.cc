@@ -0,0 +1,211 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "td_ch_query.hh"
+#include "ch_upward_search.hh"
+
+#include <algorithm>
+#include <limits>
+#include <list>
+
+namespace Tempus
+{
+
+namespace
+{
+
+// Tolerance (in minutes) added to the upper bound of the travel time, so that rounding errors
+// on lower bounds do not cut the backward search before an edge of the optimal path
+const float UPPER_BOUND_TOLERANCE = 0.01f;
+
+///
+/// Unpack the edge e at the given departure time
+/// The middle node of a time-dependent shortcut depends on the departure time, each candidate is evaluated.
+/// Returns the arrival time
+template <typename OutIterator>
+float td_unpack_edge( const TDCHRoutingData& rd, const TDCHEdge& e, float departure, OutIterator& out_it )
+{
+    const TDCHQuery& graph = rd.td_ch_query();
+    const TDCHEdgeProperty& p = e.property();
+    if ( !p.is_shortcut() ) {
+        float d = rd.ttf( p.ttf )( departure );
+        *out_it = TDCHPathStep{ p.db_id, departure, d };
+        out_it++;
+        return departure + d;
+    }
+
+    const TDCHShortcut& s = rd.shortcut( p.shortcut );
+    float best_arrival = std::numeric_limits<float>::max();
+    TDCHEdge best_first, best_second;
+    bool best_is_original = false;
+    if ( s.original_ttf != TDCHShortcut::NoTTF ) {
+        best_arrival = rd.ttf( s.original_ttf ).arrival( departure );
+        best_is_original = true;
+    }
+    for ( CHVertex m : s.middle_nodes ) {
+        TDCHEdge e1, e2;
+        bool found1 = false, found2 = false;
+        boost::tie( e1, found1 ) = edge( e.source(), m, graph );
+        boost::tie( e2, found2 ) = edge( m, e.target(), graph );
+        if ( !found1 || !found2 ) {
+            continue;
+        }
+        float a = rd.ttf( e2.property().ttf ).arrival( rd.ttf( e1.property().ttf ).arrival( departure ) );
+        if ( a < best_arrival ) {
+            best_arrival = a;
+            best_first = e1;
+            best_second = e2;
+            best_is_original = false;
+        }
+    }
+    BOOST_ASSERT( best_arrival < std::numeric_limits<float>::max() );
+
+    if ( best_is_original ) {
+        *out_it = TDCHPathStep{ p.db_id, departure, best_arrival - departure };
+        out_it++;
+        return best_arrival;
+    }
+    float a = td_unpack_edge( rd, best_first, departure, out_it );
+    return td_unpack_edge( rd, best_second, a, out_it );
+}
+
+///
+/// Downward edges marked by the backward search of the calling thread
+std::vector<TDCHEdge>& td_marked_edges()
+{
+    static thread_local std::vector<TDCHEdge> edges;
+    return edges;
+}
+
+}
+
+std::vector<TDCHPathStep> td_ch_query( const TDCHRoutingData& rd, CHVertex origin, CHVertex destination, float departure, size_t& iterations, Deadline& deadline )
+{
+    const TDCHQuery& graph = rd.td_ch_query();
+    const size_t n = num_vertices( graph );
+    CHQueryWorkspace<CHVertex, float>& workspace = ch_query_workspace<CHVertex, float>();
+    CHSearchSpace<CHVertex, float>& forward = workspace.search[0];
+    CHSearchSpace<CHVertex, float>& backward = workspace.search[1];
+    const float infinity = std::numeric_limits<float>::max();
+
+    std::vector<TDCHPathStep> path;
+
+    //
+    // Upper bound of the travel time, by a static CH query on upper bounds
+    float upper_bound = infinity;
+    {
+        auto max_weight = [&rd]( const TDCHEdge& e ) { return rd.ttf( e.property().ttf ).max(); };
+        ch_upward_search( graph, origin, CHDirection::Forward, max_weight, forward, [&]( CHVertex, float ) {
+                deadline.check();
+                iterations++;
+            });
+        ch_upward_search( graph, destination, CHDirection::Backward, max_weight, backward, [&]( CHVertex v, float c ) {
+                deadline.check();
+                iterations++;
+                if ( forward.reached( v ) ) {
+                    upper_bound = std::min( upper_bound, forward.cost( v ) + c );
+                }
+            });
+    }
+    if ( upper_bound == infinity ) {
+        return path;
+    }
+    const float bound = upper_bound + UPPER_BOUND_TOLERANCE;
+
+    //
+    // Backward search on lower bounds, every vertex with a lower bound above the upper bound is ignored
+    std::vector<TDCHEdge>& marked = td_marked_edges();
+    marked.clear();
+    backward.reset( n );
+    backward.set( destination, 0.0, backward.no_edge() );
+    backward.queue().push( destination, 0.0 );
+    while ( !backward.queue().empty() ) {
+        CHVertex v = backward.queue().top();
+        float d = backward.queue().top_key();
+        backward.queue().pop();
+        deadline.check();
+        iterations++;
+        for ( auto iei = in_edges( v, graph ).first; iei != in_edges( v, graph ).second; iei++ ) {
+            CHVertex x = source( *iei, graph );
+            float nd = d + rd.ttf( iei->property().ttf ).min();
+            if ( nd > bound ) {
+                continue;
+            }
+            marked.push_back( *iei );
+            if ( nd < backward.cost( x ) ) {
+                backward.set( x, nd, iei->index() );
+                backward.queue().push_or_decrease( x, nd );
+            }
+        }
+    }
+    // marked edges, indexed by their source
+    std::sort( marked.begin(), marked.end(), []( const TDCHEdge& a, const TDCHEdge& b ) { return a.source() < b.source(); } );
+
+    //
+    // Forward time-dependent search, the cost of a vertex is its arrival time
+    forward.reset( n );
+    forward.set( origin, departure, forward.no_edge() );
+    forward.queue().push( origin, departure );
+
+    auto relax = [&]( float t, const TDCHEdge& e ) {
+        CHVertex w = target( e, graph );
+        float nt = rd.ttf( e.property().ttf ).arrival( t );
+        if ( nt < forward.cost( w ) ) {
+            forward.set( w, nt, e.index() );
+            forward.queue().push_or_decrease( w, nt );
+        }
+    };
+
+    bool path_found = false;
+    while ( !forward.queue().empty() ) {
+        CHVertex u = forward.queue().top();
+        float t = forward.queue().top_key();
+        forward.queue().pop();
+        deadline.check();
+        iterations++;
+        if ( u == destination ) {
+            path_found = true;
+            break;
+        }
+        for ( auto oei = out_edges( u, graph ).first; oei != out_edges( u, graph ).second; oei++ ) {
+            relax( t, *oei );
+        }
+        auto first = std::lower_bound( marked.begin(), marked.end(), u, []( const TDCHEdge& e, CHVertex v ) { return e.source() < v; } );
+        for ( auto it = first; it != marked.end() && it->source() == u; ++it ) {
+            relax( t, *it );
+        }
+    }
+
+    if ( !path_found ) {
+        return path;
+    }
+
+    std::list<TDCHEdge> ch_path;
+    for ( CHVertex x = destination; x != origin; ) {
+        TDCHEdge e = graph.edge_from_index( forward.predecessor_edge( x ) );
+        ch_path.push_front( e );
+        x = e.source();
+    }
+
+    auto out_it = std::back_inserter( path );
+    float t = departure;
+    for ( const TDCHEdge& e : ch_path ) {
+        t = td_unpack_edge( rd, e, t, out_it );
+    }
+    return path;
+}
+
+} // namespace Tempus
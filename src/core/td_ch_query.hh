@@ -0,0 +1,54 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_TD_CH_QUERY_HH
+#define TEMPUS_TD_CH_QUERY_HH
+
+#include <vector>
+
+#include "td_ch_routing_data.hh"
+#include "deadline.hh"
+
+namespace Tempus
+{
+
+///
+/// A road section of an unpacked path, with its departure time and duration
+struct TDCHPathStep
+{
+    db_id_t db_id;
+    float departure;
+    float duration;
+};
+
+///
+/// Earliest arrival query on a time-dependent CH graph
+/// 1. upward searches on the upper bounds of travel times give an upper bound of the travel time
+/// 2. a backward search on lower bounds, limited by this upper bound, marks the downward edges that can lead to the destination
+/// 3. a forward time-dependent Dijkstra uses upward edges and the marked downward edges
+/// The searches use the CH query workspace of the calling thread and check the deadline on each iteration.
+/// \param[in] rd The time-dependent CH data
+/// \param[in] origin The origin vertex
+/// \param[in] destination The destination vertex
+/// \param[in] departure Departure time, in minutes since midnight
+/// \param[inout] iterations Incremented by the number of settled vertices
+/// \param[in] deadline Deadline of the request
+/// \returns the unpacked path, empty if no path has been found
+std::vector<TDCHPathStep> td_ch_query( const TDCHRoutingData& rd, CHVertex origin, CHVertex destination, float departure, size_t& iterations, Deadline& deadline );
+
+} // namespace Tempus
+
+#endif
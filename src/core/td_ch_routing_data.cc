@@ -0,0 +1,112 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "td_ch_routing_data.hh"
+
+#include <fstream>
+
+namespace Tempus
+{
+
+TDCHRoutingData::TDCHRoutingData( std::unique_ptr<TDCHQuery> a_query,
+                                  std::vector<TravelTimeFunction>&& a_ttfs,
+                                  std::vector<TDCHShortcut>&& a_shortcuts,
+                                  std::vector<db_id_t>&& a_node_id ) :
+    RoutingData( "td_ch_graph" ),
+    query_( std::move( a_query ) ),
+    ttfs_( std::move( a_ttfs ) ),
+    shortcuts_( std::move( a_shortcuts ) ),
+    node_id_( std::move( a_node_id ) )
+{
+    // update the reverse id map
+    for ( size_t i = 0; i < node_id_.size(); i++ ) {
+        rnode_id_[node_id_[i]] = i;
+    }
+}
+
+boost::optional<CHVertex> TDCHRoutingData::vertex_from_id( db_id_t id ) const
+{
+    auto it = rnode_id_.find( id );
+    if ( it != rnode_id_.end() ) {
+        return CHVertex( it->second );
+    }
+    return boost::optional<CHVertex>();
+}
+
+db_id_t TDCHRoutingData::vertex_id( CHVertex v ) const
+{
+    return node_id_[v];
+}
+
+std::unique_ptr<RoutingData> TDCHRoutingDataBuilder::pg_import( const std::string& /*pg_options*/, ProgressionCallback&, const VariantMap& /*options*/ ) const
+{
+    throw std::runtime_error( "Time-dependent CH data can only be loaded from a dump file produced by td_ch_preprocess" );
+}
+
+std::unique_ptr<RoutingData> TDCHRoutingDataBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ifstream ifs( filename, std::ios::binary );
+    if ( ifs.fail() ) {
+        throw std::runtime_error( "Problem opening input file " + filename );
+    }
+
+    if ( read_header( ifs ) < 2 ) {
+        throw std::runtime_error( "Time-dependent CH dump file " + filename + " uses an obsolete format, it must be generated again" );
+    }
+
+    std::cout << "read transport modes" << std::endl;
+    RoutingData::TransportModes modes;
+    unserialize( ifs, modes, binary_serialization_t() );
+
+    std::cout << "read graph" << std::endl;
+    std::unique_ptr<TDCHQuery> query( new TDCHQuery() );
+    query->unserialize( ifs, binary_serialization_t() );
+
+    std::cout << "read travel time functions" << std::endl;
+    std::vector<TravelTimeFunction> ttfs;
+    unserialize( ifs, ttfs, binary_serialization_t() );
+
+    std::cout << "read shortcuts" << std::endl;
+    std::vector<TDCHShortcut> shortcuts;
+    unserialize( ifs, shortcuts, binary_serialization_t() );
+
+    std::cout << "read node id" << std::endl;
+    std::vector<db_id_t> node_id;
+    unserialize( ifs, node_id, binary_serialization_t() );
+
+    std::unique_ptr<RoutingData> rd( new TDCHRoutingData( std::move( query ), std::move( ttfs ), std::move( shortcuts ), std::move( node_id ) ) );
+    rd->set_transport_modes( modes );
+    return rd;
+}
+
+void TDCHRoutingDataBuilder::file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ofstream ofs( filename, std::ios::binary );
+
+    write_header( ofs );
+
+    const TDCHRoutingData* trd = static_cast<const TDCHRoutingData*>( rd );
+
+    serialize( ofs, trd->transport_modes(), binary_serialization_t() );
+    trd->query_->serialize( ofs, binary_serialization_t() );
+    serialize( ofs, trd->ttfs_, binary_serialization_t() );
+    serialize( ofs, trd->shortcuts_, binary_serialization_t() );
+    serialize( ofs, trd->node_id_, binary_serialization_t() );
+}
+
+REGISTER_BUILDER( TDCHRoutingDataBuilder )
+
+} // namespace Tempus
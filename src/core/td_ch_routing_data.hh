@@ -0,0 +1,149 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_TD_CH_ROUTING_DATA_HH
+#define TEMPUS_TD_CH_ROUTING_DATA_HH
+
+#include <vector>
+
+#include "ch_routing_data.hh"
+#include "travel_time_function.hh"
+
+namespace Tempus
+{
+
+///
+/// Edge of a time-dependent CH graph.
+/// The travel time function and the shortcut description are stored apart
+/// and referenced by their index
+struct TDCHEdgeProperty
+{
+    static const uint32_t NoShortcut = uint32_t(-1);
+
+    /// index of the travel time function in TDCHRoutingData::ttf()
+    uint32_t ttf;
+    /// index of the shortcut description in TDCHRoutingData::shortcut(), or NoShortcut
+    uint32_t shortcut;
+    /// road section id, 0 for a pure shortcut
+    db_id_t db_id;
+
+    bool is_shortcut() const { return shortcut != NoShortcut; }
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const
+    {
+        Tempus::serialize( ostr, ttf, t );
+        Tempus::serialize( ostr, shortcut, t );
+        Tempus::serialize( ostr, db_id, t );
+    }
+    void unserialize( std::istream& istr, binary_serialization_t t )
+    {
+        Tempus::unserialize( istr, ttf, t );
+        Tempus::unserialize( istr, shortcut, t );
+        Tempus::unserialize( istr, db_id, t );
+    }
+};
+
+///
+/// Description of a time-dependent shortcut.
+/// Since the travel time function of a shortcut is the lower envelope of several paths,
+/// the middle node depends on the departure time. Every candidate is then stored.
+struct TDCHShortcut
+{
+    static const uint32_t NoTTF = uint32_t(-1);
+
+    /// candidate middle nodes
+    std::vector<CHVertex> middle_nodes;
+    /// if the shortcut also replaces an original road section, index of its own travel time function
+    uint32_t original_ttf;
+
+    TDCHShortcut() : original_ttf( NoTTF ) {}
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const
+    {
+        Tempus::serialize( ostr, middle_nodes, t );
+        Tempus::serialize( ostr, original_ttf, t );
+    }
+    void unserialize( std::istream& istr, binary_serialization_t t )
+    {
+        Tempus::unserialize( istr, middle_nodes, t );
+        Tempus::unserialize( istr, original_ttf, t );
+    }
+};
+
+using TDCHQuery = CHQueryGraph<TDCHEdgeProperty>;
+using TDCHEdge = TDCHQuery::edge_descriptor;
+
+///
+/// Routing data out of a time-dependent CH query graph
+/// Vertices are represented by their CH order, as for CHRoutingData
+class TDCHRoutingData : public RoutingData
+{
+public:
+    TDCHRoutingData( std::unique_ptr<TDCHQuery> query,
+                     std::vector<TravelTimeFunction>&& ttfs,
+                     std::vector<TDCHShortcut>&& shortcuts,
+                     std::vector<db_id_t>&& node_id );
+
+    boost::optional<CHVertex> vertex_from_id( db_id_t id ) const;
+
+    db_id_t vertex_id( CHVertex ) const;
+
+    const TDCHQuery& td_ch_query() const { return *query_; }
+
+    const TravelTimeFunction& ttf( uint32_t idx ) const { return ttfs_[idx]; }
+
+    const TDCHShortcut& shortcut( uint32_t idx ) const { return shortcuts_[idx]; }
+
+private:
+    // the CH graph
+    std::unique_ptr<TDCHQuery> query_;
+
+    // travel time functions
+    std::vector<TravelTimeFunction> ttfs_;
+
+    // shortcut descriptions
+    std::vector<TDCHShortcut> shortcuts_;
+
+    // node index -> node id
+    std::vector<db_id_t> node_id_;
+
+    // node id -> index
+    std::map<db_id_t, size_t> rnode_id_;
+
+    friend class TDCHRoutingDataBuilder;
+};
+
+///
+/// Builder of time-dependent CH data.
+/// These data are produced by the td_ch_preprocess tool and can only be loaded from a dump file,
+/// along with the transport modes they are made for.
+class TDCHRoutingDataBuilder : public RoutingDataBuilder
+{
+public:
+    TDCHRoutingDataBuilder() : RoutingDataBuilder( "td_ch_graph" ) {}
+
+    virtual std::unique_ptr<RoutingData> pg_import( const std::string& pg_options, ProgressionCallback&, const VariantMap& options = VariantMap() ) const override;
+
+    virtual std::unique_ptr<RoutingData> file_import( const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+    virtual void file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+
+    /// version 2: transport modes are stored in the dump file
+    uint32_t version() const { return 2; }
+};
+
+} // namespace Tempus
+
+#endif
@@ -0,0 +1,237 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "transit_node_routing_data.hh"
+#include "ch_query_workspace.hh"
+
+#include <fstream>
+#include <algorithm>
+
+namespace Tempus
+{
+
+const uint32_t TransitNodeRoutingData::Infinity;
+
+namespace
+{
+
+uint32_t fixed_point_cost( const CHEdge& e )
+{
+    return e.property().b.cost;
+}
+
+}
+
+TransitNodeRoutingData::TransitNodeRoutingData( uint32_t a_num_vertices,
+                                                uint32_t a_num_transit_nodes,
+                                                std::vector<uint32_t>&& a_table,
+                                                std::vector<uint64_t>&& a_access_offsets,
+                                                std::vector<AccessNode>&& a_access_nodes ) :
+    RoutingData( "transit_nodes" ),
+    num_vertices_( a_num_vertices ),
+    num_transit_nodes_( a_num_transit_nodes ),
+    table_( std::move( a_table ) ),
+    access_offsets_( std::move( a_access_offsets ) ),
+    access_nodes_( std::move( a_access_nodes ) )
+{
+    BOOST_ASSERT( table_.size() == size_t( num_transit_nodes_ ) * num_transit_nodes_ );
+    BOOST_ASSERT( access_offsets_.size() == 2 * size_t( num_vertices_ ) + 1 );
+}
+
+TransitNodeRoutingData::AccessNodeRange TransitNodeRoutingData::access_nodes( CHVertex v, CHDirection dir ) const
+{
+    const size_t idx = dir == CHDirection::Forward ? v : num_vertices_ + v;
+    return std::make_pair( access_nodes_.begin() + access_offsets_[idx], access_nodes_.begin() + access_offsets_[idx + 1] );
+}
+
+uint32_t TransitNodeRoutingData::cost( const CHQuery& graph, CHVertex s, CHVertex t, bool* local ) const
+{
+    CHQueryWorkspace<CHVertex, uint32_t>& workspace = ch_query_workspace<CHVertex, uint32_t>();
+    auto is_transit = [this]( CHVertex v ) { return is_transit_node( v ); };
+
+    // locality filter: CH searches below the transit nodes
+    uint64_t best = Infinity;
+    bool meet = false;
+    ch_upward_search( graph, s, CHDirection::Forward, fixed_point_cost, workspace.search[0], []( CHVertex, uint32_t ) {}, is_transit );
+    ch_upward_search( graph, t, CHDirection::Backward, fixed_point_cost, workspace.search[1], [&]( CHVertex v, uint32_t c ) {
+            const uint32_t forward_cost = workspace.search[0].cost( v );
+            if ( !is_transit_node( v ) && forward_cost != Infinity ) {
+                meet = true;
+                best = std::min( best, uint64_t( forward_cost ) + c );
+            }
+        }, is_transit );
+    if ( local ) {
+        *local = meet;
+    }
+
+    // paths through the transit nodes
+    const AccessNodeRange forward = access_nodes( s, CHDirection::Forward );
+    const AccessNodeRange backward = access_nodes( t, CHDirection::Backward );
+    for ( auto a = forward.first; a != forward.second; a++ ) {
+        const uint32_t* row = &table_[size_t( a->transit ) * num_transit_nodes_];
+        for ( auto b = backward.first; b != backward.second; b++ ) {
+            if ( row[b->transit] != Infinity ) {
+                best = std::min( best, uint64_t( a->cost ) + row[b->transit] + b->cost );
+            }
+        }
+    }
+    return best >= Infinity ? Infinity : uint32_t( best );
+}
+
+std::unique_ptr<TransitNodeRoutingData> build_transit_nodes( const CHQuery& graph, uint32_t num_transit_nodes )
+{
+    typedef TransitNodeRoutingData::AccessNode AccessNode;
+
+    const uint32_t n = num_vertices( graph );
+    const uint32_t k = std::min( num_transit_nodes, n );
+    const CHVertex first_transit = n - k;
+    auto is_transit = [first_transit]( CHVertex v ) { return v >= first_transit; };
+
+    //
+    // Cost table, by a bucket-based many-to-many between the transit nodes
+    // Upward searches from a transit node only reach transit nodes
+    std::vector<std::vector<AccessNode>> backward_space( k );
+    #pragma omp parallel for schedule(dynamic, 16)
+    for ( int b = 0; b < int(k); b++ ) {
+        CHSearchSpace<CHVertex, uint32_t>& search = ch_query_workspace<CHVertex, uint32_t>().search[1];
+        ch_upward_search( graph, first_transit + b, CHDirection::Backward, fixed_point_cost, search, [&]( CHVertex v, uint32_t c ) {
+                backward_space[b].push_back( { v - first_transit, c } );
+            });
+    }
+    // buckets[x]: (b, cost from x to b)
+    std::vector<std::vector<AccessNode>> buckets( k );
+    for ( uint32_t b = 0; b < k; b++ ) {
+        for ( const AccessNode& e : backward_space[b] ) {
+            buckets[e.transit].push_back( { b, e.cost } );
+        }
+        std::vector<AccessNode>().swap( backward_space[b] );
+    }
+
+    std::vector<uint32_t> table( size_t( k ) * k, TransitNodeRoutingData::Infinity );
+    #pragma omp parallel for schedule(dynamic, 16)
+    for ( int a = 0; a < int(k); a++ ) {
+        uint32_t* row = &table[size_t( a ) * k];
+        CHSearchSpace<CHVertex, uint32_t>& search = ch_query_workspace<CHVertex, uint32_t>().search[0];
+        ch_upward_search( graph, first_transit + a, CHDirection::Forward, fixed_point_cost, search, [&]( CHVertex v, uint32_t c ) {
+                for ( const AccessNode& e : buckets[v - first_transit] ) {
+                    const uint64_t cost = uint64_t( c ) + e.cost;
+                    if ( cost < row[e.transit] ) {
+                        row[e.transit] = uint32_t( cost );
+                    }
+                }
+            });
+    }
+    std::vector<std::vector<AccessNode>>().swap( buckets );
+
+    //
+    // Access nodes: transit nodes met by the upward searches pruned at the transit nodes
+    // Candidates are examined by increasing cost, a candidate reached through an already kept access node is pruned
+    std::vector<std::vector<AccessNode>> access( 2 * size_t( n ) );
+    #pragma omp parallel for schedule(dynamic, 256)
+    for ( int v = 0; v < int(n); v++ ) {
+        for ( CHDirection dir : { CHDirection::Forward, CHDirection::Backward } ) {
+            const int d = dir == CHDirection::Forward ? 0 : 1;
+            std::vector<AccessNode> candidates;
+            CHSearchSpace<CHVertex, uint32_t>& search = ch_query_workspace<CHVertex, uint32_t>().search[d];
+            ch_upward_search( graph, CHVertex( v ), dir, fixed_point_cost, search, [&]( CHVertex u, uint32_t c ) {
+                    if ( is_transit( u ) ) {
+                        candidates.push_back( { u - first_transit, c } );
+                    }
+                }, is_transit );
+            std::sort( candidates.begin(), candidates.end(), []( const AccessNode& x, const AccessNode& y ) {
+                    return x.cost < y.cost;
+                });
+
+            std::vector<AccessNode>& kept = access[d * size_t( n ) + v];
+            for ( const AccessNode& c : candidates ) {
+                bool dominated = false;
+                for ( const AccessNode& a : kept ) {
+                    const uint32_t through = d == 0 ? table[size_t( a.transit ) * k + c.transit] : table[size_t( c.transit ) * k + a.transit];
+                    if ( through != TransitNodeRoutingData::Infinity && uint64_t( a.cost ) + through <= c.cost ) {
+                        dominated = true;
+                        break;
+                    }
+                }
+                if ( !dominated ) {
+                    kept.push_back( c );
+                }
+            }
+        }
+    }
+
+    std::vector<uint64_t> access_offsets;
+    std::vector<AccessNode> access_nodes;
+    access_offsets.reserve( 2 * size_t( n ) + 1 );
+    for ( std::vector<AccessNode>& a : access ) {
+        access_offsets.push_back( access_nodes.size() );
+        access_nodes.insert( access_nodes.end(), a.begin(), a.end() );
+        std::vector<AccessNode>().swap( a );
+    }
+    access_offsets.push_back( access_nodes.size() );
+
+    return std::unique_ptr<TransitNodeRoutingData>( new TransitNodeRoutingData( n, k, std::move( table ), std::move( access_offsets ), std::move( access_nodes ) ) );
+}
+
+std::unique_ptr<RoutingData> TransitNodeRoutingDataBuilder::pg_import( const std::string& /*pg_options*/, ProgressionCallback&, const VariantMap& /*options*/ ) const
+{
+    throw std::runtime_error( "Transit nodes can only be loaded from a dump file produced by tnr_preprocess" );
+}
+
+std::unique_ptr<RoutingData> TransitNodeRoutingDataBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ifstream ifs( filename, std::ios::binary );
+    if ( ifs.fail() ) {
+        throw std::runtime_error( "Problem opening input file " + filename );
+    }
+
+    read_header( ifs );
+
+    uint32_t n = 0, k = 0;
+    unserialize( ifs, n, binary_serialization_t() );
+    unserialize( ifs, k, binary_serialization_t() );
+
+    std::cout << "read table" << std::endl;
+    std::vector<uint32_t> table;
+    unserialize( ifs, table, binary_serialization_t() );
+
+    std::cout << "read access nodes" << std::endl;
+    std::vector<uint64_t> access_offsets;
+    std::vector<TransitNodeRoutingData::AccessNode> access_nodes;
+    unserialize( ifs, access_offsets, binary_serialization_t() );
+    unserialize( ifs, access_nodes, binary_serialization_t() );
+
+    std::unique_ptr<RoutingData> rd( new TransitNodeRoutingData( n, k, std::move( table ), std::move( access_offsets ), std::move( access_nodes ) ) );
+    return rd;
+}
+
+void TransitNodeRoutingDataBuilder::file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ofstream ofs( filename, std::ios::binary );
+
+    write_header( ofs );
+
+    const TransitNodeRoutingData* trd = static_cast<const TransitNodeRoutingData*>( rd );
+
+    serialize( ofs, trd->num_vertices_, binary_serialization_t() );
+    serialize( ofs, trd->num_transit_nodes_, binary_serialization_t() );
+    serialize( ofs, trd->table_, binary_serialization_t() );
+    serialize( ofs, trd->access_offsets_, binary_serialization_t() );
+    serialize( ofs, trd->access_nodes_, binary_serialization_t() );
+}
+
+REGISTER_BUILDER( TransitNodeRoutingDataBuilder )
+
+} // namespace Tempus
@@ -0,0 +1,130 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_TRANSIT_NODE_ROUTING_DATA_HH
+#define TEMPUS_TRANSIT_NODE_ROUTING_DATA_HH
+
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "ch_routing_data.hh"
+#include "ch_upward_search.hh"
+
+namespace Tempus
+{
+
+///
+/// Transit-node routing layer on top of a CH graph
+///
+/// The transit nodes are the k highest vertices of the CH order. Their cost table is precomputed, along with
+/// the access nodes of each vertex: the transit nodes its upward search meets first, in each direction.
+/// Access nodes that are reached at a lower cost through another access node are pruned.
+///
+/// A query is local when the upward searches of its origin and of its destination, pruned at the transit nodes,
+/// meet below the transit nodes. This (graph-based) locality filter is exact: the shortest path of a local query
+/// is found by these CH searches, the one of a non-local query goes through access nodes and the table.
+///
+/// These data do not embed the CH graph, they are dumped alongside it and queries take the CH graph as argument.
+/// Costs are the fixed point costs of the CH graph.
+class TransitNodeRoutingData : public RoutingData
+{
+public:
+    static const uint32_t Infinity = uint32_t(-1);
+
+    struct AccessNode
+    {
+        /// index of the transit node, from 0 (the lowest transit node) to num_transit_nodes() - 1
+        uint32_t transit;
+        uint32_t cost;
+
+        void serialize( std::ostream& ostr, binary_serialization_t t ) const
+        {
+            Tempus::serialize( ostr, transit, t );
+            Tempus::serialize( ostr, cost, t );
+        }
+        void unserialize( std::istream& istr, binary_serialization_t t )
+        {
+            Tempus::unserialize( istr, transit, t );
+            Tempus::unserialize( istr, cost, t );
+        }
+    };
+    typedef std::pair<std::vector<AccessNode>::const_iterator, std::vector<AccessNode>::const_iterator> AccessNodeRange;
+
+    ///
+    /// \param[in] num_vertices Number of vertices of the CH graph
+    /// \param[in] table Cost table between transit nodes, row by row
+    /// \param[in] access_offsets Offsets in access_nodes of the forward access nodes of each vertex,
+    ///                           then of its backward access nodes (2 * num_vertices + 1 values)
+    /// \param[in] access_nodes Access nodes
+    TransitNodeRoutingData( uint32_t num_vertices,
+                            uint32_t num_transit_nodes,
+                            std::vector<uint32_t>&& table,
+                            std::vector<uint64_t>&& access_offsets,
+                            std::vector<AccessNode>&& access_nodes );
+
+    uint32_t num_vertices() const { return num_vertices_; }
+
+    uint32_t num_transit_nodes() const { return num_transit_nodes_; }
+
+    bool is_transit_node( CHVertex v ) const { return v >= num_vertices_ - num_transit_nodes_; }
+
+    /// Cost between two transit nodes, given by their index
+    uint32_t table_cost( uint32_t a, uint32_t b ) const { return table_[size_t( a ) * num_transit_nodes_ + b]; }
+
+    /// Access nodes of a vertex, forward ones are reached from v, backward ones reach v
+    AccessNodeRange access_nodes( CHVertex v, CHDirection dir ) const;
+
+    ///
+    /// Cost from s to t on the given CH graph, Infinity if there is no path
+    /// \param[out] local If not null, set to the result of the locality filter
+    uint32_t cost( const CHQuery& graph, CHVertex s, CHVertex t, bool* local = nullptr ) const;
+
+private:
+    uint32_t num_vertices_;
+    uint32_t num_transit_nodes_;
+    std::vector<uint32_t> table_;
+    std::vector<uint64_t> access_offsets_;
+    std::vector<AccessNode> access_nodes_;
+
+    friend class TransitNodeRoutingDataBuilder;
+};
+
+///
+/// Computes the transit-node layer of a CH graph, with its num_transit_nodes highest vertices as transit nodes
+/// (num_vertices at most). The table needs num_transit_nodes^2 * 4 bytes.
+/// Searches from the transit nodes and from each vertex are run in parallel (OpenMP).
+std::unique_ptr<TransitNodeRoutingData> build_transit_nodes( const CHQuery& graph, uint32_t num_transit_nodes );
+
+///
+/// Builder of transit-node data.
+/// These data are produced by the tnr_preprocess tool and can only be loaded from a dump file.
+class TransitNodeRoutingDataBuilder : public RoutingDataBuilder
+{
+public:
+    TransitNodeRoutingDataBuilder() : RoutingDataBuilder( "transit_nodes" ) {}
+
+    virtual std::unique_ptr<RoutingData> pg_import( const std::string& pg_options, ProgressionCallback&, const VariantMap& options = VariantMap() ) const override;
+
+    virtual std::unique_ptr<RoutingData> file_import( const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+    virtual void file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+
+    uint32_t version() const { return 1; }
+};
+
+} // namespace Tempus
+
+#endif
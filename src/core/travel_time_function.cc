@@ -0,0 +1,269 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "travel_time_function.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <boost/assert.hpp>
+
+namespace Tempus
+{
+
+constexpr float TravelTimeFunction::Period;
+
+// tolerance used to compare times (minutes)
+static const float TTF_EPSILON = 1e-3f;
+
+TravelTimeFunction::TravelTimeFunction( float duration )
+{
+    points_.push_back( { 0.0, duration } );
+    update_bounds_();
+}
+
+TravelTimeFunction::TravelTimeFunction( std::vector<Point>&& points ) : points_( points )
+{
+    BOOST_ASSERT( !points_.empty() );
+    simplify_();
+    update_bounds_();
+}
+
+void TravelTimeFunction::update_bounds_()
+{
+    min_ = std::numeric_limits<float>::max();
+    max_ = 0.0;
+    for ( const auto& p : points_ ) {
+        min_ = std::min( min_, p.duration );
+        max_ = std::max( max_, p.duration );
+    }
+}
+
+void TravelTimeFunction::simplify_()
+{
+    std::vector<Point> r;
+    r.reserve( points_.size() );
+    for ( size_t i = 0; i < points_.size(); i++ ) {
+        const Point& p = points_[i];
+        if ( !r.empty() && p.time - r.back().time < TTF_EPSILON ) {
+            // duplicate breakpoint
+            continue;
+        }
+        if ( r.empty() || i + 1 == points_.size() ) {
+            r.push_back( p );
+            continue;
+        }
+        // remove p if it is on the segment between the last kept point and the next one
+        const Point& prev = r.back();
+        const Point& next = points_[i+1];
+        float interp = prev.duration + ( next.duration - prev.duration ) * ( p.time - prev.time ) / ( next.time - prev.time );
+        if ( std::abs( interp - p.duration ) < TTF_EPSILON ) {
+            continue;
+        }
+        r.push_back( p );
+    }
+
+    // constant function ?
+    bool constant = true;
+    for ( const auto& p : r ) {
+        if ( std::abs( p.duration - r[0].duration ) >= TTF_EPSILON ) {
+            constant = false;
+            break;
+        }
+    }
+    if ( constant ) {
+        r.resize( 1 );
+        r[0].time = 0.0;
+    }
+    points_.swap( r );
+}
+
+float TravelTimeFunction::operator()( float t ) const
+{
+    if ( points_.size() == 1 ) {
+        return points_[0].duration;
+    }
+    t = std::fmod( t, Period );
+    if ( t < 0 ) {
+        t += Period;
+    }
+    auto it = std::upper_bound( points_.begin(), points_.end(), t, []( float lt, const Point& p ) { return lt < p.time; } );
+    Point prev, next;
+    if ( it == points_.begin() ) {
+        prev = points_.back();
+        prev.time -= Period;
+        next = points_.front();
+    }
+    else if ( it == points_.end() ) {
+        prev = points_.back();
+        next = points_.front();
+        next.time += Period;
+    }
+    else {
+        next = *it;
+        prev = *(it - 1);
+    }
+    return prev.duration + ( next.duration - prev.duration ) * ( t - prev.time ) / ( next.time - prev.time );
+}
+
+static float normalize_time( float t )
+{
+    t = std::fmod( t, TravelTimeFunction::Period );
+    if ( t < 0 ) {
+        t += TravelTimeFunction::Period;
+    }
+    return t;
+}
+
+static std::vector<float> sorted_unique( std::vector<float>& times )
+{
+    std::sort( times.begin(), times.end() );
+    std::vector<float> r;
+    r.reserve( times.size() );
+    for ( float t : times ) {
+        if ( r.empty() || t - r.back() >= TTF_EPSILON ) {
+            r.push_back( t );
+        }
+    }
+    return r;
+}
+
+TravelTimeFunction TravelTimeFunction::link( const TravelTimeFunction& g ) const
+{
+    if ( is_constant() && g.is_constant() ) {
+        return TravelTimeFunction( points_[0].duration + g.points_[0].duration );
+    }
+
+    // breakpoints of the result are breakpoints of f
+    // and departure times that reach a breakpoint of g
+    std::vector<float> times;
+    for ( const auto& p : points_ ) {
+        times.push_back( p.time );
+    }
+    if ( !g.is_constant() ) {
+        const size_t n = points_.size();
+        for ( size_t i = 0; i < n; i++ ) {
+            float t1 = points_[i].time;
+            float t2 = i + 1 < n ? points_[i+1].time : points_[0].time + Period;
+            float a1 = t1 + points_[i].duration;
+            float a2 = t2 + ( i + 1 < n ? points_[i+1].duration : points_[0].duration );
+            if ( a2 - a1 < TTF_EPSILON ) {
+                continue;
+            }
+            for ( const auto& q : g.points_ ) {
+                // all the occurences of q.time in [a1, a2)
+                float s = q.time + std::ceil( ( a1 - q.time ) / Period ) * Period;
+                for ( ; s < a2; s += Period ) {
+                    times.push_back( normalize_time( t1 + ( s - a1 ) * ( t2 - t1 ) / ( a2 - a1 ) ) );
+                }
+            }
+        }
+    }
+
+    std::vector<Point> r;
+    for ( float t : sorted_unique( times ) ) {
+        float d = (*this)( t );
+        r.push_back( { t, d + g( t + d ) } );
+    }
+    return TravelTimeFunction( std::move( r ) );
+}
+
+TravelTimeFunction TravelTimeFunction::merge( const TravelTimeFunction& g ) const
+{
+    if ( max_ <= g.min_ ) {
+        return *this;
+    }
+    if ( g.max_ <= min_ ) {
+        return g;
+    }
+
+    std::vector<float> times;
+    for ( const auto& p : points_ ) {
+        times.push_back( p.time );
+    }
+    for ( const auto& p : g.points_ ) {
+        times.push_back( p.time );
+    }
+    times = sorted_unique( times );
+
+    // add intersection points
+    std::vector<float> all_times;
+    for ( size_t i = 0; i < times.size(); i++ ) {
+        float t1 = times[i];
+        float t2 = i + 1 < times.size() ? times[i+1] : times[0] + Period;
+        all_times.push_back( t1 );
+        float d1 = (*this)( t1 ) - g( t1 );
+        float d2 = (*this)( t2 ) - g( t2 );
+        if ( ( d1 < 0 && d2 > 0 ) || ( d1 > 0 && d2 < 0 ) ) {
+            all_times.push_back( normalize_time( t1 + ( t2 - t1 ) * d1 / ( d1 - d2 ) ) );
+        }
+    }
+
+    std::vector<Point> r;
+    for ( float t : sorted_unique( all_times ) ) {
+        r.push_back( { t, std::min( (*this)( t ), g( t ) ) } );
+    }
+    return TravelTimeFunction( std::move( r ) );
+}
+
+bool TravelTimeFunction::dominates( const TravelTimeFunction& g ) const
+{
+    if ( max_ <= g.min_ ) {
+        return true;
+    }
+    if ( min_ > g.max_ ) {
+        return false;
+    }
+    for ( const auto& p : points_ ) {
+        if ( p.duration > g( p.time ) + TTF_EPSILON ) {
+            return false;
+        }
+    }
+    for ( const auto& p : g.points_ ) {
+        if ( (*this)( p.time ) > p.duration + TTF_EPSILON ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TravelTimeFunction::serialize( std::ostream& ostr, binary_serialization_t t ) const
+{
+    uint32_t n = points_.size();
+    Tempus::serialize( ostr, n, t );
+    Tempus::serialize( ostr, reinterpret_cast<const char*>( &points_[0] ), n * sizeof( Point ), t );
+}
+
+void TravelTimeFunction::unserialize( std::istream& istr, binary_serialization_t t )
+{
+    uint32_t n = 0;
+    Tempus::unserialize( istr, n, t );
+    points_.resize( n );
+    Tempus::unserialize( istr, reinterpret_cast<char*>( &points_[0] ), n * sizeof( Point ), t );
+    update_bounds_();
+}
+
+std::ostream& operator<<( std::ostream& ostr, const TravelTimeFunction& f )
+{
+    ostr << "[";
+    for ( const auto& p : f.points() ) {
+        ostr << "(" << p.time << "," << p.duration << ")";
+    }
+    ostr << "]";
+    return ostr;
+}
+
+} // namespace Tempus
@@ -0,0 +1,110 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_TRAVEL_TIME_FUNCTION_HH
+#define TEMPUS_TRAVEL_TIME_FUNCTION_HH
+
+#include <vector>
+#include "serializers.hh"
+
+namespace Tempus
+{
+
+///
+/// Periodic piecewise linear travel time function (TTF).
+///
+/// A TTF gives, for a departure time t (in minutes since midnight), the time needed
+/// to traverse an edge (or a path). It is defined by a list of breakpoints sorted by departure time
+/// in [0, period) and linearly interpolated between them. The function wraps around the period,
+/// i.e. the last breakpoint is connected to the first one of the next day.
+///
+/// TTFs are supposed to respect the FIFO property (departing later never makes you arrive earlier),
+/// which is the case of TTFs built out of speed profiles.
+class TravelTimeFunction
+{
+public:
+    /// Length of the period, in minutes
+    static constexpr float Period = 1440.0;
+
+    struct Point
+    {
+        /// departure time (minutes since midnight)
+        float time;
+        /// travel time (minutes)
+        float duration;
+    };
+
+    ///
+    /// Builds a constant function of the given travel time
+    explicit TravelTimeFunction( float duration = 0.0 );
+
+    ///
+    /// Builds a function out of breakpoints.
+    /// Points must be sorted by time and lie in [0, Period)
+    explicit TravelTimeFunction( std::vector<Point>&& points );
+
+    ///
+    /// Travel time when departing at t
+    float operator()( float t ) const;
+
+    ///
+    /// Arrival time when departing at t
+    float arrival( float t ) const { return t + (*this)( t ); }
+
+    ///
+    /// Lower bound of the travel time
+    float min() const { return min_; }
+
+    ///
+    /// Upper bound of the travel time
+    float max() const { return max_; }
+
+    bool is_constant() const { return points_.size() == 1; }
+
+    const std::vector<Point>& points() const { return points_; }
+
+    ///
+    /// Returns the travel time function of the path made of this function followed by g:
+    /// h(t) = f(t) + g(t + f(t))
+    TravelTimeFunction link( const TravelTimeFunction& g ) const;
+
+    ///
+    /// Returns the lower envelope of this function and g:
+    /// h(t) = min( f(t), g(t) )
+    TravelTimeFunction merge( const TravelTimeFunction& g ) const;
+
+    ///
+    /// Returns true if this function is lower or equal than g for every departure time
+    bool dominates( const TravelTimeFunction& g ) const;
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const;
+    void unserialize( std::istream& istr, binary_serialization_t t );
+
+private:
+    void update_bounds_();
+    // remove redundant (colinear or duplicate) breakpoints
+    void simplify_();
+
+    std::vector<Point> points_;
+    float min_;
+    float max_;
+};
+
+std::ostream& operator<<( std::ostream& ostr, const TravelTimeFunction& f );
+
+} // namespace Tempus
+
+#endif
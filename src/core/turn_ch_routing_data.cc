@@ -0,0 +1,123 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "turn_ch_routing_data.hh"
+
+#include <fstream>
+#include <algorithm>
+
+namespace Tempus
+{
+
+constexpr double TurnCHRoutingData::CostPerMinute;
+
+namespace
+{
+
+bool node_less( const TurnCHNodeVertex& a, const TurnCHNodeVertex& b )
+{
+    return a.node < b.node;
+}
+
+TurnCHRoutingData::NodeVertexRange node_vertices( const std::vector<TurnCHNodeVertex>& vertices, db_id_t node )
+{
+    TurnCHNodeVertex n;
+    n.node = node;
+    return std::equal_range( vertices.begin(), vertices.end(), n, node_less );
+}
+
+}
+
+TurnCHRoutingData::TurnCHRoutingData( std::unique_ptr<CHQuery> a_ch_query,
+                                      std::vector<CHEdgeOrigin>&& a_edge_origin,
+                                      std::vector<db_id_t>&& a_vertex_section,
+                                      std::vector<TurnCHNodeVertex>&& a_departures,
+                                      std::vector<TurnCHNodeVertex>&& a_arrivals ) :
+    RoutingData( "turn_ch_graph" ),
+    ch_query_( std::move( a_ch_query ) ),
+    edge_origin_( std::move( a_edge_origin ) ),
+    vertex_section_( std::move( a_vertex_section ) ),
+    departures_( std::move( a_departures ) ),
+    arrivals_( std::move( a_arrivals ) )
+{
+    std::stable_sort( departures_.begin(), departures_.end(), node_less );
+    std::stable_sort( arrivals_.begin(), arrivals_.end(), node_less );
+}
+
+TurnCHRoutingData::NodeVertexRange TurnCHRoutingData::departures( db_id_t node ) const
+{
+    return node_vertices( departures_, node );
+}
+
+TurnCHRoutingData::NodeVertexRange TurnCHRoutingData::arrivals( db_id_t node ) const
+{
+    return node_vertices( arrivals_, node );
+}
+
+std::unique_ptr<RoutingData> TurnCHRoutingDataBuilder::pg_import( const std::string& /*pg_options*/, ProgressionCallback&, const VariantMap& /*options*/ ) const
+{
+    throw std::runtime_error( "Turn-aware CH data can only be loaded from a dump file produced by turn_ch_preprocess" );
+}
+
+std::unique_ptr<RoutingData> TurnCHRoutingDataBuilder::file_import( const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ifstream ifs( filename, std::ios::binary );
+    if ( ifs.fail() ) {
+        throw std::runtime_error( "Problem opening input file " + filename );
+    }
+
+    read_header( ifs );
+
+    std::cout << "read graph" << std::endl;
+    std::unique_ptr<CHQuery> query( new CHQuery() );
+    query->unserialize( ifs, binary_serialization_t() );
+
+    std::cout << "read edge origins" << std::endl;
+    std::vector<CHEdgeOrigin> edge_origin;
+    unserialize( ifs, edge_origin, binary_serialization_t() );
+
+    std::cout << "read vertex sections" << std::endl;
+    std::vector<db_id_t> vertex_section;
+    unserialize( ifs, vertex_section, binary_serialization_t() );
+
+    std::cout << "read node vertices" << std::endl;
+    std::vector<TurnCHNodeVertex> departures, arrivals;
+    unserialize( ifs, departures, binary_serialization_t() );
+    unserialize( ifs, arrivals, binary_serialization_t() );
+
+    std::unique_ptr<RoutingData> rd( new TurnCHRoutingData( std::move( query ), std::move( edge_origin ), std::move( vertex_section ),
+                                                            std::move( departures ), std::move( arrivals ) ) );
+    return rd;
+}
+
+void TurnCHRoutingDataBuilder::file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& /*progression*/, const VariantMap& /*options*/ ) const
+{
+    std::ofstream ofs( filename, std::ios::binary );
+
+    write_header( ofs );
+
+    const TurnCHRoutingData* trd = static_cast<const TurnCHRoutingData*>( rd );
+
+    trd->ch_query_->serialize( ofs, binary_serialization_t() );
+    serialize( ofs, trd->edge_origin_, binary_serialization_t() );
+    serialize( ofs, trd->vertex_section_, binary_serialization_t() );
+    serialize( ofs, trd->departures_, binary_serialization_t() );
+    serialize( ofs, trd->arrivals_, binary_serialization_t() );
+}
+
+REGISTER_BUILDER( TurnCHRoutingDataBuilder )
+
+} // namespace Tempus
@@ -0,0 +1,125 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_TURN_CH_ROUTING_DATA_HH
+#define TEMPUS_TURN_CH_ROUTING_DATA_HH
+
+#include <vector>
+#include <utility>
+
+#include "ch_routing_data.hh"
+
+namespace Tempus
+{
+
+///
+/// A vertex of the edge-based graph seen from a road node: a vertex that leaves the node
+/// (departure) or that reaches it (arrival)
+struct TurnCHNodeVertex
+{
+    /// road node id
+    db_id_t node;
+    /// vertex of the edge-based graph, by CH order
+    uint32_t vertex;
+    /// fixed point cost of a path that starts on this vertex, 0 for an arrival
+    uint32_t cost;
+
+    void serialize( std::ostream& ostr, binary_serialization_t t ) const
+    {
+        Tempus::serialize( ostr, node, t );
+        Tempus::serialize( ostr, vertex, t );
+        Tempus::serialize( ostr, cost, t );
+    }
+    void unserialize( std::istream& istr, binary_serialization_t t )
+    {
+        Tempus::unserialize( istr, node, t );
+        Tempus::unserialize( istr, vertex, t );
+        Tempus::unserialize( istr, cost, t );
+    }
+};
+
+///
+/// Routing data out of a CH of the edge-based (turn-expanded) road graph (see turn_ch_preprocess)
+///
+/// A vertex of the edge-based graph is a road section in a given state of the turn restriction automaton,
+/// an edge is a turn between two road sections. Its cost is the travel time of the second section,
+/// plus the penalty of the restriction that the turn completes, if any. Forbidden turns are not in the graph.
+///
+/// The CH query graph is the one of CHRoutingData, an original edge has the road section of its target vertex
+/// as origin. Costs are travel times in 1/100 s.
+class TurnCHRoutingData : public RoutingData
+{
+public:
+    typedef std::pair<std::vector<TurnCHNodeVertex>::const_iterator, std::vector<TurnCHNodeVertex>::const_iterator> NodeVertexRange;
+
+    /// Number of fixed point cost units per minute
+    static constexpr double CostPerMinute = 6000.0;
+
+    TurnCHRoutingData( std::unique_ptr<CHQuery> ch_query,
+                       std::vector<CHEdgeOrigin>&& edge_origin,
+                       std::vector<db_id_t>&& vertex_section,
+                       std::vector<TurnCHNodeVertex>&& departures,
+                       std::vector<TurnCHNodeVertex>&& arrivals );
+
+    const CHQuery& ch_query() const { return *ch_query_; }
+
+    const CHEdgeOrigin& edge_origin( CHQuery::EdgeIndex e ) const { return edge_origin_[e]; }
+
+    /// Road section id of a vertex of the edge-based graph
+    db_id_t vertex_section( CHVertex v ) const { return vertex_section_[v]; }
+
+    /// Vertices a path leaving the given road node starts from
+    NodeVertexRange departures( db_id_t node ) const;
+
+    /// Vertices a path reaching the given road node ends on
+    NodeVertexRange arrivals( db_id_t node ) const;
+
+private:
+    // the CH graph
+    std::unique_ptr<CHQuery> ch_query_;
+
+    // edge index -> road section or child edges
+    std::vector<CHEdgeOrigin> edge_origin_;
+
+    // vertex -> road section id
+    std::vector<db_id_t> vertex_section_;
+
+    // sorted by node id
+    std::vector<TurnCHNodeVertex> departures_;
+    std::vector<TurnCHNodeVertex> arrivals_;
+
+    friend class TurnCHRoutingDataBuilder;
+};
+
+///
+/// Builder of turn-aware CH data.
+/// These data are produced by the turn_ch_preprocess tool and can only be loaded from a dump file.
+class TurnCHRoutingDataBuilder : public RoutingDataBuilder
+{
+public:
+    TurnCHRoutingDataBuilder() : RoutingDataBuilder( "turn_ch_graph" ) {}
+
+    virtual std::unique_ptr<RoutingData> pg_import( const std::string& pg_options, ProgressionCallback&, const VariantMap& options = VariantMap() ) const override;
+
+    virtual std::unique_ptr<RoutingData> file_import( const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+    virtual void file_export( const RoutingData* rd, const std::string& filename, ProgressionCallback& progression, const VariantMap& options = VariantMap() ) const override;
+
+    uint32_t version() const { return 1; }
+};
+
+} // namespace Tempus
+
+#endif
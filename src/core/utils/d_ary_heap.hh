@@ -0,0 +1,182 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPUS_UTILS_D_ARY_HEAP_HH
+#define TEMPUS_UTILS_D_ARY_HEAP_HH
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <boost/assert.hpp>
+
+namespace Tempus
+{
+
+///
+/// Addressable d-ary min heap on integer ids in [0, n), with a decrease-key operation.
+///
+/// The position of each id in the heap is stored in a dense array, so that each id is
+/// stored at most once, contrary to the "lazy deletion" of std::priority_queue.
+/// The heap can be reused for several searches: clear() is in O(size()), not O(n).
+template <typename Id, typename Key, unsigned Arity = 4>
+class DAryHeap
+{
+public:
+    static_assert( Arity >= 2, "Arity must be at least 2" );
+
+    DAryHeap() {}
+    explicit DAryHeap( size_t n ) : position_( n, NotInHeap ) {}
+
+    ///
+    /// Resize the id space. The heap is emptied
+    void resize( size_t n )
+    {
+        clear();
+        position_.resize( n, NotInHeap );
+    }
+
+    size_t capacity() const { return position_.size(); }
+
+    bool empty() const { return heap_.empty(); }
+    size_t size() const { return heap_.size(); }
+
+    bool contains( Id id ) const { return position_[id] != NotInHeap; }
+
+    Id top() const { return heap_.front().id; }
+    Key top_key() const { return heap_.front().key; }
+
+    Key key( Id id ) const
+    {
+        BOOST_ASSERT( contains( id ) );
+        return heap_[position_[id]].key;
+    }
+
+    void push( Id id, Key key )
+    {
+        BOOST_ASSERT( !contains( id ) );
+        position_[id] = heap_.size();
+        heap_.push_back( Element{ id, key } );
+        sift_up_( heap_.size() - 1 );
+    }
+
+    ///
+    /// Decrease the key of an id already in the heap
+    void decrease( Id id, Key key )
+    {
+        BOOST_ASSERT( contains( id ) );
+        BOOST_ASSERT( !( heap_[position_[id]].key < key ) );
+        heap_[position_[id]].key = key;
+        sift_up_( position_[id] );
+    }
+
+    ///
+    /// Push an id or decrease its key if it is already in the heap
+    void push_or_decrease( Id id, Key key )
+    {
+        if ( contains( id ) ) {
+            decrease( id, key );
+        }
+        else {
+            push( id, key );
+        }
+    }
+
+    void pop()
+    {
+        BOOST_ASSERT( !empty() );
+        position_[heap_.front().id] = NotInHeap;
+        if ( heap_.size() > 1 ) {
+            heap_.front() = heap_.back();
+            position_[heap_.front().id] = 0;
+            heap_.pop_back();
+            sift_down_( 0 );
+        }
+        else {
+            heap_.pop_back();
+        }
+    }
+
+    void clear()
+    {
+        for ( const Element& e : heap_ ) {
+            position_[e.id] = NotInHeap;
+        }
+        heap_.clear();
+    }
+
+private:
+    static const size_t NotInHeap = std::numeric_limits<size_t>::max();
+
+    struct Element
+    {
+        Id id;
+        Key key;
+    };
+
+    void sift_up_( size_t i )
+    {
+        Element e = heap_[i];
+        while ( i > 0 ) {
+            size_t parent = ( i - 1 ) / Arity;
+            if ( !( e.key < heap_[parent].key ) ) {
+                break;
+            }
+            heap_[i] = heap_[parent];
+            position_[heap_[i].id] = i;
+            i = parent;
+        }
+        heap_[i] = e;
+        position_[e.id] = i;
+    }
+
+    void sift_down_( size_t i )
+    {
+        Element e = heap_[i];
+        const size_t n = heap_.size();
+        for ( ;; ) {
+            size_t first_child = i * Arity + 1;
+            if ( first_child >= n ) {
+                break;
+            }
+            size_t last_child = std::min( first_child + Arity, n );
+            size_t min_child = first_child;
+            for ( size_t c = first_child + 1; c < last_child; c++ ) {
+                if ( heap_[c].key < heap_[min_child].key ) {
+                    min_child = c;
+                }
+            }
+            if ( !( heap_[min_child].key < e.key ) ) {
+                break;
+            }
+            heap_[i] = heap_[min_child];
+            position_[heap_[i].id] = i;
+            i = min_child;
+        }
+        heap_[i] = e;
+        position_[e.id] = i;
+    }
+
+    std::vector<Element> heap_;
+    // id -> position in heap_
+    std::vector<size_t> position_;
+};
+
+template <typename Id, typename Key, unsigned Arity>
+const size_t DAryHeap<Id, Key, Arity>::NotInHeap;
+
+} // namespace Tempus
+
+#endif
@@ -20,14 +20,15 @@
 
 #include "graph_db_link.hh"
 #include "../multimodal_graph.hh"
+#include "../instrumentation.hh"
 
 using namespace std;
 
 namespace Tempus {
 Point2D coordinates( const Road::Vertex& v, Db::Connection& db, const Road::Graph& graph )
 {
-    string q = ( boost::format( "SELECT st_x(geom), st_y(geom) FROM tempus.road_node WHERE id=%1%" ) % graph[v].db_id() ).str();
-    Db::Result res = db.exec( q );
+    Db::Result res = db.exec_prepared( "road_node_coordinates", "SELECT st_x(geom), st_y(geom) FROM tempus.road_node WHERE id=$1",
+                                       std::vector<std::string>( 1, to_string( graph[v].db_id() ) ) );
     BOOST_ASSERT( res.size() > 0 );
     Point2D p;
     p.set_x( res[0][0].as<float>() );
@@ -37,8 +38,8 @@ Point2D coordinates( const Road::Vertex& v, Db::Connection& db, const Road::Grap
 
 Point2D coordinates( const PublicTransport::Vertex& v, Db::Connection& db, const PublicTransport::Graph& graph )
 {
-    string q = ( boost::format( "SELECT st_x(geom), st_y(geom) FROM tempus.pt_stop WHERE id=%1%" ) % graph[v].db_id() ).str();
-    Db::Result res = db.exec( q );
+    Db::Result res = db.exec_prepared( "pt_stop_coordinates", "SELECT st_x(geom), st_y(geom) FROM tempus.pt_stop WHERE id=$1",
+                                       std::vector<std::string>( 1, to_string( graph[v].db_id() ) ) );
     BOOST_ASSERT( res.size() > 0 );
     Point2D p;
     p.set_x( res[0][0].as<float>() );
@@ -48,8 +49,8 @@ Point2D coordinates( const PublicTransport::Vertex& v, Db::Connection& db, const
 
 Point2D coordinates( const POI* poi, Db::Connection& db )
 {
-    string q = ( boost::format( "SELECT st_x(geom), st_y(geom) FROM tempus.poi WHERE id=%1%" ) % poi->db_id() ).str();
-    Db::Result res = db.exec( q );
+    Db::Result res = db.exec_prepared( "poi_coordinates", "SELECT st_x(geom), st_y(geom) FROM tempus.poi WHERE id=$1",
+                                       std::vector<std::string>( 1, to_string( poi->db_id() ) ) );
     BOOST_ASSERT( res.size() > 0 );
     Point2D p;
     p.set_x( res[0][0].as<float>() );
@@ -136,6 +137,7 @@ void get_edge_info_from_db( const MMEdge& e, Db::Connection& db, std::string& wk
 
 void fill_roadmap_from_db( Roadmap::StepIterator itbegin, Roadmap::StepIterator itend, Db::Connection& db  )
 {
+    Instrumentation::ScopedPhase roadmap_phase( Instrumentation::RoadmapPhase );
     // road node id -> road step*
     std::map<db_id_t, Roadmap::RoadStep*> road_steps;
     // pt stop id -> pt step*
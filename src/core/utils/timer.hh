@@ -33,25 +33,26 @@ public:
 
     void restart()
     {
-        t_start = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
+        t_start = std::chrono::steady_clock::now();
     }
 
     ///
     /// Get elapsed number of seconds since construction
     double elapsed()
     {
-        return elapsed_ms() / 1000;
+        return elapsed_ms() / 1000.0;
     }
 
     ///
     /// Get elapsed number of milliseconds since construction
     double elapsed_ms()
     {
-        auto t_stop = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
-        return double((t_stop - t_start).count());
+        // microsecond resolution, short queries would otherwise be reported as 0ms
+        auto t_stop = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(t_stop - t_start).count() / 1000.0;
     }
 private:
-    std::chrono::milliseconds t_start;
+    std::chrono::steady_clock::time_point t_start;
 };
 
 #endif
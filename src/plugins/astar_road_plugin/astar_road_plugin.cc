@@ -91,7 +91,7 @@ public:
 
     AStarRoadPlugin( ProgressionCallback& progression, const VariantMap& options ) : Plugin( "astar_road_plugin", options ) {
         // load graph
-        const RoutingData* rd = load_routing_data( "multimodal_graph", progression, options );
+        const RoutingData* rd = use_routing_data( "multimodal_graph", progression, options );
         graph_ = dynamic_cast<const Multimodal::Graph*>( rd );
         if ( graph_ == nullptr ) {
             throw std::runtime_error( "Problem loading the multimodal graph" );
@@ -113,8 +113,9 @@ struct astar_goal_found {};
 class GoalVisitor : public boost::default_astar_visitor
 {
 public:
-    GoalVisitor( Road::Vertex goal, size_t& iterations ) : goal_( goal ), iterations_( iterations ) {}
+    GoalVisitor( Road::Vertex goal, size_t& iterations, Deadline& deadline ) : goal_( goal ), iterations_( iterations ), deadline_( deadline ) {}
     void examine_vertex( Road::Vertex u, const Road::Graph& ) {
+        deadline_.check();
         if( u == goal_ )
             throw astar_goal_found();
         iterations_++;
@@ -122,6 +123,7 @@ public:
 private:
     Road::Vertex goal_;
     size_t& iterations_;
+    Deadline& deadline_;
 };
 
 struct EuclidianHeuristic
@@ -197,7 +199,7 @@ public:
         std::cout << "origin " << origin << " destination " << destination << std::endl;
 
         size_t iterations = 0;
-        GoalVisitor vis( destination, iterations );
+        GoalVisitor vis( destination, iterations, deadline() );
 
         EuclidianHeuristic h( road_graph, destination, max_speed );
 
@@ -300,7 +302,8 @@ public:
         }
 
         if ( prepare_result ) {
-            Db::Connection connection( plugin_->db_options() );
+            Db::PooledConnection pooled_connection( plugin_->db_options() );
+            Db::Connection& connection = *pooled_connection;
             simple_multimodal_roadmap( *result, connection, graph_ );
         }
 
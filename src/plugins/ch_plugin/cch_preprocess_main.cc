@@ -0,0 +1,207 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *   Copyright (C) 2015 Mappy <dt.lbs.route@mappy.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "cch_routing_data.hh"
+#include "routing_data.hh"
+#include "multimodal_graph.hh"
+#include "utils/timer.hh"
+
+#include <string>
+#include <algorithm>
+#include <boost/program_options.hpp>
+
+using namespace Tempus;
+
+namespace
+{
+
+// Speed used when no speed limit is available (km/h)
+const float DEFAULT_CAR_SPEED = 50.0;
+// Average cycling speed (km/h)
+const float CYCLING_SPEED = 12.0;
+
+///
+/// Description of a metric that can be used for the customization
+struct Metric
+{
+    std::string name;
+    /// sections that can be used
+    TransportModeTrafficRule traffic_rule;
+    CostId cost_id;
+};
+
+const Metric METRICS[] = {
+    { "distance", TrafficRulePedestrian, CostId::CostDistance },
+    { "bike_time", TrafficRuleBicycle, CostId::CostDuration },
+    { "car_time", TrafficRuleCar, CostId::CostDuration }
+};
+
+///
+/// Arcs of the road graph with their fixed point cost (1/100 m or 1/100 min)
+std::vector<CCHArc> metric_arcs( const Road::Graph& road_graph, const Metric& metric )
+{
+    std::vector<CCHArc> arcs;
+    for ( Road::Edge e : pair_range( edges( road_graph ) ) ) {
+        const Road::Section& section = road_graph[e];
+        if ( (section.traffic_rules() & metric.traffic_rule) == 0 ) {
+            continue;
+        }
+        double cost = section.length();
+        if ( metric.traffic_rule == TrafficRuleBicycle ) {
+            cost = section.length() / ( CYCLING_SPEED * 1000.0 / 60.0 );
+        }
+        else if ( metric.traffic_rule == TrafficRuleCar ) {
+            float speed_limit = section.car_speed_limit() > 0 ? section.car_speed_limit() : DEFAULT_CAR_SPEED;
+            cost = section.length() / ( speed_limit * 1000.0 / 60.0 );
+        }
+        arcs.push_back( { uint32_t( source( e, road_graph ) ), uint32_t( target( e, road_graph ) ),
+                    uint32_t( std::max( int( cost * 100.0 ), 1 ) ), section.db_id() } );
+    }
+    return arcs;
+}
+
+}
+
+int main( int argc, char *argv[] )
+{
+    using namespace std;
+
+    std::string db_options = "dbname=tempus_test_db";
+    std::string in_schema = "tempus";
+    std::string in_file;
+    std::string topology_file = "cch_topology.dump";
+    std::string out_file = "ch_graph.dump";
+    std::string metric = "distance";
+
+    namespace po = boost::program_options;
+    po::options_description desc( "Allowed options" );
+    desc.add_options()
+        ( "help", "produce help message" )
+        ( "db,d", po::value<string>(&db_options), "set database connection options" )
+        ( "in_schema,s", po::value<string>(&in_schema), "set database schema for the input graph" )
+        ( "in_file,L", po::value<string>(&in_file), "set the name of the dump file where the input graph is located" )
+        ( "topology,t", po::value<string>(&topology_file), "set the name of the dump file of the metric-independent topology" )
+        ( "out_file,o", po::value<string>(&out_file), "set the name of the output CH dump file" )
+        ( "metric,m", po::value<string>(&metric), "metric used for the customization: distance (pedestrians), bike_time or car_time" )
+        ( "multi-profile", "customize for every metric and write multi-profile CH data sharing the topology" )
+        ( "topology-only", "only compute the topology" )
+        ( "customize-only", "load the topology from its dump file and only compute the customization" )
+        ;
+
+    po::variables_map vm;
+    po::store( po::parse_command_line( argc, argv, desc ), vm );
+    po::notify( vm );
+
+    if ( vm.count( "help" ) ) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+    const Metric* single_metric = std::find_if( std::begin( METRICS ), std::end( METRICS ), [&metric]( const Metric& m ) { return m.name == metric; } );
+    if ( single_metric == std::end( METRICS ) ) {
+        std::cerr << "Unknown metric " << metric << std::endl;
+        return 1;
+    }
+
+    TextProgression progression;
+    VariantMap options;
+    options["db/options"] = Variant::from_string( db_options );
+    options["db/schema"] = Variant::from_string( in_schema );
+    if ( !in_file.empty() ) {
+        options["from_file"] = Variant::from_string( in_file );
+    }
+    const RoutingData* data = load_routing_data( "multimodal_graph", progression, options );
+
+    const Multimodal::Graph& graph = *dynamic_cast<const Multimodal::Graph*>(data);
+
+    const Road::Graph& road_graph = graph.road();
+
+    //
+    // Topology, independent of the metric
+    std::unique_ptr<CCHTopology> computed_topology;
+    const CCHTopology* topology = nullptr;
+    if ( vm.count( "customize-only" ) ) {
+        VariantMap topology_options;
+        topology_options["from_file"] = Variant::from_string( topology_file );
+        topology = dynamic_cast<const CCHTopology*>( load_routing_data( "cch_topology", progression, topology_options ) );
+    }
+    else {
+        std::cout << "* Computing the topology" << std::endl;
+        Timer t;
+        std::vector<Point2D> coordinates;
+        std::vector<db_id_t> node_id;
+        for ( Road::Vertex v : pair_range( vertices( road_graph ) ) ) {
+            coordinates.push_back( Point2D( road_graph[v].coordinates().x(), road_graph[v].coordinates().y() ) );
+            node_id.push_back( road_graph[v].db_id() );
+        }
+        // every section, so that any metric can be applied
+        std::vector<std::pair<uint32_t, uint32_t>> topology_edges;
+        for ( Road::Edge e : pair_range( edges( road_graph ) ) ) {
+            topology_edges.push_back( std::make_pair( uint32_t( source( e, road_graph ) ), uint32_t( target( e, road_graph ) ) ) );
+        }
+        computed_topology.reset( new CCHTopology( coordinates, topology_edges, node_id ) );
+        topology = computed_topology.get();
+        std::cout << "Topology computed in " << t.elapsed_ms() << "ms: " << topology->num_edges() << " edges, "
+                  << topology->num_levels() << " levels" << std::endl;
+
+        std::cout << "* Writing " << topology_file << std::endl;
+        dump_routing_data( topology, topology_file, progression );
+    }
+
+    if ( vm.count( "topology-only" ) ) {
+        return 0;
+    }
+
+    //
+    // Customization
+    if ( vm.count( "multi-profile" ) ) {
+        std::vector<std::unique_ptr<CCHMetric>> metrics;
+        std::vector<const CCHMetric*> metric_ptrs;
+        std::vector<CHProfile> profiles;
+        for ( const Metric& m : METRICS ) {
+            std::cout << "* Customizing for metric " << m.name << std::endl;
+            Timer t;
+            metrics.emplace_back( new CCHMetric( *topology, metric_arcs( road_graph, m ) ) );
+            metric_ptrs.push_back( metrics.back().get() );
+            std::cout << "Customized in " << t.elapsed_ms() << "ms" << std::endl;
+
+            CHProfile profile;
+            profile.name = m.name;
+            profile.traffic_rules = m.traffic_rule;
+            profile.cost_id = m.cost_id;
+            profiles.push_back( profile );
+        }
+
+        std::cout << "* Writing " << out_file << std::endl;
+        std::unique_ptr<MultiProfileCHRoutingData> rd = multi_profile_routing_data( *topology, std::move( profiles ), metric_ptrs );
+        rd->set_transport_modes( graph.transport_modes() );
+        dump_routing_data( rd.get(), out_file, progression );
+    }
+    else {
+        std::cout << "* Customizing for metric " << metric << std::endl;
+        Timer t;
+        CCHMetric cch_metric( *topology, metric_arcs( road_graph, *single_metric ) );
+        std::cout << "Customized in " << t.elapsed_ms() << "ms" << std::endl;
+
+        std::cout << "* Writing " << out_file << std::endl;
+        std::unique_ptr<CHRoutingData> rd = cch_metric.routing_data();
+        dump_routing_data( rd.get(), out_file, progression );
+    }
+
+    return 0;
+}
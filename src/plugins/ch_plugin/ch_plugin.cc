@@ -20,23 +20,22 @@
 #include "ch_plugin.hh"
 #include "plugin_factory.hh"
 
-//#include <boost/heap/d_ary_heap.hpp>
 #ifdef _WIN32
 #pragma warning(push, 0)
 #endif
-#include <queue>
-#include <boost/pending/indirect_cmp.hpp>
-#include <boost/graph/visitors.hpp>
-#include <boost/graph/dijkstra_shortest_paths_no_color_map.hpp>
 #include <boost/property_map/function_property_map.hpp>
 #include <boost/format.hpp>
 #ifdef _WIN32
 #pragma warning(pop)
 #endif
 
-#include "utils/associative_property_map_default_value.hh"
+#include "config.hh"
+#include "ch_query_workspace.hh"
+#include "ch_bidirectional_search.hh"
 #include "utils/timer.hh"
 
+#include <sstream>
+
 #include "utils/graph_db_link.hh"
 
 namespace Tempus {
@@ -44,6 +43,12 @@ namespace Tempus {
 const Plugin::OptionDescriptionList CHPlugin::option_descriptions()
 {
     Plugin::OptionDescriptionList odl;
+    odl.declare_option( "ch/multi_profile", "Load multi-profile CH data (one graph, weights per profile)", Variant::from_bool( false ) );
+    odl.declare_option( "ch/hub_labels", "Load hub labels along with the CH data, for fast cost queries", Variant::from_bool( false ) );
+    odl.declare_option( "ch/transit_nodes_file", "Dump file of the transit-node layer of the CH data (see tnr_preprocess), if any", Variant::from_string( "" ) );
+    odl.declare_option( "ch/closures", "Allow requests to close road sections (see ch/closed_sections)", Variant::from_bool( false ) );
+    odl.declare_option( "ch/closed_sections", "Comma separated ids of the road sections closed for this request", Variant::from_string( "" ) );
+    odl.declare_option( "ch/cost_only", "Only compute the cost of the path (metric 'cost'), by hub labels or transit nodes if they are loaded", Variant::from_bool( false ) );
     return odl;
 }
 
@@ -51,211 +56,146 @@ const Plugin::Capabilities CHPlugin::plugin_capabilities()
 {
     Plugin::Capabilities caps;
     caps.optimization_criteria().push_back( CostId::CostDuration );
+    caps.optimization_criteria().push_back( CostId::CostDistance );
     return caps;
 }
 
-CHPlugin::CHPlugin( ProgressionCallback& progression, const VariantMap& options ) : Plugin( "ch_plugin", options )
+CHPlugin::CHPlugin( ProgressionCallback& progression, const VariantMap& options ) : Plugin( "ch_plugin", options ),
+    rd_( nullptr ),
+    hrd_( nullptr ),
+    trd_( nullptr ),
+    mrd_( nullptr )
 {
     // load graph
-    const RoutingData* rd = load_routing_data( "ch_graph", progression, options );
-    rd_ = dynamic_cast<const CHRoutingData*>( rd );
-    if ( rd_ == nullptr ) {
+    if ( get_option_or_default( options, "ch/multi_profile" ).as<bool>() ) {
+        const RoutingData* rd = use_routing_data( "multi_profile_ch_graph", progression, options );
+        mrd_ = dynamic_cast<const MultiProfileCHRoutingData*>( rd );
+    }
+    else if ( get_option_or_default( options, "ch/hub_labels" ).as<bool>() ) {
+        const RoutingData* rd = use_routing_data( "hub_labels", progression, options );
+        hrd_ = dynamic_cast<const HubLabelRoutingData*>( rd );
+        if ( hrd_ ) {
+            rd_ = &hrd_->ch_data();
+        }
+    }
+    else {
+        const RoutingData* rd = use_routing_data( "ch_graph", progression, options );
+        rd_ = dynamic_cast<const CHRoutingData*>( rd );
+    }
+    if ( rd_ == nullptr && mrd_ == nullptr ) {
         throw std::runtime_error( "Problem loading the CH routing data" );
     }
+
+    // transit-node layer, dumped alongside the CH data
+    const std::string transit_nodes_file = get_option_or_default( options, "ch/transit_nodes_file" ).str();
+    if ( rd_ && !transit_nodes_file.empty() ) {
+        VariantMap tnr_options;
+        tnr_options["from_file"] = Variant::from_string( transit_nodes_file );
+        trd_ = dynamic_cast<const TransitNodeRoutingData*>( use_routing_data( "transit_nodes", progression, tnr_options ) );
+        if ( trd_ == nullptr || trd_->num_vertices() != num_vertices( rd_->ch_query() ) ) {
+            throw std::runtime_error( "Problem loading the transit nodes, or they do not match the CH routing data" );
+        }
+    }
+
+    if ( rd_ && get_option_or_default( options, "ch/closures" ).as<bool>() ) {
+        Timer timer;
+        closure_index_.reset( new CHClosureIndex( *rd_ ) );
+        std::cout << "Closure index built in " << timer.elapsed() << "s" << std::endl;
+    }
 }
 
 
 
+///
+/// Unpack an edge into the original edges it replaces, by following the child edges of shortcuts
 template <typename OutIterator>
-void unpack_edge( CHVertex v1, CHVertex v2, const MiddleNodeMap& middle_node, OutIterator out_it )
+void unpack_edge( const CHRoutingData& rd, CHQuery::EdgeIndex e, OutIterator out_it )
 {
-    auto it = middle_node.find( std::make_pair(v1,v2) );
-    if ( it != middle_node.end() ) {
-        unpack_edge( v1, it->second, middle_node, out_it );
-        unpack_edge( it->second, v2, middle_node, out_it );
+    if ( rd.ch_query().edge_property( e ).b.is_shortcut ) {
+        const CHEdgeOrigin& o = rd.edge_origin( e );
+        unpack_edge( rd, o.child[0], out_it );
+        unpack_edge( rd, o.child[1], out_it );
     }
     else {
-        *out_it = v1;
+        *out_it = e;
         out_it++;
     }
 }
 
-template <typename InIterator, typename OutIterator>
-void unpack_path( InIterator it_begin, InIterator it_end, const MiddleNodeMap& middle_node, OutIterator out_it )
-{
-    if ( it_begin == it_end )
-        return;
-    auto it = it_begin;
-    auto it2 = it_begin;
-    it2++;
-    for ( ; it2 != it_end; it++, it2++ ) {
-        unpack_edge( *it, *it2, middle_node, out_it );
-    }
-    *out_it = *it;
-    out_it++;
-}
-
 
-template <typename CostType, typename WeightMap>
-std::list<CHVertex> bidirectional_ch_dijkstra( const CHRoutingData& rd, CHVertex origin, CHVertex destination, WeightMap weight_map, CostType& ret_cost )
+///
+/// Returns the unpacked path as a list of indices of original edges and its cost, max() if there is no path
+std::pair<std::list<CHQuery::EdgeIndex>, float> ch_query( const CHRoutingData& rd, CHVertex ch_origin, CHVertex ch_destination, CHQueryStatistics& stats )
 {
-    const CHQuery& graph = rd.ch_query();
-
-    std::map<CHVertex, CostType> costs;
-    std::list<CHVertex> returned_path;
-
-    const CostType infinity = std::numeric_limits<CostType>::max();
-
-    typedef std::vector<CostType> PotentialMap;
-    size_t n = num_vertices( graph );
-    PotentialMap potential[2] = { PotentialMap( n, infinity ),
-                                  PotentialMap( n, infinity ) };
-    typedef CostType* PotentialPMap;
-    PotentialPMap potential_map[2] = { &potential[0][0], &potential[1][0] };
-
-    typedef boost::indirect_cmp<PotentialPMap, std::greater<CostType>> Cmp;
+    std::pair<std::list<CHQuery::EdgeIndex>, float> ret;
 
-    // FIXME is the heap needed ? since the graph is partitioned in two acyclic graphs with a topological order on nodes
-    // There may be a way to be faster: loop over each node in order and relax out edges
-    //typedef boost::heap::d_ary_heap< CHVertex, boost::heap::arity<4>, boost::heap::compare< Cmp >, boost::heap::mutable_<true> > VertexQueue;
-    typedef std::priority_queue<CHVertex, std::vector<CHVertex>, Cmp> VertexQueue;
-    Cmp cmp_fw( potential_map[0] );
-    Cmp cmp_bw( potential_map[1] );
-    VertexQueue vertex_queue[2] = { VertexQueue( cmp_fw ), VertexQueue( cmp_bw ) };
-
-    std::map<CHVertex, CHVertex> predecessor[2];
-
-    vertex_queue[0].push( origin );
-    put( potential_map[0], origin, 0.0 );
-    vertex_queue[1].push( destination );
-    put( potential_map[1], destination, 0.0 );
-
-    // direction : 0 = forward, 1 = backward
-    int dir = 1;
-
-    CHVertex top_node = 0;
-    CostType total_cost = infinity;
-    bool path_found = false;
-
-    auto get_min_pi = [&vertex_queue,&potential_map]( int ldir ) {
-        if ( !vertex_queue[ldir].empty() ) {
-            return get( potential_map[ldir], vertex_queue[ldir].top() );
-        }
-        return std::numeric_limits<CostType>::max();
+    auto weight_map_fn = []( const CHQuery::edge_descriptor& e ) {
+        return float(e.property().b.cost / 100.0);
     };
+    auto weight_map = boost::make_function_property_map<CHQuery::edge_descriptor, float, decltype(weight_map_fn)>( weight_map_fn );
+    float ret_cost = std::numeric_limits<float>::max();
+    auto path = bidirectional_ch_dijkstra( rd.ch_query(), ch_origin, ch_destination, weight_map, ret_cost, ch_query_workspace<CHVertex, float>(), stats );
 
-    while ( !vertex_queue[0].empty() || !vertex_queue[1].empty() ) {
-
-        if ( std::min( get_min_pi(dir), get_min_pi(1-dir) ) > total_cost ) {
-            // we've reached the best path
-            break;
-        }
-
-        // interleave directions
-        dir = 1 - dir;
-
-        if ( vertex_queue[dir].empty() )
-            dir = 1 - dir;
-
-        CHVertex min_v = vertex_queue[dir].top();
-        vertex_queue[dir].pop();
-        CostType min_pi = get( potential_map[dir], min_v );
-
-        {
-            CostType min_pi2 = get( potential_map[1-dir], min_v );
-            // if min_pi2 is not infinity, it means this node has already been seen
-            // in the other direction
-            // so it is a candidate top node
-            if ( min_pi + min_pi2 < total_cost ) {
-                top_node = min_v;
-                total_cost = min_pi + min_pi2;
-                path_found = true;
-            }
-        }
-
-        if ( dir == 0 ) {
-            for ( auto oei = out_edges( min_v, graph ).first;
-                  oei != out_edges( min_v, graph ).second;
-                  oei++ ) {
-                CHVertex vv = target( *oei, graph );
-
-                CostType new_pi = get( potential_map[dir], vv );
-                CostType cost = get( weight_map, *oei );
-                if ( min_pi + cost < new_pi ) {
-                    // relax edge
-                    put( potential_map[dir], vv, min_pi + cost );
-                    vertex_queue[dir].push( vv );
-                    predecessor[dir][vv] = min_v;
-                }
-            }
-        }
-        else {
-            for ( auto iei = in_edges( min_v, graph ).first;
-                  iei != in_edges( min_v, graph ).second;
-                  iei++ ) {
-                CHVertex vv = source( *iei, graph );
-
-                CostType new_pi = get( potential_map[dir], vv );
-                CostType cost = get( weight_map, *iei );
-                if ( min_pi + cost < new_pi ) {
-                    // relax edge
-                    put( potential_map[dir], vv, min_pi + cost );
-                    vertex_queue[dir].push( vv );
-                    predecessor[dir][vv] = min_v;
-                }
-            }
-        }
+    for ( const CHEdge& e : path ) {
+        unpack_edge( rd, e.index(), std::back_inserter( ret.first ) );
     }
+    ret.second = ret_cost;
 
-    if ( !path_found ) {
-        //std::cout << "NO PATH FOUND" << std::endl;
-        return returned_path;
-    }
-    //std::cout << "PATH FOUND" << std::endl;
+    return ret;
+}
 
-    // path from origin (s) to top node (x)
-    // s = p[p[p[p[p[...[x]]]]]] , ..., p[x], x
-    //std::cout << "top node " << node_id[top_node] << std::endl;
+///
+/// Returns the cost of the shortest path without unpacking it, max() if there is no path
+float ch_cost( const CHRoutingData& rd, CHVertex ch_origin, CHVertex ch_destination, CHQueryStatistics& stats )
+{
+    auto weight_map_fn = []( const CHQuery::edge_descriptor& e ) {
+        return float(e.property().b.cost / 100.0);
+    };
+    auto weight_map = boost::make_function_property_map<CHQuery::edge_descriptor, float, decltype(weight_map_fn)>( weight_map_fn );
+    float ret_cost = std::numeric_limits<float>::max();
+    bidirectional_ch_dijkstra( rd.ch_query(), ch_origin, ch_destination, weight_map, ret_cost, ch_query_workspace<CHVertex, float>(), stats );
+    return ret_cost;
+}
 
-    std::list<CHVertex> path;
-    CHVertex x = top_node;
-    while (x != origin)
-    {
-        returned_path.push_front( x );
-        auto it = predecessor[0].find( x );
-        BOOST_ASSERT_MSG( it != predecessor[0].end(), "Can't find upward predecessor" );
-        x = it->second;
+template <typename OutIterator>
+void unpack_profile_edge( const MultiProfileCHQuery& graph, const CHProfile& profile, const MultiProfileCHEdge& e, OutIterator out_it )
+{
+    CHVertex middle = profile.middle[e.property().index];
+    if ( middle != CHProfile::NoMiddle ) {
+        // the middle vertex depends on the profile, the child edges are then looked up
+        MultiProfileCHEdge e1, e2;
+        bool found1 = false, found2 = false;
+        boost::tie( e1, found1 ) = edge( e.source(), middle, graph );
+        boost::tie( e2, found2 ) = edge( middle, e.target(), graph );
+        BOOST_ASSERT( found1 && found2 );
+        unpack_profile_edge( graph, profile, e1, out_it );
+        unpack_profile_edge( graph, profile, e2, out_it );
     }
-    returned_path.push_front( origin );
-
-    // path from destination (t) to top node (x)
-    // t = p[p[p[p[p[...[x]]]]]] , ..., p[x], x
-    CHVertex t = top_node;
-    while ( t != destination )
-    {
-        auto it = predecessor[1].find( t );
-        BOOST_ASSERT_MSG( it != predecessor[0].end(), "Can't find downward predecessor" );
-        t = it->second;
-        returned_path.push_back( t );
+    else {
+        *out_it = e;
+        out_it++;
     }
-
-    ret_cost = total_cost;
-    return returned_path;
 }
 
-std::pair<std::list<CHVertex>, float> ch_query( const CHRoutingData& rd, CHVertex ch_origin, CHVertex ch_destination )
+///
+/// Query on multi-profile CH data, with the weights of the given profile
+/// Returns the unpacked path as a list of original edges and its cost
+std::pair<std::list<MultiProfileCHEdge>, float> multi_profile_ch_query( const MultiProfileCHRoutingData& rd, const CHProfile& profile, CHVertex ch_origin, CHVertex ch_destination, CHQueryStatistics& stats )
 {
-    std::pair<std::list<CHVertex>, float> ret;
+    std::pair<std::list<MultiProfileCHEdge>, float> ret;
 
-    auto weight_map_fn = []( const CHQuery::edge_descriptor& e ) {
-        return float(e.property().b.cost / 100.0);
+    // edges that cannot be used by this profile have an infinite weight and are never relaxed
+    auto weight_map_fn = [&profile]( const MultiProfileCHEdge& e ) {
+        uint32_t cost = profile.cost[e.property().index];
+        return cost == CHProfile::Infinity ? std::numeric_limits<float>::infinity() : float(cost / 100.0);
     };
-    auto weight_map = boost::make_function_property_map<CHQuery::edge_descriptor, float, decltype(weight_map_fn)>( weight_map_fn );
+    auto weight_map = boost::make_function_property_map<MultiProfileCHEdge, float, decltype(weight_map_fn)>( weight_map_fn );
     float ret_cost = std::numeric_limits<float>::max();
-    auto path = bidirectional_ch_dijkstra( rd, ch_origin, ch_destination, weight_map, ret_cost );
+    auto path = bidirectional_ch_dijkstra( rd.ch_query(), ch_origin, ch_destination, weight_map, ret_cost, ch_query_workspace<CHVertex, float>(), stats );
 
-    auto& ret_path = ret.first;
-    unpack_path( path.begin(), path.end(), rd.middle_node(), std::back_inserter( ret_path ) );
+    for ( const MultiProfileCHEdge& e : path ) {
+        unpack_profile_edge( rd.ch_query(), profile, e, std::back_inserter( ret.first ) );
+    }
     ret.second = ret_cost;
 
     return ret;
@@ -264,18 +204,30 @@ std::pair<std::list<CHVertex>, float> ch_query( const CHRoutingData& rd, CHVerte
 class CHPluginRequest : public PluginRequest
 {
 private:
-    const CHRoutingData& rd_;
+    const CHRoutingData* rd_;
+    const HubLabelRoutingData* hrd_;
+    const TransitNodeRoutingData* trd_;
+    const MultiProfileCHRoutingData* mrd_;
+    const CHClosureIndex* closure_index_;
+    std::shared_ptr<const CHClosure> closure_;
 public:
-    CHPluginRequest( const CHPlugin* parent, const VariantMap& options, const CHRoutingData& rd )
-        : PluginRequest( parent, options), rd_(rd)
+    CHPluginRequest( const CHPlugin* parent, const VariantMap& options, const CHRoutingData* rd, const HubLabelRoutingData* hrd,
+                     const TransitNodeRoutingData* trd, const MultiProfileCHRoutingData* mrd,
+                     const CHClosureIndex* closure_index, std::shared_ptr<const CHClosure> closure )
+        : PluginRequest( parent, options), rd_(rd), hrd_(hrd), trd_(trd), mrd_(mrd), closure_index_(closure_index), closure_(closure)
     {}
 
     std::unique_ptr<Result> process( const Request& request ) override
     {
         Timer timer;
+        // the request is reused by batches, metrics of the previous request must not be reported
+        metrics_.clear();
 
-        boost::optional<CHVertex> origin = rd_.vertex_from_id( request.origin() );
-        boost::optional<CHVertex> destination = rd_.vertex_from_id( request.destination() );
+        auto vertex_from_id = [this]( db_id_t id ) {
+            return rd_ ? rd_->vertex_from_id( id ) : mrd_->vertex_from_id( id );
+        };
+        boost::optional<CHVertex> origin = vertex_from_id( request.origin() );
+        boost::optional<CHVertex> destination = vertex_from_id( request.destination() );
 
         if ( !origin ) {
             throw std::runtime_error( (boost::format("Can't find vertex of ID %1%") % request.origin()).str() );
@@ -285,53 +237,109 @@ public:
         }
         std::cout << "From " << request.origin() << " to " << request.destination() << std::endl;
 
-        auto ch_ret = ch_query( rd_, origin.get(), destination.get() );
-        auto& ch_graph = rd_.ch_query();
-
-        auto& path = ch_ret.first;
-
-        if ( path.empty() ) {
-            throw std::runtime_error( "No path found !" );
-        }
-
-        metrics_[ "time_s" ] = Variant::from_float( timer.elapsed() );
-
         std::unique_ptr<Result> result( new Result() );
         result->push_back( Roadmap() );
         Roadmap& roadmap = result->back();
 
         roadmap.set_starting_date_time( request.steps()[1].constraint().date_time() );
 
-        std::auto_ptr<Roadmap::Step> step;
-
-        Road::Edge current_road;
-        auto prev = path.begin();
-        auto it = prev;
-        it++;
-
-        for ( ; it != path.end(); ++it, ++prev) {
-            CHVertex v = *it;
-            CHVertex previous = *prev;
+        auto add_step = [&roadmap]( CostId cost_id, double cost, db_id_t transport_mode, db_id_t road_edge_id ) {
+            std::auto_ptr<Roadmap::Step> step( new Roadmap::RoadStep() );
+            step->set_cost( cost_id, cost );
+            step->set_transport_mode( transport_mode );
+            static_cast<Roadmap::RoadStep*>(step.get())->set_road_edge_id( road_edge_id );
+            roadmap.add_step( step );
+        };
+
+        CHQueryStatistics stats;
+        if ( closure_ && !closure_->empty() ) {
+            // hub labels and transit nodes ignore closures
+            uint32_t cost = std::numeric_limits<uint32_t>::max();
+            bool fallback = false;
+            std::list<CHEdge> path = ch_query_with_closure( *rd_, *closure_index_, *closure_, origin.get(), destination.get(), cost, &fallback );
+            if ( cost == std::numeric_limits<uint32_t>::max() ) {
+                throw std::runtime_error( "No path found !" );
+            }
+            metrics_[ "closure_fallback" ] = Variant::from_bool( fallback );
+            if ( get_bool_option( "ch/cost_only" ) ) {
+                metrics_[ "cost" ] = Variant::from_float( float(cost / 100.0) );
+            }
+            else {
+                std::list<CHQuery::EdgeIndex> edges;
+                for ( const CHEdge& e : path ) {
+                    unpack_edge( *rd_, e.index(), std::back_inserter( edges ) );
+                }
+                for ( CHQuery::EdgeIndex idx : edges ) {
+                    add_step( CostId::CostDistance, rd_->ch_query().edge_property( idx ).b.cost / 100.0, 1, rd_->edge_origin( idx ).db_id );
+                }
+            }
+        }
+        else if ( rd_ && get_bool_option( "ch/cost_only" ) ) {
+            // no roadmap, the cost comes from the hub labels or the transit nodes when they are loaded,
+            // from a CH search without unpacking otherwise
+            float cost = std::numeric_limits<float>::max();
+            if ( hrd_ ) {
+                const uint32_t c = hrd_->labels().cost( origin.get(), destination.get() );
+                if ( c != HubLabels::Infinity ) {
+                    cost = float(c / 100.0);
+                }
+            }
+            else if ( trd_ ) {
+                bool local = false;
+                const uint32_t c = trd_->cost( rd_->ch_query(), origin.get(), destination.get(), &local );
+                if ( c != TransitNodeRoutingData::Infinity ) {
+                    cost = float(c / 100.0);
+                }
+                metrics_[ "local" ] = Variant::from_bool( local );
+            }
+            else {
+                cost = ch_cost( *rd_, origin.get(), destination.get(), stats );
+            }
+            if ( cost == std::numeric_limits<float>::max() ) {
+                throw std::runtime_error( "No path found !" );
+            }
+            metrics_[ "cost" ] = Variant::from_float( cost );
+        }
+        else if ( rd_ ) {
+            auto ch_ret = ch_query( *rd_, origin.get(), destination.get(), stats );
+            auto& ch_graph = rd_->ch_query();
 
-            // Find an edge, based on a source and destination vertex
-            CHEdge e;
-            bool found = false;
-            boost::tie( e, found ) = edge( previous, v, ch_graph );
+            if ( ch_ret.second == std::numeric_limits<float>::max() ) {
+                throw std::runtime_error( "No path found !" );
+            }
 
-            if ( !found ) {
-                std::cout << "Cannot find edge (" << rd_.vertex_id( previous ) << "->" << rd_.vertex_id( v ) << ")" << std::endl;
+            for ( CHQuery::EdgeIndex idx : ch_ret.first ) {
+                add_step( CostId::CostDistance, ch_graph.edge_property( idx ).b.cost / 100.0, 1, rd_->edge_origin( idx ).db_id );
             }
-            BOOST_ASSERT( found );
+        }
+        else {
+            // the profile is chosen by the first optimizing criterion and the allowed modes
+            CostId cost_id = request.optimizing_criteria().empty() ? CostId::CostDistance : request.optimizing_criteria()[0];
+            db_id_t mode_id = 0;
+            boost::optional<size_t> profile_idx = mrd_->find_profile( request.allowed_modes(), cost_id, &mode_id );
+            if ( !profile_idx ) {
+                throw std::runtime_error( "No CH profile for the allowed transport modes and the optimizing criterion" );
+            }
+            const CHProfile& profile = mrd_->profile( *profile_idx );
 
-            step.reset( new Roadmap::RoadStep() );
-            step->set_cost( CostId::CostDistance, e.property().b.cost / 100.0 );
-            step->set_transport_mode(1);
-            Roadmap::RoadStep* rstep = static_cast<Roadmap::RoadStep*>(step.get());
-            rstep->set_road_edge_id( e.property().db_id );
-            roadmap.add_step( step );
+            auto ch_ret = multi_profile_ch_query( *mrd_, profile, origin.get(), destination.get(), stats );
+            if ( ch_ret.second == std::numeric_limits<float>::max() ) {
+                throw std::runtime_error( "No path found !" );
+            }
+            for ( const MultiProfileCHEdge& e : ch_ret.first ) {
+                const uint32_t idx = e.property().index;
+                add_step( profile.cost_id, profile.cost[idx] / 100.0, mode_id, profile.db_id[idx] );
+            }
         }
 
-        Db::Connection connection( plugin_->db_options() );
+        metrics_[ "time_s" ] = Variant::from_float( timer.elapsed() );
+        metrics_[ "settled_forward" ] = Variant::from_int( stats.settled[0] );
+        metrics_[ "settled_backward" ] = Variant::from_int( stats.settled[1] );
+        metrics_[ "stalled_forward" ] = Variant::from_int( stats.stalled[0] );
+        metrics_[ "stalled_backward" ] = Variant::from_int( stats.stalled[1] );
+
+        Db::PooledConnection pooled_connection( plugin_->db_options() );
+        Db::Connection& connection = *pooled_connection;
         fill_roadmap_from_db( roadmap.begin(), roadmap.end(), connection );
         return std::move( result );
     }
@@ -340,7 +348,27 @@ public:
 
 std::unique_ptr<PluginRequest> CHPlugin::request( const VariantMap& options ) const
 {
-    return std::unique_ptr<PluginRequest>( new CHPluginRequest( this, options, *rd_ ) );
+    std::shared_ptr<const CHClosure> closure;
+    const std::string sections = get_option_or_default( options, "ch/closed_sections" ).str();
+    if ( !sections.empty() ) {
+        if ( !closure_index_ ) {
+            throw std::runtime_error( "Road sections can only be closed when the ch/closures option is set" );
+        }
+        // consecutive requests usually share the same closures, that are then only applied once
+        boost::lock_guard<boost::mutex> lock( closure_mutex_ );
+        if ( sections != closure_sections_ ) {
+            std::vector<db_id_t> ids;
+            std::istringstream iss( sections );
+            std::string id;
+            while ( std::getline( iss, id, ',' ) ) {
+                ids.push_back( std::stoll( id ) );
+            }
+            closure_ = closure_index_->close( ids );
+            closure_sections_ = sections;
+        }
+        closure = closure_;
+    }
+    return std::unique_ptr<PluginRequest>( new CHPluginRequest( this, options, rd_, hrd_, trd_, mrd_, closure_index_.get(), closure ) );
 }
 
 } // namespace Tempus
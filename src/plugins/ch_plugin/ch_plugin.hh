@@ -19,6 +19,12 @@
 
 #include "plugin.hh"
 #include "ch_routing_data.hh"
+#include "multi_profile_ch_routing_data.hh"
+#include "hub_label_routing_data.hh"
+#include "transit_node_routing_data.hh"
+#include "ch_closures.hh"
+
+#include <boost/thread/mutex.hpp>
 
 namespace Tempus
 {
@@ -32,12 +38,29 @@ public:
 
     CHPlugin( ProgressionCallback& progression, const VariantMap& options );
 
-    const RoutingData* routing_data() const override { return rd_; }
+    const RoutingData* routing_data() const override { return rd_ ? static_cast<const RoutingData*>( rd_ ) : mrd_; }
 
     std::unique_ptr<PluginRequest> request( const VariantMap& options = VariantMap() ) const override;
 
+    // requests only hold pointers to the data, search workspaces are per thread
+    bool reusable_requests() const override { return true; }
+
 private:
+    // single profile data, or null
     const CHRoutingData* rd_;
+    // hub labels, or null. rd_ is then their CH data
+    const HubLabelRoutingData* hrd_;
+    // transit-node layer of rd_, or null
+    const TransitNodeRoutingData* trd_;
+    // multi-profile data, or null
+    const MultiProfileCHRoutingData* mrd_;
+
+    // closures of road sections on rd_, or null
+    std::unique_ptr<CHClosureIndex> closure_index_;
+    // last closure applied, by its list of sections
+    mutable boost::mutex closure_mutex_;
+    mutable std::string closure_sections_;
+    mutable std::shared_ptr<const CHClosure> closure_;
 };
 
 } // namespace Tempus
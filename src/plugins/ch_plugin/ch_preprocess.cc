@@ -20,18 +20,14 @@
 #include "common.hh"
 #include "ch_preprocess.hh"
 #include "utils/timer.hh"
+#include "utils/d_ary_heap.hh"
 
-#include <chrono>
-#include <unordered_set>
-#include <queue>
+#include <limits>
 
 using namespace Tempus;
 using namespace std;
 
-using TTargetSet = std::set<CHVertex>;
-
 using TNodeContractionCost = int;
-using TRemainingNodeSet = std::unordered_set<CHVertex>;
 
 struct TEdge
 {
@@ -40,255 +36,274 @@ struct TEdge
     TCost cost;
 };
 
-void add_edge_or_update( CHGraph& graph, CHVertex u, CHVertex v, TCost cost )
+namespace
 {
-    bool found = false;
-    CHEdge e;
-    boost::tie( e, found ) = edge( u, v, graph );
-    if ( !found ) {
-        boost::tie( e, found ) = add_edge( u, v, graph );
-    }
-    // update the cost
-    graph[e].weight = cost;
-}
 
-// If set to 1, the graph is really contracted (i.e. a node and its references are removed from the graph after contraction)
-// If set to 0, edges are filtered during the contraction (retaining nodes of upper order)
-// Actually reducing the graph seems a bit faster
-#define REDUCE_GRAPH 1
-
-map<CHVertex, TCost> witness_search(const CHGraph& graph, CHVertex contracted_node, CHVertex source, const TTargetSet& targets, TCost cutoff, int& search_space)
+// Limits of the witness searches. A search that reaches a limit may miss a witness path,
+// which only leads to a superfluous shortcut.
+struct WitnessLimits
 {
-    struct DijkstraNode
+    int max_hops;
+    size_t max_settled;
+};
+// Limits when contractions are simulated during the node ordering
+const WitnessLimits ORDERING_LIMITS = { 5, 500 };
+// Limits of the actual contraction
+const WitnessLimits CONTRACTION_LIMITS = { 64, 2000 };
+
+///
+/// Graph updated during the contraction
+///
+/// Each vertex has its own arrays of outgoing and incoming arcs. A contracted vertex is removed
+/// from the arrays of its neighbours, so that the searches only see the remaining graph.
+class ContractionGraph
+{
+public:
+    struct Arc
     {
-        CHVertex node;
-        TCost cost;
-        int hops;
-        int order;
+        uint32_t other;
+        TCost weight;
     };
 
-    class CompareNode
+    explicit ContractionGraph( const CHGraph& graph ) : out_( boost::num_vertices( graph ) ), in_( boost::num_vertices( graph ) )
     {
-    public:
-        bool operator()(const DijkstraNode& node1, const DijkstraNode& node2) const
-        {
-            // node2 has higher priority if it has a smaller cost
-            // (DijkstraNode::order used in case of cost equality, for non-random heap.pop())
-            return node1.cost > node2.cost || (node1.cost == node2.cost && node1.order > node2.order);
+        for ( auto e : pair_range( edges( graph ) ) ) {
+            add_or_decrease_arc( source( e, graph ), target( e, graph ), graph[e].weight );
         }
-    };
-
-    // Dijkstra from one source to multiple targets.
-    REQUIRE(!targets.empty());
+    }
 
-    TTargetSet found; // targets found
-    map<CHVertex, TCost> relaxed; // minimal costs of relaxed nodes (from 'source')
-    relaxed[source] = 0; // the cost from 'source' to 'source' is 0
-    search_space = 1; // search-space of Dijkstra (used for node-ordering)
+    uint32_t num_vertices() const { return out_.size(); }
 
-    int order = 0;
-#if 1
-    priority_queue<DijkstraNode, vector<DijkstraNode>, CompareNode> heap; // priority queue
-#else
-    CompareNode cmp;
-    boost::heap::d_ary_heap< DijkstraNode, boost::heap::arity<2>, boost::heap::compare< CompareNode >, boost::heap::mutable_<true> > heap( cmp );
-#endif
-    heap.push( {source, 0, 1, order++} );
+    const vector<Arc>& out_arcs( uint32_t v ) const { return out_[v]; }
+    const vector<Arc>& in_arcs( uint32_t v ) const { return in_[v]; }
 
-    while( !heap.empty() )
+    ///
+    /// Add an arc, or lower the weight of an existing one
+    void add_or_decrease_arc( uint32_t u, uint32_t v, TCost weight )
     {
-        // Get less costly node in priority queue:
-        const DijkstraNode& top = heap.top();
-        CHVertex node = top.node;
-        TCost cost = top.cost;
-        int num_hops = top.hops;
-        heap.pop();
-
-        if( targets.find( node ) != targets.end() ) // found one of the targets
-        {
-            found.emplace( node );
-
-            if( found == targets ) // all targets have been found
-            {
-                break;
-            }
+        if ( u == v ) {
+            return;
         }
-
-        for ( auto succ : pair_range( out_edges( node, graph ) ) )
-        {
-            CHVertex successor_node = target( succ, graph );
-#if REDUCE_GRAPH
-            if( successor_node == contracted_node ) // ignore contracted node
-                continue;
-#else
-            if( successor_node <= contracted_node ) // ignore contracted node and lower nodes
-                continue;
-#endif
-
-            TCost vu_cost = cost + graph[succ].weight;
-            if(cutoff && vu_cost > cutoff) // do not search beyond 'cutoff'
-            {
-                continue;
+        for ( Arc& a : out_[u] ) {
+            if ( a.other == v ) {
+                if ( weight < a.weight ) {
+                    a.weight = weight;
+                    for ( Arc& b : in_[v] ) {
+                        if ( b.other == u ) {
+                            b.weight = weight;
+                            break;
+                        }
+                    }
+                }
+                return;
             }
+        }
+        out_[u].push_back( { v, weight } );
+        in_[v].push_back( { u, weight } );
+    }
 
-            auto iter = relaxed.find( successor_node );
-            if( iter == relaxed.end() || vu_cost < iter->second )
-            {
-                // Add node to priority queue:
-                heap.push( {successor_node, vu_cost, num_hops + 1, order++} );
-                relaxed[successor_node] = vu_cost;
+    ///
+    /// Remove every arc to and from v
+    void remove_vertex( uint32_t v )
+    {
+        for ( const Arc& a : out_[v] ) {
+            remove_arc_( in_[a.other], v );
+        }
+        for ( const Arc& a : in_[v] ) {
+            remove_arc_( out_[a.other], v );
+        }
+        vector<Arc>().swap( out_[v] );
+        vector<Arc>().swap( in_[v] );
+    }
 
-                if(num_hops + 1 > search_space)
-                    search_space = num_hops + 1;
+private:
+    // arcs are not sorted, the last one takes the place of the removed one
+    static void remove_arc_( vector<Arc>& arcs, uint32_t other )
+    {
+        for ( size_t i = 0; i < arcs.size(); i++ ) {
+            if ( arcs[i].other == other ) {
+                arcs[i] = arcs.back();
+                arcs.pop_back();
+                return;
             }
         }
     }
 
-    map<CHVertex, TCost> target_costs;
-    for(CHVertex t : found)
-        target_costs.emplace( t, relaxed[t] );
-    return target_costs;
-}
+    vector<vector<Arc>> out_;
+    vector<vector<Arc>> in_;
+};
 
-std::vector<TEdge> get_contraction_shortcuts( const CHGraph& graph, CHVertex v )
+///
+/// Dijkstra used to look for witness paths, i.e. paths that do not go through the contracted vertex.
+///
+/// Arrays are dense and allocated once. A vertex is only considered during the current search if its
+/// epoch matches the current one, so that a new search neither allocates nor clears anything.
+class WitnessSearch
 {
-    // Contraction of 'node'.
-
-    vector<TEdge> shortcuts;
-    for ( auto uv : pair_range( in_edges( v, graph ) ) )
+public:
+    ///
+    /// Start a new search on a graph of n vertices
+    void start( uint32_t n )
     {
-        TTargetSet targets;
-        TCost mx = 0;
-        CHVertex u = source( uv, graph );
+        if ( epoch_.size() != n ) {
+            cost_.resize( n );
+            hops_.resize( n );
+            epoch_.assign( n, 0 );
+            target_epoch_.assign( n, 0 );
+            current_ = 0;
+            heap_.resize( n );
+        }
+        heap_.clear();
+        num_targets_ = 0;
+        current_++;
+        if ( current_ == 0 ) {
+            // wrap around
+            std::fill( epoch_.begin(), epoch_.end(), 0 );
+            std::fill( target_epoch_.begin(), target_epoch_.end(), 0 );
+            current_ = 1;
+        }
+    }
 
-#if !REDUCE_GRAPH
-        if ( u < v ) // only consider upper predecessors
-            continue;
-#endif
+    void add_target( uint32_t t )
+    {
+        if ( target_epoch_[t] != current_ ) {
+            target_epoch_[t] = current_;
+            num_targets_++;
+        }
+    }
 
-        //std::cout << s << " " << node << std::endl;
-        for ( auto vw : pair_range( out_edges( v, graph ) ) )
-        {
-            CHVertex w = target( vw, graph );
-            if ( w == u )
-                continue;
-#if !REDUCE_GRAPH
-            if ( w < v ) // only consider upper successors
+    ///
+    /// Search from origin, ignoring the contracted vertex, until every target is settled.
+    /// The search does not go beyond cutoff (if not null) and the given limits.
+    /// \returns the maximum number of hops of a relaxed vertex (search space)
+    int run( const ContractionGraph& graph, uint32_t contracted, uint32_t origin, TCost cutoff, const WitnessLimits& limits )
+    {
+        size_t remaining = num_targets_;
+        // the origin is at 0 hops, vertices at up to max_hops arcs from it are reached
+        set_( origin, 0, 0 );
+        heap_.push( origin, 0 );
+        int search_space = 0;
+        size_t settled = 0;
+        while ( !heap_.empty() && remaining > 0 && settled < limits.max_settled ) {
+            const uint32_t u = heap_.top();
+            const TCost c = heap_.top_key();
+            heap_.pop();
+            settled++;
+
+            if ( target_epoch_[u] == current_ ) {
+                remaining--;
+            }
+            const int hops = hops_[u] + 1;
+            if ( hops > limits.max_hops ) {
                 continue;
-#endif
-
-            targets.emplace( w );
+            }
 
-            if ( graph[vw].weight > mx )
-                mx = graph[vw].weight;
+            for ( const ContractionGraph::Arc& a : graph.out_arcs( u ) ) {
+                if ( a.other == contracted ) {
+                    continue;
+                }
+                const TCost vc = c + a.weight;
+                if ( cutoff && vc > cutoff ) {
+                    // do not search beyond 'cutoff'
+                    continue;
+                }
+                if ( vc < cost( a.other ) ) {
+                    set_( a.other, vc, hops );
+                    heap_.push_or_decrease( a.other, vc );
+                    search_space = std::max( search_space, hops );
+                }
+            }
         }
+        return search_space;
+    }
 
-        if ( targets.empty() )
-            continue;
-
-        // It is not useful to search shortcuts beyond 'cutoff'
-        TCost cutoff = graph[uv].weight + mx;
-
-        // Perform Dijkstra from 'predecessor' to all 'targets' while ignoring 'node'
-        int _ = 0; // not used
-        auto target_costs = witness_search( graph, v, u, targets, cutoff, _ );
+    ///
+    /// Cost of the best path found to v during the last search, or the maximum cost
+    TCost cost( uint32_t v ) const { return epoch_[v] == current_ ? cost_[v] : std::numeric_limits<TCost>::max(); }
 
-        for ( auto vw : pair_range( out_edges( v, graph ) ) )
-        {
-            CHVertex w = target( vw, graph );
-            if ( w == u )
-                continue;
-#if !REDUCE_GRAPH
-            if ( w < v ) // only consider upper successors
-                continue;
-#endif
-
-            auto iter_shortcut = target_costs.find( w );
-            TCost uvw_cost = graph[uv].weight + graph[vw].weight;
-            if( iter_shortcut == target_costs.end() || iter_shortcut->second > uvw_cost )
-            {
-                // If no shortest path was found from 'predecessor' to 'successor' during the Dijkstra
-                // propagation, then it means the shortest path from 'predecessor' to 'successor' is
-                // <predecessor, node, successor>, and a shortcut must be added.
-                shortcuts.push_back( {u, w, uvw_cost} );
-            }
-        }
+private:
+    void set_( uint32_t v, TCost c, int hops )
+    {
+        epoch_[v] = current_;
+        cost_[v] = c;
+        hops_[v] = hops;
     }
 
-    // cout << "Contracted " << node << "." << endl;
-    return shortcuts;
-}
+    vector<TCost> cost_;
+    vector<int> hops_;
+    vector<uint32_t> epoch_;
+    vector<uint32_t> target_epoch_;
+    uint32_t current_ = 0;
+    size_t num_targets_ = 0;
+    DAryHeap<uint32_t, TCost> heap_;
+};
 
-void get_node_edge_impact( const CHGraph& graph, CHVertex v, int& nb_added_edges, int& max_search_space )
+///
+/// Witness search of the current thread
+WitnessSearch& witness_search()
 {
-    // Contraction of 'node'.
+    static thread_local WitnessSearch w;
+    return w;
+}
 
-    nb_added_edges = 0;
-    max_search_space = 0;
+///
+/// Call visitor( u, w, cost ) for each shortcut u -> w needed by the contraction of v
+/// \returns the maximum search space of the witness searches
+template <typename Visitor>
+int for_each_shortcut( const ContractionGraph& graph, uint32_t v, const WitnessLimits& limits, Visitor visitor )
+{
+    WitnessSearch& witness = witness_search();
+    int max_search_space = 0;
 
-    for ( auto uv : pair_range( in_edges( v, graph ) ) )
-    {
-        TTargetSet targets;
+    for ( const ContractionGraph::Arc& uv : graph.in_arcs( v ) ) {
+        const uint32_t u = uv.other;
         TCost mx = 0;
-        CHVertex u = source( uv, graph );
-
-        //std::cout << s << " " << node << std::endl;
-        for ( auto vw : pair_range( out_edges( v, graph ) ) )
-        {
-            CHVertex w = target( vw, graph );
-            if ( w == u )
+        bool has_target = false;
+        witness.start( graph.num_vertices() );
+        for ( const ContractionGraph::Arc& vw : graph.out_arcs( v ) ) {
+            if ( vw.other == u ) {
                 continue;
-
-            targets.emplace( w );
-
-            if ( graph[vw].weight > mx )
-                mx = graph[vw].weight;
+            }
+            witness.add_target( vw.other );
+            mx = std::max( mx, vw.weight );
+            has_target = true;
         }
-
-        if ( targets.empty() )
+        if ( !has_target ) {
             continue;
+        }
 
         // It is not useful to search shortcuts beyond 'cutoff'
-        TCost cutoff = graph[uv].weight + mx;
-
-        // Perform Dijkstra from 'predecessor' to all 'targets' while ignoring 'node'
-        int search_space = 0;
-        auto target_costs = witness_search( graph, v, u, targets, cutoff, search_space );
-
-        if ( search_space > max_search_space )
-            max_search_space = search_space;
+        // Perform Dijkstra from 'u' to all the targets while ignoring 'v'
+        const int search_space = witness.run( graph, v, u, uv.weight + mx, limits );
+        max_search_space = std::max( max_search_space, search_space );
 
-        for ( auto vw : pair_range( out_edges( v, graph ) ) )
-        {
-            CHVertex w = target( vw, graph );
-            if ( w == u )
+        for ( const ContractionGraph::Arc& vw : graph.out_arcs( v ) ) {
+            if ( vw.other == u ) {
                 continue;
-
-            auto iter_shortcut = target_costs.find( w );
-            TCost uvw_cost = graph[uv].weight + graph[vw].weight;
-            if( iter_shortcut == target_costs.end() || iter_shortcut->second > uvw_cost )
-            {
-                // If no shortest path was found from 'predecessor' to 'successor' during the Dijkstra
-                // propagation, then it means the shortest path from 'predecessor' to 'successor' is
-                // <predecessor, node, successor>, and a shortcut must be added.
-                nb_added_edges++;
+            }
+            const TCost uvw_cost = uv.weight + vw.weight;
+            if ( witness.cost( vw.other ) > uvw_cost ) {
+                // If no shorter path was found from 'u' to 'w' during the Dijkstra
+                // propagation, then the shortest path from 'u' to 'w' is
+                // <u, v, w>, and a shortcut must be added.
+                visitor( u, vw.other, uvw_cost );
             }
         }
     }
+    return max_search_space;
 }
 
-TNodeContractionCost get_node_cost( const CHGraph& graph,
-                                    CHVertex node,
+TNodeContractionCost get_node_cost( const ContractionGraph& graph,
+                                    uint32_t node,
                                     const vector<int>& hierarchyDepths,
                                     db_id_t nodeId64)
 {
-    int nbRemovedEdges = 0;
+    int nbRemovedEdges = graph.in_arcs( node ).size() + graph.out_arcs( node ).size();
     int nbAddedEdges = 0;
-    int maxSearchSpace = 0;
 
-    nbRemovedEdges = in_degree( node, graph ) + out_degree( node, graph );
-
-    get_node_edge_impact(graph, node, nbAddedEdges, maxSearchSpace);
+    int maxSearchSpace = for_each_shortcut( graph, node, ORDERING_LIMITS, [&nbAddedEdges]( uint32_t, uint32_t, TCost ) {
+            nbAddedEdges++;
+        });
 
     // The "edge difference" is the number of shortcuts created
     // when contracting 'node' minus the number of edges removed.
@@ -301,130 +316,78 @@ TNodeContractionCost get_node_cost( const CHGraph& graph,
     return edgeDiff * 1000000 + depth * 100000 + maxSearchSpace * 10000 + (nodeId64 % 10000);
 }
 
-
-inline bool is_node_independent(const CHGraph& graph,
-                                CHVertex node,
-                                const vector<TNodeContractionCost>& nodeCosts,
-                                TNodeContractionCost nodeCost)
+template <typename Foo>
+void apply_on_1_neighbourhood( const ContractionGraph& graph, uint32_t node, Foo foo )
 {
-    // A node is 'independent' if all its neighbors, and the neighbors
-    // of its neighbors have a higher cost.
-
-    for ( const auto& pred : pair_range( in_edges( node, graph ) ) )
-    {
-        CHVertex u = source( pred, graph );
-        if ( nodeCosts[u] < nodeCost )
-            return false;
-
-        for ( const auto& pred2 : pair_range( in_edges( u, graph ) ) )
-        {
-            CHVertex v = source( pred2, graph );
-            if ( nodeCosts[v] < nodeCost )
-                return false;
-        }
-        for ( const auto& succ2 : pair_range( out_edges( u, graph ) ) )
-        {
-            CHVertex v = target( succ2, graph );
-            if ( nodeCosts[v] < nodeCost )
-                return false;
-        }
+    for ( const ContractionGraph::Arc& a : graph.in_arcs( node ) ) {
+        foo( a.other );
     }
-
-    for ( const auto& succ : pair_range( out_edges( node, graph ) ) )
-    {
-        CHVertex u = target( succ, graph );
-        if ( nodeCosts[u] < nodeCost )
-            return false;
-
-        for ( const auto& pred2 : pair_range( in_edges( u, graph ) ) )
-        {
-            CHVertex v = source( pred2, graph );
-            if ( nodeCosts[v] < nodeCost )
-                return false;
-        }
-        for ( const auto& succ2 : pair_range( out_edges( u, graph ) ) )
-        {
-            CHVertex v = target( succ2, graph );
-            if ( nodeCosts[v] < nodeCost )
-                return false;
-        }
+    for ( const ContractionGraph::Arc& a : graph.out_arcs( node ) ) {
+        foo( a.other );
     }
-
-    return true;
 }
 
-
 template <typename Foo>
-void apply_on_1_neighbourhood( const CHGraph& graph, CHVertex node, Foo foo )
+void apply_on_2_neighbourhood( const ContractionGraph& graph, uint32_t node, Foo foo )
 {
-    for ( const auto& pred : pair_range( in_edges( node, graph ) ) )
-    {
-        CHVertex u = source( pred, graph );
-        foo( u );
-    }
-
-    for ( const auto& succ : pair_range( out_edges( node, graph ) ) )
-    {
-        CHVertex u = target( succ, graph );
-        foo( u );
-    }
+    apply_on_1_neighbourhood( graph, node, [&graph, &foo]( uint32_t u ) {
+            foo( u );
+            apply_on_1_neighbourhood( graph, u, foo );
+        });
 }
 
-template <typename Foo>
-void apply_on_2_neighbourhood( const CHGraph& graph, CHVertex node, Foo foo )
+inline bool is_node_independent( const ContractionGraph& graph,
+                                 uint32_t node,
+                                 const vector<TNodeContractionCost>& nodeCosts,
+                                 TNodeContractionCost nodeCost )
 {
-    for ( const auto& pred : pair_range( in_edges( node, graph ) ) )
-    {
-        CHVertex u = source( pred, graph );
-        foo( u );
-
-        for ( const auto& pred2 : pair_range( in_edges( u, graph ) ) )
-        {
-            CHVertex v = source( pred2, graph );
-            foo( v );
-        }
-        for ( const auto& succ2 : pair_range( out_edges( u, graph ) ) )
-        {
-            CHVertex v = target( succ2, graph );
-            foo( v );
+    // A node is 'independent' if all its neighbors, and the neighbors
+    // of its neighbors have a higher cost.
+    auto lower_neighbour = [&]( const vector<ContractionGraph::Arc>& arcs ) {
+        for ( const ContractionGraph::Arc& a : arcs ) {
+            if ( nodeCosts[a.other] < nodeCost ) {
+                return true;
+            }
         }
-    }
-
-    for ( const auto& succ : pair_range( out_edges( node, graph ) ) )
-    {
-        CHVertex u = target( succ, graph );
-        foo( u );
+        return false;
+    };
 
-        for ( const auto& pred2 : pair_range( in_edges( u, graph ) ) )
-        {
-            CHVertex v = source( pred2, graph );
-            foo( v );
+    if ( lower_neighbour( graph.in_arcs( node ) ) || lower_neighbour( graph.out_arcs( node ) ) ) {
+        return false;
+    }
+    for ( const ContractionGraph::Arc& a : graph.in_arcs( node ) ) {
+        if ( lower_neighbour( graph.in_arcs( a.other ) ) || lower_neighbour( graph.out_arcs( a.other ) ) ) {
+            return false;
         }
-        for ( const auto& succ2 : pair_range( out_edges( u, graph ) ) )
-        {
-            CHVertex v = target( succ2, graph );
-            foo( v );
+    }
+    for ( const ContractionGraph::Arc& a : graph.out_arcs( node ) ) {
+        if ( lower_neighbour( graph.in_arcs( a.other ) ) || lower_neighbour( graph.out_arcs( a.other ) ) ) {
+            return false;
         }
     }
+
+    return true;
 }
 
-vector<CHVertex> get_independent_node_set( const CHGraph& graph,
-                                           vector<CHVertex>::const_iterator nodeBeginIt,
+vector<uint32_t> get_independent_node_set( const ContractionGraph& graph,
+                                           vector<uint32_t>::const_iterator nodeBeginIt,
                                            int numNodes,
-                                           const vector<TNodeContractionCost>& nodeCosts )
+                                           const vector<TNodeContractionCost>& nodeCosts,
+                                           vector<uint32_t>& excluded,
+                                           uint32_t round )
 {
     // Get all independent nodes from the sequence [nodeBeginIt : NodeBeginIt+numNodes]
+    // excluded[v] == round if v is in the 2-neighbourhood of a selected node
 
     REQUIRE(!nodeCosts.empty());
     REQUIRE(numNodes > 0);
 
-    vector<CHVertex> returnValue;
-    unordered_set<CHVertex> excluded;
+    vector<uint32_t> returnValue;
     auto nodeEndIt = nodeBeginIt + numNodes;
     for (auto nodeIt=nodeBeginIt; nodeIt!=nodeEndIt; ++nodeIt)
     {
-        CHVertex nodeID = *nodeIt;
-        if (excluded.find(nodeID) != excluded.end())
+        uint32_t nodeID = *nodeIt;
+        if ( excluded[nodeID] == round )
             continue;
         REQUIRE(nodeID < nodeCosts.size());
         TNodeContractionCost nodeCost = nodeCosts[nodeID];
@@ -432,8 +395,8 @@ vector<CHVertex> get_independent_node_set( const CHGraph& graph,
         if ( !is_node_independent( graph, nodeID, nodeCosts, nodeCost ) )
             continue;
 
-        apply_on_2_neighbourhood( graph, nodeID, [&excluded]( CHVertex u ) {
-                excluded.emplace( u );
+        apply_on_2_neighbourhood( graph, nodeID, [&excluded, round]( uint32_t u ) {
+                excluded[u] = round;
             });
 
         returnValue.push_back(nodeID);
@@ -442,46 +405,48 @@ vector<CHVertex> get_independent_node_set( const CHGraph& graph,
     return returnValue;
 }
 
+}
 
 namespace Tempus
 {
 
-vector<CHVertex> order_graph( CHGraph& graph, std::function<db_id_t(CHVertex)> node_id )
+vector<CHVertex> order_graph( const CHGraph& input_graph, std::function<db_id_t(CHVertex)> node_id )
 {
+    const uint32_t n = num_vertices( input_graph );
+    ContractionGraph graph( input_graph );
+
     std::vector<CHVertex> processed_nodes;
-    std::vector<TNodeContractionCost> node_costs;
+    std::vector<TNodeContractionCost> node_costs( n );
 
     Timer t;
 
-    processed_nodes.reserve( num_vertices( graph ) );
-    node_costs.resize( num_vertices( graph ) );
+    processed_nodes.reserve( n );
 
-    vector<int> hierarchy_depths( num_vertices( graph ) );
+    vector<int> hierarchy_depths( n );
 
     cout << "Processing initial contraction costs..." << endl;
 
-    // nodes not contracted yet
-    TRemainingNodeSet remaining_nodes;
-
     // Parallel processing of node costs:
-    #pragma omp parallel
+    #pragma omp parallel for schedule(dynamic, 64)
+    for ( int node_i = 0; node_i < int(n); node_i++ )
     {
-        #pragma omp for schedule(dynamic)
-        for ( int node_i = 0; node_i < int(num_vertices( graph )); node_i++ )
-        {
-            CHVertex node = CHVertex( node_i );
-            node_costs[node] = get_node_cost( graph, node, hierarchy_depths, node_id(node) );
-        }
+        node_costs[node_i] = get_node_cost( graph, node_i, hierarchy_depths, node_id( node_i ) );
     }
 
-    for ( CHVertex node=0; node < num_vertices( graph ); ++node )
+    // nodes not contracted yet
+    vector<uint32_t> remaining_nodes( n );
+    for ( uint32_t node = 0; node < n; ++node )
     {
-        remaining_nodes.insert( node );
+        remaining_nodes[node] = node;
     }
+    vector<char> contracted( n, 0 );
+    vector<uint32_t> excluded( n, 0 );
+    uint32_t round = 0;
 
     int num_shortcuts = 0;
     while ( !remaining_nodes.empty() )
     {
+        round++;
         cout << "--------" << endl;
         cout << "Sorting nodes... [processed=" << processed_nodes.size()
              << ", remaining=" << remaining_nodes.size()
@@ -490,15 +455,16 @@ vector<CHVertex> order_graph( CHGraph& graph, std::function<db_id_t(CHVertex)> n
              << endl;
 
         // Sort all remaining nodes by cost
-        vector<CHVertex> sorted_nodes(remaining_nodes.begin(), remaining_nodes.end());
-        sort(sorted_nodes.begin(), sorted_nodes.end(), [&node_costs](CHVertex a, CHVertex b) { return node_costs[a] < node_costs[b]; });
+        sort(remaining_nodes.begin(), remaining_nodes.end(), [&node_costs](uint32_t a, uint32_t b) {
+                return node_costs[a] < node_costs[b] || ( node_costs[a] == node_costs[b] && a < b );
+            });
 
         // Only contract among the best 20% of remaining nodes during this iteration.
-        int step = max(static_cast<size_t>(1), sorted_nodes.size()/5);
-        REQUIRE(step <= int(sorted_nodes.size()));
+        int step = max(static_cast<size_t>(1), remaining_nodes.size()/5);
+        REQUIRE(step <= int(remaining_nodes.size()));
 
         // Independent node set
-        vector<CHVertex> next_nodes = get_independent_node_set(graph, sorted_nodes.cbegin(), step, node_costs );
+        vector<uint32_t> next_nodes = get_independent_node_set(graph, remaining_nodes.cbegin(), step, node_costs, excluded, round );
         REQUIRE(!next_nodes.empty());
 
         cout << "Contracting " << next_nodes.size()
@@ -506,49 +472,50 @@ vector<CHVertex> order_graph( CHGraph& graph, std::function<db_id_t(CHVertex)> n
 
         // Parallel contractions of selected nodes:
         vector<vector<TEdge>> node_shortcuts(next_nodes.size());
-        #pragma omp parallel
+        #pragma omp parallel for schedule(dynamic)
+        for (int i=0; i<int(next_nodes.size()); ++i)
         {
-            #pragma omp for schedule(dynamic)
-            for (int i=0; i<int(next_nodes.size()); ++i)
-            {
-                node_shortcuts[i] = get_contraction_shortcuts( graph, next_nodes[i] );
-            }
+            for_each_shortcut( graph, next_nodes[i], ORDERING_LIMITS, [&node_shortcuts, i]( uint32_t u, uint32_t w, TCost cost ) {
+                    node_shortcuts[i].push_back( { u, w, cost } );
+                });
         }
 
         // Update graph after contractions:
-        set<CHVertex> impacted_neighbors;
+        vector<uint32_t> impacted_neighbors;
         for (int i=0; i<int(next_nodes.size()); ++i)
         {
-            CHVertex nodeID = next_nodes[i];
+            uint32_t nodeID = next_nodes[i];
 
-            apply_on_1_neighbourhood( graph, nodeID, [&impacted_neighbors, &hierarchy_depths, &nodeID] ( CHVertex node ) {
-                impacted_neighbors.emplace( node );
+            apply_on_1_neighbourhood( graph, nodeID, [&impacted_neighbors, &hierarchy_depths, &nodeID] ( uint32_t node ) {
+                impacted_neighbors.push_back( node );
                 hierarchy_depths[node] = max(hierarchy_depths[nodeID]+1, hierarchy_depths[node]);
                 });
 
             num_shortcuts += static_cast<int>(node_shortcuts[i].size());
-            remaining_nodes.erase(nodeID);
+            contracted[nodeID] = 1;
 
             for (const TEdge& shortcut : node_shortcuts[i])
-                add_edge_or_update( graph, shortcut.from, shortcut.to, shortcut.cost );
+                graph.add_or_decrease_arc( shortcut.from, shortcut.to, shortcut.cost );
 
-            //graph.removeNode(nodeID);
-            clear_vertex( nodeID, graph );
+            graph.remove_vertex( nodeID );
         }
+        remaining_nodes.erase( std::remove_if( remaining_nodes.begin(), remaining_nodes.end(), [&contracted]( uint32_t v ) { return contracted[v]; } ),
+                               remaining_nodes.end() );
+
+        std::sort( impacted_neighbors.begin(), impacted_neighbors.end() );
+        impacted_neighbors.erase( std::unique( impacted_neighbors.begin(), impacted_neighbors.end() ), impacted_neighbors.end() );
+        impacted_neighbors.erase( std::remove_if( impacted_neighbors.begin(), impacted_neighbors.end(), [&contracted]( uint32_t v ) { return contracted[v]; } ),
+                                  impacted_neighbors.end() );
 
         cout << "Updating " << impacted_neighbors.size()
              << " impacted neighbors. [elapsed=" << t.elapsed_ms() << "ms]" << endl;
 
         // Parallel update of node costs:
-        vector<CHVertex> impacted_neighbors1(impacted_neighbors.begin(), impacted_neighbors.end());
-        #pragma omp parallel
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (int i=0; i<int(impacted_neighbors.size()); ++i)
         {
-            #pragma omp for schedule(dynamic)
-            for (int i=0; i<int(impacted_neighbors1.size()); ++i)
-            {
-                CHVertex update_node = impacted_neighbors1[i];
-                node_costs[update_node] = get_node_cost(graph, update_node, hierarchy_depths, node_id( update_node ));
-            }
+            uint32_t update_node = impacted_neighbors[i];
+            node_costs[update_node] = get_node_cost(graph, update_node, hierarchy_depths, node_id( update_node ));
         }
 
         // Save the order of this contraction (this is our node-ordering).
@@ -556,46 +523,44 @@ vector<CHVertex> order_graph( CHGraph& graph, std::function<db_id_t(CHVertex)> n
     }
 
     cout << "Shortcuts: " << num_shortcuts << endl;
-    REQUIRE(processed_nodes.size() == num_vertices( graph ));
-    REQUIRE(node_costs.size() == num_vertices( graph ));
-
-    // IDF: 31019ms
-    // France: 1237s.
+    REQUIRE(processed_nodes.size() == n);
 
     return processed_nodes;
 }
 
-vector<Shortcut> contract_graph( CHGraph& graph )
+vector<Shortcut> contract_graph( const CHGraph& input_graph )
 {
     vector<Shortcut> r;
     Timer t;
 
-    for ( auto node : pair_range( vertices( graph ) ) )
+    ContractionGraph graph( input_graph );
+    vector<TEdge> shortcuts;
+
+    for ( uint32_t node = 0; node < graph.num_vertices(); node++ )
     {
         if(node % 10000 == 0)
             cout << "Contracting nodes " << node << "... [elapsed=" << t.elapsed_ms() << "ms]" << endl;
 
-        // Single node contraction:
-        vector<TEdge> shortcuts = get_contraction_shortcuts( graph, node );
+        // Single node contraction, the graph is only modified afterwards
+        shortcuts.clear();
+        for_each_shortcut( graph, node, CONTRACTION_LIMITS, [&shortcuts]( uint32_t u, uint32_t w, TCost cost ) {
+                shortcuts.push_back( { u, w, cost } );
+            });
 
-        // Update graph after contraction:
         for(const TEdge& edge : shortcuts)
         {
             r.push_back( {edge.from, edge.to, edge.cost, node} );
 
             // add the shortcut to the graph
-            add_edge_or_update( graph, edge.from, edge.to, edge.cost );
+            graph.add_or_decrease_arc( edge.from, edge.to, edge.cost );
         }
 
-#if REDUCE_GRAPH
         // clear any reference to this node
-        clear_vertex( node, graph );
-#endif
+        graph.remove_vertex( node );
     }
-    // IDF: 7289ms
 
     cout << "Contracted entire graph in " << t.elapsed_ms() << "ms." << endl;
     return r;
 }
 
-} // namespace Tempus
+}
@@ -58,10 +58,11 @@ typedef typename boost::graph_traits<CHGraph>::edge_descriptor CHEdge;
 
 ///
 /// The node ordering processing
-/// \param[inout] graph The input graph that will be contracted
+/// Contractions are simulated on a copy of the graph, with hop-limited witness searches run in parallel
+/// \param[in] graph The input graph
 /// \param[in] node_id A function that maps a vertex to its id
 /// \returns the ordered nodes
-std::vector<CHVertex> order_graph( CHGraph& graph, std::function<db_id_t(CHVertex)> node_id );
+std::vector<CHVertex> order_graph( const CHGraph& graph, std::function<db_id_t(CHVertex)> node_id );
 
 struct Shortcut
 {
@@ -73,9 +74,10 @@ struct Shortcut
 
 ///
 /// The graph contraction processing
-/// \param[inout] graph The input graph that will be contracted
+/// Vertices are contracted in the order of their index, on a copy of the graph
+/// \param[in] graph The input graph, where vertices are indexed by their order
 /// \returns the shortcuts created
-std::vector<Shortcut> contract_graph( CHGraph& graph );
+std::vector<Shortcut> contract_graph( const CHGraph& graph );
 
 }
 
@@ -18,6 +18,7 @@
  */
 
 #include "ch_preprocess.hh"
+#include "ch_contracted_graph.hh"
 #include "routing_data.hh"
 #include "multimodal_graph.hh"
 #include "db.hh"
@@ -42,6 +43,7 @@ int main( int argc, char *argv[] )
     std::string ordering_out_schema = "ch";
     std::string ordering_in_schema = "ch";
     std::string contraction_out_schema = "ch";
+    std::string out_file;
 
     namespace po = boost::program_options;
     po::options_description desc( "Allowed options" );
@@ -57,6 +59,7 @@ int main( int argc, char *argv[] )
         ( "ordering-in-schema", po::value<string>(&ordering_in_schema), "set database schema used for reading the node ordering" )
         ( "contraction-out-schema", po::value<string>(&contraction_out_schema), "set database schema used for writing the contraction" )
         ( "no-db-saving", "do not save to db" )
+        ( "out_file,o", po::value<string>(&out_file), "also write the contraction as a ch_graph dump file" )
         ;
 
     po::variables_map vm;
@@ -153,10 +156,14 @@ int main( int argc, char *argv[] )
         // get nodes, ordered
         std::vector<db_id_t> order_id; // order -> id
         std::map<db_id_t, uint32_t> id_order_map; // id -> order
-        Db::Connection conn( db_options );
+        // the database is only needed to load the ordering or save the contraction
+        std::unique_ptr<Db::Connection> conn;
+        if ( load_ordering_from_db || save_to_db ) {
+            conn.reset( new Db::Connection( db_options ) );
+        }
         if ( load_ordering_from_db ) {
             std::cout << "* Loading node ordering from schema " << ordering_in_schema << std::endl;
-            Db::ResultIterator res_it = conn.exec_it( "select node_id from " + ordering_in_schema + ".ordered_nodes order by id asc" );
+            Db::ResultIterator res_it = conn->exec_it( "select node_id from " + ordering_in_schema + ".ordered_nodes order by id asc" );
             Db::ResultIterator it_end;
 
             CHVertex i = 0;
@@ -189,13 +196,14 @@ int main( int argc, char *argv[] )
         }
 
         if ( save_to_db ) {
-            conn.exec( "CREATE SCHEMA IF NOT EXISTS " + contraction_out_schema );
-            conn.exec( "DROP TABLE IF EXISTS " + contraction_out_schema + ".query_graph CASCADE" );
-            conn.exec( "CREATE TABLE " + contraction_out_schema + ".query_graph (id SERIAL PRIMARY KEY, node_inf BIGINT NOT NULL, node_sup BIGINT NOT NULL, contracted_id BIGINT, weight INT NOT NULL, constraints INT NOT NULL)" );
+            conn->exec( "CREATE SCHEMA IF NOT EXISTS " + contraction_out_schema );
+            conn->exec( "DROP TABLE IF EXISTS " + contraction_out_schema + ".query_graph CASCADE" );
+            conn->exec( "CREATE TABLE " + contraction_out_schema + ".query_graph (id SERIAL PRIMARY KEY, node_inf BIGINT NOT NULL, node_sup BIGINT NOT NULL, contracted_id BIGINT, weight INT NOT NULL, constraints INT NOT NULL)" );
 
-            conn.exec( "BEGIN" );
+            conn->exec( "BEGIN" );
         }
 
+        std::vector<CHContractedEdge> contracted_edges;
         for ( uint32_t order = 0; order < order_id.size(); order++ ) {
             Road::Vertex v = id_vertex_map[order_id[order]];
             BOOST_ASSERT( ch_graph[order].id == order_id[order] );
@@ -210,6 +218,9 @@ int main( int argc, char *argv[] )
                 boost::tie( e, added ) = add_edge( order, id_order_map[id], ch_graph );
                 BOOST_ASSERT( added );
                 ch_graph[e].weight = std::max(int(road_graph[*it].length()*100.0),1);
+                if ( !out_file.empty() ) {
+                    contracted_edges.push_back( { order, id_order_map[id], uint32_t( ch_graph[e].weight ), CHContractedEdge::NoMiddle, road_graph[*it].db_id() } );
+                }
                 if ( save_to_db ) {
                     std::ostringstream ss;
                     if ( order < id_order_map[id] ) {
@@ -217,12 +228,12 @@ int main( int argc, char *argv[] )
                     } else {
                         ss << "(" << id << "," << order_id[order] << "," << ch_graph[e].weight << ",2)";
                     }
-                    conn.exec( "INSERT INTO " + contraction_out_schema + ".query_graph (node_inf, node_sup, weight, constraints) VALUES " + ss.str() );
+                    conn->exec( "INSERT INTO " + contraction_out_schema + ".query_graph (node_inf, node_sup, weight, constraints) VALUES " + ss.str() );
                 }
             }
         }
         if ( save_to_db ) {
-            conn.exec( "COMMIT" );
+            conn->exec( "COMMIT" );
         }
 
         std::vector<Shortcut> shortcuts = contract_graph( ch_graph );
@@ -230,7 +241,7 @@ int main( int argc, char *argv[] )
         if ( save_to_db ) {
             std::cout << "* Saving contraction to schema " << contraction_out_schema << std::endl;
             // write shortcuts
-            conn.exec( "BEGIN" );
+            conn->exec( "BEGIN" );
             for ( const Shortcut& s : shortcuts )
             {
                 std::ostringstream ss;
@@ -239,9 +250,25 @@ int main( int argc, char *argv[] )
                 } else {
                     ss << "(" << ch_graph[s.to].id << "," << ch_graph[s.from].id << "," << ch_graph[s.contracted].id << "," << s.cost << ",2)";
                 }
-                conn.exec( "INSERT INTO " + contraction_out_schema + ".query_graph (node_inf, node_sup, contracted_id, weight, constraints) VALUES " + ss.str() );
+                conn->exec( "INSERT INTO " + contraction_out_schema + ".query_graph (node_inf, node_sup, contracted_id, weight, constraints) VALUES " + ss.str() );
             }
-            conn.exec( "COMMIT" );
+            conn->exec( "COMMIT" );
+        }
+
+        if ( !out_file.empty() ) {
+            std::cout << "* Writing contraction to " << out_file << std::endl;
+            for ( const Shortcut& s : shortcuts ) {
+                contracted_edges.push_back( { uint32_t( s.from ), uint32_t( s.to ), uint32_t( s.cost ), uint32_t( s.contracted ), 0 } );
+            }
+            std::unique_ptr<RoutingData> rd = ch_routing_data_from_contraction( order_id.size(), contracted_edges, std::vector<db_id_t>( order_id ) );
+            // keep only pedestrian, as the contraction is done on pedestrian sections
+            RoutingData::TransportModes modes;
+            auto mit = graph.transport_modes().find( TransportModeWalking );
+            if ( mit != graph.transport_modes().end() ) {
+                modes[TransportModeWalking] = mit->second;
+            }
+            rd->set_transport_modes( modes );
+            dump_routing_data( rd.get(), out_file, progression );
         }
     }
 }
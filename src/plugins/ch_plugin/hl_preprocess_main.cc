@@ -0,0 +1,84 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *   Copyright (C) 2015 Mappy <dt.lbs.route@mappy.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hub_label_routing_data.hh"
+#include "routing_data.hh"
+#include "utils/timer.hh"
+
+#include <string>
+#include <algorithm>
+#include <boost/program_options.hpp>
+
+using namespace Tempus;
+
+int main( int argc, char *argv[] )
+{
+    using namespace std;
+
+    std::string db_options = "dbname=tempus_test_db";
+    std::string ch_schema = "ch";
+    std::string in_file;
+    std::string out_file = "hub_labels.dump";
+
+    namespace po = boost::program_options;
+    po::options_description desc( "Allowed options" );
+    desc.add_options()
+        ( "help", "produce help message" )
+        ( "db,d", po::value<string>(&db_options), "set database connection options" )
+        ( "ch_schema,s", po::value<string>(&ch_schema), "set database schema of the CH graph" )
+        ( "in_file,L", po::value<string>(&in_file), "set the name of the dump file where the CH graph is located" )
+        ( "out_file,o", po::value<string>(&out_file), "set the name of the output dump file" )
+        ;
+
+    po::variables_map vm;
+    po::store( po::parse_command_line( argc, argv, desc ), vm );
+    po::notify( vm );
+
+    if ( vm.count( "help" ) ) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    // the CH data are loaded here rather than by load_routing_data, since the hub label data take their ownership
+    TextProgression progression;
+    VariantMap options;
+    options["ch/schema"] = Variant::from_string( ch_schema );
+    const RoutingDataBuilder* builder = RoutingDataBuilderRegistry::instance().builder( "ch_graph" );
+    std::unique_ptr<RoutingData> data = in_file.empty() ? builder->pg_import( db_options, progression, options )
+        : builder->file_import( in_file, progression, options );
+    std::unique_ptr<CHRoutingData> ch_data( static_cast<CHRoutingData*>( data.release() ) );
+
+    std::cout << "* Computing hub labels" << std::endl;
+    Timer timer;
+    std::unique_ptr<HubLabels> labels = build_hub_labels( ch_data->ch_query() );
+    std::cout << "done in " << timer.elapsed() << "s" << std::endl;
+
+    uint64_t num_entries = 0;
+    for ( uint32_t v = 0; v < labels->num_vertices(); v++ ) {
+        num_entries += labels->label( v, CHDirection::Forward ).size() + labels->label( v, CHDirection::Backward ).size();
+    }
+    std::cout << labels->num_vertices() << " vertices, " << double( num_entries ) / std::max( labels->num_vertices(), 1u ) / 2
+              << " hubs per label on average, " << labels->size() << " bytes" << std::endl;
+
+    std::cout << "* Writing " << out_file << std::endl;
+    HubLabelRoutingData rd( std::move( ch_data ), std::move( labels ) );
+    dump_routing_data( &rd, out_file, progression );
+
+    return 0;
+}
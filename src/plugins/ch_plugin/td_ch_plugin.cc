@@ -0,0 +1,129 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *   Copyright (C) 2015 Mappy <dt.lbs.route@mappy.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "td_ch_plugin.hh"
+#include "td_ch_query.hh"
+#include "plugin_factory.hh"
+
+#ifdef _WIN32
+#pragma warning(push, 0)
+#endif
+#include <boost/format.hpp>
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+#include "utils/timer.hh"
+#include "utils/graph_db_link.hh"
+
+namespace Tempus {
+
+const Plugin::OptionDescriptionList TDCHPlugin::option_descriptions()
+{
+    Plugin::OptionDescriptionList odl;
+    return odl;
+}
+
+const Plugin::Capabilities TDCHPlugin::plugin_capabilities()
+{
+    Plugin::Capabilities caps;
+    caps.optimization_criteria().push_back( CostId::CostDuration );
+    caps.set_depart_after( true );
+    return caps;
+}
+
+TDCHPlugin::TDCHPlugin( ProgressionCallback& progression, const VariantMap& options ) : Plugin( "td_ch_plugin", options )
+{
+    // load graph
+    const RoutingData* rd = use_routing_data( "td_ch_graph", progression, options );
+    rd_ = dynamic_cast<const TDCHRoutingData*>( rd );
+    if ( rd_ == nullptr ) {
+        throw std::runtime_error( "Problem loading the time-dependent CH routing data" );
+    }
+}
+
+class TDCHPluginRequest : public PluginRequest
+{
+private:
+    const TDCHRoutingData& rd_;
+public:
+    TDCHPluginRequest( const TDCHPlugin* parent, const VariantMap& options, const TDCHRoutingData& rd )
+        : PluginRequest( parent, options ), rd_( rd )
+    {}
+
+    std::unique_ptr<Result> process( const Request& request ) override
+    {
+        Timer timer;
+
+        boost::optional<CHVertex> origin = rd_.vertex_from_id( request.origin() );
+        boost::optional<CHVertex> destination = rd_.vertex_from_id( request.destination() );
+
+        if ( !origin ) {
+            throw std::runtime_error( (boost::format("Can't find vertex of ID %1%") % request.origin()).str() );
+        }
+        if ( !destination ) {
+            throw std::runtime_error( (boost::format("Can't find vertex of ID %1%") % request.destination()).str() );
+        }
+
+        // departure time, in minutes since midnight
+        const DateTime& dt = request.steps()[1].constraint().date_time();
+        const float departure = dt.time_of_day().total_seconds() / 60.0;
+
+        size_t iterations = 0;
+        std::vector<TDCHPathStep> path = td_ch_query( rd_, origin.get(), destination.get(), departure, iterations, deadline() );
+
+        metrics_[ "time_s" ] = Variant::from_float( timer.elapsed() );
+        metrics_[ "iterations" ] = Variant::from_int( iterations );
+
+        if ( path.empty() && origin.get() != destination.get() ) {
+            throw std::runtime_error( "No path found !" );
+        }
+
+        std::unique_ptr<Result> result( new Result() );
+        result->push_back( Roadmap() );
+        Roadmap& roadmap = result->back();
+
+        roadmap.set_starting_date_time( dt );
+
+        std::auto_ptr<Roadmap::Step> step;
+        for ( const TDCHPathStep& s : path ) {
+            step.reset( new Roadmap::RoadStep() );
+            step->set_cost( CostId::CostDuration, s.duration );
+            step->set_transport_mode( TransportModePrivateCar );
+            Roadmap::RoadStep* rstep = static_cast<Roadmap::RoadStep*>( step.get() );
+            rstep->set_road_edge_id( s.db_id );
+            roadmap.add_step( step );
+        }
+
+        Db::PooledConnection pooled_connection( plugin_->db_options() );
+        Db::Connection& connection = *pooled_connection;
+        fill_roadmap_from_db( roadmap.begin(), roadmap.end(), connection );
+        return std::move( result );
+    }
+};
+
+
+std::unique_ptr<PluginRequest> TDCHPlugin::request( const VariantMap& options ) const
+{
+    return std::unique_ptr<PluginRequest>( new TDCHPluginRequest( this, options, *rd_ ) );
+}
+
+} // namespace Tempus
+
+DECLARE_TEMPUS_PLUGIN( "td_ch_plugin", Tempus::TDCHPlugin )
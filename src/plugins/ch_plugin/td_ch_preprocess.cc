@@ -0,0 +1,305 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *   Copyright (C) 2015 Mappy <dt.lbs.route@mappy.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "common.hh"
+#include "td_ch_preprocess.hh"
+#include "ch_preprocess.hh"
+#include "utils/timer.hh"
+
+#include <queue>
+#include <limits>
+
+using namespace Tempus;
+using namespace std;
+
+namespace
+{
+
+// Maximum number of vertices settled by a witness search
+const size_t WITNESS_SETTLED_LIMIT = 1000;
+
+struct TDArcData
+{
+    TravelTimeFunction ttf;
+    db_id_t db_id;
+    vector<uint32_t> middle_nodes;
+    boost::optional<TravelTimeFunction> original_ttf;
+};
+
+struct TDArc
+{
+    uint32_t other;
+    // index in the arc data array
+    uint32_t data;
+};
+
+///
+/// Graph updated during the contraction
+/// Contracted vertices are removed from adjacency lists
+class TDContractionGraph
+{
+public:
+    TDContractionGraph( uint32_t n ) : out_( n ), in_( n ) {}
+
+    const vector<TDArc>& out_arcs( uint32_t v ) const { return out_[v]; }
+    const vector<TDArc>& in_arcs( uint32_t v ) const { return in_[v]; }
+
+    TDArcData& data( const TDArc& a ) { return data_[a.data]; }
+    const TDArcData& data( const TDArc& a ) const { return data_[a.data]; }
+
+    boost::optional<TDArc> arc( uint32_t u, uint32_t v ) const
+    {
+        for ( const TDArc& a : out_[u] ) {
+            if ( a.other == v ) {
+                return a;
+            }
+        }
+        return boost::optional<TDArc>();
+    }
+
+    void add_arc( uint32_t u, uint32_t v, TDArcData&& d )
+    {
+        uint32_t idx = data_.size();
+        data_.emplace_back( std::move( d ) );
+        out_[u].push_back( { v, idx } );
+        in_[v].push_back( { u, idx } );
+    }
+
+    ///
+    /// Remove every arc to and from v
+    void remove_vertex( uint32_t v )
+    {
+        for ( const TDArc& a : out_[v] ) {
+            auto& l = in_[a.other];
+            l.erase( std::remove_if( l.begin(), l.end(), [v]( const TDArc& b ) { return b.other == v; } ), l.end() );
+        }
+        for ( const TDArc& a : in_[v] ) {
+            auto& l = out_[a.other];
+            l.erase( std::remove_if( l.begin(), l.end(), [v]( const TDArc& b ) { return b.other == v; } ), l.end() );
+        }
+        vector<TDArc>().swap( out_[v] );
+        vector<TDArc>().swap( in_[v] );
+    }
+
+    uint32_t num_vertices() const { return out_.size(); }
+
+private:
+    vector<vector<TDArc>> out_;
+    vector<vector<TDArc>> in_;
+    vector<TDArcData> data_;
+};
+
+///
+/// Dijkstra on upper bounds of travel times, used to find witness paths
+class UpperBoundWitnessSearch
+{
+public:
+    UpperBoundWitnessSearch( uint32_t n ) : dist_( n, numeric_limits<float>::max() ) {}
+
+    ///
+    /// Compute upper bounds of travel times from source, ignoring the contracted vertex
+    /// Results are available by dist() until the next call
+    void run( const TDContractionGraph& graph, uint32_t source, uint32_t contracted, float cutoff )
+    {
+        for ( uint32_t v : touched_ ) {
+            dist_[v] = numeric_limits<float>::max();
+        }
+        touched_.clear();
+
+        typedef pair<float, uint32_t> QueueElement;
+        priority_queue<QueueElement, vector<QueueElement>, greater<QueueElement>> queue;
+        dist_[source] = 0.0;
+        touched_.push_back( source );
+        queue.push( make_pair( 0.0, source ) );
+        size_t settled = 0;
+        while ( !queue.empty() && settled < WITNESS_SETTLED_LIMIT ) {
+            float d = queue.top().first;
+            uint32_t u = queue.top().second;
+            queue.pop();
+            if ( d > dist_[u] ) {
+                continue;
+            }
+            if ( d > cutoff ) {
+                break;
+            }
+            settled++;
+            for ( const TDArc& a : graph.out_arcs( u ) ) {
+                if ( a.other == contracted ) {
+                    continue;
+                }
+                float nd = d + graph.data( a ).ttf.max();
+                if ( nd < dist_[a.other] ) {
+                    if ( dist_[a.other] == numeric_limits<float>::max() ) {
+                        touched_.push_back( a.other );
+                    }
+                    dist_[a.other] = nd;
+                    queue.push( make_pair( nd, a.other ) );
+                }
+            }
+        }
+    }
+
+    float dist( uint32_t v ) const { return dist_[v]; }
+
+private:
+    vector<float> dist_;
+    vector<uint32_t> touched_;
+};
+
+}
+
+namespace Tempus
+{
+
+TDCHContraction td_contract_graph( uint32_t num_vertices, const std::vector<TDCHInputEdge>& edges, std::function<db_id_t(uint32_t)> node_id )
+{
+    TDCHContraction r;
+
+    //
+    // Node ordering, based on lower bounds
+    {
+        cout << "Computing node ordering on lower bounds" << endl;
+        CHGraph graph;
+        for ( uint32_t v = 0; v < num_vertices; v++ ) {
+            CHVertex nv = add_vertex( graph );
+            graph[nv].id = node_id( v );
+        }
+        for ( const TDCHInputEdge& e : edges ) {
+            // weights are stored in fixed point (1/100s)
+            TCost w = std::max( int( e.ttf.min() * 6000.0 ), 1 );
+            bool found = false;
+            CHEdge ce;
+            boost::tie( ce, found ) = edge( e.source, e.target, graph );
+            if ( !found ) {
+                boost::tie( ce, found ) = add_edge( e.source, e.target, graph );
+                graph[ce].weight = w;
+            }
+            else {
+                graph[ce].weight = std::min( graph[ce].weight, w );
+            }
+        }
+        vector<CHVertex> ordered = order_graph( graph, [&graph]( CHVertex v ) { return graph[v].id; } );
+        r.order.assign( ordered.begin(), ordered.end() );
+    }
+
+    vector<uint32_t> rank( num_vertices );
+    for ( uint32_t i = 0; i < r.order.size(); i++ ) {
+        rank[r.order[i]] = i;
+    }
+
+    //
+    // Contraction
+    TDContractionGraph graph( num_vertices );
+    for ( const TDCHInputEdge& e : edges ) {
+        if ( e.source == e.target ) {
+            continue;
+        }
+        boost::optional<TDArc> a = graph.arc( e.source, e.target );
+        if ( a ) {
+            // parallel edges: their profiles may cross, the lower envelope is kept
+            // along with the road section that is the fastest at best
+            if ( e.ttf.min() < graph.data( *a ).ttf.min() ) {
+                graph.data( *a ).db_id = e.db_id;
+            }
+            graph.data( *a ).ttf = graph.data( *a ).ttf.merge( e.ttf );
+            continue;
+        }
+        graph.add_arc( e.source, e.target, { e.ttf, e.db_id, {}, boost::none } );
+    }
+
+    Timer t;
+    UpperBoundWitnessSearch witness( num_vertices );
+    size_t num_shortcuts = 0;
+    for ( uint32_t i = 0; i < r.order.size(); i++ ) {
+        uint32_t v = r.order[i];
+        if ( i % 10000 == 0 ) {
+            cout << "Contracting nodes " << i << "... [elapsed=" << t.elapsed_ms() << "ms, shortcuts=" << num_shortcuts << "]" << endl;
+        }
+
+        // the remaining arcs of v are part of the final graph
+        for ( const TDArc& a : graph.out_arcs( v ) ) {
+            const TDArcData& d = graph.data( a );
+            r.edges.push_back( { i, rank[a.other], d.ttf, d.db_id, {}, d.original_ttf } );
+            for ( uint32_t m : d.middle_nodes ) {
+                r.edges.back().middle_nodes.push_back( rank[m] );
+            }
+        }
+        for ( const TDArc& a : graph.in_arcs( v ) ) {
+            const TDArcData& d = graph.data( a );
+            r.edges.push_back( { rank[a.other], i, d.ttf, d.db_id, {}, d.original_ttf } );
+            for ( uint32_t m : d.middle_nodes ) {
+                r.edges.back().middle_nodes.push_back( rank[m] );
+            }
+        }
+
+        // copy, since the graph will be modified
+        const vector<TDArc> in_arcs = graph.in_arcs( v );
+        const vector<TDArc> out_arcs = graph.out_arcs( v );
+        for ( const TDArc& uv : in_arcs ) {
+            uint32_t u = uv.other;
+            vector<pair<uint32_t, TravelTimeFunction>> vias;
+            float cutoff = 0.0;
+            for ( const TDArc& vw : out_arcs ) {
+                if ( vw.other == u ) {
+                    continue;
+                }
+                vias.push_back( make_pair( vw.other, graph.data( uv ).ttf.link( graph.data( vw ).ttf ) ) );
+                cutoff = std::max( cutoff, vias.back().second.min() );
+            }
+            if ( vias.empty() ) {
+                continue;
+            }
+
+            witness.run( graph, u, v, cutoff );
+
+            for ( auto& p : vias ) {
+                uint32_t w = p.first;
+                TravelTimeFunction& via = p.second;
+                if ( witness.dist( w ) <= via.min() ) {
+                    // there is always a path at least as fast as u->v->w
+                    continue;
+                }
+                boost::optional<TDArc> uw = graph.arc( u, w );
+                if ( uw ) {
+                    TDArcData& d = graph.data( *uw );
+                    if ( d.ttf.dominates( via ) ) {
+                        continue;
+                    }
+                    if ( d.db_id != 0 && d.middle_nodes.empty() ) {
+                        // keep the travel time function of the original road section
+                        d.original_ttf = d.ttf;
+                    }
+                    d.ttf = d.ttf.merge( via );
+                    d.middle_nodes.push_back( v );
+                }
+                else {
+                    graph.add_arc( u, w, { via, 0, { v }, boost::none } );
+                }
+                num_shortcuts++;
+            }
+        }
+
+        graph.remove_vertex( v );
+    }
+    cout << "Contracted entire graph in " << t.elapsed_ms() << "ms, " << num_shortcuts << " shortcuts." << endl;
+
+    return r;
+}
+
+}
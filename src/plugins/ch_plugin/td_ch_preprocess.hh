@@ -0,0 +1,88 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *   Copyright (C) 2015 Mappy <dt.lbs.route@mappy.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef TEMPUS_TD_CH_PREPROCESS_HH
+#define TEMPUS_TD_CH_PREPROCESS_HH
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <boost/optional.hpp>
+
+#include "base.hh"
+#include "travel_time_function.hh"
+
+namespace Tempus
+{
+
+class TDCHRoutingData;
+
+///
+/// An edge of the road graph with its travel time function
+struct TDCHInputEdge
+{
+    uint32_t source;
+    uint32_t target;
+    db_id_t db_id;
+    TravelTimeFunction ttf;
+};
+
+///
+/// An edge of the resulting CH graph.
+/// Vertices are given by their CH order
+struct TDCHOutputEdge
+{
+    uint32_t source;
+    uint32_t target;
+    TravelTimeFunction ttf;
+    /// road section id, 0 for a pure shortcut
+    db_id_t db_id;
+    /// candidate middle nodes (CH order) for a shortcut
+    std::vector<uint32_t> middle_nodes;
+    /// travel time function of the original road section, when it has been merged with a shortcut
+    boost::optional<TravelTimeFunction> original_ttf;
+};
+
+struct TDCHContraction
+{
+    /// CH order -> input vertex
+    std::vector<uint32_t> order;
+    std::vector<TDCHOutputEdge> edges;
+};
+
+///
+/// Time-dependent contraction
+/// The node ordering is computed on the lower bounds of the travel time functions (see order_graph())
+/// The contraction then creates shortcuts carrying travel time functions. A witness search on upper bounds
+/// is used to avoid shortcuts that are never on a shortest path.
+/// \param[in] num_vertices Number of vertices of the input graph
+/// \param[in] edges The input edges
+/// \param[in] node_id A function that maps a vertex to its id
+TDCHContraction td_contract_graph( uint32_t num_vertices, const std::vector<TDCHInputEdge>& edges, std::function<db_id_t(uint32_t)> node_id );
+
+///
+/// Build the time-dependent CH query graph out of a contraction
+/// \param[in] contraction The result of td_contract_graph()
+/// \param[in] node_id A function that maps a vertex of the input graph to its id
+/// Defined apart (td_ch_query_graph.cc), since the types of the CH query graph conflict with those of ch_preprocess.hh
+std::unique_ptr<TDCHRoutingData> td_ch_routing_data( const TDCHContraction& contraction, std::function<db_id_t(uint32_t)> node_id );
+
+}
+
+#endif
@@ -0,0 +1,245 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *   Copyright (C) 2015 Mappy <dt.lbs.route@mappy.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "td_ch_preprocess.hh"
+#include "td_ch_routing_data.hh"
+#include "routing_data.hh"
+#include "multimodal_graph.hh"
+#include "db.hh"
+
+#include <string>
+#include <algorithm>
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+
+using namespace Tempus;
+
+namespace
+{
+
+// Speed used when no speed limit is available (km/h)
+const float DEFAULT_CAR_SPEED = 50.0;
+
+struct SpeedPeriod
+{
+    float end;
+    // km/h
+    float speed;
+};
+
+// begin time -> period
+typedef std::map<float, SpeedPeriod> DailyProfile;
+
+///
+/// Travel time function of a road section of the given length, driven with a piecewise constant speed
+/// Breakpoints are the beginning of each period and the departure times that lead to an arrival
+/// at the beginning of a period
+TravelTimeFunction travel_time_function_from_profile( float length, const DailyProfile& profile, float default_speed )
+{
+    const float P = TravelTimeFunction::Period;
+
+    // speed changes
+    std::vector<float> b;
+    for ( const auto& p : profile ) {
+        b.push_back( p.first );
+        b.push_back( std::fmod( p.second.end, P ) );
+    }
+    std::sort( b.begin(), b.end() );
+    b.erase( std::unique( b.begin(), b.end() ), b.end() );
+
+    // speed in m/min at time t
+    auto speed_at = [&]( float t ) {
+        t = std::fmod( t, P );
+        auto it = profile.upper_bound( t );
+        if ( it != profile.begin() ) {
+            it--;
+            if ( t < it->second.end ) {
+                return it->second.speed * 1000.0f / 60.0f;
+            }
+        }
+        return default_speed * 1000.0f / 60.0f;
+    };
+    // next speed change strictly after t
+    auto next_change = [&]( float t ) {
+        float day = std::floor( t / P ) * P;
+        auto it = std::upper_bound( b.begin(), b.end(), t - day );
+        return it == b.end() ? day + P + b[0] : day + *it;
+    };
+    // last speed change strictly before t
+    auto previous_change = [&]( float t ) {
+        float day = std::floor( t / P ) * P;
+        auto it = std::lower_bound( b.begin(), b.end(), t - day );
+        return it == b.begin() ? day - P + b.back() : day + *(it-1);
+    };
+
+    auto travel_time = [&]( float t ) {
+        float l = length;
+        float cur = t;
+        for ( ;; ) {
+            float v = speed_at( cur );
+            float e = next_change( cur );
+            if ( l <= v * ( e - cur ) ) {
+                return cur + l / v - t;
+            }
+            l -= v * ( e - cur );
+            cur = e;
+        }
+    };
+    // departure time to arrive at t
+    auto departure_for = [&]( float t ) {
+        float l = length;
+        float cur = t;
+        for ( ;; ) {
+            float s = previous_change( cur );
+            float v = speed_at( s );
+            if ( l <= v * ( cur - s ) ) {
+                return cur - l / v;
+            }
+            l -= v * ( cur - s );
+            cur = s;
+        }
+    };
+
+    if ( b.empty() ) {
+        return TravelTimeFunction( length / ( default_speed * 1000.0f / 60.0f ) );
+    }
+
+    std::vector<float> times;
+    for ( float t : b ) {
+        times.push_back( t );
+        float d = std::fmod( departure_for( t ), P );
+        times.push_back( d < 0 ? d + P : d );
+    }
+    std::sort( times.begin(), times.end() );
+    times.erase( std::unique( times.begin(), times.end() ), times.end() );
+
+    std::vector<TravelTimeFunction::Point> points;
+    for ( float t : times ) {
+        points.push_back( { t, travel_time( t ) } );
+    }
+    return TravelTimeFunction( std::move( points ) );
+}
+
+}
+
+int main( int argc, char *argv[] )
+{
+    using namespace std;
+
+    bool use_speed_profiles = true;
+
+    std::string db_options = "dbname=tempus_test_db";
+    std::string in_schema = "tempus";
+    std::string in_file;
+    std::string out_file = "td_ch_graph.dump";
+
+    namespace po = boost::program_options;
+    po::options_description desc( "Allowed options" );
+    desc.add_options()
+        ( "help", "produce help message" )
+        ( "db,d", po::value<string>(&db_options), "set database connection options" )
+        ( "in_schema,s", po::value<string>(&in_schema), "set database schema for the input graph" )
+        ( "in_file,L", po::value<string>(&in_file), "set the name of the dump file where the input graph is located" )
+        ( "out_file,o", po::value<string>(&out_file), "set the name of the output dump file" )
+        ( "no-speed-profiles", "do not use speed profiles, only speed limits" )
+        ;
+
+    po::variables_map vm;
+    po::store( po::parse_command_line( argc, argv, desc ), vm );
+    po::notify( vm );
+
+    if ( vm.count( "help" ) ) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    if ( vm.count( "no-speed-profiles" ) ) {
+        use_speed_profiles = false;
+    }
+
+    TextProgression progression;
+    VariantMap options;
+    options["db/options"] = Variant::from_string( db_options );
+    options["db/schema"] = Variant::from_string( in_schema );
+    if ( !in_file.empty() ) {
+        options["from_file"] = Variant::from_string( in_file );
+    }
+    const RoutingData* data = load_routing_data( "multimodal_graph", progression, options );
+
+    const Multimodal::Graph& graph = *dynamic_cast<const Multimodal::Graph*>(data);
+
+    const Road::Graph& road_graph = graph.road();
+
+    //
+    // Speed profiles of cars
+    std::map<db_id_t, DailyProfile> profiles;
+    if ( use_speed_profiles ) {
+        std::cout << "* Loading speed profiles" << std::endl;
+        Db::Connection conn( db_options );
+        Db::ResultIterator res_it = conn.exec_it( (boost::format( "SELECT road_section_id, begin_time, end_time, average_speed FROM\n"
+                                                                  "%1%.road_section_speed as ss,\n"
+                                                                  "%1%.road_daily_profile as p\n"
+                                                                  "WHERE\n"
+                                                                  "p.profile_id = ss.profile_id AND p.speed_rule = %2%" ) % in_schema % int(SpeedRuleCar)).str() );
+        Db::ResultIterator it_end;
+        for ( ; res_it != it_end; res_it++ ) {
+            Db::RowValue res_i = *res_it;
+            db_id_t id = res_i[0].as<db_id_t>();
+            float begin = res_i[1].as<float>();
+            profiles[id][begin] = { res_i[2].as<float>(), res_i[3].as<float>() };
+        }
+        std::cout << profiles.size() << " road sections with a speed profile" << std::endl;
+    }
+
+    //
+    // Travel time functions of road sections
+    std::cout << "* Computing travel time functions" << std::endl;
+    std::vector<TDCHInputEdge> input_edges;
+    for ( Road::Edge e : pair_range( edges( road_graph ) ) ) {
+        const Road::Section& section = road_graph[e];
+        if ( (section.traffic_rules() & TrafficRuleCar) == 0 ) {
+            continue;
+        }
+        float speed_limit = section.car_speed_limit() > 0 ? section.car_speed_limit() : DEFAULT_CAR_SPEED;
+        auto pit = profiles.find( section.db_id() );
+        TravelTimeFunction ttf = pit == profiles.end()
+            ? TravelTimeFunction( section.length() / ( speed_limit * 1000.0f / 60.0f ) )
+            : travel_time_function_from_profile( section.length(), pit->second, speed_limit );
+        input_edges.push_back( { uint32_t( source( e, road_graph ) ), uint32_t( target( e, road_graph ) ), section.db_id(), ttf } );
+    }
+
+    const uint32_t n = num_vertices( road_graph );
+    TDCHContraction contraction = td_contract_graph( n, input_edges, [&road_graph]( uint32_t v ) { return road_graph[v].db_id(); } );
+
+    std::cout << "* Building the query graph" << std::endl;
+    std::unique_ptr<TDCHRoutingData> rd = td_ch_routing_data( contraction, [&road_graph]( uint32_t v ) { return road_graph[v].db_id(); } );
+
+    // keep only the private car, travel time functions are built on car sections
+    RoutingData::TransportModes modes;
+    auto mit = graph.transport_modes().find( TransportModePrivateCar );
+    if ( mit != graph.transport_modes().end() ) {
+        modes[TransportModePrivateCar] = mit->second;
+    }
+    rd->set_transport_modes( modes );
+
+    std::cout << "* Writing " << out_file << std::endl;
+    dump_routing_data( rd.get(), out_file, progression );
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *   Copyright (C) 2015 Mappy <dt.lbs.route@mappy.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "td_ch_preprocess.hh"
+#include "td_ch_routing_data.hh"
+
+#include <algorithm>
+#include <tuple>
+
+namespace Tempus
+{
+
+std::unique_ptr<TDCHRoutingData> td_ch_routing_data( const TDCHContraction& contraction, std::function<db_id_t(uint32_t)> node_id )
+{
+    const uint32_t n = contraction.order.size();
+    std::vector<TravelTimeFunction> ttfs;
+    std::vector<TDCHShortcut> shortcuts;
+    // (lower vertex, upper vertex), is downward, property
+    struct QueryEdge
+    {
+        std::pair<uint32_t, uint32_t> vertices;
+        bool downward;
+        TDCHEdgeProperty property;
+    };
+    std::vector<QueryEdge> query_edges;
+    for ( const TDCHOutputEdge& e : contraction.edges ) {
+        TDCHEdgeProperty p;
+        p.ttf = ttfs.size();
+        ttfs.push_back( e.ttf );
+        p.db_id = e.db_id;
+        p.shortcut = TDCHEdgeProperty::NoShortcut;
+        if ( !e.middle_nodes.empty() ) {
+            p.shortcut = shortcuts.size();
+            TDCHShortcut s;
+            s.middle_nodes.assign( e.middle_nodes.begin(), e.middle_nodes.end() );
+            if ( e.original_ttf ) {
+                s.original_ttf = ttfs.size();
+                ttfs.push_back( *e.original_ttf );
+            }
+            shortcuts.push_back( s );
+        }
+        if ( e.source < e.target ) {
+            query_edges.push_back( { std::make_pair( e.source, e.target ), false, p } );
+        }
+        else {
+            query_edges.push_back( { std::make_pair( e.target, e.source ), true, p } );
+        }
+    }
+    std::sort( query_edges.begin(), query_edges.end(), []( const QueryEdge& a, const QueryEdge& b ) {
+            return std::tie( a.vertices.first, a.downward, a.vertices.second ) < std::tie( b.vertices.first, b.downward, b.vertices.second );
+        });
+
+    std::vector<std::pair<uint32_t, uint32_t>> targets;
+    std::vector<TDCHEdgeProperty> properties;
+    std::vector<uint32_t> up_degrees( n );
+    for ( const QueryEdge& e : query_edges ) {
+        targets.push_back( e.vertices );
+        properties.push_back( e.property );
+        if ( !e.downward ) {
+            up_degrees[e.vertices.first]++;
+        }
+    }
+    std::unique_ptr<TDCHQuery> query( new TDCHQuery( targets.begin(), targets.end(), n, up_degrees.begin(), properties.begin() ) );
+
+    std::vector<db_id_t> ids( n );
+    for ( uint32_t i = 0; i < n; i++ ) {
+        ids[i] = node_id( contraction.order[i] );
+    }
+
+    return std::unique_ptr<TDCHRoutingData>( new TDCHRoutingData( std::move( query ), std::move( ttfs ), std::move( shortcuts ), std::move( ids ) ) );
+}
+
+}
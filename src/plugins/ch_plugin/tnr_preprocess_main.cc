@@ -0,0 +1,91 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *   Copyright (C) 2015 Mappy <dt.lbs.route@mappy.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "transit_node_routing_data.hh"
+#include "routing_data.hh"
+#include "utils/timer.hh"
+
+#include <string>
+#include <algorithm>
+#include <boost/program_options.hpp>
+
+using namespace Tempus;
+
+int main( int argc, char *argv[] )
+{
+    using namespace std;
+
+    std::string db_options = "dbname=tempus_test_db";
+    std::string ch_schema = "ch";
+    std::string in_file;
+    std::string out_file = "transit_nodes.dump";
+    uint32_t num_transit_nodes = 1000;
+
+    namespace po = boost::program_options;
+    po::options_description desc( "Allowed options" );
+    desc.add_options()
+        ( "help", "produce help message" )
+        ( "db,d", po::value<string>(&db_options), "set database connection options" )
+        ( "ch_schema,s", po::value<string>(&ch_schema), "set database schema of the CH graph" )
+        ( "in_file,L", po::value<string>(&in_file), "set the name of the dump file where the CH graph is located" )
+        ( "out_file,o", po::value<string>(&out_file), "set the name of the output dump file" )
+        ( "transit_nodes,k", po::value<uint32_t>(&num_transit_nodes), "set the number of transit nodes (highest CH vertices)" )
+        ;
+
+    po::variables_map vm;
+    po::store( po::parse_command_line( argc, argv, desc ), vm );
+    po::notify( vm );
+
+    if ( vm.count( "help" ) ) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    TextProgression progression;
+    VariantMap options;
+    options["db/options"] = Variant::from_string( db_options );
+    options["ch/schema"] = Variant::from_string( ch_schema );
+    if ( !in_file.empty() ) {
+        options["from_file"] = Variant::from_string( in_file );
+    }
+    const CHRoutingData* ch_data = dynamic_cast<const CHRoutingData*>( load_routing_data( "ch_graph", progression, options ) );
+    if ( ch_data == nullptr ) {
+        std::cerr << "Problem loading the CH graph" << std::endl;
+        return 1;
+    }
+
+    std::cout << "* Computing " << num_transit_nodes << " transit nodes" << std::endl;
+    Timer timer;
+    std::unique_ptr<TransitNodeRoutingData> tnr = build_transit_nodes( ch_data->ch_query(), num_transit_nodes );
+    std::cout << "done in " << timer.elapsed() << "s" << std::endl;
+
+    uint64_t num_access_nodes = 0;
+    for ( CHVertex v = 0; v < tnr->num_vertices(); v++ ) {
+        for ( CHDirection dir : { CHDirection::Forward, CHDirection::Backward } ) {
+            TransitNodeRoutingData::AccessNodeRange r = tnr->access_nodes( v, dir );
+            num_access_nodes += r.second - r.first;
+        }
+    }
+    std::cout << double( num_access_nodes ) / std::max( tnr->num_vertices(), 1u ) / 2 << " access nodes per vertex and direction on average" << std::endl;
+
+    std::cout << "* Writing " << out_file << std::endl;
+    dump_routing_data( tnr.get(), out_file, progression );
+
+    return 0;
+}
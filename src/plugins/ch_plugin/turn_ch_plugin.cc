@@ -0,0 +1,214 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *   Copyright (C) 2015 Mappy <dt.lbs.route@mappy.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "turn_ch_plugin.hh"
+#include "plugin_factory.hh"
+
+#ifdef _WIN32
+#pragma warning(push, 0)
+#endif
+#include <algorithm>
+#include <boost/property_map/function_property_map.hpp>
+#include <boost/format.hpp>
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+#include "config.hh"
+#include "ch_query_workspace.hh"
+#include "ch_bidirectional_search.hh"
+#include "utils/timer.hh"
+#include "utils/graph_db_link.hh"
+
+namespace Tempus {
+
+const Plugin::OptionDescriptionList TurnCHPlugin::option_descriptions()
+{
+    Plugin::OptionDescriptionList odl;
+    return odl;
+}
+
+const Plugin::Capabilities TurnCHPlugin::plugin_capabilities()
+{
+    Plugin::Capabilities caps;
+    caps.optimization_criteria().push_back( CostId::CostDuration );
+    return caps;
+}
+
+TurnCHPlugin::TurnCHPlugin( ProgressionCallback& progression, const VariantMap& options ) : Plugin( "turn_ch_plugin", options )
+{
+    // load graph
+    const RoutingData* rd = use_routing_data( "turn_ch_graph", progression, options );
+    rd_ = dynamic_cast<const TurnCHRoutingData*>( rd );
+    if ( rd_ == nullptr ) {
+        throw std::runtime_error( "Problem loading the turn-aware CH routing data" );
+    }
+}
+
+///
+/// Unpack an edge into the turns it replaces, by following the child edges of shortcuts
+template <typename OutIterator>
+void unpack_turn_edge( const TurnCHRoutingData& rd, CHQuery::EdgeIndex e, OutIterator out_it )
+{
+    if ( rd.ch_query().edge_property( e ).b.is_shortcut ) {
+        const CHEdgeOrigin& o = rd.edge_origin( e );
+        unpack_turn_edge( rd, o.child[0], out_it );
+        unpack_turn_edge( rd, o.child[1], out_it );
+    }
+    else {
+        *out_it = e;
+        out_it++;
+    }
+}
+
+///
+/// A road section of a path, with its fixed point cost, turn penalty included
+struct TurnCHPathStep
+{
+    db_id_t db_id;
+    uint32_t cost;
+};
+
+///
+/// Shortest path between two road nodes
+/// Forward seeds are the sections leaving the origin, with their own cost, backward seeds are the sections reaching the destination.
+/// Returns the road sections of the path, empty if there is no path
+std::vector<TurnCHPathStep> turn_ch_query( const TurnCHRoutingData& rd, db_id_t origin, db_id_t destination, CHQueryStatistics& stats )
+{
+    std::vector<TurnCHPathStep> path;
+
+    const TurnCHRoutingData::NodeVertexRange departures = rd.departures( origin );
+    const TurnCHRoutingData::NodeVertexRange arrivals = rd.arrivals( destination );
+    std::vector<std::pair<CHVertex, uint32_t>> origins, destinations;
+    for ( auto it = departures.first; it != departures.second; ++it ) {
+        origins.push_back( std::make_pair( it->vertex, it->cost ) );
+    }
+    for ( auto it = arrivals.first; it != arrivals.second; ++it ) {
+        destinations.push_back( std::make_pair( it->vertex, it->cost ) );
+    }
+
+    auto weight_map_fn = []( const CHQuery::edge_descriptor& e ) {
+        return uint32_t( e.property().b.cost );
+    };
+    auto weight_map = boost::make_function_property_map<CHQuery::edge_descriptor, uint32_t, decltype(weight_map_fn)>( weight_map_fn );
+    uint32_t cost = std::numeric_limits<uint32_t>::max();
+    auto ch_path = bidirectional_ch_seeded_dijkstra( rd.ch_query(), origins, destinations, weight_map, cost, ch_query_workspace<CHVertex, uint32_t>(), stats );
+    if ( cost == std::numeric_limits<uint32_t>::max() ) {
+        return path;
+    }
+
+    // the first section, on which the path starts
+    CHVertex first = 0;
+    if ( !ch_path.empty() ) {
+        first = source( ch_path.front(), rd.ch_query() );
+    }
+    else {
+        // a path made of one section, that is both a departure and an arrival
+        for ( const auto& d : origins ) {
+            if ( d.second == cost && std::find_if( destinations.begin(), destinations.end(), [&d]( const std::pair<CHVertex, uint32_t>& a ) { return a.first == d.first; } ) != destinations.end() ) {
+                first = d.first;
+                break;
+            }
+        }
+    }
+    uint32_t first_cost = std::numeric_limits<uint32_t>::max();
+    for ( const auto& d : origins ) {
+        if ( d.first == first ) {
+            first_cost = std::min( first_cost, d.second );
+        }
+    }
+    path.push_back( { rd.vertex_section( first ), first_cost } );
+
+    std::vector<CHQuery::EdgeIndex> turns;
+    for ( const CHEdge& e : ch_path ) {
+        unpack_turn_edge( rd, e.index(), std::back_inserter( turns ) );
+    }
+    for ( CHQuery::EdgeIndex idx : turns ) {
+        path.push_back( { rd.edge_origin( idx ).db_id, rd.ch_query().edge_property( idx ).b.cost } );
+    }
+    return path;
+}
+
+class TurnCHPluginRequest : public PluginRequest
+{
+private:
+    const TurnCHRoutingData& rd_;
+public:
+    TurnCHPluginRequest( const TurnCHPlugin* parent, const VariantMap& options, const TurnCHRoutingData& rd )
+        : PluginRequest( parent, options ), rd_( rd )
+    {}
+
+    std::unique_ptr<Result> process( const Request& request ) override
+    {
+        Timer timer;
+
+        if ( rd_.departures( request.origin() ).first == rd_.departures( request.origin() ).second ) {
+            throw std::runtime_error( (boost::format("Can't find vertex of ID %1%") % request.origin()).str() );
+        }
+        if ( rd_.arrivals( request.destination() ).first == rd_.arrivals( request.destination() ).second ) {
+            throw std::runtime_error( (boost::format("Can't find vertex of ID %1%") % request.destination()).str() );
+        }
+
+        CHQueryStatistics stats;
+        std::vector<TurnCHPathStep> path;
+        if ( request.origin() != request.destination() ) {
+            path = turn_ch_query( rd_, request.origin(), request.destination(), stats );
+            if ( path.empty() ) {
+                throw std::runtime_error( "No path found !" );
+            }
+        }
+
+        metrics_[ "time_s" ] = Variant::from_float( timer.elapsed() );
+        metrics_[ "settled_forward" ] = Variant::from_int( stats.settled[0] );
+        metrics_[ "settled_backward" ] = Variant::from_int( stats.settled[1] );
+        metrics_[ "stalled_forward" ] = Variant::from_int( stats.stalled[0] );
+        metrics_[ "stalled_backward" ] = Variant::from_int( stats.stalled[1] );
+
+        std::unique_ptr<Result> result( new Result() );
+        result->push_back( Roadmap() );
+        Roadmap& roadmap = result->back();
+
+        roadmap.set_starting_date_time( request.steps()[1].constraint().date_time() );
+
+        std::auto_ptr<Roadmap::Step> step;
+        for ( const TurnCHPathStep& s : path ) {
+            step.reset( new Roadmap::RoadStep() );
+            step->set_cost( CostId::CostDuration, s.cost / TurnCHRoutingData::CostPerMinute );
+            step->set_transport_mode( TransportModePrivateCar );
+            Roadmap::RoadStep* rstep = static_cast<Roadmap::RoadStep*>( step.get() );
+            rstep->set_road_edge_id( s.db_id );
+            roadmap.add_step( step );
+        }
+
+        Db::PooledConnection pooled_connection( plugin_->db_options() );
+        Db::Connection& connection = *pooled_connection;
+        fill_roadmap_from_db( roadmap.begin(), roadmap.end(), connection );
+        return std::move( result );
+    }
+};
+
+
+std::unique_ptr<PluginRequest> TurnCHPlugin::request( const VariantMap& options ) const
+{
+    return std::unique_ptr<PluginRequest>( new TurnCHPluginRequest( this, options, *rd_ ) );
+}
+
+} // namespace Tempus
+
+DECLARE_TEMPUS_PLUGIN( "turn_ch_plugin", Tempus::TurnCHPlugin )
@@ -0,0 +1,205 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *   Copyright (C) 2015 Mappy <dt.lbs.route@mappy.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "turn_ch_preprocess.hh"
+#include "ch_preprocess.hh"
+#include "automaton_lib/automaton.hh"
+
+#include <map>
+#include <cmath>
+
+using namespace Tempus;
+using namespace std;
+
+namespace
+{
+
+typedef Automaton<Road::Edge> EdgeAutomaton;
+
+///
+/// Next state of the automaton
+/// A sequence can also begin in the middle of another one, its first transition is then searched from the initial state
+EdgeAutomaton::State next_state( const EdgeAutomaton& automaton, EdgeAutomaton::State q, Road::Edge e )
+{
+    std::pair<EdgeAutomaton::State, bool> t = automaton.find_transition( q, e );
+    if ( !t.second && q != automaton.initial_state_ ) {
+        t = automaton.find_transition( automaton.initial_state_, e );
+    }
+    return t.second ? t.first : automaton.initial_state_;
+}
+
+///
+/// Penalty (in minutes) of a transition from q to q2, as in the dynamic_multi_plugin:
+/// only a new state may have a penalty, the first one that matches the traffic rules
+double transition_penalty( const EdgeAutomaton& automaton, EdgeAutomaton::State q, EdgeAutomaton::State q2, unsigned traffic_rules )
+{
+    if ( q == q2 ) {
+        return 0.0;
+    }
+    for ( const auto& p : automaton.automaton_graph_[q2].penalty_per_mode ) {
+        if ( traffic_rules & p.first ) {
+            return p.second;
+        }
+    }
+    return 0.0;
+}
+
+}
+
+namespace Tempus
+{
+
+const uint32_t TurnExpandedGraph::NoDeparture;
+
+TurnExpandedGraph turn_expanded_graph( const Road::Graph& road_graph,
+                                       const Road::Restrictions& restrictions,
+                                       unsigned traffic_rules,
+                                       std::function<uint32_t(Road::Edge)> section_cost )
+{
+    TurnExpandedGraph r;
+
+    EdgeAutomaton automaton;
+    automaton.build_graph( restrictions );
+
+    // penalties are in minutes, costs in 1/100 s
+    auto penalty_cost = []( double penalty ) {
+        return uint32_t( std::lround( penalty * 6000.0 ) );
+    };
+
+    // vertices in the initial state are indexed by road edge, the other ones are in a map
+    const uint32_t none = uint32_t(-1);
+    std::vector<uint32_t> initial_vertex( num_edges( road_graph ), none );
+    std::map<std::pair<size_t, EdgeAutomaton::State>, uint32_t> other_vertex;
+    // automaton state of each vertex
+    std::vector<EdgeAutomaton::State> vertex_state;
+    // vertices whose turns are still to be added
+    std::vector<uint32_t> stack;
+
+    auto vertex = [&]( Road::Edge e, EdgeAutomaton::State q ) {
+        const size_t idx = get( boost::edge_index, road_graph, e );
+        uint32_t* v;
+        if ( q == automaton.initial_state_ ) {
+            v = &initial_vertex[idx];
+        }
+        else {
+            v = &other_vertex.insert( std::make_pair( std::make_pair( idx, q ), none ) ).first->second;
+        }
+        if ( *v == none ) {
+            *v = r.section.size();
+            r.section.push_back( e );
+            r.departure_cost.push_back( TurnExpandedGraph::NoDeparture );
+            vertex_state.push_back( q );
+            stack.push_back( *v );
+        }
+        return *v;
+    };
+
+    auto usable = [&road_graph, traffic_rules]( Road::Edge e ) {
+        return ( road_graph[e].traffic_rules() & traffic_rules ) != 0;
+    };
+
+    // a path starts on a section from the initial state
+    for ( Road::Edge e : pair_range( edges( road_graph ) ) ) {
+        if ( !usable( e ) ) {
+            continue;
+        }
+        EdgeAutomaton::State q = next_state( automaton, automaton.initial_state_, e );
+        double penalty = transition_penalty( automaton, automaton.initial_state_, q, traffic_rules );
+        uint32_t v = vertex( e, q );
+        if ( !std::isinf( penalty ) ) {
+            r.departure_cost[v] = section_cost( e ) + penalty_cost( penalty );
+        }
+    }
+
+    // add the turns of each reachable vertex
+    while ( !stack.empty() ) {
+        uint32_t v = stack.back();
+        stack.pop_back();
+        const EdgeAutomaton::State q = vertex_state[v];
+        const Road::Edge e = r.section[v];
+        for ( Road::Edge e2 : pair_range( out_edges( target( e, road_graph ), road_graph ) ) ) {
+            if ( !usable( e2 ) ) {
+                continue;
+            }
+            EdgeAutomaton::State q2 = next_state( automaton, q, e2 );
+            double penalty = transition_penalty( automaton, q, q2, traffic_rules );
+            if ( std::isinf( penalty ) ) {
+                // forbidden turn
+                continue;
+            }
+            uint32_t w = vertex( e2, q2 );
+            r.arcs.push_back( { v, w, section_cost( e2 ) + penalty_cost( penalty ) } );
+        }
+    }
+
+    return r;
+}
+
+TurnCHContraction turn_contract_graph( uint32_t num_vertices, const std::vector<TurnCHArc>& arcs )
+{
+    TurnCHContraction r;
+
+    {
+        cout << "Computing node ordering" << endl;
+        CHGraph graph;
+        for ( uint32_t v = 0; v < num_vertices; v++ ) {
+            CHVertex nv = add_vertex( graph );
+            graph[nv].id = v;
+        }
+        for ( const TurnCHArc& a : arcs ) {
+            if ( a.source == a.target ) {
+                // a loop on a road node, never on a shortest path
+                continue;
+            }
+            CHEdge e = add_edge( a.source, a.target, graph ).first;
+            graph[e].weight = std::max( int( a.cost ), 1 );
+        }
+        vector<CHVertex> ordered = order_graph( graph, [&graph]( CHVertex v ) { return graph[v].id; } );
+        r.order.assign( ordered.begin(), ordered.end() );
+    }
+
+    vector<uint32_t> rank( num_vertices );
+    for ( uint32_t i = 0; i < r.order.size(); i++ ) {
+        rank[r.order[i]] = i;
+    }
+
+    cout << "Computing graph contraction" << endl;
+    CHGraph graph;
+    for ( uint32_t i = 0; i < num_vertices; i++ ) {
+        CHVertex nv = add_vertex( graph );
+        graph[nv].id = r.order[i];
+    }
+    for ( const TurnCHArc& a : arcs ) {
+        if ( a.source == a.target ) {
+            continue;
+        }
+        // there is at most one turn between two vertices
+        CHEdge e = add_edge( rank[a.source], rank[a.target], graph ).first;
+        graph[e].weight = std::max( int( a.cost ), 1 );
+        r.edges.push_back( { rank[a.source], rank[a.target], uint32_t( graph[e].weight ), CHContractedEdge::NoMiddle, 0 } );
+    }
+
+    for ( const Shortcut& s : contract_graph( graph ) ) {
+        r.edges.push_back( { uint32_t( s.from ), uint32_t( s.to ), uint32_t( s.cost ), uint32_t( s.contracted ), 0 } );
+    }
+
+    return r;
+}
+
+}
@@ -0,0 +1,90 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *   Copyright (C) 2015 Mappy <dt.lbs.route@mappy.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef TEMPUS_TURN_CH_PREPROCESS_HH
+#define TEMPUS_TURN_CH_PREPROCESS_HH
+
+#include <vector>
+#include <functional>
+
+#include "road_graph.hh"
+#include "ch_contracted_graph.hh"
+
+namespace Tempus
+{
+
+///
+/// A turn between two road sections, i.e. an edge of the edge-based graph
+struct TurnCHArc
+{
+    uint32_t source;
+    uint32_t target;
+    /// fixed point cost of the target section, plus the turn penalty
+    uint32_t cost;
+};
+
+///
+/// Edge-based (turn-expanded) road graph
+///
+/// A vertex is a road section, along with the state of the turn restriction automaton once it has been traversed.
+/// A road section then has several vertices if it is part of a restriction sequence.
+struct TurnExpandedGraph
+{
+    static const uint32_t NoDeparture = uint32_t(-1);
+
+    /// road section of each vertex
+    std::vector<Road::Edge> section;
+    /// cost of a path that starts on a vertex, or NoDeparture if no path can start on it
+    std::vector<uint32_t> departure_cost;
+    std::vector<TurnCHArc> arcs;
+};
+
+///
+/// Expands the road graph along the turn restrictions
+///
+/// Restrictions are followed by the automaton of the dynamic_multi_plugin. When a turn leads to a new
+/// automaton state, the penalty of this state for the given traffic rules is added to the turn. Infinite penalties
+/// are forbidden turns, that are not part of the graph.
+/// \param[in] road_graph The road graph
+/// \param[in] restrictions The turn restrictions, see import_turn_restrictions()
+/// \param[in] traffic_rules Traffic rules of the road sections to keep
+/// \param[in] section_cost Fixed point cost of a road section, in 1/100 s
+TurnExpandedGraph turn_expanded_graph( const Road::Graph& road_graph,
+                                       const Road::Restrictions& restrictions,
+                                       unsigned traffic_rules,
+                                       std::function<uint32_t(Road::Edge)> section_cost );
+
+struct TurnCHContraction
+{
+    /// CH order -> input vertex
+    std::vector<uint32_t> order;
+    /// original edges and shortcuts, vertices are given by their CH order and db_id is left to 0
+    std::vector<CHContractedEdge> edges;
+};
+
+///
+/// Contraction of an edge-based graph, with the node ordering and contraction of ch_preprocess
+/// (see order_graph() and contract_graph())
+/// \param[in] num_vertices Number of vertices of the edge-based graph
+/// \param[in] arcs The turns
+TurnCHContraction turn_contract_graph( uint32_t num_vertices, const std::vector<TurnCHArc>& arcs );
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *   Copyright (C) 2015 Mappy <dt.lbs.route@mappy.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "turn_ch_preprocess.hh"
+#include "turn_ch_routing_data.hh"
+#include "routing_data.hh"
+#include "multimodal_graph.hh"
+#include "multimodal_graph_builder.hh"
+#include "db.hh"
+
+#include <string>
+#include <algorithm>
+#include <boost/program_options.hpp>
+
+using namespace Tempus;
+
+namespace
+{
+
+// Speed used when no speed limit is available (km/h)
+const float DEFAULT_CAR_SPEED = 50.0;
+
+}
+
+int main( int argc, char *argv[] )
+{
+    using namespace std;
+
+    std::string db_options = "dbname=tempus_test_db";
+    std::string in_schema = "tempus";
+    std::string in_file;
+    std::string out_file = "turn_ch_graph.dump";
+
+    namespace po = boost::program_options;
+    po::options_description desc( "Allowed options" );
+    desc.add_options()
+        ( "help", "produce help message" )
+        ( "db,d", po::value<string>(&db_options), "set database connection options" )
+        ( "in_schema,s", po::value<string>(&in_schema), "set database schema for the input graph and the turn restrictions" )
+        ( "in_file,L", po::value<string>(&in_file), "set the name of the dump file where the input graph is located" )
+        ( "out_file,o", po::value<string>(&out_file), "set the name of the output dump file" )
+        ;
+
+    po::variables_map vm;
+    po::store( po::parse_command_line( argc, argv, desc ), vm );
+    po::notify( vm );
+
+    if ( vm.count( "help" ) ) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    TextProgression progression;
+    VariantMap options;
+    options["db/options"] = Variant::from_string( db_options );
+    options["db/schema"] = Variant::from_string( in_schema );
+    if ( !in_file.empty() ) {
+        options["from_file"] = Variant::from_string( in_file );
+    }
+    const RoutingData* data = load_routing_data( "multimodal_graph", progression, options );
+
+    const Multimodal::Graph& graph = *dynamic_cast<const Multimodal::Graph*>(data);
+
+    const Road::Graph& road_graph = graph.road();
+
+    std::cout << "* Loading turn restrictions" << std::endl;
+    Db::Connection conn( db_options );
+    Road::Restrictions restrictions = import_turn_restrictions( conn, road_graph, in_schema );
+    std::cout << restrictions.restrictions().size() << " turn restrictions" << std::endl;
+
+    //
+    // Edge-based graph
+    std::cout << "* Expanding the road graph" << std::endl;
+    auto section_cost = [&road_graph]( Road::Edge e ) {
+        const Road::Section& section = road_graph[e];
+        float speed_limit = section.car_speed_limit() > 0 ? section.car_speed_limit() : DEFAULT_CAR_SPEED;
+        // 1/100 s
+        return uint32_t( std::max( int( section.length() / ( speed_limit / 3.6f ) * 100.0f ), 1 ) );
+    };
+    TurnExpandedGraph expanded = turn_expanded_graph( road_graph, restrictions, TrafficRuleCar, section_cost );
+    const uint32_t n = expanded.section.size();
+    std::cout << n << " vertices, " << expanded.arcs.size() << " turns" << std::endl;
+
+    TurnCHContraction contraction = turn_contract_graph( n, expanded.arcs );
+
+    //
+    // Build the query graph
+    std::cout << "* Building the query graph" << std::endl;
+    for ( CHContractedEdge& e : contraction.edges ) {
+        if ( e.middle == CHContractedEdge::NoMiddle ) {
+            // a turn leads to the road section of its target
+            e.db_id = road_graph[expanded.section[contraction.order[e.target]]].db_id();
+        }
+    }
+    std::vector<CHEdgeOrigin> edge_origin;
+    std::unique_ptr<CHQuery> query = ch_query_from_contraction( n, contraction.edges, edge_origin );
+
+    std::vector<db_id_t> vertex_section( n );
+    std::vector<TurnCHNodeVertex> departures, arrivals;
+    for ( uint32_t i = 0; i < n; i++ ) {
+        const uint32_t v = contraction.order[i];
+        const Road::Edge e = expanded.section[v];
+        vertex_section[i] = road_graph[e].db_id();
+        if ( expanded.departure_cost[v] != TurnExpandedGraph::NoDeparture ) {
+            departures.push_back( { road_graph[source( e, road_graph )].db_id(), i, expanded.departure_cost[v] } );
+        }
+        arrivals.push_back( { road_graph[target( e, road_graph )].db_id(), i, 0 } );
+    }
+
+    std::cout << "* Writing " << out_file << std::endl;
+    TurnCHRoutingData rd( std::move( query ), std::move( edge_origin ), std::move( vertex_section ), std::move( departures ), std::move( arrivals ) );
+    // keep only the private car, the edge-based graph is built on car sections
+    RoutingData::TransportModes modes;
+    auto mit = graph.transport_modes().find( TransportModePrivateCar );
+    if ( mit != graph.transport_modes().end() ) {
+        modes[TransportModePrivateCar] = mit->second;
+    }
+    rd.set_transport_modes( modes );
+    dump_routing_data( &rd, out_file, progression );
+
+    return 0;
+}
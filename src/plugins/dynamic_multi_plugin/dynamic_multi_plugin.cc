@@ -61,11 +61,13 @@ public:
                                 const std::vector<Road::Vertex>& destinations,
                                 bool pvad,
                                 bool verbose,
-                                size_t& iterations) :
+                                size_t& iterations,
+                                Deadline& deadline ) :
         graph_(graph),
         pvad_(pvad),
         verbose_(verbose),
-        iterations_(iterations)
+        iterations_(iterations),
+        deadline_(deadline)
     {
         for ( size_t i = 0; i < destinations.size(); i++ ) {
             destinations_.insert(destinations[i]);
@@ -74,6 +76,8 @@ public:
 
     void examine_vertex( const Triple& t, const Graph& )
     {
+        // a search on a large multimodal graph can run for long, stop it when the request expires
+        deadline_.check();
         for ( std::set<Road::Vertex>::const_iterator it = destinations_.begin(); it != destinations_.end(); ++it ) {
             if ( t.vertex.type() == Multimodal::Vertex::Road && t.vertex.road_vertex() == *it ) {
                 TransportMode mode = graph_.transport_mode( t.mode ).get();
@@ -139,6 +143,7 @@ private:
     bool pvad_;
     bool verbose_;
     size_t& iterations_;
+    Deadline& deadline_;
 };
 
 template <class Graph>
@@ -285,7 +290,7 @@ Plugin::Capabilities DynamicMultiPlugin::plugin_capabilities()
 DynamicMultiPlugin::DynamicMultiPlugin( ProgressionCallback& progression, const VariantMap& options ) : Plugin( "dynamic_multi_plugin", options )
 {
     // load graph
-    const RoutingData* rd = load_routing_data( "multimodal_graph", progression, options );
+    const RoutingData* rd = use_routing_data( "multimodal_graph", progression, options );
     graph_ = dynamic_cast<const Multimodal::Graph*>( rd );
     if ( graph_ == nullptr ) {
         throw std::runtime_error( "Problem loading the multimodal graph" );
@@ -328,7 +333,8 @@ std::unique_ptr<Result> DynamicMultiPluginRequest::process( const Request& reque
     std::unique_ptr<Result> result( new Result );
 
     const DynamicMultiPlugin* parent = static_cast<const DynamicMultiPlugin*>( plugin_ );
-    Db::Connection db_( plugin_->db_options() );
+    Db::PooledConnection pooled_connection( plugin_->db_options() );
+    Db::Connection& db_ = *pooled_connection;
 
     const Automaton<Road::Edge>& automaton_ = parent->automaton();
 
@@ -648,7 +654,7 @@ std::unique_ptr<Result> DynamicMultiPluginRequest::process( const Request& reque
     }
 
     // we cannot use the regular visitor here, since we examine tuples instead of vertices
-    DestinationDetectorVisitor<Multimodal::Graph> vis( *graph_, destinations, request.steps().back().private_vehicule_at_destination(), verbose_algo_, iterations_ );
+    DestinationDetectorVisitor<Multimodal::Graph> vis( *graph_, destinations, request.steps().back().private_vehicule_at_destination(), verbose_algo_, iterations_, deadline() );
 
     bool path_found = false;
     try {
@@ -659,7 +665,7 @@ std::unique_ptr<Result> DynamicMultiPluginRequest::process( const Request& reque
             if ( reversed ) {
                 Multimodal::ReverseGraph rgraph( *graph_ );
                 EuclidianHeuristic<Multimodal::ReverseGraph> heuristic( rgraph, request.origin(), h_speed_max );
-                DestinationDetectorVisitor<Multimodal::ReverseGraph> rvis( rgraph, destinations, request.steps().back().private_vehicule_at_destination(), verbose_algo_, iterations_ );
+                DestinationDetectorVisitor<Multimodal::ReverseGraph> rvis( rgraph, destinations, request.steps().back().private_vehicule_at_destination(), verbose_algo_, iterations_, deadline() );
                 combined_ls_algorithm_no_init( rgraph, automaton_, destination_o, vertex_data_pmap, cost_calculator, request.allowed_modes(), rvis, heuristic );
             }
             else {
@@ -670,7 +676,7 @@ std::unique_ptr<Result> DynamicMultiPluginRequest::process( const Request& reque
         else {
             if ( reversed ) {
                 Multimodal::ReverseGraph rgraph( *graph_ );
-                DestinationDetectorVisitor<Multimodal::ReverseGraph> rvis( rgraph, destinations, request.steps().back().private_vehicule_at_destination(), verbose_algo_, iterations_ );
+                DestinationDetectorVisitor<Multimodal::ReverseGraph> rvis( rgraph, destinations, request.steps().back().private_vehicule_at_destination(), verbose_algo_, iterations_, deadline() );
                 combined_ls_algorithm_no_init( rgraph, automaton_, destination_o, vertex_data_pmap, cost_calculator, request.allowed_modes(), rvis, NullHeuristic() );
             }
             else {
@@ -709,8 +715,8 @@ std::unique_ptr<Result> DynamicMultiPluginRequest::process( const Request& reque
         add_roadmap( request, *result, path, /* reverse */ true );
     }
 
-    Db::Connection connection( plugin_->db_options() );
-    simple_multimodal_roadmap( *result, connection, *graph_ );
+    // the pooled connection of the request is reused, a second one from the same pool could wait forever
+    simple_multimodal_roadmap( *result, db_, *graph_ );
 
     return result;
 }
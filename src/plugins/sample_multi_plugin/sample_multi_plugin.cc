@@ -73,7 +73,7 @@ public:
     MultiPlugin( ProgressionCallback& progression, const VariantMap& options ) : Plugin( "sample_multi_plugin", options )
     {
         // load graph
-        const RoutingData* rd = load_routing_data( "multimodal_graph", progression, options );
+        const RoutingData* rd = use_routing_data( "multimodal_graph", progression, options );
         graph_ = dynamic_cast<const Multimodal::Graph*>( rd );
         if ( graph_ == nullptr ) {
             throw std::runtime_error( "Problem loading the multimodal graph" );
@@ -415,7 +415,8 @@ public:
             // convert the path to a roadmap
             add_roadmap( request, *result, path );
         }
-        Db::Connection connection( plugin_->db_options() );
+        Db::PooledConnection pooled_connection( plugin_->db_options() );
+        Db::Connection& connection = *pooled_connection;
         simple_multimodal_roadmap( *result, connection, graph );
 
         return std::move(result);
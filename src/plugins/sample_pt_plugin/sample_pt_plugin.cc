@@ -72,7 +72,7 @@ public:
 
     PtPlugin( ProgressionCallback& progression, const VariantMap& options ) : Plugin( "sample_pt_plugin", options ) {
         // load graph
-        const RoutingData* rd = load_routing_data( "multimodal_graph", progression, options );
+        const RoutingData* rd = use_routing_data( "multimodal_graph", progression, options );
         graph_ = dynamic_cast<const Multimodal::Graph*>( rd );
         if ( graph_ == nullptr ) {
             throw std::runtime_error( "Problem loading the multimodal graph" );
@@ -114,7 +114,8 @@ public:
             throw std::invalid_argument( "Unsupported optimizing criterion" );
         }
 
-        Db::Connection db( plugin_->db_options() );
+        Db::PooledConnection pooled_connection( plugin_->db_options() );
+        Db::Connection& db = *pooled_connection;
 
         auto p = *graph_.public_transports().begin();
         const PublicTransport::Graph& pt_graph = *p.second;
@@ -107,7 +107,7 @@ public:
 
     RoadPlugin( ProgressionCallback& progression, const VariantMap& options ) : Plugin( "sample_road_plugin", options ) {
         // load graph
-        const RoutingData* rd = load_routing_data( "multimodal_graph", progression, options );
+        const RoutingData* rd = use_routing_data( "multimodal_graph", progression, options );
         graph_ = dynamic_cast<const Multimodal::Graph*>( rd );
         if ( graph_ == nullptr ) {
             throw std::runtime_error( "Problem loading the multimodal graph" );
@@ -323,7 +323,8 @@ public:
         }
 
         if ( prepare_result ) {
-            Db::Connection connection( plugin_->db_options() );
+            Db::PooledConnection pooled_connection( plugin_->db_options() );
+            Db::Connection& connection = *pooled_connection;
             simple_multimodal_roadmap( *result, connection, graph_ );
         }
         return std::move( result );
@@ -514,6 +514,31 @@ def parse_results(results):
     return r
 
 
+def options_to_pson(plugin_options):
+    opt_r = []
+    plugin_options = plugin_options or {}
+    for k, v in plugin_options.iteritems():
+        tag_name = ''
+        value = str(v)
+        if isinstance(v, bool):
+            tag_name = "bool_value"
+            value = "true" if v else "false"
+        elif isinstance(v, int):
+            tag_name = "int_value"
+        elif isinstance(v, float):
+            tag_name = "float_value"
+        elif isinstance(v, str):
+            tag_name = "string_value"
+        elif isinstance(v, unicode):
+            tag_name = "string_value"
+        else:
+            raise RuntimeError("Unknown value type " + value)
+
+        opt_r.append(['option', {'name': k}, [tag_name, {'value': value}]])
+    opt_r.insert(0, 'options')
+    return opt_r
+
+
 def parse_plugin_options(xml):
     "Returns a dict of options name => OptionValue"
     options = {}
@@ -600,28 +625,7 @@ class TempusRequest:
             args['request'].append(['allowed_mode', mode])
 
         # options
-        opt_r = []
-        plugin_options = plugin_options or {}
-        for k, v in plugin_options.iteritems():
-            tag_name = ''
-            value = str(v)
-            if isinstance(v, bool):
-                tag_name = "bool_value"
-                value = "true" if v else "false"
-            elif isinstance(v, int):
-                tag_name = "int_value"
-            elif isinstance(v, float):
-                tag_name = "float_value"
-            elif isinstance(v, str):
-                tag_name = "string_value"
-            elif isinstance(v, unicode):
-                tag_name = "string_value"
-            else:
-                raise RuntimeError("Unknown value type " + value)
-
-            opt_r.append(['option', {'name': k}, [tag_name, {'value': value}]])
-        opt_r.insert(0, 'options')
-        args['options'] = opt_r
+        args['options'] = options_to_pson(plugin_options)
 
         outputs = self.wps.execute('select', args)
         for k, v in outputs.iteritems():
@@ -634,6 +638,88 @@ class TempusRequest:
         r = "<select>\n" + r + "</select>\n"
         return r
 
+    def many_to_many(self, plugin_name='ch_plugin', sources=None, targets=None):
+        """Compute the cost matrix between sources and targets (lists of Point).
+        Returns a list of rows, unreachable targets have a None cost"""
+        sources = sources or []
+        targets = targets or []
+        args = {
+            'plugin': ['plugin', {'name': plugin_name}],
+            'sources': ['sources'] + [p.to_pson() for p in sources],
+            'targets': ['targets'] + [p.to_pson() for p in targets]
+        }
+        outputs = self.wps.execute('many_to_many', args)
+        self.metrics = parse_metrics(outputs['metrics'])
+        matrix = []
+        for row in outputs['matrix']:
+            costs = [float(c.attrib['value']) for c in row]
+            matrix.append([c if c >= 0 else None for c in costs])
+        return matrix
+
+    def select_batch(
+        self,
+        plugin_name='ch_plugin',
+        plugin_options=None,
+        pairs=None,  # list of (origin Point, RequestStep)
+        allowed_transport_modes=None,
+        criteria=None,
+        roadmaps=False,
+        threads=0
+    ):
+        """Process a list of requests that share the same options, in one call.
+        Returns a list of (total costs, error message, roadmaps) tuples, one per pair.
+        Roadmaps are only returned if roadmaps is True"""
+        pairs = pairs or []
+        allowed_transport_modes = allowed_transport_modes or [1]
+        criteria = criteria or [Cost.Duration]
+        requests = ['requests', {'roadmaps': 'true' if roadmaps else 'false', 'threads': str(threads)}]
+        for origin, step in pairs:
+            request = ['request', origin.to_pson('origin')]
+            for criterion in criteria:
+                request.append(['optimizing_criterion', criterion])
+            request.append(step.to_pson())
+            for mode in allowed_transport_modes:
+                request.append(['allowed_mode', mode])
+            requests.append(request)
+        args = {
+            'plugin': ['plugin', {'name': plugin_name}],
+            'requests': requests,
+            'options': options_to_pson(plugin_options)
+        }
+        outputs = self.wps.execute('select_batch', args)
+        self.metrics = parse_metrics(outputs['metrics'])
+        results = []
+        for pair in outputs['results']:
+            costs = {}
+            pair_roadmaps = None
+            for child in pair:
+                if child.tag == 'cost':
+                    costs[int(child.attrib['type'])] = float(child.attrib['value'])
+                elif child.tag == 'results':
+                    pair_roadmaps = parse_results(child)
+            results.append((costs, pair.attrib.get('error'), pair_roadmaps))
+        return results
+
+    def server_metrics(self):
+        """Load of the server: request queue depth, rejected requests and requests running on each plugin.
+        Returns a dict of metric name -> value (as strings)"""
+        outputs = self.wps.execute('server_metrics', {})
+        return parse_metrics(outputs['metrics'])
+
+    def reload(self, plugin_name):
+        """Reload a plugin and its routing data in the background, requests are served meanwhile.
+        Returns 'started', or 'running' if a reload of this plugin is already running.
+        Its progress is reported by server_metrics()"""
+        outputs = self.wps.execute('reload', {'plugin': ['plugin', {'name': plugin_name}]})
+        return outputs['reload'].attrib['status']
+
+    def latency_metrics(self):
+        """Request counters and latency histograms by plugin and phase, in the Prometheus text format"""
+        [r, text] = self.wps.metrics()
+        if r != 200:
+            raise RuntimeError(text)
+        return text
+
     def server_state(self):
         """Retrieve current server state and return a XML string"""
         plugins = self.plugin_list()
@@ -169,6 +169,9 @@ class WPSClient:
     def describe_process(self, identifier):
         return self.conn.request('GET', 'service=wps&version=1.0.0&request=DescribeProcess&identifier=' + identifier)
 
+    def metrics(self):
+        return self.conn.request('GET', 'request=metrics')
+
     #
     # inputs: dictionary of argument_name -> xml_value
     #          if xml_value is a list, it is considered a 'complex' datum
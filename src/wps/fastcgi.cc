@@ -22,6 +22,7 @@
 #include <fstream>
 
 #include <string>
+#include <memory>
 
 #ifdef _WIN32
 #pragma warning(push, 0)
@@ -53,6 +54,12 @@
 #include "config.hh"
 #include "plugin_factory.hh"
 #include "tempus_services.hh"
+#include "request_queue.hh"
+#include "server_state.hh"
+#include "result_cache.hh"
+#ifdef TEMPUS_HTTP_SERVER
+#include "http_server.hh"
+#endif
 
 
 #define DEBUG_TRACE if(1) std::cout << " debug: "
@@ -63,39 +70,99 @@ using namespace Tempus;
 /// This is the main WPS server. It is designed to be called by a FastCGI-aware web server
 ///
 
-struct RequestThread {
-    RequestThread( int listen_socket )
-        :_listen_socket( listen_socket ) {
+///
+/// Output stream buffer that writes directly to a FastCGI stream.
+/// The FastCGI stream is itself buffered, so there is no buffer here.
+class FCGXOutputBuffer : public std::streambuf {
+public:
+    explicit FCGXOutputBuffer( FCGX_Stream* stream ) : stream_( stream ) {}
+
+protected:
+    virtual int_type overflow( int_type c ) {
+        if ( traits_type::eq_int_type( c, traits_type::eof() ) ) {
+            return traits_type::not_eof( c );
+        }
+        return FCGX_PutChar( c, stream_ ) == -1 ? traits_type::eof() : c;
     }
 
-    void operator ()( void ) const { // noexept
-        FCGX_Request request;
-        FCGX_InitRequest( &request, _listen_socket, 0 );
-        XML::init(); // must be called once per thread
+    virtual std::streamsize xsputn( const char* s, std::streamsize n ) {
+        return FCGX_PutStr( s, int( n ), stream_ ) == -1 ? 0 : n;
+    }
 
+private:
+    FCGX_Stream* stream_;
+};
+
+typedef std::unique_ptr<FCGX_Request> FCGXRequestPtr;
+typedef WPS::BoundedQueue<FCGXRequestPtr> RequestQueue;
+
+///
+/// Accepts connections and queues the requests for the workers.
+/// A request that does not fit in the queue is answered right away with a 503 status, so that a burst
+/// of requests never builds an unbounded backlog.
+struct AcceptThread {
+    AcceptThread( int listen_socket, RequestQueue& queue )
+        :_listen_socket( listen_socket ), _queue( queue ) {
+    }
+
+    void operator ()( void ) const { // noexept
         for ( ;; ) {
-            if ( FCGX_Accept_r( &request ) ) {
+            FCGXRequestPtr request( new FCGX_Request );
+            FCGX_InitRequest( request.get(), _listen_socket, 0 );
+            if ( FCGX_Accept_r( request.get() ) ) {
                 CERR << "failed to accept request\n";
-                FCGX_Finish_r( &request );
+                FCGX_Finish_r( request.get() );
+                continue;
+            }
+
+            if ( !_queue.try_push( request ) ) {
+                WPS::ServerState::instance().add_rejected_request();
+                static const std::string overloaded = "Status: 503 Server overloaded\r\n"
+                    "Retry-After: 1\r\n"
+                    "Content-type: text/html\r\n"
+                    "\r\n"
+                    "<h2>Server overloaded</h2>\n";
+                FCGX_PutStr( overloaded.c_str(), overloaded.size(), request->out );
+                FCGX_Finish_r( request.get() );
                 continue;
             }
+            WPS::ServerState::instance().set_queue_depth( _queue.size() );
+        }
+    }
+
+private:
+    const int _listen_socket;
+    RequestQueue& _queue;
+};
+
+///
+/// Worker: processes the requests of the queue
+struct RequestThread {
+    RequestThread( RequestQueue& queue )
+        :_queue( queue ) {
+    }
+
+    void operator ()( void ) const { // noexept
+        XML::init(); // must be called once per thread
+        WPS::Service::init_thread();
+
+        for ( ;; ) {
+            FCGXRequestPtr request( _queue.pop() );
+            WPS::ServerState::instance().set_queue_depth( _queue.size() );
 
 #ifdef NDEBUG
             try
 #endif
             {
-                fcgi_streambuf cin_fcgi_streambuf( request.in );
+                fcgi_streambuf cin_fcgi_streambuf( request->in );
 
-                // This causes a crash under Windows (??).
-                // We rely on a classic stringstream and FCGX_PutStr
-                // fcgi_streambuf cout_fcgi_streambuf( request.out );
-                std::ostringstream outbuf;
+                // The response is written to the FastCGI stream as it is produced.
+                // (fcgi_streambuf is not used for output, it causes a crash under Windows)
+                FCGXOutputBuffer cout_fcgi_streambuf( request->out );
 
-                WPS::Request wps_request( &cin_fcgi_streambuf, outbuf.rdbuf(), request.envp );
+                WPS::Request wps_request( &cin_fcgi_streambuf, &cout_fcgi_streambuf, request->envp );
 
                 wps_request.process();
-                const std::string& outstr = outbuf.str();
-                FCGX_PutStr( outstr.c_str(), outstr.size(), request.out );
             }
 #ifdef NDEBUG
             // only catch in release mode
@@ -104,12 +171,12 @@ struct RequestThread {
             }
 #endif
 
-            FCGX_Finish_r( &request );
+            FCGX_Finish_r( request.get() );
         }
     }
 
 private:
-    const int _listen_socket;
+    RequestQueue& _queue;
 };
 
 void add_str_option( VariantMap& options, const std::string& opt )
@@ -177,9 +244,15 @@ int main( int argc, char* argv[] )
     bool standalone = true;
     // the default TCP port to listen to
     string port_str = "9000"; // ex 9000
+    // port of the embedded HTTP server, FastCGI is used if empty
+    string http_port_str = "";
     string chdir_str = "";
     std::vector<string> plugins;
     size_t num_threads = 1;
+    size_t queue_size = 64;
+    size_t cache_mb = 0;
+    double cache_ttl = 0.0;
+    double request_timeout = 0.0;
     string dbstring = "dbname=tempus_test_db";
     string schema_name = "tempus";
     bool consistency_check = true;
@@ -205,6 +278,13 @@ int main( int argc, char* argv[] )
                     port_str = argv[++i];
                 }
             }
+#ifdef TEMPUS_HTTP_SERVER
+            else if ( arg == "--http" ) {
+                if ( argc > i+1 ) {
+                    http_port_str = argv[++i];
+                }
+            }
+#endif
             else if ( arg == "-c" ) {
                 if ( argc > i+1 ) {
                     chdir_str = argv[++i];
@@ -227,6 +307,35 @@ int main( int argc, char* argv[] )
                     num_threads = atoi( argv[++i] );
                 }
             }
+            else if ( arg == "-q" ) {
+                if ( argc > i+1 ) {
+                    queue_size = atoi( argv[++i] );
+                }
+            }
+            else if ( arg == "--plugin_limit" ) {
+                if ( argc > i+1 ) {
+                    std::string opt = argv[++i];
+                    size_t n = opt.find( '=' );
+                    if ( n != std::string::npos ) {
+                        WPS::ServerState::instance().set_plugin_limit( opt.substr( 0, n ), atoi( opt.substr( n+1 ).c_str() ) );
+                    }
+                }
+            }
+            else if ( arg == "--cache_mb" ) {
+                if ( argc > i+1 ) {
+                    cache_mb = atoi( argv[++i] );
+                }
+            }
+            else if ( arg == "--cache_ttl" ) {
+                if ( argc > i+1 ) {
+                    cache_ttl = atof( argv[++i] );
+                }
+            }
+            else if ( arg == "--request_timeout" ) {
+                if ( argc > i+1 ) {
+                    request_timeout = atof( argv[++i] );
+                }
+            }
             else if ( arg == "-d" ) {
                 if ( argc > i+1 ) {
                     dbstring = argv[++i];
@@ -294,8 +403,16 @@ int main( int argc, char* argv[] )
             else {
                 std::cout << "Options: " << endl
                           << "\t-p port_number\tstandalone mode (for use with nginx and lighttpd)" << endl
+#ifdef TEMPUS_HTTP_SERVER
+                          << "\t--http port_number\tserve HTTP/1.1 directly on this port, without FastCGI" << endl
+#endif
                           << "\t-c dir\tchange directory to dir before execution" << endl
                           << "\t-t num_threads\tnumber of request-processing threads" << endl
+                          << "\t-q queue_size\tmaximum number of requests waiting for a thread, others are rejected (default: 64)" << endl
+                          << "\t--plugin_limit plugin=n\tmaximum number of requests processed at the same time by a plugin" << endl
+                          << "\t--cache_mb n\tmemory budget of the cache of results of identical requests, in MB (default: 0, disabled)" << endl
+                          << "\t--cache_ttl s\ttime to live of a cached result, in seconds (default: 0, no expiration)" << endl
+                          << "\t--request_timeout s\tdefault maximum processing time of a request, in seconds (default: 0, none)" << endl
                           << "\t-l plugin_name\tload plugin" << endl
                           << "\t-d dbstring\tstring used to connect to pgsql" << endl
                           << "\t-s schema\tschema to use (default: tempus)" << endl
@@ -358,6 +475,10 @@ int main( int argc, char* argv[] )
     WPS::PluginListService plugin_list_service;
     WPS::SelectService select_service;
     WPS::ConstantListService constant_list_service;
+    WPS::ManyToManyService many_to_many_service;
+    WPS::SelectBatchService select_batch_service;
+    WPS::ServerMetricsService server_metrics_service;
+    WPS::ReloadService reload_service;
 
     if ( chdir_str != "" ) {
         if( chdir( chdir_str.c_str() ) ) {
@@ -379,6 +500,9 @@ int main( int argc, char* argv[] )
             options["from_file"] = Variant::from_string( load_from );
         }
         options["consistency_check"] = Variant::from_bool( consistency_check );
+        if ( request_timeout > 0 ) {
+            options["request/timeout"] = Variant::from_float( request_timeout );
+        }
 
         // load plugins
         TextProgression progression;
@@ -398,6 +522,29 @@ int main( int argc, char* argv[] )
 
     std::cout << "ready !" << std::endl;
 
+#ifdef TEMPUS_HTTP_SERVER
+    if ( !http_port_str.empty() ) {
+#ifdef NDEBUG
+        try
+#endif
+        {
+            WPS::ServerState::instance().set_queue_capacity( queue_size );
+            Tempus::ResultCache::instance().configure( cache_mb * 1024 * 1024, cache_ttl );
+
+            WPS::HttpServer server( http_port_str, num_threads, queue_size );
+            server.run();
+        }
+#ifdef NDEBUG
+        // only catch in release mode
+        catch ( std::exception& e ) {
+            std::cerr << "HTTP server error: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+#endif
+        return EXIT_SUCCESS;
+    }
+#endif
+
     int listen_socket = 0;
 
     if ( standalone ) {
@@ -413,14 +560,18 @@ int main( int argc, char* argv[] )
     try
 #endif
     {
+        RequestQueue queue( queue_size );
+        WPS::ServerState::instance().set_queue_capacity( queue_size );
+        Tempus::ResultCache::instance().configure( cache_mb * 1024 * 1024, cache_ttl );
+
         boost::thread_group pool;
 
-        for ( size_t i=0; i<num_threads-1; i++ ) {
-            pool.add_thread( new boost::thread( RequestThread( listen_socket ) ) );
+        for ( size_t i=0; i<num_threads; i++ ) {
+            pool.add_thread( new boost::thread( RequestThread( queue ) ) );
         }
 
-        RequestThread mainThread( listen_socket ); // so we use the main
-        mainThread();
+        AcceptThread acceptThread( listen_socket, queue ); // so we use the main
+        acceptThread();
         pool.join_all();
     }
 #ifdef NDEBUG
@@ -0,0 +1,696 @@
+/**
+ *   Copyright (C) 2012-2013 IFSTTAR (http://www.ifsttar.fr)
+ *   Copyright (C) 2012-2013 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+
+#include "http_server.hh"
+#include "wps_request.hh"
+#include "wps_service.hh"
+#include "xml_helper.hh"
+#include "server_state.hh"
+#include "io.hh"
+
+namespace WPS {
+
+namespace {
+/// Maximum size of the buffered data of a connection, the body of a request included
+const size_t MaxRequestSize = 64 * 1024 * 1024;
+
+/// Maximum size of the request line and headers of a request
+const size_t MaxHeaderSize = 8 * 1024;
+
+/// A connection without any activity for this time, in seconds, is closed
+const int IdleTimeout = 30;
+
+/// Idle connections are looked for with this period, in milliseconds
+const int SweepPeriod = 1000;
+
+/// Room left before the response of a worker, for the HTTP headers that replace the CGI ones
+const size_t ResponseHeadRoom = 256;
+
+typedef std::chrono::steady_clock Clock;
+
+const std::string overloaded = "Status: 503 Server overloaded\r\n"
+                               "Retry-After: 1\r\n"
+                               "Content-type: text/html\r\n"
+                               "\r\n"
+                               "<h2>Server overloaded</h2>\n";
+
+void throw_errno( const std::string& what )
+{
+    throw std::runtime_error( what + ": " + strerror( errno ) );
+}
+
+std::string reason_phrase( int status )
+{
+    switch ( status ) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 406: return "Not Acceptable";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    case 504: return "Gateway Timeout";
+    default: return "Unknown";
+    }
+}
+
+std::string error_response( int status, const std::string& msg )
+{
+    return "Status: " + boost::lexical_cast<std::string>( status ) + " " + reason_phrase( status ) + "\r\n"
+        "Content-type: text/html\r\n"
+        "\r\n"
+        "<h2>" + msg + "</h2>\n";
+}
+
+///
+/// Output stream buffer that appends to a string, so that a response is written once, in the buffer it is sent from
+class StringAppendBuf : public std::streambuf {
+public:
+    explicit StringAppendBuf( std::string& s ) : s_( s ) {}
+
+protected:
+    int_type overflow( int_type c ) override
+    {
+        if ( !traits_type::eq_int_type( c, traits_type::eof() ) ) {
+            s_.push_back( traits_type::to_char_type( c ) );
+        }
+        return traits_type::not_eof( c );
+    }
+
+    std::streamsize xsputn( const char* s, std::streamsize n ) override
+    {
+        s_.append( s, size_t( n ) );
+        return n;
+    }
+
+private:
+    std::string& s_;
+};
+}
+
+struct HttpServer::Connection {
+    explicit Connection( int a_fd ) :
+        fd( a_fd ), out_pos( 0 ), events( EPOLLIN ), registered( true ),
+        busy( false ), continue_sent( false ), closing( false ), read_closed( false ), broken( false ),
+        last_activity( Clock::now() ) {}
+
+    int fd;
+    /// Received data, not parsed yet
+    std::string in;
+    /// Data to send, from out_pos
+    std::string out;
+    size_t out_pos;
+    /// Events the connection is registered for
+    uint32_t events;
+    bool registered;
+    /// A request of this connection is being processed by a worker
+    bool busy;
+    /// "100 Continue" has been sent for the request being read
+    bool continue_sent;
+    /// The connection is closed once the output is sent
+    bool closing;
+    /// The client will not send anything more
+    bool read_closed;
+    /// Nothing can be sent anymore
+    bool broken;
+    /// Last time data has been received or sent, or a response has been completed
+    Clock::time_point last_activity;
+};
+
+HttpServer::HttpServer( const std::string& port, size_t num_threads, size_t queue_size ) :
+    listen_socket_( -1 ), epoll_fd_( -1 ), event_fd_( -1 ), queue_( queue_size )
+{
+    const int port_number = atoi( port.c_str() );
+    if ( port_number <= 0 || port_number > 65535 ) {
+        throw std::invalid_argument( "Invalid port " + port );
+    }
+
+    listen_socket_ = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if ( listen_socket_ < 0 ) {
+        throw_errno( "socket" );
+    }
+    int one = 1;
+    setsockopt( listen_socket_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one ) );
+
+    sockaddr_in address;
+    memset( &address, 0, sizeof( address ) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_ANY );
+    address.sin_port = htons( uint16_t( port_number ) );
+    if ( bind( listen_socket_, reinterpret_cast<sockaddr*>( &address ), sizeof( address ) ) < 0 ) {
+        throw_errno( "Problem opening the socket on port " + port );
+    }
+    if ( listen( listen_socket_, SOMAXCONN ) < 0 ) {
+        throw_errno( "listen" );
+    }
+
+    epoll_fd_ = epoll_create1( EPOLL_CLOEXEC );
+    event_fd_ = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if ( epoll_fd_ < 0 || event_fd_ < 0 ) {
+        throw_errno( "epoll" );
+    }
+    const int fds[] = { listen_socket_, event_fd_ };
+    for ( int fd : fds ) {
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if ( epoll_ctl( epoll_fd_, EPOLL_CTL_ADD, fd, &ev ) < 0 ) {
+            throw_errno( "epoll_ctl" );
+        }
+    }
+
+    for ( size_t i = 0; i < num_threads; i++ ) {
+        workers_.create_thread( boost::bind( &HttpServer::worker, this ) );
+    }
+}
+
+HttpServer::~HttpServer()
+{
+    workers_.interrupt_all();
+    workers_.join_all();
+    for ( auto& p : connections_ ) {
+        ::close( p.first );
+    }
+    const int fds[] = { listen_socket_, epoll_fd_, event_fd_ };
+    for ( int fd : fds ) {
+        if ( fd >= 0 ) {
+            ::close( fd );
+        }
+    }
+}
+
+void HttpServer::run()
+{
+    std::vector<epoll_event> events( 256 );
+    Clock::time_point last_sweep = Clock::now();
+    for ( ;; ) {
+        const int n = epoll_wait( epoll_fd_, &events[0], int( events.size() ), SweepPeriod );
+        if ( n < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            throw_errno( "epoll_wait" );
+        }
+
+        if ( Clock::now() - last_sweep >= std::chrono::milliseconds( SweepPeriod ) ) {
+            close_idle_connections();
+            last_sweep = Clock::now();
+        }
+
+        for ( int i = 0; i < n; i++ ) {
+            const int fd = events[i].data.fd;
+            if ( fd == listen_socket_ ) {
+                accept_connections();
+                continue;
+            }
+            if ( fd == event_fd_ ) {
+                complete_requests();
+                continue;
+            }
+
+            auto it = connections_.find( fd );
+            if ( it == connections_.end() ) {
+                continue;
+            }
+            Connection& c = *it->second;
+            if ( events[i].events & ( EPOLLERR | EPOLLHUP ) ) {
+                c.broken = true;
+            }
+            else if ( events[i].events & EPOLLIN ) {
+                read_connection( c );
+            }
+            // pending output is written by dispatch()
+            dispatch( c );
+        }
+    }
+}
+
+void HttpServer::accept_connections()
+{
+    for ( ;; ) {
+        const int fd = accept4( listen_socket_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC );
+        if ( fd < 0 ) {
+            if ( errno == EINTR || errno == ECONNABORTED ) {
+                continue;
+            }
+            if ( errno != EAGAIN && errno != EWOULDBLOCK ) {
+                CERR << "failed to accept connection: " << strerror( errno ) << "\n";
+            }
+            return;
+        }
+
+        // responses are written at once, they must not wait for an acknowledgement
+        int one = 1;
+        setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if ( epoll_ctl( epoll_fd_, EPOLL_CTL_ADD, fd, &ev ) < 0 ) {
+            CERR << "failed to register connection: " << strerror( errno ) << "\n";
+            ::close( fd );
+            continue;
+        }
+        connections_[fd].reset( new Connection( fd ) );
+    }
+}
+
+void HttpServer::read_connection( Connection& c )
+{
+    char buffer[65536];
+    while ( c.in.size() < MaxRequestSize ) {
+        const ssize_t r = recv( c.fd, buffer, sizeof( buffer ), 0 );
+        if ( r > 0 ) {
+            c.in.append( buffer, size_t( r ) );
+            c.last_activity = Clock::now();
+        }
+        else if ( r == 0 ) {
+            c.read_closed = true;
+            return;
+        }
+        else if ( errno != EINTR ) {
+            if ( errno != EAGAIN && errno != EWOULDBLOCK ) {
+                c.broken = true;
+            }
+            return;
+        }
+    }
+}
+
+void HttpServer::write_connection( Connection& c )
+{
+    while ( c.out_pos < c.out.size() && !c.broken ) {
+        const ssize_t w = send( c.fd, c.out.data() + c.out_pos, c.out.size() - c.out_pos, MSG_NOSIGNAL );
+        if ( w >= 0 ) {
+            c.out_pos += size_t( w );
+            c.last_activity = Clock::now();
+        }
+        else if ( errno == EAGAIN || errno == EWOULDBLOCK ) {
+            return;
+        }
+        else if ( errno != EINTR ) {
+            c.broken = true;
+        }
+    }
+    c.out.clear();
+    c.out_pos = 0;
+}
+
+void HttpServer::respond( Connection& c, const std::string& response, bool keep_alive )
+{
+    c.out += response;
+    if ( !keep_alive ) {
+        c.closing = true;
+    }
+}
+
+void HttpServer::respond( Connection& c, std::string& response, size_t offset, bool keep_alive )
+{
+    if ( c.out.empty() ) {
+        // the response is sent from the buffer the worker has written it to
+        c.out.swap( response );
+        c.out_pos = offset;
+    }
+    else {
+        c.out.append( response, offset, std::string::npos );
+    }
+    if ( !keep_alive ) {
+        c.closing = true;
+    }
+}
+
+void HttpServer::dispatch( Connection& c )
+{
+    // a request is only passed to the workers when the previous one is answered, so that responses are in order
+    while ( !c.busy && !c.closing && !c.broken ) {
+        HttpRequest request;
+        size_t size = 0;
+        try {
+            size = parse_request( c.in, request );
+        }
+        catch ( HttpError& e ) {
+            respond( c, cgi_to_http( error_response( e.status(), e.what() ), false ), false );
+            break;
+        }
+
+        if ( size == 0 ) {
+            if ( c.in.size() >= MaxRequestSize ) {
+                respond( c, cgi_to_http( error_response( 413, "Request too large" ), false ), false );
+            }
+            else if ( request.expect_continue && !c.continue_sent ) {
+                c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+                c.continue_sent = true;
+            }
+            break;
+        }
+        c.in.erase( 0, size );
+        c.continue_sent = false;
+
+        const bool keep_alive = request.keep_alive;
+        JobPtr job( new Job );
+        job->fd = c.fd;
+        job->request = std::move( request );
+        if ( !queue_.try_push( job ) ) {
+            ServerState::instance().add_rejected_request();
+            respond( c, cgi_to_http( overloaded, keep_alive ), keep_alive );
+            continue;
+        }
+        ServerState::instance().set_queue_depth( queue_.size() );
+        c.busy = true;
+    }
+
+    write_connection( c );
+
+    // a connection is never closed while a worker holds its descriptor
+    if ( !c.busy && ( c.broken || ( c.out.empty() && ( c.closing || c.read_closed ) ) ) ) {
+        close_connection( c );
+        return;
+    }
+    update_events( c );
+}
+
+void HttpServer::update_events( Connection& c )
+{
+    if ( c.broken ) {
+        // the connection waits for its request to be answered, then it is closed
+        if ( c.registered ) {
+            epoll_ctl( epoll_fd_, EPOLL_CTL_DEL, c.fd, nullptr );
+            c.registered = false;
+        }
+        return;
+    }
+
+    uint32_t events = 0;
+    if ( !c.read_closed && !c.closing && c.in.size() < MaxRequestSize ) {
+        events |= EPOLLIN;
+    }
+    if ( c.out_pos < c.out.size() ) {
+        events |= EPOLLOUT;
+    }
+    if ( events != c.events ) {
+        epoll_event ev;
+        ev.events = events;
+        ev.data.fd = c.fd;
+        epoll_ctl( epoll_fd_, EPOLL_CTL_MOD, c.fd, &ev );
+        c.events = events;
+    }
+}
+
+void HttpServer::close_connection( Connection& c )
+{
+    const int fd = c.fd;
+    if ( c.registered ) {
+        epoll_ctl( epoll_fd_, EPOLL_CTL_DEL, fd, nullptr );
+    }
+    ::close( fd );
+    connections_.erase( fd );
+}
+
+void HttpServer::complete_requests()
+{
+    uint64_t count;
+    if ( read( event_fd_, &count, sizeof( count ) ) < 0 && errno != EAGAIN ) {
+        throw_errno( "read" );
+    }
+
+    std::vector<Completion> completions;
+    {
+        boost::lock_guard<boost::mutex> lock( completions_mutex_ );
+        completions.swap( completions_ );
+    }
+
+    for ( Completion& done : completions ) {
+        auto it = connections_.find( done.fd );
+        if ( it == connections_.end() ) {
+            continue;
+        }
+        Connection& c = *it->second;
+        c.busy = false;
+        c.last_activity = Clock::now();
+        if ( !c.broken ) {
+            respond( c, done.response, done.offset, done.keep_alive );
+        }
+        dispatch( c );
+    }
+}
+
+void HttpServer::close_idle_connections()
+{
+    const Clock::time_point now = Clock::now();
+    std::vector<int> idle;
+    for ( auto& p : connections_ ) {
+        const Connection& c = *p.second;
+        // a connection is never closed while a worker holds its descriptor
+        if ( !c.busy && now - c.last_activity > std::chrono::seconds( IdleTimeout ) ) {
+            idle.push_back( p.first );
+        }
+    }
+    for ( int fd : idle ) {
+        close_connection( *connections_[fd] );
+    }
+}
+
+void HttpServer::worker()
+{
+    XML::init(); // must be called once per thread
+    Service::init_thread();
+
+    for ( ;; ) {
+        JobPtr job( queue_.pop() );
+        ServerState::instance().set_queue_depth( queue_.size() );
+        const HttpRequest& request = job->request;
+
+        // the CGI variables WPS::Request looks for
+        std::vector<std::string> env;
+        env.push_back( "REQUEST_METHOD=" + request.method );
+        env.push_back( "QUERY_STRING=" + request.query_string );
+        env.push_back( "CONTENT_TYPE=" + request.content_type );
+        env.push_back( "CONTENT_LENGTH=" + boost::lexical_cast<std::string>( request.body.size() ) );
+        env.push_back( "REQUEST_URI=" + request.uri );
+        env.push_back( "SCRIPT_NAME=" + request.path );
+        env.push_back( "SERVER_PROTOCOL=HTTP/1.1" );
+        std::vector<char*> envp;
+        for ( std::string& var : env ) {
+            envp.push_back( &var[0] );
+        }
+        envp.push_back( nullptr );
+
+        Completion done;
+        done.fd = job->fd;
+        done.offset = 0;
+        done.keep_alive = request.keep_alive;
+        try {
+            std::stringbuf in( request.body, std::ios::in );
+            // the CGI response is written after some room for the HTTP headers, then converted in place
+            done.response.assign( ResponseHeadRoom, ' ' );
+            StringAppendBuf out( done.response );
+            Request wps_request( &in, &out, &envp[0] );
+            wps_request.process();
+            done.offset = cgi_to_http( done.response, ResponseHeadRoom, done.keep_alive );
+        }
+        catch ( boost::thread_interrupted& ) {
+            throw;
+        }
+        catch ( std::exception& e ) {
+            // the connection would wait forever for its response
+            CERR << "failed to process request (exception thrown): " << e.what() << "\n";
+            done.response = cgi_to_http( error_response( 500, "Internal server error" ), done.keep_alive );
+            done.offset = 0;
+        }
+        catch ( ... ) {
+            CERR << "failed to process request (unknown exception thrown)\n";
+            done.response = cgi_to_http( error_response( 500, "Internal server error" ), done.keep_alive );
+            done.offset = 0;
+        }
+
+        {
+            boost::lock_guard<boost::mutex> lock( completions_mutex_ );
+            completions_.push_back( std::move( done ) );
+        }
+        const uint64_t one = 1;
+        if ( write( event_fd_, &one, sizeof( one ) ) < 0 ) {
+            CERR << "failed to wake the event loop up: " << strerror( errno ) << "\n";
+        }
+    }
+}
+
+size_t HttpServer::parse_request( const std::string& buffer, HttpRequest& request )
+{
+    const size_t header_end = buffer.find( "\r\n\r\n" );
+    if ( header_end == std::string::npos ) {
+        if ( buffer.size() > MaxHeaderSize ) {
+            throw HttpError( 431, "Request headers too large" );
+        }
+        return 0;
+    }
+    if ( header_end + 4 > MaxHeaderSize ) {
+        throw HttpError( 431, "Request headers too large" );
+    }
+
+    // request line
+    size_t eol = buffer.find( "\r\n" );
+    std::vector<std::string> parts;
+    boost::split( parts, buffer.substr( 0, eol ), boost::is_any_of( " " ) );
+    if ( parts.size() != 3 || parts[2].compare( 0, 5, "HTTP/" ) != 0 ) {
+        throw HttpError( 400, "Malformed request line" );
+    }
+    request.method = parts[0];
+    request.uri = parts[1];
+    const size_t q = request.uri.find( '?' );
+    request.path = request.uri.substr( 0, q );
+    request.query_string = q == std::string::npos ? "" : request.uri.substr( q + 1 );
+    const bool http_1_0 = parts[2] == "HTTP/1.0";
+    request.keep_alive = !http_1_0;
+
+    // headers
+    size_t content_length = 0;
+    bool has_content_length = false;
+    for ( size_t pos = eol + 2; pos < header_end; pos = eol + 2 ) {
+        eol = buffer.find( "\r\n", pos );
+        const std::string line = buffer.substr( pos, eol - pos );
+        const size_t colon = line.find( ':' );
+        if ( colon == std::string::npos ) {
+            throw HttpError( 400, "Malformed header" );
+        }
+        const std::string name = boost::to_lower_copy( line.substr( 0, colon ) );
+        const std::string value = boost::trim_copy( line.substr( colon + 1 ) );
+        if ( name == "content-length" ) {
+            // only digits: a sign would be accepted by lexical_cast and wrap around
+            if ( value.empty() || value.size() > 18 || value.find_first_not_of( "0123456789" ) != std::string::npos ) {
+                throw HttpError( 400, "Invalid Content-Length" );
+            }
+            const size_t length = boost::lexical_cast<size_t>( value );
+            if ( has_content_length && length != content_length ) {
+                throw HttpError( 400, "Invalid Content-Length" );
+            }
+            if ( length > MaxRequestSize ) {
+                throw HttpError( 413, "Request too large" );
+            }
+            content_length = length;
+            has_content_length = true;
+        }
+        else if ( name == "content-type" ) {
+            request.content_type = value;
+        }
+        else if ( name == "connection" ) {
+            if ( boost::ifind_first( value, "close" ) ) {
+                request.keep_alive = false;
+            }
+            else if ( boost::ifind_first( value, "keep-alive" ) ) {
+                request.keep_alive = true;
+            }
+        }
+        else if ( name == "transfer-encoding" ) {
+            throw HttpError( 400, "Transfer encodings are not supported, Content-Length is required" );
+        }
+        else if ( name == "expect" ) {
+            request.expect_continue = !http_1_0 && boost::iequals( value, "100-continue" );
+        }
+    }
+
+    const size_t body_start = header_end + 4;
+    if ( buffer.size() < body_start + content_length ) {
+        return 0;
+    }
+    request.body = buffer.substr( body_start, content_length );
+    return body_start + content_length;
+}
+
+std::string HttpServer::cgi_to_http( const std::string& cgi, bool keep_alive )
+{
+    std::string response( cgi );
+    const size_t start = cgi_to_http( response, 0, keep_alive );
+    return response.substr( start );
+}
+
+size_t HttpServer::cgi_to_http( std::string& cgi, size_t cgi_start, bool keep_alive )
+{
+    int status = 200;
+    std::string reason = reason_phrase( status );
+    std::string headers;
+
+    // CGI headers may end with "\n" or "\r\n"
+    size_t body_start = cgi.size();
+    for ( size_t pos = cgi_start; pos < cgi.size(); ) {
+        size_t eol = cgi.find( '\n', pos );
+        if ( eol == std::string::npos ) {
+            eol = cgi.size();
+        }
+        std::string line = cgi.substr( pos, eol - pos );
+        pos = eol + 1;
+        if ( !line.empty() && line[line.size() - 1] == '\r' ) {
+            line.erase( line.size() - 1 );
+        }
+        if ( line.empty() ) {
+            body_start = std::min( pos, cgi.size() );
+            break;
+        }
+
+        const size_t colon = line.find( ':' );
+        if ( colon != std::string::npos && boost::iequals( line.substr( 0, colon ), "Status" ) ) {
+            const std::string value = boost::trim_copy( line.substr( colon + 1 ) );
+            const size_t space = value.find( ' ' );
+            status = atoi( value.substr( 0, space ).c_str() );
+            reason = space == std::string::npos ? reason_phrase( status ) : value.substr( space + 1 );
+        }
+        else {
+            headers += line + "\r\n";
+        }
+    }
+
+    std::ostringstream response;
+    response << "HTTP/1.1 " << status << " " << reason << "\r\n"
+             << headers
+             << "Content-Length: " << cgi.size() - body_start << "\r\n";
+    if ( !keep_alive ) {
+        response << "Connection: close\r\n";
+    }
+    response << "\r\n";
+    const std::string head = response.str();
+
+    // the HTTP headers overwrite the CGI ones, and the room before them, if it is large enough
+    if ( head.size() <= body_start ) {
+        const size_t start = body_start - head.size();
+        cgi.replace( start, head.size(), head );
+        return start;
+    }
+    cgi.replace( 0, body_start, head );
+    return 0;
+}
+
+}
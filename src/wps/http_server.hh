@@ -0,0 +1,159 @@
+/**
+ *   Copyright (C) 2012-2013 IFSTTAR (http://www.ifsttar.fr)
+ *   Copyright (C) 2012-2013 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+// Embedded HTTP/1.1 server, an alternative to FastCGI
+
+#ifndef TEMPUS_WPS_HTTP_SERVER_HH
+#define TEMPUS_WPS_HTTP_SERVER_HH
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#pragma warning(push, 0)
+#endif
+#include <boost/thread.hpp>
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+#include "request_queue.hh"
+
+namespace WPS {
+///
+/// A request read from a HTTP connection
+struct HttpRequest {
+    std::string method;
+    /// Request target, with its query string
+    std::string uri;
+    std::string path;
+    std::string query_string;
+    std::string content_type;
+    std::string body;
+    bool keep_alive;
+    /// The client waits for a "100 Continue" before sending the body
+    bool expect_continue;
+    HttpRequest() : keep_alive( true ), expect_continue( false ) {}
+};
+
+///
+/// Error in a request read from a HTTP connection, answered with its status before the connection is closed
+class HttpError : public std::invalid_argument {
+public:
+    HttpError( int status, const std::string& msg ) : std::invalid_argument( msg ), status_( status ) {}
+    int status() const { return status_; }
+private:
+    int status_;
+};
+
+///
+/// HTTP/1.1 server that passes requests to WPS::Request, as a FastCGI web server would
+///
+/// A single thread multiplexes the connections with epoll (Linux only): it accepts connections, reads and parses
+/// requests, and writes responses. Requests are processed by a fixed pool of worker threads, through a bounded queue.
+/// A request that does not fit in the queue is answered right away with a 503 status.
+///
+/// Connections are kept alive, and a client may pipeline its requests. The requests of a connection are processed
+/// one at a time, so that responses are sent in order, while the following ones are already read and buffered.
+/// A connection that neither sends nor receives anything for 30 seconds, while none of its requests is processed,
+/// is closed.
+class HttpServer {
+public:
+    ///
+    /// \param[in] port TCP port to listen to
+    /// \param[in] num_threads Number of worker threads
+    /// \param[in] queue_size Maximum number of requests waiting for a worker
+    HttpServer( const std::string& port, size_t num_threads, size_t queue_size );
+    ~HttpServer();
+
+    ///
+    /// Serve requests, never returns
+    void run();
+
+    ///
+    /// Parses the first request of a buffer.
+    /// Fields of the request are set as soon as its headers are complete.
+    /// \throw HttpError if the request is malformed or not supported (400), if its body is too large (413)
+    /// or if its headers are larger than a few kilobytes (431)
+    /// \return the size of the request, 0 if it is not complete yet
+    static size_t parse_request( const std::string& buffer, HttpRequest& request );
+
+    ///
+    /// Converts the response of a CGI program (a "Status" header, other headers, an empty line, the body)
+    /// to a HTTP/1.1 response
+    static std::string cgi_to_http( const std::string& cgi, bool keep_alive );
+
+    ///
+    /// Converts in place the response of a CGI program, that starts at cgi_start in the buffer.
+    /// The HTTP headers are written just before the body when there is room for them, so that the body is not copied.
+    /// \return the position of the HTTP response in the buffer
+    static size_t cgi_to_http( std::string& buffer, size_t cgi_start, bool keep_alive );
+
+private:
+    struct Connection;
+
+    /// A request waiting for a worker
+    struct Job {
+        int fd;
+        HttpRequest request;
+    };
+    typedef std::unique_ptr<Job> JobPtr;
+
+    /// A response ready to be sent, from offset in its buffer
+    struct Completion {
+        int fd;
+        std::string response;
+        size_t offset;
+        bool keep_alive;
+    };
+
+    void worker();
+
+    void accept_connections();
+    void read_connection( Connection& c );
+    void write_connection( Connection& c );
+    void complete_requests();
+    void close_idle_connections();
+
+    /// Passes the next buffered request of a connection to the workers, if it is idle
+    void dispatch( Connection& c );
+    /// Queues a response generated by the server itself
+    void respond( Connection& c, const std::string& response, bool keep_alive );
+    /// Queues the response of a worker, its buffer becomes the output buffer of the connection if it is empty
+    void respond( Connection& c, std::string& response, size_t offset, bool keep_alive );
+    void close_connection( Connection& c );
+    void update_events( Connection& c );
+
+    int listen_socket_;
+    int epoll_fd_;
+    /// Wakes the event loop up when workers have completed requests
+    int event_fd_;
+
+    /// Connections by file descriptor, only accessed by the event loop
+    std::map<int, std::unique_ptr<Connection> > connections_;
+
+    BoundedQueue<JobPtr> queue_;
+    boost::thread_group workers_;
+
+    boost::mutex completions_mutex_;
+    std::vector<Completion> completions_;
+};
+}
+
+#endif
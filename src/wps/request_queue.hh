@@ -0,0 +1,90 @@
+/**
+ *   Copyright (C) 2012-2013 IFSTTAR (http://www.ifsttar.fr)
+ *   Copyright (C) 2012-2013 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+// Bounded request queue
+
+#ifndef TEMPUS_WPS_REQUEST_QUEUE_HH
+#define TEMPUS_WPS_REQUEST_QUEUE_HH
+
+#include <deque>
+#include <utility>
+
+#ifdef _WIN32
+#pragma warning(push, 0)
+#endif
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/lock_guard.hpp>
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+namespace WPS {
+///
+/// Multi-producer multi-consumer queue of bounded capacity.
+///
+/// Producers never block: try_push() fails when the queue is full, so that the caller can reject the element
+/// right away (back-pressure) instead of letting the backlog grow. Consumers block in pop() until an element is available.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue( size_t capacity ) : capacity_( capacity ) {}
+
+    ///
+    /// Adds an element, if the queue is not full
+    /// @returns false if the queue is full, the element is then left untouched
+    bool try_push( T& element ) {
+        {
+            boost::lock_guard<boost::mutex> lock( mutex_ );
+            if ( queue_.size() >= capacity_ ) {
+                return false;
+            }
+            queue_.push_back( std::move( element ) );
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    ///
+    /// Removes the oldest element, waits for one if the queue is empty
+    T pop() {
+        boost::unique_lock<boost::mutex> lock( mutex_ );
+        while ( queue_.empty() ) {
+            not_empty_.wait( lock );
+        }
+        T element( std::move( queue_.front() ) );
+        queue_.pop_front();
+        return element;
+    }
+
+    size_t size() const {
+        boost::lock_guard<boost::mutex> lock( mutex_ );
+        return queue_.size();
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+private:
+    const size_t capacity_;
+    std::deque<T> queue_;
+    mutable boost::mutex mutex_;
+    boost::condition_variable not_empty_;
+};
+}
+
+#endif
@@ -0,0 +1,181 @@
+/**
+ *   Copyright (C) 2012-2013 IFSTTAR (http://www.ifsttar.fr)
+ *   Copyright (C) 2012-2013 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+#include <ostream>
+
+#include <boost/lexical_cast.hpp>
+
+#include "server_state.hh"
+#include "result_cache.hh"
+
+namespace WPS {
+
+ServerState::ServerState() :
+    queue_capacity_( 0 ),
+    queue_depth_( 0 ),
+    max_queue_depth_( 0 ),
+    rejected_requests_( 0 )
+{
+}
+
+ServerState& ServerState::instance()
+{
+    static ServerState state;
+    return state;
+}
+
+void ServerState::set_queue_capacity( size_t capacity )
+{
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    queue_capacity_ = capacity;
+}
+
+void ServerState::set_queue_depth( size_t depth )
+{
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    queue_depth_ = depth;
+    if ( depth > max_queue_depth_ ) {
+        max_queue_depth_ = depth;
+    }
+}
+
+void ServerState::add_rejected_request()
+{
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    rejected_requests_++;
+}
+
+void ServerState::set_plugin_limit( const std::string& plugin, size_t max_concurrent_requests )
+{
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    plugins_[plugin].limit = max_concurrent_requests;
+}
+
+ServerState::PluginSlot::PluginSlot( const std::string& plugin ) : plugin_( plugin )
+{
+    ServerState& state = ServerState::instance();
+    boost::lock_guard<boost::mutex> lock( state.mutex_ );
+    PluginLoad& load = state.plugins_[plugin];
+    if ( load.limit && load.running >= load.limit ) {
+        load.rejected++;
+        throw ServiceUnavailable( "Too many requests on plugin " + plugin + ", retry later" );
+    }
+    load.running++;
+}
+
+ServerState::PluginSlot::~PluginSlot()
+{
+    ServerState& state = ServerState::instance();
+    boost::lock_guard<boost::mutex> lock( state.mutex_ );
+    state.plugins_[plugin_].running--;
+}
+
+bool ServerState::start_reload( const std::string& plugin )
+{
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    PluginReload& reload = reloads_[plugin];
+    if ( reload.running ) {
+        return false;
+    }
+    reload.running = true;
+    return true;
+}
+
+void ServerState::end_reload( const std::string& plugin, const std::string& error )
+{
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    PluginReload& reload = reloads_[plugin];
+    reload.running = false;
+    reload.error = error;
+    if ( error.empty() ) {
+        reload.reloads++;
+    }
+}
+
+std::map<std::string, std::string> ServerState::metrics() const
+{
+    using boost::lexical_cast;
+    boost::lock_guard<boost::mutex> lock( mutex_ );
+    std::map<std::string, std::string> m;
+    m["queue_depth"] = lexical_cast<std::string>( queue_depth_ );
+    m["queue_capacity"] = lexical_cast<std::string>( queue_capacity_ );
+    m["max_queue_depth"] = lexical_cast<std::string>( max_queue_depth_ );
+    m["rejected_requests"] = lexical_cast<std::string>( rejected_requests_ );
+    const Tempus::ResultCache& cache = Tempus::ResultCache::instance();
+    if ( cache.enabled() ) {
+        const Tempus::ResultCache::Statistics stats = cache.statistics();
+        m["cache/hits"] = lexical_cast<std::string>( stats.hits );
+        m["cache/misses"] = lexical_cast<std::string>( stats.misses );
+        m["cache/evictions"] = lexical_cast<std::string>( stats.evictions );
+        m["cache/entries"] = lexical_cast<std::string>( stats.entries );
+        m["cache/bytes"] = lexical_cast<std::string>( stats.bytes );
+    }
+    for ( std::map<std::string, PluginLoad>::const_iterator it = plugins_.begin(); it != plugins_.end(); it++ ) {
+        m["plugin/" + it->first + "/running"] = lexical_cast<std::string>( it->second.running );
+        m["plugin/" + it->first + "/rejected"] = lexical_cast<std::string>( it->second.rejected );
+        m["plugin/" + it->first + "/limit"] = lexical_cast<std::string>( it->second.limit );
+    }
+    for ( std::map<std::string, PluginReload>::const_iterator it = reloads_.begin(); it != reloads_.end(); it++ ) {
+        m["reload/" + it->first + "/running"] = it->second.running ? "1" : "0";
+        m["reload/" + it->first + "/reloads"] = lexical_cast<std::string>( it->second.reloads );
+        m["reload/" + it->first + "/error"] = it->second.error;
+    }
+    return m;
+}
+
+void ServerState::write_text( std::ostream& ostr ) const
+{
+    {
+        boost::lock_guard<boost::mutex> lock( mutex_ );
+        ostr << "# TYPE tempus_queue_depth gauge\n";
+        ostr << "tempus_queue_depth " << queue_depth_ << "\n";
+        ostr << "# TYPE tempus_queue_capacity gauge\n";
+        ostr << "tempus_queue_capacity " << queue_capacity_ << "\n";
+        ostr << "# TYPE tempus_max_queue_depth gauge\n";
+        ostr << "tempus_max_queue_depth " << max_queue_depth_ << "\n";
+        ostr << "# TYPE tempus_rejected_requests_total counter\n";
+        ostr << "tempus_rejected_requests_total " << rejected_requests_ << "\n";
+        ostr << "# TYPE tempus_plugin_running gauge\n";
+        for ( std::map<std::string, PluginLoad>::const_iterator it = plugins_.begin(); it != plugins_.end(); it++ ) {
+            ostr << "tempus_plugin_running{label=\"" << it->first << "\"} " << it->second.running << "\n";
+        }
+        ostr << "# TYPE tempus_plugin_rejected_total counter\n";
+        for ( std::map<std::string, PluginLoad>::const_iterator it = plugins_.begin(); it != plugins_.end(); it++ ) {
+            ostr << "tempus_plugin_rejected_total{label=\"" << it->first << "\"} " << it->second.rejected << "\n";
+        }
+        ostr << "# TYPE tempus_plugin_reloads_total counter\n";
+        for ( std::map<std::string, PluginReload>::const_iterator it = reloads_.begin(); it != reloads_.end(); it++ ) {
+            ostr << "tempus_plugin_reloads_total{label=\"" << it->first << "\"} " << it->second.reloads << "\n";
+        }
+    }
+
+    const Tempus::ResultCache& cache = Tempus::ResultCache::instance();
+    if ( cache.enabled() ) {
+        const Tempus::ResultCache::Statistics stats = cache.statistics();
+        ostr << "# TYPE tempus_cache_hits_total counter\n";
+        ostr << "tempus_cache_hits_total " << stats.hits << "\n";
+        ostr << "# TYPE tempus_cache_misses_total counter\n";
+        ostr << "tempus_cache_misses_total " << stats.misses << "\n";
+        ostr << "# TYPE tempus_cache_evictions_total counter\n";
+        ostr << "tempus_cache_evictions_total " << stats.evictions << "\n";
+        ostr << "# TYPE tempus_cache_entries gauge\n";
+        ostr << "tempus_cache_entries " << stats.entries << "\n";
+        ostr << "# TYPE tempus_cache_bytes gauge\n";
+        ostr << "tempus_cache_bytes " << stats.bytes << "\n";
+    }
+}
+
+}
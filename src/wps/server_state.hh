@@ -0,0 +1,129 @@
+/**
+ *   Copyright (C) 2012-2013 IFSTTAR (http://www.ifsttar.fr)
+ *   Copyright (C) 2012-2013 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+// State of the WPS server, shared by request threads
+
+#ifndef TEMPUS_WPS_SERVER_STATE_HH
+#define TEMPUS_WPS_SERVER_STATE_HH
+
+#include <map>
+#include <string>
+#include <iosfwd>
+#include <stdexcept>
+
+#ifdef _WIN32
+#pragma warning(push, 0)
+#endif
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+namespace WPS {
+///
+/// Exception thrown when a request cannot be processed now because of the server load.
+/// It is answered with a HTTP 503 status
+class ServiceUnavailable : public std::runtime_error {
+public:
+    explicit ServiceUnavailable( const std::string& msg ) : std::runtime_error( msg ) {}
+};
+
+///
+/// Admission control and load metrics of the server
+///
+/// The request queue is filled by the accept thread and emptied by the worker threads, that report its depth here.
+/// Plugins may have a limit on the number of requests they process at the same time, so that a burst of expensive requests
+/// on one plugin does not hold every worker thread.
+class ServerState {
+public:
+    static ServerState& instance();
+
+    void set_queue_capacity( size_t capacity );
+
+    ///
+    /// Called by the accept thread and the workers each time the queue changes
+    void set_queue_depth( size_t depth );
+
+    ///
+    /// Called by the accept thread when a request is rejected because the queue is full
+    void add_rejected_request();
+
+    ///
+    /// Sets the maximum number of requests a plugin processes at the same time. 0 means no limit.
+    void set_plugin_limit( const std::string& plugin, size_t max_concurrent_requests );
+
+    ///
+    /// Slot held during the processing of a request by a plugin.
+    /// The constructor throws ServiceUnavailable if the plugin has reached its limit.
+    class PluginSlot {
+    public:
+        explicit PluginSlot( const std::string& plugin );
+        ~PluginSlot();
+    private:
+        PluginSlot( const PluginSlot& );
+        PluginSlot& operator=( const PluginSlot& );
+        std::string plugin_;
+    };
+
+    ///
+    /// Called when the reload of a plugin starts.
+    /// \return false if a reload of this plugin is already running
+    bool start_reload( const std::string& plugin );
+
+    ///
+    /// Called when the reload of a plugin ends
+    /// \param error Error message, empty if the reload has succeeded
+    void end_reload( const std::string& plugin, const std::string& error );
+
+    ///
+    /// Current values of the metrics, by name
+    std::map<std::string, std::string> metrics() const;
+
+    ///
+    /// Write the metrics in the Prometheus text format
+    void write_text( std::ostream& ostr ) const;
+
+private:
+    ServerState();
+
+    struct PluginLoad {
+        size_t limit;
+        size_t running;
+        size_t rejected;
+        PluginLoad() : limit( 0 ), running( 0 ), rejected( 0 ) {}
+    };
+
+    struct PluginReload {
+        bool running;
+        /// number of successful reloads
+        size_t reloads;
+        /// error of the last reload, if it has failed
+        std::string error;
+        PluginReload() : running( false ), reloads( 0 ) {}
+    };
+
+    mutable boost::mutex mutex_;
+    size_t queue_capacity_;
+    size_t queue_depth_;
+    size_t max_queue_depth_;
+    size_t rejected_requests_;
+    std::map<std::string, PluginLoad> plugins_;
+    std::map<std::string, PluginReload> reloads_;
+};
+}
+
+#endif
@@ -17,8 +17,15 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <boost/format.hpp>
 
+#ifdef _OPENMP
+#include <omp.h>
+#else
+inline int omp_get_max_threads() { return 1; }
+#endif
+
 #include "wps_service.hh"
 #include "multimodal_graph.hh"
 #include "request.hh"
@@ -28,6 +35,10 @@
 #include <boost/timer/timer.hpp>
 #include "plugin_factory.hh"
 #include "tempus_services.hh"
+#include "server_state.hh"
+#include "ch_many_to_many.hh"
+#include "utils/timer.hh"
+#include "instrumentation.hh"
 
 using namespace Tempus;
 
@@ -35,6 +46,7 @@ using namespace Tempus;
 // This file contains implementations of services offered by the Tempus WPS server.
 // Variables are their XML schema are defined inside constructors.
 // And the execute() method read from the XML tree or format the resulting XML tree.
+// Services with large outputs implement execute_streamed() instead and write their outputs directly.
 // Pretty boring ...
 //
 
@@ -144,10 +156,10 @@ Service::ParameterMap ConstantListService::execute( const ParameterMap& input_pa
 {
     ParameterMap output_parameters;
 
-    Service::check_parameters( input_parameter_map, input_parameter_schema_ );
+    Service::check_parameter_names( input_parameter_map, input_parameter_schema_ );
     const xmlNode* plugin_node = input_parameter_map.find( "plugin" )->second;
     const std::string plugin_str = XML::get_prop( plugin_node, "name" );
-    Plugin* plugin = PluginFactory::instance()->plugin( plugin_str );
+    std::shared_ptr<Plugin> plugin = PluginFactory::instance()->plugin_handle( plugin_str );
 
     if ( plugin == nullptr ) {
         throw std::invalid_argument( "Cannot find plugin " + plugin_str );
@@ -207,11 +219,14 @@ Service::ParameterMap ConstantListService::execute( const ParameterMap& input_pa
 
 Tempus::db_id_t road_vertex_id_from_coordinates( Db::Connection& db, double x, double y )
 {
+    Instrumentation::ScopedPhase snap_phase( Instrumentation::SnapPhase );
     //
     // Call to the stored procedure
     //
-    std::string q = ( boost::format( "SELECT tempus.road_node_id_from_coordinates(%.3f, %.3f)" ) % x % y ).str();
-    Db::Result res = db.exec( q );
+    std::vector<std::string> params;
+    params.push_back( ( boost::format( "%.3f" ) % x ).str() );
+    params.push_back( ( boost::format( "%.3f" ) % y ).str() );
+    Db::Result res = db.exec_prepared( "road_node_id_from_coordinates", "SELECT tempus.road_node_id_from_coordinates($1, $2)", params );
 
     if ( (res.size() == 0) || (res[0][0].is_null()) ) {
         return 0;
@@ -222,16 +237,21 @@ Tempus::db_id_t road_vertex_id_from_coordinates( Db::Connection& db, double x, d
 
 Tempus::db_id_t road_vertex_id_from_coordinates_and_modes( Db::Connection& db, double x, double y, const std::vector<db_id_t>& modes )
 {
-    std::string array_modes = "array[";
+    Instrumentation::ScopedPhase snap_phase( Instrumentation::SnapPhase );
+    std::string array_modes = "{";
     for ( size_t i = 0; i < modes.size(); i++ ) {
         array_modes += (boost::format("%d") % modes[i]).str();
         if (i<modes.size()-1) {
             array_modes += ",";
         }
     }
-    array_modes += "]";
-    std::string q = ( boost::format( "SELECT tempus.road_node_id_from_coordinates_and_modes(%.3f, %.3f, %s)" ) % x % y % array_modes ).str();
-    Db::Result res = db.exec( q );
+    array_modes += "}";
+    std::vector<std::string> params;
+    params.push_back( ( boost::format( "%.3f" ) % x ).str() );
+    params.push_back( ( boost::format( "%.3f" ) % y ).str() );
+    params.push_back( array_modes );
+    Db::Result res = db.exec_prepared( "road_node_id_from_coordinates_and_modes",
+                                       "SELECT tempus.road_node_id_from_coordinates_and_modes($1, $2, $3)", params );
 
     if ( (res.size() == 0) || (res[0][0].is_null()) ) {
         return 0;
@@ -331,398 +351,645 @@ db_id_t get_vertex_id_from_point_and_mode( const xmlNode* node, Db::Connection&
 }
 
 ///
-/// "result" service, get results from a path query.
-///
-/// Output var: results, see roadmap.hh
-///
-SelectService::SelectService() : Service( "select" ) {
-    add_input_parameter( "plugin" );
-    add_input_parameter( "request" );
-    add_input_parameter( "options" );
-    add_output_parameter( "results" );
-    add_output_parameter( "metrics" );
-}
-
-Service::ParameterMap SelectService::execute( const ParameterMap& input_parameter_map ) const
+/// Parses plugin options
+VariantMap parse_options( const xmlNode* options_node )
 {
-    ParameterMap output_parameters;
-    /*
-     */
-    // Ensure XML is OK
-    Service::check_parameters( input_parameter_map, input_parameter_schema_ );
-    const xmlNode* plugin_node = input_parameter_map.find( "plugin" )->second;
-    const std::string plugin_str = XML::get_prop( plugin_node, "name" );
-    Plugin* plugin = PluginFactory::instance()->plugin( plugin_str );
+    VariantMap options;
+    const xmlNode* field = XML::get_next_nontext( options_node->children );
 
-    if ( plugin == nullptr ) {
-        throw std::invalid_argument( "Cannot find plugin " + plugin_str );
-    }
+    while ( field && !xmlStrcmp( field->name, ( const xmlChar* )"option" ) ) {
+        std::string name = XML::get_prop( field, "name" );
 
-    Tempus::Request request;
+        const xmlNode* value_node = XML::get_next_nontext( field->children );
+        Tempus::VariantType t = Tempus::IntVariant;
 
-    // get options
-    VariantMap options;
-    {
-        const xmlNode* options_node = input_parameter_map.find( "options" )->second;
-        const xmlNode* field = XML::get_next_nontext( options_node->children );
+        if ( !xmlStrcmp( value_node->name, ( const xmlChar* )"bool_value" ) ) {
+            t = Tempus::BoolVariant;
+        }
+        else if ( !xmlStrcmp( value_node->name, ( const xmlChar* )"int_value" ) ) {
+            t = Tempus::IntVariant;
+        }
+        else if ( !xmlStrcmp( value_node->name, ( const xmlChar* )"float_value" ) ) {
+            t = Tempus::FloatVariant;
+        }
+        else if ( !xmlStrcmp( value_node->name, ( const xmlChar* )"string_value" ) ) {
+            t = Tempus::StringVariant;
+        }
 
-        while ( field && !xmlStrcmp( field->name, ( const xmlChar* )"option" ) ) {
-            std::string name = XML::get_prop( field, "name" );
+        const std::string value = XML::get_prop( value_node, "value" );
 
-            const xmlNode* value_node = XML::get_next_nontext( field->children );
-            Tempus::VariantType t = Tempus::IntVariant;
+        options[name] = Variant::from_string( value, t );
 
-            if ( !xmlStrcmp( value_node->name, ( const xmlChar* )"bool_value" ) ) {
-                t = Tempus::BoolVariant;
-            }
-            else if ( !xmlStrcmp( value_node->name, ( const xmlChar* )"int_value" ) ) {
-                t = Tempus::IntVariant;
-            }
-            else if ( !xmlStrcmp( value_node->name, ( const xmlChar* )"float_value" ) ) {
-                t = Tempus::FloatVariant;
-            }
-            else if ( !xmlStrcmp( value_node->name, ( const xmlChar* )"string_value" ) ) {
-                t = Tempus::StringVariant;
-            }
+        field = XML::get_next_nontext( field->next );
+    }
+    return options;
+}
 
-            const std::string value = XML::get_prop( value_node, "value" );
+///
+/// Parses a request, points given by coordinates are snapped to road vertices
+Tempus::Request parse_request( const xmlNode* request_node, Db::Connection& db )
+{
+    Tempus::Request request;
 
-                
-            options[name] = Variant::from_string( value, t );
+    const xmlNode* field = XML::get_next_nontext( request_node->children );
 
-            field = XML::get_next_nontext( field->next );
+    // first, parse allowed modes
+    {
+        const xmlNode* sfield = field;
+        // skip until the first allowed mode
+        while ( sfield && xmlStrcmp( sfield->name, (const xmlChar*)"allowed_mode") ) {
+            sfield = XML::get_next_nontext( sfield->next );                    
+        }
+        // loop over allowed modes
+        while ( sfield && !xmlStrcmp( sfield->name, ( const xmlChar* )"allowed_mode" ) ) {
+            db_id_t mode = lexical_cast<db_id_t>( sfield->children->content );
+            request.add_allowed_mode( mode );
+            sfield = XML::get_next_nontext( sfield->next );
         }
     }
-    std::unique_ptr<PluginRequest> plugin_request( plugin->request(options) );
-    std::unique_ptr<Result> result;
 
-    // pre_process
-    {
-        Db::Connection db( plugin->db_options() );
-
-        // now extract actual data
-        xmlNode* request_node = input_parameter_map.find( "request" )->second;
+    bool has_walking = std::find( request.allowed_modes().begin(), request.allowed_modes().end(), TransportModeWalking ) != request.allowed_modes().end();
+    bool has_private_bike = std::find( request.allowed_modes().begin(), request.allowed_modes().end(), TransportModePrivateBicycle ) != request.allowed_modes().end();
+    bool has_private_car = std::find( request.allowed_modes().begin(), request.allowed_modes().end(), TransportModePrivateCar ) != request.allowed_modes().end();
 
-        const xmlNode* field = XML::get_next_nontext( request_node->children );
-
-        // first, parse allowed modes
-        {
-            const xmlNode* sfield = field;
-            // skip until the first allowed mode
-            while ( sfield && xmlStrcmp( sfield->name, (const xmlChar*)"allowed_mode") ) {
-                sfield = XML::get_next_nontext( sfield->next );                    
-            }
-            // loop over allowed modes
-            while ( sfield && !xmlStrcmp( sfield->name, ( const xmlChar* )"allowed_mode" ) ) {
-                db_id_t mode = lexical_cast<db_id_t>( sfield->children->content );
-                request.add_allowed_mode( mode );
-                sfield = XML::get_next_nontext( sfield->next );
-            }
-        }
+    // add walking if private car && private bike
+    if ( !has_walking && has_private_car && has_private_bike ) {
+        request.add_allowed_mode( TransportModeWalking );
+    }
+    // add walking if no other private mode is present
+    if ( !has_walking && !has_private_car && !has_private_bike ) {
+        request.add_allowed_mode( TransportModeWalking );
+    }
 
-        bool has_walking = std::find( request.allowed_modes().begin(), request.allowed_modes().end(), TransportModeWalking ) != request.allowed_modes().end();
-        bool has_private_bike = std::find( request.allowed_modes().begin(), request.allowed_modes().end(), TransportModePrivateBicycle ) != request.allowed_modes().end();
-        bool has_private_car = std::find( request.allowed_modes().begin(), request.allowed_modes().end(), TransportModePrivateCar ) != request.allowed_modes().end();
+    Request::Step origin;
+    origin.set_location( get_vertex_id_from_point_and_mode( field, db, request.allowed_modes()[0] ) );
 
-        // add walking if private car && private bike
-        if ( !has_walking && has_private_car && has_private_bike ) {
-            request.add_allowed_mode( TransportModeWalking );
-        }
-        // add walking if no other private mode is present
-        if ( !has_walking && !has_private_car && !has_private_bike ) {
-            request.add_allowed_mode( TransportModeWalking );
-        }
+    request.set_origin( origin );
 
-        Request::Step origin;
-        origin.set_location( get_vertex_id_from_point_and_mode( field, db, request.allowed_modes()[0] ) );
-            
-        request.set_origin( origin );
+    // parking location id, optional
+    const xmlNode* n = XML::get_next_nontext( field->next );
 
-        // parking location id, optional
-        const xmlNode* n = XML::get_next_nontext( field->next );
+    if ( !xmlStrcmp( n->name, ( const xmlChar* )"parking_location" ) ) {
+        request.set_parking_location( get_vertex_id_from_point( n, db ) );
+        field = n;
+    }
 
-        if ( !xmlStrcmp( n->name, ( const xmlChar* )"parking_location" ) ) {
-            request.set_parking_location( get_vertex_id_from_point( n, db ) );
-            field = n;
-        }
+    // optimizing criteria
+    field = XML::get_next_nontext( field->next );
+    request.set_optimizing_criterion( 0, lexical_cast<int>( field->children->content ) );
+    field = XML::get_next_nontext( field->next );
 
-        // optimizing criteria
-        field = XML::get_next_nontext( field->next );
-        request.set_optimizing_criterion( 0, lexical_cast<int>( field->children->content ) );
+    while ( !xmlStrcmp( field->name, ( const xmlChar* )"optimizing_criterion" ) ) {
+        request.add_criterion( static_cast<CostId>(lexical_cast<int>( field->children->content )) );
         field = XML::get_next_nontext( field->next );
+    }
 
-        while ( !xmlStrcmp( field->name, ( const xmlChar* )"optimizing_criterion" ) ) {
-            request.add_criterion( static_cast<CostId>(lexical_cast<int>( field->children->content )) );
-            field = XML::get_next_nontext( field->next );
+    // steps, 1 .. N
+    while ( field && !xmlStrcmp( field->name, (const xmlChar*)"step" ) ) {
+        Request::Step step;
+        const xmlNode* subfield;
+        // destination id
+        subfield = XML::get_next_nontext( field->children );
+        step.set_location( get_vertex_id_from_point_and_mode( subfield, db, request.allowed_modes()[0] ) );
+
+        // constraint
+        subfield = XML::get_next_nontext( subfield->next );
+        Request::TimeConstraint constraint;
+        parse_constraint( subfield, constraint );
+        step.set_constraint( constraint );
+
+        // private_vehicule_at_destination
+        std::string val = XML::get_prop( field, "private_vehicule_at_destination" );
+        step.set_private_vehicule_at_destination( val == "true" );
+
+        // next step
+        field = XML::get_next_nontext( field->next );
+        if ( field && !xmlStrcmp( field->name, (const xmlChar*)"step" ) ) {
+            request.add_intermediary_step( step );
         }
+        else {
+            // destination
+            request.set_destination( step );
+        }
+    }
 
-        // steps, 1 .. N
-        while ( field && !xmlStrcmp( field->name, (const xmlChar*)"step" ) ) {
-            Request::Step step;
-            const xmlNode* subfield;
-            // destination id
-            subfield = XML::get_next_nontext( field->children );
-            step.set_location( get_vertex_id_from_point_and_mode( subfield, db, request.allowed_modes()[0] ) );
-
-            // constraint
-            subfield = XML::get_next_nontext( subfield->next );
-            Request::TimeConstraint constraint;
-            parse_constraint( subfield, constraint );
-            step.set_constraint( constraint );
-
-            // private_vehicule_at_destination
-            std::string val = XML::get_prop( field, "private_vehicule_at_destination" );
-            step.set_private_vehicule_at_destination( val == "true" );
-
-            // next step
-            field = XML::get_next_nontext( field->next );
-            if ( field && !xmlStrcmp( field->name, (const xmlChar*)"step" ) ) {
-                request.add_intermediary_step( step );
+    return request;
+}
+
+///
+/// Throws if a public transport network of a result is unknown.
+/// Called before the response is started, since it cannot be reported once the results are being written
+void check_result_networks( const Tempus::Result& result, const RoutingData* rd )
+{
+    for ( Tempus::Result::const_iterator rit = result.begin(); rit != result.end(); ++rit ) {
+        for ( Roadmap::StepConstIterator sit = rit->begin(); sit != rit->end(); sit++ ) {
+            boost::optional<db_id_t> network_id;
+            if ( sit->step_type() == Roadmap::Step::PublicTransportStep ) {
+                network_id = static_cast<const Roadmap::PublicTransportStep*>( &*sit )->network_id();
             }
-            else {
-                // destination
-                request.set_destination( step );
+            else if ( sit->step_type() == Roadmap::Step::TransferStep ) {
+                const Roadmap::TransferStep* step = static_cast<const Roadmap::TransferStep*>( &*sit );
+                if ( step->source().type() == MMVertex::Road && step->target().type() == MMVertex::Transport ) {
+                    network_id = step->target().network_id();
+                }
+                else if ( step->source().type() == MMVertex::Transport && step->target().type() == MMVertex::Road ) {
+                    network_id = step->source().network_id();
+                }
+            }
+            if ( network_id && ! rd->network( network_id.get() ) ) {
+                throw std::runtime_error( ( boost::format( "Can't find PT network ID %1%" ) % network_id.get() ).str() );
             }
         }
-
-        // then call process
-        result.reset( plugin_request->process( request ).release() );
     }
+}
 
-    // metrics
-    xmlNode* metrics_node = XML::new_node( "metrics" );
-
-    for ( auto metric : plugin_request->metrics() ) {
-        xmlNode* metric_node = XML::new_node( "metric" );
-        XML::new_prop( metric_node, "name", metric.first );
-        XML::new_prop( metric_node, "value",
-                       plugin_request->metric_to_string( metric.first ) );
-
-        XML::add_child( metrics_node, metric_node );
+void write_costs( XML::Writer& writer, const Tempus::Costs& costs )
+{
+    for ( Tempus::Costs::const_iterator cit = costs.begin(); cit != costs.end(); cit++ ) {
+        writer.start( "cost" ).attr( "type", to_string( cit->first ) ).attr( "value", to_string( cit->second ) ).end();
     }
+}
 
-    output_parameters[ "metrics" ] = metrics_node;
-
-    // result
-    xmlNode* root_node = XML::new_node( "results" );
-
-    if ( result->size() == 0 ) {
-        output_parameters["results"] = root_node;
-        return output_parameters;
+void write_trace_vertex( XML::Writer& writer, const MMVertex& v )
+{
+    if ( v.type() == MMVertex::Road ) {
+        writer.start( "road" ).attr( "id", to_string( v.id() ) ).end();
     }
+    else if ( v.type() == MMVertex::Transport ) {
+        writer.start( "pt" ).attr( "id", to_string( v.id() ) ).end();
+    }
+    else if ( v.type() == MMVertex::Poi ) {
+        writer.start( "poi" ).attr( "id", to_string( v.id() ) ).end();
+    }
+}
 
-    Tempus::Result::const_iterator rit;
-
-    const RoutingData* rd = plugin->routing_data();
+///
+/// Writes the roadmaps of a result, networks must have been checked by check_result_networks()
+void write_results( XML::Writer& writer, const Tempus::Result& result, const RoutingData* rd )
+{
+    writer.start( "results" );
 
-    for ( rit = result->begin(); rit != result->end(); ++rit ) {
+    for ( Tempus::Result::const_iterator rit = result.begin(); rit != result.end(); ++rit ) {
         const Tempus::Roadmap& roadmap = *rit;
 
-        xmlNode* result_node = XML::new_node( "result" );
+        writer.start( "result" );
 
         for ( Roadmap::StepConstIterator sit = roadmap.begin(); sit != roadmap.end(); sit++ ) {
-            xmlNode* step_node = 0;
-            const Roadmap::Step* gstep = &*sit;
-
             if ( sit->step_type() == Roadmap::Step::RoadStep ) {
                 const Roadmap::RoadStep* step = static_cast<const Roadmap::RoadStep*>( &*sit );
-                step_node = XML::new_node( "road_step" );
-
-                XML::set_prop( step_node, "road", step->road_name() );
-                XML::set_prop( step_node, "end_movement", to_string( step->end_movement() ) );
+                writer.start( "road_step" );
+                writer.attr( "road", step->road_name() );
+                writer.attr( "end_movement", to_string( step->end_movement() ) );
             }
             else if ( sit->step_type() == Roadmap::Step::PublicTransportStep ) {
                 const Roadmap::PublicTransportStep* step = static_cast<const Roadmap::PublicTransportStep*>( &*sit );
-
-                if ( ! rd->network( step->network_id() ) ) {
-                    throw std::runtime_error( ( boost::format( "Can't find PT network ID %1%" ) % step->network_id() ).str() );
-                }
-
-                step_node = XML::new_node( "public_transport_step" );
-
                 const PublicTransport::Network& network = rd->network( step->network_id() ).get();
 
-                XML::set_prop( step_node, "network", network.name() );
-
-                XML::set_prop( step_node, "departure_stop", step->departure_name() );
-                XML::set_prop( step_node, "arrival_stop", step->arrival_name() );
-                XML::set_prop( step_node, "route", step->route() );
-                XML::set_prop( step_node, "trip_id", to_string(step->trip_id()) );
-                XML::set_prop( step_node, "departure_time", to_string(step->departure_time()) );
-                XML::set_prop( step_node, "arrival_time", to_string(step->arrival_time()) );
-                XML::set_prop( step_node, "wait_time", to_string(step->wait()) );
+                writer.start( "public_transport_step" );
+                writer.attr( "network", network.name() );
+                writer.attr( "departure_stop", step->departure_name() );
+                writer.attr( "arrival_stop", step->arrival_name() );
+                writer.attr( "route", step->route() );
+                writer.attr( "trip_id", to_string(step->trip_id()) );
+                writer.attr( "departure_time", to_string(step->departure_time()) );
+                writer.attr( "arrival_time", to_string(step->arrival_time()) );
+                writer.attr( "wait_time", to_string(step->wait()) );
             }
             else if ( sit->step_type() == Roadmap::Step::TransferStep ) {
-
                 const Roadmap::TransferStep* step = static_cast<const Roadmap::TransferStep*>( &*sit );
                 if ( step->source().type() == MMVertex::Road && step->target().type() == MMVertex::Transport ) {
-                    if ( ! rd->network( step->target().network_id().get() ) ) {
-                        throw std::runtime_error( ( boost::format( "Can't find PT network ID %1%" ) % step->target().network_id().get() ).str() );
-                    }
-                    step_node = XML::new_node( "road_transport_step" );
-                    XML::set_prop( step_node, "type", "2" );
-                    XML::set_prop( step_node, "road", step->initial_name() );
-                    XML::set_prop( step_node, "network", rd->network( step->target().network_id().get() )->name() );
-                    XML::set_prop( step_node, "stop", step->final_name() );
+                    writer.start( "road_transport_step" );
+                    writer.attr( "type", "2" );
+                    writer.attr( "road", step->initial_name() );
+                    writer.attr( "network", rd->network( step->target().network_id().get() )->name() );
+                    writer.attr( "stop", step->final_name() );
                 }
                 else if ( step->source().type() == MMVertex::Transport && step->target().type() == MMVertex::Road ) {
-                    if ( ! rd->network( step->source().network_id().get() ) ) {
-                        throw std::runtime_error( ( boost::format( "Can't find PT network ID %1%" ) % step->source().network_id().get() ).str() );
-                    }
-                    step_node = XML::new_node( "road_transport_step" );
-                    XML::set_prop( step_node, "type", "3" );
-                    XML::set_prop( step_node, "road", step->final_name() );
-                    XML::set_prop( step_node, "network", rd->network( step->source().network_id().get() )->name() );
-                    XML::set_prop( step_node, "stop", step->initial_name() );
+                    writer.start( "road_transport_step" );
+                    writer.attr( "type", "3" );
+                    writer.attr( "road", step->final_name() );
+                    writer.attr( "network", rd->network( step->source().network_id().get() )->name() );
+                    writer.attr( "stop", step->initial_name() );
                 }
                 else if ( step->source().type() == MMVertex::Road && step->target().type() == MMVertex::Poi ) {
-                    step_node = XML::new_node( "transfer_step" );
-                    XML::set_prop( step_node, "type", "5" );
-                    XML::set_prop( step_node, "road", step->initial_name() );
-                    XML::set_prop( step_node, "poi", step->final_name() );
-                    XML::set_prop( step_node, "final_mode", to_string( step->final_mode() ) );
+                    writer.start( "transfer_step" );
+                    writer.attr( "type", "5" );
+                    writer.attr( "road", step->initial_name() );
+                    writer.attr( "poi", step->final_name() );
+                    writer.attr( "final_mode", to_string( step->final_mode() ) );
                 }
                 else if ( step->source().type() == MMVertex::Poi && step->target().type() == MMVertex::Road ) {
-                    step_node = XML::new_node( "transfer_step" );
-                    XML::set_prop( step_node, "type", "6" );
-                    XML::set_prop( step_node, "road", step->final_name() );
-                    XML::set_prop( step_node, "poi", step->initial_name() );
-                    XML::set_prop( step_node, "final_mode", to_string( step->final_mode() ) );
+                    writer.start( "transfer_step" );
+                    writer.attr( "type", "6" );
+                    writer.attr( "road", step->final_name() );
+                    writer.attr( "poi", step->initial_name() );
+                    writer.attr( "final_mode", to_string( step->final_mode() ) );
                 }
-                else if ( step->source().type() == MMVertex::Road && step->target().type() == MMVertex::Road ) {
-                    step_node = XML::new_node( "transfer_step" );
-                    XML::set_prop( step_node, "type", "1" );
-                    XML::set_prop( step_node, "road", step->final_name() );
-                    XML::set_prop( step_node, "poi", "0" );
-                    XML::set_prop( step_node, "final_mode", to_string( step->final_mode() ) );
+                else {
+                    BOOST_ASSERT( step->source().type() == MMVertex::Road && step->target().type() == MMVertex::Road );
+                    writer.start( "transfer_step" );
+                    writer.attr( "type", "1" );
+                    writer.attr( "road", step->final_name() );
+                    writer.attr( "poi", "0" );
+                    writer.attr( "final_mode", to_string( step->final_mode() ) );
                 }
             }
 
-            BOOST_ASSERT( step_node );
-
-            // transport_mode
-            XML::new_prop( step_node, "transport_mode", to_string(sit->transport_mode()) );
-
-            for ( Tempus::Costs::const_iterator cit = gstep->costs().begin(); cit != gstep->costs().end(); cit++ ) {
-                xmlNode* cost_node = XML::new_node( "cost" );
-                XML::new_prop( cost_node,
-                               "type",
-                               to_string( cit->first ) );
-                XML::new_prop( cost_node,
-                               "value",
-                               to_string( cit->second ) );
-                XML::add_child( step_node, cost_node );
-            }
-
-            XML::set_prop( step_node, "wkb", sit->geometry_wkb() );
-
-            XML::add_child( result_node, step_node );
+            writer.attr( "transport_mode", to_string(sit->transport_mode()) );
+            writer.attr( "wkb", sit->geometry_wkb() );
+            write_costs( writer, sit->costs() );
+            writer.end(); // step
         }
 
         // total costs
+        write_costs( writer, get_total_costs( roadmap ) );
 
-        Costs total_costs( get_total_costs(roadmap) );
-        for ( Tempus::Costs::const_iterator cit = total_costs.begin(); cit != total_costs.end(); cit++ ) {
-            xmlNode* cost_node = XML::new_node( "cost" );
-            XML::new_prop( cost_node,
-                           "type",
-                           to_string( cit->first ) );
-            XML::new_prop( cost_node,
-                           "value",
-                           to_string( cit->second ) );
-            XML::add_child( result_node, cost_node );
-        }
-
-        {
-            xmlNode* starting_dt_node = XML::new_node( "starting_date_time" );
-            std::string dt_string = boost::posix_time::to_iso_extended_string( roadmap.starting_date_time() );
-            XML::add_child( starting_dt_node, XML::new_text( dt_string ) );
-            XML::add_child( result_node, starting_dt_node );
-        }
+        writer.start( "starting_date_time" ).text( boost::posix_time::to_iso_extended_string( roadmap.starting_date_time() ) ).end();
 
         // path trace
         if ( roadmap.trace().size() ) {
-            xmlNode * trace_node = XML::new_node( "trace" );
+            writer.start( "trace" );
 
             for ( size_t i = 0; i < roadmap.trace().size(); i++ ) {
-                xmlNode *edge_node = XML::new_node("edge");
                 const ValuedEdge& ve = roadmap.trace()[i];
 
-                XML::set_prop( edge_node, "wkb", ve.geometry_wkb() );
-
-                MMVertex orig = ve.source();
-                MMVertex dest = ve.target();
-
-                xmlNode *orig_node = 0;
-                if ( orig.type() == MMVertex::Road ) {
-                    orig_node = XML::new_node("road");
-                    XML::set_prop(orig_node, "id", to_string(orig.id()));
-                }
-                else if ( orig.type() == MMVertex::Transport ) {
-                    orig_node = XML::new_node("pt");
-                    XML::set_prop(orig_node, "id", to_string(orig.id()));
-                }
-                else if ( orig.type() == MMVertex::Poi ) {
-                    orig_node = XML::new_node("poi");
-                    XML::set_prop(orig_node, "id", to_string(orig.id()));
-                }
-                if (orig_node) {
-                    XML::add_child(edge_node, orig_node);
-                }
-
-                xmlNode *dest_node = 0;
-                if ( dest.type() == MMVertex::Road ) {
-                    dest_node = XML::new_node("road");
-                    XML::set_prop(dest_node, "id", to_string(dest.id()));
-                }
-                else if ( dest.type() == MMVertex::Transport ) {
-                    dest_node = XML::new_node("pt");
-                    XML::set_prop(dest_node, "id", to_string(dest.id()));
-                }
-                else if ( dest.type() == MMVertex::Poi ) {
-                    dest_node = XML::new_node("poi");
-                    XML::set_prop(dest_node, "id", to_string(dest.id()));
-                }
-                if (dest_node) {
-                    XML::add_child(edge_node, dest_node);
-                }
+                writer.start( "edge" ).attr( "wkb", ve.geometry_wkb() );
+                write_trace_vertex( writer, ve.source() );
+                write_trace_vertex( writer, ve.target() );
 
                 VariantMap::const_iterator vit;
                 for ( vit = ve.values().begin(); vit != ve.values().end(); ++vit ) {
-                    xmlNode *n = 0;
+                    const char* tag = 0;
                     if (vit->second.type() == BoolVariant) {
-                        n = XML::new_node("b");
+                        tag = "b";
                     }
                     else if (vit->second.type() == IntVariant) {
-                        n = XML::new_node("i");
+                        tag = "i";
                     }
                     else if (vit->second.type() == FloatVariant) {
-                        n = XML::new_node("f");
+                        tag = "f";
                     }
                     else if (vit->second.type() == StringVariant) {
-                        n = XML::new_node("s");
+                        tag = "s";
                     }
-                    if (n ) {
-                        XML::set_prop(n, "k", vit->first);
-                        XML::set_prop(n, "v", vit->second.str());
-                        XML::add_child(edge_node, n);
+                    if ( tag ) {
+                        writer.start( tag ).attr( "k", vit->first ).attr( "v", vit->second.str() ).end();
                     }
                 }
-                XML::add_child(trace_node, edge_node);
+                writer.end(); // edge
             }
-            XML::add_child(result_node, trace_node);
+            writer.end(); // trace
         }
 
-        XML::add_child( root_node, result_node );
+        writer.end(); // result
     } // for each result
 
-    output_parameters[ "results" ] = root_node;
+    writer.end();
+}
+
+///
+/// "result" service, get results from a path query.
+///
+/// Output var: results, see roadmap.hh
+///
+SelectService::SelectService() : Service( "select" ) {
+    add_input_parameter( "plugin" );
+    add_input_parameter( "request" );
+    add_input_parameter( "options" );
+    add_output_parameter( "results" );
+    add_output_parameter( "metrics" );
+}
+
+Service::OutputMap SelectService::execute_streamed( const ParameterMap& input_parameter_map ) const
+{
+    // inputs have been validated against their schemas while the request was read
+    Service::check_parameter_names( input_parameter_map, input_parameter_schema_ );
+    const xmlNode* plugin_node = input_parameter_map.find( "plugin" )->second;
+    const std::string plugin_str = XML::get_prop( plugin_node, "name" );
+    std::shared_ptr<Plugin> plugin = PluginFactory::instance()->plugin_handle( plugin_str );
+
+    if ( plugin == nullptr ) {
+        throw std::invalid_argument( "Cannot find plugin " + plugin_str );
+    }
+    ServerState::PluginSlot slot( plugin_str );
+    Instrumentation::set_label( plugin_str );
+
+    // get options
+    VariantMap options = parse_options( input_parameter_map.find( "options" )->second );
+    std::unique_ptr<PluginRequest> plugin_request( plugin->request(options) );
+    std::shared_ptr<const Result> result;
+
+    // pre_process
+    {
+        Db::PooledConnection pooled_connection( plugin->db_options() );
+        Tempus::Request request;
+        {
+            Instrumentation::ScopedPhase parse_phase( Instrumentation::ParsePhase );
+            request = parse_request( input_parameter_map.find( "request" )->second, *pooled_connection );
+        }
+
+        // then call process, identical requests are answered by the result cache
+        Instrumentation::ScopedPhase search_phase( Instrumentation::SearchPhase );
+        result = plugin_request->process_cached( request );
+    }
+
+    const RoutingData* rd = plugin->routing_data();
+    check_result_networks( *result, rd );
+
+    OutputMap outputs;
+
+    // the request and its result are kept alive by the writers
+    std::shared_ptr<PluginRequest> shared_request( plugin_request.release() );
+    outputs[ "metrics" ] = [shared_request]( XML::Writer& writer ) {
+        writer.start( "metrics" );
+        for ( auto metric : shared_request->metrics() ) {
+            writer.start( "metric" ).attr( "name", metric.first ).attr( "value", shared_request->metric_to_string( metric.first ) ).end();
+        }
+        writer.end();
+    };
+
+    // the plugin handle keeps rd alive if the plugin is reloaded before the results are written
+    outputs[ "results" ] = [result, rd, plugin]( XML::Writer& writer ) {
+        write_results( writer, *result, rd );
+    };
 
 #ifdef TIMING_ENABLED
     timer.stop();
     std::cout << timer.elapsed().wall*1.e-9 << " in select " << plugin->name()<< "\n";
 #endif
 #undef TIMING
+    return outputs;
+}
+
+///
+/// "many_to_many" service, computes a cost matrix between sources and targets.
+/// The plugin must be based on CH routing data (ch_plugin).
+///
+/// Output var: matrix, one row per source, one cost per target
+///
+ManyToManyService::ManyToManyService() : Service( "many_to_many" ) {
+    add_input_parameter( "plugin" );
+    add_input_parameter( "sources" );
+    add_input_parameter( "targets" );
+    add_output_parameter( "matrix" );
+    add_output_parameter( "metrics" );
+}
+
+Service::OutputMap ManyToManyService::execute_streamed( const ParameterMap& input_parameter_map ) const
+{
+    Service::check_parameter_names( input_parameter_map, input_parameter_schema_ );
+    const xmlNode* plugin_node = input_parameter_map.find( "plugin" )->second;
+    const std::string plugin_str = XML::get_prop( plugin_node, "name" );
+    std::shared_ptr<Plugin> plugin = PluginFactory::instance()->plugin_handle( plugin_str );
+
+    if ( plugin == nullptr ) {
+        throw std::invalid_argument( "Cannot find plugin " + plugin_str );
+    }
+    ServerState::PluginSlot slot( plugin_str );
+
+    const CHRoutingData* rd = dynamic_cast<const CHRoutingData*>( plugin->routing_data() );
+    if ( rd == nullptr ) {
+        throw std::invalid_argument( "Plugin " + plugin_str + " is not based on CH routing data" );
+    }
+    Instrumentation::set_label( plugin_str );
+
+    Timer timer;
+
+    // parse a list of points into db ids and CH vertices
+    auto parse_points = [&rd, &plugin]( const xmlNode* list_node, std::vector<db_id_t>& ids, std::vector<CHVertex>& vertices ) {
+        Db::PooledConnection pooled_connection( plugin->db_options() );
+        Db::Connection& db = *pooled_connection;
+        const xmlNode* field = XML::get_next_nontext( list_node->children );
+        while ( field ) {
+            db_id_t id = get_vertex_id_from_point( field, db );
+            boost::optional<CHVertex> v = rd->vertex_from_id( id );
+            if ( !v ) {
+                throw std::invalid_argument( ( boost::format( "Can't find vertex of ID %1%" ) % id ).str() );
+            }
+            ids.push_back( id );
+            vertices.push_back( v.get() );
+            field = XML::get_next_nontext( field->next );
+        }
+    };
+
+    std::vector<db_id_t> source_ids, target_ids;
+    std::vector<CHVertex> sources, targets;
+    {
+        Instrumentation::ScopedPhase parse_phase( Instrumentation::ParsePhase );
+        parse_points( input_parameter_map.find( "sources" )->second, source_ids, sources );
+        parse_points( input_parameter_map.find( "targets" )->second, target_ids, targets );
+    }
+
+    std::shared_ptr<std::vector<float> > costs;
+    {
+        Instrumentation::ScopedPhase search_phase( Instrumentation::SearchPhase );
+        costs.reset( new std::vector<float>( ch_many_to_many( *rd, sources, targets ) ) );
+    }
+    const double elapsed = timer.elapsed();
+
+    OutputMap outputs;
+    outputs[ "metrics" ] = [elapsed]( XML::Writer& writer ) {
+        writer.start( "metrics" );
+        writer.start( "metric" ).attr( "name", "time_s" ).attr( "value", to_string( elapsed ) ).end();
+        writer.end();
+    };
+
+    const size_t num_targets = targets.size();
+    std::shared_ptr<std::vector<db_id_t> > shared_source_ids( new std::vector<db_id_t>() );
+    std::shared_ptr<std::vector<db_id_t> > shared_target_ids( new std::vector<db_id_t>() );
+    shared_source_ids->swap( source_ids );
+    shared_target_ids->swap( target_ids );
+    outputs[ "matrix" ] = [costs, shared_source_ids, shared_target_ids, num_targets]( XML::Writer& writer ) {
+        writer.start( "matrix" );
+        for ( size_t i = 0; i < shared_source_ids->size(); i++ ) {
+            writer.start( "row" ).attr( "source", (*shared_source_ids)[i] );
+            for ( size_t j = 0; j < num_targets; j++ ) {
+                const float c = (*costs)[i * num_targets + j];
+                writer.start( "cost" ).attr( "target", (*shared_target_ids)[j] );
+                if ( c == std::numeric_limits<float>::max() ) {
+                    writer.attr( "value", "-1" );
+                }
+                else {
+                    writer.attr( "value", to_string( c ) );
+                }
+                writer.end();
+            }
+            writer.end();
+        }
+        writer.end();
+    };
+
+    return outputs;
+}
+
+///
+/// "select_batch" service, processes a list of requests that share the same plugin options.
+/// Requests are processed in parallel by Plugin::process_batch().
+///
+/// Output var: results, for each request its total costs, and its roadmaps if the "roadmaps" attribute of the requests is true
+/// Output var: metrics, for the whole batch
+///
+SelectBatchService::SelectBatchService() : Service( "select_batch" ) {
+    add_input_parameter( "plugin" );
+    add_input_parameter( "requests" );
+    add_input_parameter( "options" );
+    add_output_parameter( "results" );
+    add_output_parameter( "metrics" );
+}
+
+Service::OutputMap SelectBatchService::execute_streamed( const ParameterMap& input_parameter_map ) const
+{
+    Service::check_parameter_names( input_parameter_map, input_parameter_schema_ );
+    const xmlNode* plugin_node = input_parameter_map.find( "plugin" )->second;
+    const std::string plugin_str = XML::get_prop( plugin_node, "name" );
+    std::shared_ptr<Plugin> plugin = PluginFactory::instance()->plugin_handle( plugin_str );
+
+    if ( plugin == nullptr ) {
+        throw std::invalid_argument( "Cannot find plugin " + plugin_str );
+    }
+    ServerState::PluginSlot slot( plugin_str );
+
+    Timer timer;
+
+    VariantMap options = parse_options( input_parameter_map.find( "options" )->second );
+
+    const xmlNode* requests_node = input_parameter_map.find( "requests" )->second;
+    const bool with_roadmaps = XML::has_prop( requests_node, "roadmaps" ) && XML::get_prop( requests_node, "roadmaps" ) == "true";
+    // a client cannot ask for more threads than the server has, 0 is the default number of threads
+    int num_threads = XML::has_prop( requests_node, "threads" ) ? lexical_cast<int>( XML::get_prop( requests_node, "threads" ) ) : 0;
+    num_threads = std::max( 0, std::min( num_threads, omp_get_max_threads() ) );
+
+    std::shared_ptr<std::vector<Tempus::Request> > requests( new std::vector<Tempus::Request>() );
+    {
+        Instrumentation::ScopedPhase parse_phase( Instrumentation::ParsePhase );
+        Db::PooledConnection pooled_connection( plugin->db_options() );
+        const xmlNode* field = XML::get_next_nontext( requests_node->children );
+        while ( field ) {
+            requests->push_back( parse_request( field, *pooled_connection ) );
+            field = XML::get_next_nontext( field->next );
+        }
+    }
+
+    std::shared_ptr<std::vector<Plugin::BatchResult> > results( new std::vector<Plugin::BatchResult>( plugin->process_batch( *requests, options, num_threads ) ) );
+
+    const RoutingData* rd = plugin->routing_data();
+    size_t num_errors = 0;
+    for ( const Plugin::BatchResult& r : *results ) {
+        if ( !r.result ) {
+            num_errors++;
+        }
+        else if ( with_roadmaps ) {
+            check_result_networks( *r.result, rd );
+        }
+    }
+
+    OutputMap outputs;
+
+    const double elapsed = timer.elapsed();
+    const size_t num_requests = requests->size();
+    outputs[ "metrics" ] = [elapsed, num_requests, num_errors]( XML::Writer& writer ) {
+        writer.start( "metrics" );
+        writer.start( "metric" ).attr( "name", "time_s" ).attr( "value", to_string( elapsed ) ).end();
+        writer.start( "metric" ).attr( "name", "requests" ).attr( "value", to_string( num_requests ) ).end();
+        writer.start( "metric" ).attr( "name", "errors" ).attr( "value", to_string( num_errors ) ).end();
+        writer.end();
+    };
+
+    // the plugin handle keeps rd alive if the plugin is reloaded before the results are written
+    outputs[ "results" ] = [requests, results, with_roadmaps, rd, plugin]( XML::Writer& writer ) {
+        writer.start( "results" );
+        for ( size_t i = 0; i < results->size(); i++ ) {
+            const Plugin::BatchResult& r = (*results)[i];
+            writer.start( "pair" );
+            writer.attr( "index", i ).attr( "origin", (*requests)[i].origin() ).attr( "destination", (*requests)[i].destination() );
+            if ( !r.result ) {
+                writer.attr( "error", r.error );
+            }
+            else {
+                if ( !r.result->empty() ) {
+                    write_costs( writer, get_total_costs( r.result->front() ) );
+                }
+                if ( with_roadmaps ) {
+                    write_results( writer, *r.result, rd );
+                }
+            }
+            writer.end();
+        }
+        writer.end();
+    };
+
+    return outputs;
+}
+
+///
+/// "server_metrics" service, outputs the load of the server: request queue depth, rejected requests, requests running on each plugin.
+///
+/// Output var: metrics
+///
+ServerMetricsService::ServerMetricsService() : Service( "server_metrics" ) {
+    add_output_parameter( "metrics" );
+}
+
+Service::ParameterMap ServerMetricsService::execute( const ParameterMap& /*input_parameter_map*/ ) const
+{
+    ParameterMap output_parameters;
+
+    xmlNode* metrics_node = XML::new_node( "metrics" );
+    std::map<std::string, std::string> metrics = ServerState::instance().metrics();
+    for ( std::map<std::string, std::string>::const_iterator it = metrics.begin(); it != metrics.end(); it++ ) {
+        xmlNode* metric_node = XML::new_node( "metric" );
+        XML::new_prop( metric_node, "name", it->first );
+        XML::new_prop( metric_node, "value", it->second );
+        XML::add_child( metrics_node, metric_node );
+    }
+    output_parameters[ "metrics" ] = metrics_node;
+    return output_parameters;
+}
+
+///
+/// "reload" service, reloads a plugin along with its routing data (graph, timetables) without stopping the server.
+/// Data are loaded by a background thread, requests are processed by the current plugin in the meantime.
+/// See PluginFactory::reload_plugin(). The progress of reloads is reported by server_metrics.
+///
+/// Output var: reload, with a "started" status, or "running" if a reload of this plugin is already running
+///
+ReloadService::ReloadService() : Service( "reload" ) {
+    add_input_parameter( "plugin" );
+    add_output_parameter( "reload" );
+}
+
+Service::ParameterMap ReloadService::execute( const ParameterMap& input_parameter_map ) const
+{
+    Service::check_parameter_names( input_parameter_map, input_parameter_schema_ );
+    const xmlNode* plugin_node = input_parameter_map.find( "plugin" )->second;
+    const std::string plugin_str = XML::get_prop( plugin_node, "name" );
+
+    if ( PluginFactory::instance()->plugin_handle( plugin_str ) == nullptr ) {
+        throw std::invalid_argument( "Cannot find plugin " + plugin_str );
+    }
+
+    std::string status = "running";
+    if ( ServerState::instance().start_reload( plugin_str ) ) {
+        boost::thread reload_thread( [plugin_str]() {
+            try {
+                TextProgression progression;
+                PluginFactory::instance()->reload_plugin( plugin_str, progression );
+                ServerState::instance().end_reload( plugin_str, "" );
+            }
+            catch ( std::exception& e ) {
+                CERR << "Reload of " << plugin_str << " failed: " << e.what() << std::endl;
+                ServerState::instance().end_reload( plugin_str, e.what() );
+            }
+        } );
+        reload_thread.detach();
+        status = "started";
+    }
+
+    ParameterMap output_parameters;
+    xmlNode* reload_node = XML::new_node( "reload" );
+    XML::new_prop( reload_node, "plugin", plugin_str );
+    XML::new_prop( reload_node, "status", status );
+    output_parameters[ "reload" ] = reload_node;
     return output_parameters;
 }
 
@@ -35,6 +35,30 @@ public:
 class SelectService : public Service {
 public:
     SelectService();
+    Service::OutputMap execute_streamed( const ParameterMap& input_parameter_map ) const;
+};
+
+class ManyToManyService : public Service {
+public:
+    ManyToManyService();
+    Service::OutputMap execute_streamed( const ParameterMap& input_parameter_map ) const;
+};
+
+class SelectBatchService : public Service {
+public:
+    SelectBatchService();
+    Service::OutputMap execute_streamed( const ParameterMap& input_parameter_map ) const;
+};
+
+class ServerMetricsService : public Service {
+public:
+    ServerMetricsService();
+    Service::ParameterMap execute( const ParameterMap& /*input_parameter_map*/ ) const;
+};
+
+class ReloadService : public Service {
+public:
+    ReloadService();
     Service::ParameterMap execute( const ParameterMap& input_parameter_map ) const;
 };
 
@@ -23,6 +23,8 @@
 #include <list>
 #include <vector>
 #include <map>
+#include <iterator>
+#include <memory>
 
 #ifdef _WIN32
 #pragma warning(push, 0)
@@ -33,13 +35,50 @@
 #pragma warning(pop)
 #endif
 
+#include <libxml/xmlreader.h>
+
 #include "wps_request.hh"
 #include "wps_service.hh"
 #include "xml_helper.hh"
+#include "server_state.hh"
+#include "instrumentation.hh"
+#include "deadline.hh"
 
 using namespace std;
 
 static boost::mutex print_error_status_mutex;
+
+typedef scoped_ptr<xmlTextReader, xmlFreeTextReader> scoped_xmlTextReader;
+
+///
+/// Moves the reader to the next element of the given depth, inside the current parent element.
+/// Returns 1 if an element is found, 0 at the end of the parent, -1 on a parse error
+static int next_element( xmlTextReader* reader, int depth )
+{
+    int ret;
+    while ( ( ret = xmlTextReaderRead( reader ) ) == 1 ) {
+        const int d = xmlTextReaderDepth( reader );
+        if ( d < depth ) {
+            return 0;
+        }
+        if ( d == depth && xmlTextReaderNodeType( reader ) == XML_READER_TYPE_ELEMENT ) {
+            return 1;
+        }
+    }
+    return ret;
+}
+
+static bool is_element( xmlTextReader* reader, const char* name )
+{
+    return !xmlStrcmp( xmlTextReaderConstLocalName( reader ), ( const xmlChar* )name );
+}
+
+static string last_xml_error()
+{
+    const xmlError* error = xmlGetLastError();
+    return error && error->message ? error->message : "parse error";
+}
+
 namespace WPS {
 
 int Request::print_error_status( int status, const std::string& msg )
@@ -66,6 +105,28 @@ int Request::print_exception( const std::string& type, const std::string& messag
 }
 
 int Request::process()
+{
+    // the label is changed to the one of the service, then to the one of the plugin, if any
+    Tempus::Instrumentation::RequestScope scope( "wps" );
+    const int status = process_request();
+    if ( status != 0 ) {
+        scope.set_error();
+    }
+    return status;
+}
+
+int Request::print_metrics()
+{
+    Tempus::Instrumentation::set_label( "metrics" );
+    outs_ << "Content-type: text/plain; version=0.0.4" << endl;
+    outs_ << endl;
+    ServerState::instance().write_text( outs_ );
+    Tempus::Instrumentation::write_text( outs_ );
+    outs_.flush();
+    return 0;
+}
+
+int Request::process_request()
 {
     if ( getParam( "REQUEST_METHOD" ) == 0 ) {
         CERR << "This program is intended to be called from a web server, as a CGI" << endl;
@@ -75,7 +136,10 @@ int Request::process()
     string request_method = getParam( "REQUEST_METHOD" );
 
     // libxml inits
+    // the document keeps the input trees, it is declared first so that it outlives the reader
     scoped_xmlDoc xml_doc;
+    string body;
+    scoped_xmlTextReader reader;
 
     // Local map that stores request parameters :
     // Service
@@ -109,50 +173,49 @@ int Request::process()
             return print_error_status( 406, "Wrong content-type. Must be text/xml" );
         }
 
-        // The root XML element must be the name of the operation
-        string doc;
-
-        while ( !ins_.eof() ) {
-            char c;
-            ins_.get( c );
+        Tempus::Instrumentation::ScopedPhase parse_phase( Tempus::Instrumentation::ParsePhase );
 
-            if ( ins_.eof() ) {
-                break;
-            }
-
-            doc.push_back( c );
-        }
+        // The root XML element must be the name of the operation
+        body.assign( istreambuf_iterator<char>( ins_ ), istreambuf_iterator<char>() );
 
-        CERR << doc << endl;
-        xml_doc = xmlReadMemory( doc.c_str(), doc.size(), getParam( "REQUEST_URI" ), NULL, XML_PARSE_NOERROR );
+        CERR << body << endl;
+        // the body is read as a stream of nodes, only the inputs of an Execute operation are expanded into trees.
+        // Blank text nodes are not kept, the trees are then smaller to validate and walk
+        reader = xmlReaderForMemory( body.c_str(), body.size(), getParam( "REQUEST_URI" ), NULL, XML_PARSE_NOERROR | XML_PARSE_NOBLANKS );
 
-        if ( xml_doc.get() == NULL ) {
-            return print_exception( WPS_INVALID_PARAMETER_VALUE, "Malformed XML request: " + string( xmlGetLastError()->message ) );
+        if ( reader.get() == NULL || next_element( reader.get(), 0 ) != 1 ) {
+            return print_exception( WPS_INVALID_PARAMETER_VALUE, "Malformed XML request: " + last_xml_error() );
         }
 
-        xmlNodePtr root = xmlDocGetRootElement( xml_doc.get() );
-        query["request"] = ( const char* )root->name;
+        query["request"] = ( const char* )xmlTextReaderConstLocalName( reader.get() );
 
-        xmlChar* service = xmlGetProp( root, ( const xmlChar* )"service" );
+        xmlChar* service = xmlTextReaderGetAttribute( reader.get(), ( const xmlChar* )"service" );
 
         if ( service == NULL ) {
             query["service"] = "";
         }
         else {
             query["service"] = ( const char* )service;
+            xmlFree( service );
         }
 
-        xmlChar* version = xmlGetProp( root, ( const xmlChar* )"version" );
+        xmlChar* version = xmlTextReaderGetAttribute( reader.get(), ( const xmlChar* )"version" );
 
         if ( version == NULL ) {
             query["version"] = "";
         }
         else {
             query["version"] = ( const char* )version;
+            xmlFree( version );
         }
     }
 
 
+    // plain text metrics, for scrapers
+    if ( request_method == "GET" && boost::to_lower_copy( query["request"] ) == "metrics" ) {
+        return print_metrics();
+    }
+
     if ( boost::to_lower_copy( query["service"] ) != "wps" ) {
         return print_error_status( 400, "Only 'wps' service is supported." );
     }
@@ -197,33 +260,54 @@ int Request::process()
             return print_error_status( 405, "Method not allowed" );
         }
 
-        xmlNode* root = xmlDocGetRootElement( xml_doc.get() );
-        const xmlNode* child = XML::get_next_nontext( root->children );
+        // the phase ends once the inputs are known
+        std::unique_ptr<Tempus::Instrumentation::ScopedPhase> parse_phase( new Tempus::Instrumentation::ScopedPhase( Tempus::Instrumentation::ParsePhase ) );
 
+        xmlTextReader* r = reader.get();
         string identifier;
 
-        if ( child && !xmlStrcmp( child->name, ( const xmlChar* )"Identifier" ) ) {
-            if ( child->children && child->children->content ) {
-                identifier = ( const char* )child->children->content;
+        int ret = next_element( r, 1 );
+        if ( ret == 1 && is_element( r, "Identifier" ) ) {
+            xmlChar* content = xmlTextReaderReadString( r );
+            if ( content ) {
+                identifier = ( const char* )content;
+                xmlFree( content );
             }
+            ret = next_element( r, 1 );
+        }
+
+        if ( ret < 0 ) {
+            return print_exception( WPS_INVALID_PARAMETER_VALUE, "Malformed XML request: " + last_xml_error() );
         }
 
         if ( identifier == "" ) {
             return print_exception( WPS_INVALID_PARAMETER_VALUE, "Identifier undefined" );
         }
 
-        child = XML::get_next_nontext( child->next );
+        // the service is needed to validate each input as soon as it is read
+        if ( !WPS::Service::exists( identifier ) ) {
+            return print_exception( WPS_INVALID_PARAMETER_VALUE, "Unknown service identifier " + identifier );
+        }
+        const WPS::Service* service( WPS::Service::get_service( identifier ) );
+
         // Parse DataInputs and make a map for each input string -> xmlNode*
         WPS::Service::ParameterMap input_parameter_map;
 
-        if ( child && !xmlStrcmp( child->name, ( const xmlChar* )"DataInputs" ) ) {
-            const xmlNode* node = XML::get_next_nontext( child->children );
-
-            while ( node ) {
-                if ( xmlStrcmp( node->name, ( const xmlChar* )"Input" ) ) {
+        if ( ret == 1 && is_element( r, "DataInputs" ) ) {
+            // each Input is expanded into a tree, validated, and kept in the document of the reader
+            const bool empty = xmlTextReaderIsEmptyElement( r ) == 1;
+            while ( !empty && ( ret = next_element( r, 2 ) ) == 1 ) {
+                if ( !is_element( r, "Input" ) ) {
                     return print_exception( WPS_INVALID_PARAMETER_VALUE, "Only Input elements are allowed inside DataInputs" );
                 }
 
+                const xmlNode* node = xmlTextReaderExpand( r );
+
+                if ( node == NULL ) {
+                    return print_exception( WPS_INVALID_PARAMETER_VALUE, "Malformed XML request: " + last_xml_error() );
+                }
+                xmlTextReaderPreserve( r );
+
                 const xmlNode* nnode = XML::get_next_nontext( node->children );
 
                 string id;
@@ -263,48 +347,70 @@ int Request::process()
 
                 const xmlNode* actual_data = XML::get_next_nontext( n->children );
 
+                if ( actual_data == 0 ) {
+                    return print_exception( WPS_INVALID_PARAMETER_VALUE, "Undefined data" );
+                }
+
+                try {
+                    service->check_input_parameter( id, actual_data );
+                }
+                catch ( std::invalid_argument& e ) {
+                    return print_exception( WPS_INVALID_PARAMETER_VALUE, e.what() );
+                }
+
                 // associate xml data to identifier
                 input_parameter_map[id] = const_cast<xmlNode*>( actual_data );
+            }
 
-                // next input
-                node = XML::get_next_nontext( node->next );
+            if ( ret >= 0 ) {
+                ret = next_element( r, 1 );
             }
         }
         else {
             return print_exception( WPS_INVALID_PARAMETER_VALUE, "DataInputs undefined" );
         }
 
-        child = XML::get_next_nontext( child->next );
+        if ( ret == 1 && is_element( r, "ResponseForm" ) ) {
+            const xmlNode* form = xmlTextReaderExpand( r );
+            const xmlNode* output = form ? XML::get_next_nontext( form->children ) : 0;
 
-        if ( child && !xmlStrcmp( child->name, ( const xmlChar* )"ResponseForm" ) ) {
-            child = XML::get_next_nontext( child->children );
-
-            if ( child && xmlStrcmp( child->name, ( const xmlChar* )"RawDataOutput" ) ) {
+            if ( output && xmlStrcmp( output->name, ( const xmlChar* )"RawDataOutput" ) ) {
                 return print_exception( WPS_INVALID_PARAMETER_VALUE, "Only raw data output are supported" );
             }
         }
-        else {
+        else if ( ret >= 0 ) {
             return print_exception( WPS_INVALID_PARAMETER_VALUE, "Responseform undefined" );
         }
 
-        if ( !WPS::Service::exists( identifier ) ) {
-            return print_exception( WPS_INVALID_PARAMETER_VALUE, "Unknown service identifier " + identifier );
+        // the preserved inputs belong to the document of the reader, that is now freed with xml_doc
+        xml_doc = xmlTextReaderCurrentDoc( r );
+
+        // the end of the request is read, so that a malformed request is rejected before it is executed
+        while ( ret == 1 ) {
+            ret = xmlTextReaderRead( r );
         }
 
-        // all inputs are now defined, parse them
-        const WPS::Service* service( WPS::Service::get_service( identifier ) );
+        if ( ret < 0 ) {
+            return print_exception( WPS_INVALID_PARAMETER_VALUE, "Malformed XML request: " + last_xml_error() );
+        }
+        parse_phase.reset();
+        Tempus::Instrumentation::set_label( identifier );
 
+        // all inputs are now defined and validated, parse them
         try {
-            WPS::Service::ParameterMap outputs = service->execute( input_parameter_map );
+            // outputs are computed first, then written directly to the output stream
+            WPS::Service::OutputMap outputs = service->execute_streamed( input_parameter_map );
 
+            Tempus::Instrumentation::ScopedPhase serialize_phase( Tempus::Instrumentation::SerializePhase );
             outs_ << "Content-type: text/xml" << endl;
             outs_ << endl;
             service->get_xml_execute_response( outs_, getParam( "REQUEST_URI" ), outputs );
-
-            // must free xmlNode in outputs
-            for ( WPS::Service::ParameterMap::iterator it = outputs.begin(); it != outputs.end(); ++it ) {
-                xmlFreeNode( it->second );
-            }
+        }
+        catch ( WPS::ServiceUnavailable& e ) {
+            return print_error_status( 503, e.what() );
+        }
+        catch ( Tempus::DeadlineExceeded& e ) {
+            return print_error_status( 504, e.what() );
         }
         catch ( std::invalid_argument& e ) {
             return print_exception( WPS_INVALID_PARAMETER_VALUE, e.what() );
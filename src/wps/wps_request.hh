@@ -36,6 +36,8 @@ public:
     Request( std::streambuf* ins, std::streambuf* outs, char** env ) : ins_( ins ), outs_( outs ), env_( env )
     {}
 
+    ///
+    /// Process the request, its latency is recorded by Tempus::Instrumentation
     int process();
     const char* getParam( const char* name ) {
         return FCGX_GetParam( name, env_ );
@@ -43,7 +45,13 @@ public:
 
     int print_error_status( int status, const std::string& msg );
     int print_exception( const std::string& type, const std::string& msg );
+
+    ///
+    /// Answer a GET request with "request=metrics": server state and request latencies in the Prometheus text format
+    int print_metrics();
 protected:
+    int process_request();
+
     std::istream ins_;
     std::ostream outs_;
     char** env_;
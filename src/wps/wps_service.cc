@@ -17,6 +17,7 @@
 
 #include <iostream>
 #include <stdexcept>
+#include <memory>
 #include <boost/format.hpp>
 
 #include "application.hh"
@@ -62,6 +63,23 @@ Service::ParameterMap Service::execute( const Service::ParameterMap& input_param
     return ParameterMap();
 }
 
+Service::OutputMap Service::execute_streamed( const Service::ParameterMap& input_parameter_map ) const
+{
+    ParameterMap output_parameters = execute( input_parameter_map );
+
+    OutputMap outputs;
+    for ( ParameterMap::const_iterator it = output_parameters.begin(); it != output_parameters.end(); ++it ) {
+        // the tree is freed with its writer
+        std::shared_ptr<xmlNode> node( it->second, xmlFreeNode );
+        outputs[it->first] = [node]( XML::Writer& writer ) {
+            writer.node( node.get() );
+        };
+    }
+
+    check_parameters( output_parameters, output_parameter_schema_ );
+    return outputs;
+}
+
 void Service::add_input_parameter( const std::string& name, const std::string& schema )
 {
     if ( schema.empty() ) {
@@ -88,11 +106,22 @@ void Service::add_output_parameter( const std::string& name, const std::string&
 
 void Service::parse_xml_parameters( const ParameterMap& input_parameter_map ) const
 {
-    // default behaviour: only check schemas
-    check_parameters( input_parameter_map, input_parameter_schema_ );
+    // default behaviour: only check parameters, they have been validated while the request was read
+    check_parameter_names( input_parameter_map, input_parameter_schema_ );
 }
 
-void Service::check_parameters( const ParameterMap& parameter_map, const SchemaMap& schema_map ) const
+void Service::check_input_parameter( const std::string& name, const xmlNode* node ) const
+{
+    SchemaMap::const_iterator itv = input_parameter_schema_.find( name );
+
+    if ( itv == input_parameter_schema_.end() ) {
+        throw std::invalid_argument( "Unknown parameter " + name );
+    }
+
+    itv->second->ensure_validity( node );
+}
+
+void Service::check_parameter_names( const ParameterMap& parameter_map, const SchemaMap& schema_map ) const
 {
     if ( parameter_map.size() != schema_map.size() ) {
         std::string argList;
@@ -109,13 +138,18 @@ void Service::check_parameters( const ParameterMap& parameter_map, const SchemaM
     }
 
     for ( ParameterMap::const_iterator it = parameter_map.begin(); it != parameter_map.end(); it++ ) {
-        SchemaMap::const_iterator itv = schema_map.find( it->first );
-
-        if ( itv == schema_map.end() ) {
+        if ( schema_map.find( it->first ) == schema_map.end() ) {
             throw std::invalid_argument( "Unknown parameter " + it->first );
         }
+    }
+}
+
+void Service::check_parameters( const ParameterMap& parameter_map, const SchemaMap& schema_map ) const
+{
+    check_parameter_names( parameter_map, schema_map );
 
-        itv->second->ensure_validity( it->second );
+    for ( ParameterMap::const_iterator it = parameter_map.begin(); it != parameter_map.end(); it++ ) {
+        schema_map.find( it->first )->second->ensure_validity( it->second );
     }
 }
 
@@ -186,9 +220,16 @@ std::ostream& Service::get_xml_description( std::ostream& out ) const
     return out;
 }
 
-std::ostream& Service::get_xml_execute_response( std::ostream& out, const std::string& service_instance, const ParameterMap& outputs ) const
+std::ostream& Service::get_xml_execute_response( std::ostream& out, const std::string& service_instance, const OutputMap& outputs ) const
 {
-    check_parameters( outputs, output_parameter_schema_ );
+    if ( outputs.size() != output_parameter_schema_.size() ) {
+        throw std::runtime_error( ( boost::format( "Service %1% has %2% outputs, %3% expected" ) % name_ % outputs.size() % output_parameter_schema_.size() ).str() );
+    }
+    for ( OutputMap::const_iterator it = outputs.begin(); it != outputs.end(); it++ ) {
+        if ( output_parameter_schema_.find( it->first ) == output_parameter_schema_.end() ) {
+            throw std::runtime_error( "Unknown output " + it->first );
+        }
+    }
 
     out << "<wps:ExecuteResponse xmlns:xs=\"http://www.w3.org/2001/XMLSchema\" xmlns:wps=\"http://www.opengis.net/wps/1.0.0\" xmlns:ows=\"http://www.opengis.net/ows/1.1\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xsi:schemaLocation=\"http://schemas.opengis.net/wps/1.0.0/wpsDescribeProcess_response.xsd\" service=\"WPS\" version=\"1.0.0\" xml:lang=\"en-US\" serviceInstance=\"" << service_instance << "\">" << endl;
     out << "  <wps:Process wps:processVersion=\"1\">" << endl;
@@ -206,13 +247,16 @@ std::ostream& Service::get_xml_execute_response( std::ostream& out, const std::s
     out << "  </wps:Status>" << endl;
     out << "  <wps:ProcessOutputs>" << endl;
 
-    for ( ParameterMap::const_iterator it = outputs.begin(); it != outputs.end(); it++ ) {
+    for ( OutputMap::const_iterator it = outputs.begin(); it != outputs.end(); it++ ) {
         out << "    <wps:Output>" << endl;
         out << "      <ows:Identifier>" << it->first << "</ows:Identifier>" << endl;
         out << "      <ows:Title>" << it->first << "</ows:Title>" << endl;
         out << "      <wps:Data>" << endl;
         out << "        <wps:ComplexData>" << endl;
-        out << "          " << XML::to_string( it->second, 5 ) << endl;
+        out << "          ";
+        XML::Writer writer( out );
+        it->second( writer );
+        out << endl;
         out << "        </wps:ComplexData>" << endl;
         out << "      </wps:Data>" << endl;
         out << "    </wps:Output>" << endl;
@@ -232,6 +276,18 @@ const Service* Service::get_service( const std::string& name )
     return 0;
 }
 
+void Service::init_thread()
+{
+    for ( std::map<std::string, Service*>::const_iterator it = services_->begin(); it != services_->end(); it++ ) {
+        for ( SchemaMap::const_iterator sit = it->second->input_parameter_schema_.begin(); sit != it->second->input_parameter_schema_.end(); sit++ ) {
+            sit->second->init_thread();
+        }
+        for ( SchemaMap::const_iterator sit = it->second->output_parameter_schema_.begin(); sit != it->second->output_parameter_schema_.end(); sit++ ) {
+            sit->second->init_thread();
+        }
+    }
+}
+
 std::ostream& Service::get_xml_capabilities( std::ostream& out, const std::string& script_name )
 {
 
@@ -26,9 +26,11 @@
 
 #include <map>
 #include <string>
+#include <functional>
 
 #include "plugin.hh"
 #include "xml_helper.hh"
+#include "xml_writer.hh"
 
 namespace WPS {
 ///
@@ -36,6 +38,9 @@ namespace WPS {
 class Service {
 public:
     typedef std::map<std::string, xmlNode*> ParameterMap;
+    ///
+    /// Functions that write each output of an Execute operation, called while the response is streamed
+    typedef std::map<std::string, std::function<void ( XML::Writer& )> > OutputMap;
 
     Service( const std::string& name );
     virtual ~Service();
@@ -44,21 +49,37 @@ public:
     /// Extract input parameters
     void parse_xml_parameters( const ParameterMap& input_parameter_map ) const;
 
+    ///
+    /// Check an input parameter against its XML schema.
+    /// WPS::Request calls it on each input as soon as it is read, inputs given to execute() are then already validated
+    void check_input_parameter( const std::string& name, const xmlNode* node ) const;
+
     virtual ParameterMap execute( const ParameterMap& input_parameter_map ) const;
 
+    ///
+    /// Executes the service and returns the writers of its outputs.
+    /// Everything that may fail must be done here, so that errors are reported before the response is started.
+    /// The default implementation checks the trees returned by execute() against the output schemas and writes them.
+    virtual OutputMap execute_streamed( const ParameterMap& input_parameter_map ) const;
+
     ///
     /// Returns an XML string that conforms to a DescribeProcess operation
     std::ostream& get_xml_description( std::ostream& out ) const;
 
     ///
     /// Returns an XML string that represents results of an Execute operation
-    std::ostream& get_xml_execute_response( std::ostream& out, const std::string& service_instance, const ParameterMap& outputs ) const;
+    std::ostream& get_xml_execute_response( std::ostream& out, const std::string& service_instance, const OutputMap& outputs ) const;
 
     ///
     /// Global service map interface: returns a Service* based on a service name.
     /// The returned service is const and can be used in different threads
     static const Service* get_service( const std::string& name );
 
+    ///
+    /// Prepares the schema validation of every service for the calling thread.
+    /// To be called by each worker thread at startup, after XML::init()
+    static void init_thread();
+
     ///
     /// Global service map interface: tests if a service exists
     static bool exists( const std::string& name ) {
@@ -82,6 +103,10 @@ protected:
     /// Check parameters against their XML schemas
     virtual void check_parameters( const ParameterMap& parameter_map, const SchemaMap& schema_map ) const;
 
+    ///
+    /// Check that the parameters are the ones of the schema map, without validating them
+    void check_parameter_names( const ParameterMap& parameter_map, const SchemaMap& schema_map ) const;
+
     ///
     /// Adds an input parameter definition. To be called by derived classes in their constructor
     /// @param[in] name Name of the parameter
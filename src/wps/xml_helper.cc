@@ -19,14 +19,6 @@
 
 #include "xml_helper.hh"
 
-#ifdef _WIN32
-#pragma warning(push, 0)
-#endif
-#include <boost/thread.hpp>
-#ifdef _WIN32
-#pragma warning(pop)
-#endif
-
 using namespace std;
 
 namespace XML {
@@ -58,6 +50,20 @@ void ErrorHandling::accumulate_error( void* /*ctx*/, const char* msg, ... )
 #undef TMP_BUF_SIZE
 }
 
+void ErrorHandling::append_error( void* ctx, const char* msg, ... )
+{
+#define TMP_BUF_SIZE 1024
+    char buffer[TMP_BUF_SIZE];
+    va_list arg_ptr;
+
+    va_start( arg_ptr, msg );
+    vsnprintf( buffer, TMP_BUF_SIZE, msg, arg_ptr );
+    va_end( arg_ptr );
+
+    *static_cast<std::string*>( ctx ) += buffer;
+#undef TMP_BUF_SIZE
+}
+
 std::string escape_text( const std::string& message )
 {
     // escape the given error message
@@ -119,21 +125,24 @@ Schema::Schema() :
     schema_doc_( 0 ),
     parser_ctxt_( 0 ),
     schema_( 0 ),
-    valid_ctxt_( 0 ),
+    valid_ctxt_( xmlSchemaFreeValidCtxt ),
     schema_str_( "" )
 {
 }
 
-Schema::Schema( const std::string& schemaFile )
+Schema::Schema( const std::string& schemaFile ) :
+    schema_doc_( 0 ),
+    parser_ctxt_( 0 ),
+    schema_( 0 ),
+    valid_ctxt_( xmlSchemaFreeValidCtxt )
 {
     load( schemaFile );
 }
 
 Schema::~Schema()
 {
-    if ( valid_ctxt_ ) {
-        xmlSchemaFreeValidCtxt( valid_ctxt_ );
-    }
+    // only the context of this thread is freed here, the others are freed at the end of their thread
+    valid_ctxt_.reset();
 
     if ( schema_ ) {
         xmlSchemaFree( schema_ );
@@ -175,13 +184,6 @@ void Schema::load( const std::string& schema )
         throw std::invalid_argument( ErrorHandling::xml_error_ );
     }
 
-    valid_ctxt_ = xmlSchemaNewValidCtxt( schema_ );
-
-    if ( valid_ctxt_ == NULL ) {
-        // unable to create a validation context for the schema
-        ErrorHandling::clear_errors_ = true;
-        throw std::invalid_argument( ErrorHandling::xml_error_ );
-    }
 }
 
 std::string Schema::to_string( bool with_header ) const
@@ -195,27 +197,33 @@ std::string Schema::to_string( bool with_header ) const
     return schema_str_;
 }
 
-boost::mutex xml_mutex; // because libxml2 doc should not be shared between threads
-
-void Schema::ensure_validity( const xmlNode* node )
+void Schema::init_thread() const
 {
-    boost::lock_guard<boost::mutex> lock( xml_mutex ) ;
+    if ( schema_ == 0 || valid_ctxt_.get() != 0 ) {
+        return;
+    }
 
-    if ( valid_ctxt_ == 0 ) {
+    valid_ctxt_.reset( xmlSchemaNewValidCtxt( schema_ ) );
+    if ( valid_ctxt_.get() == 0 ) {
+        throw std::runtime_error( "Unable to create a schema validation context" );
+    }
+}
+
+void Schema::ensure_validity( const xmlNode* node ) const
+{
+    if ( schema_ == 0 ) {
         return;
     }
 
-    // create a new Doc from the subtree node
-    scoped_xmlDoc subtree_doc = xmlNewDoc( ( const xmlChar* )"1.0" );
-    // ! xmlDocSetRootElement update every nodes, use simple pointer affectation instead
-    subtree_doc.get()->children = const_cast<xmlNode*>( node );
-    int is_valid = ( xmlSchemaValidateDoc( valid_ctxt_, subtree_doc.get() ) == 0 );
-    // remove the root node from the subtree document to prevent double free()
-    subtree_doc.get()->children = NULL;
+    init_thread();
 
-    if ( !is_valid ) {
-        ErrorHandling::clear_errors_ = true;
-        throw std::invalid_argument( ErrorHandling::xml_error_ );
+    // errors are collected per validation, not in the global error handler
+    std::string errors;
+    xmlSchemaSetValidErrors( valid_ctxt_.get(), ErrorHandling::append_error, ErrorHandling::append_error, &errors );
+
+    // the subtree is validated in place, without copying it to a new document
+    if ( xmlSchemaValidateOneElement( valid_ctxt_.get(), const_cast<xmlNode*>( node ) ) != 0 ) {
+        throw std::invalid_argument( errors );
     }
 }
 
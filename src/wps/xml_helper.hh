@@ -31,6 +31,14 @@
 #include <string>
 #include <sstream>
 
+#ifdef _WIN32
+#pragma warning(push, 0)
+#endif
+#include <boost/thread/tss.hpp>
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
 
 ///
 /// Helper class designed to hold already-allocated pointers and call a deletion function
@@ -88,6 +96,11 @@ typedef scoped_ptr<xmlDoc, xmlFreeDoc> scoped_xmlDoc;
 /// XML helper namespace
 /// @note the static member finction init() must be called once per thread
 namespace XML {
+///
+/// A compiled XML schema.
+///
+/// The schema is parsed and compiled once. Each thread validates with its own validation context,
+/// so that validations of different threads run in parallel.
 class Schema {
 public:
     Schema();
@@ -98,9 +111,13 @@ public:
     /// Load the schema
     void load( const std::string& );
 
+    ///
+    /// Creates the validation context of the calling thread, if needed
+    void init_thread() const;
+
     ///
     /// Throws a std::invalid_argument if the given node is not validated against the schema
-    void ensure_validity( const xmlNode* node );
+    void ensure_validity( const xmlNode* node ) const;
 
     ///
     /// Get the string representation of the schema
@@ -111,7 +128,8 @@ private:
     xmlDoc*                           schema_doc_;
     xmlSchemaParserCtxt* parser_ctxt_;
     xmlSchema*                     schema_;
-    xmlSchemaValidCtxt*   valid_ctxt_;
+    // validation context of each thread, created on first use
+    mutable boost::thread_specific_ptr<xmlSchemaValidCtxt> valid_ctxt_;
     // temp
     std::string schema_str_;
 };
@@ -171,6 +189,9 @@ int init();
 /// This is intended to be used to transform XML parsing errors to std::exceptions
 struct ErrorHandling {
     static void accumulate_error( void* ctx, const char* msg, ... );
+    ///
+    /// Appends an error to the std::string given as context
+    static void append_error( void* ctx, const char* msg, ... );
     static bool clear_errors_;
     static std::string xml_error_;
 };
@@ -0,0 +1,120 @@
+/**
+ *   Copyright (C) 2012-2013 IFSTTAR (http://www.ifsttar.fr)
+ *   Copyright (C) 2012-2013 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "xml_writer.hh"
+#include "xml_helper.hh"
+
+namespace XML {
+
+void Writer::close_tag()
+{
+    if ( tag_open_ ) {
+        out_ << '>';
+        tag_open_ = false;
+    }
+}
+
+Writer& Writer::start( const char* name )
+{
+    close_tag();
+    out_ << '<' << name;
+    open_elements_.push_back( name );
+    tag_open_ = true;
+    return *this;
+}
+
+Writer& Writer::attr( const char* name, const std::string& value )
+{
+    out_ << ' ' << name << "=\"";
+    escape( value, true );
+    out_ << '"';
+    return *this;
+}
+
+Writer& Writer::attr( const char* name, const char* value )
+{
+    return attr( name, std::string( value ) );
+}
+
+Writer& Writer::text( const std::string& text )
+{
+    close_tag();
+    escape( text, false );
+    return *this;
+}
+
+Writer& Writer::end()
+{
+    if ( tag_open_ ) {
+        out_ << "/>";
+        tag_open_ = false;
+    }
+    else {
+        out_ << "</" << open_elements_.back() << '>';
+    }
+    open_elements_.pop_back();
+    return *this;
+}
+
+Writer& Writer::node( const xmlNode* node )
+{
+    close_tag();
+    out_ << to_string( node );
+    return *this;
+}
+
+void Writer::escape( const std::string& str, bool in_attribute )
+{
+    // write runs of characters that need no escaping at once
+    size_t run = 0;
+    for ( size_t i = 0; i < str.size(); i++ ) {
+        const char* entity = 0;
+        switch ( str[i] ) {
+        case '&':
+            entity = "&amp;";
+            break;
+        case '<':
+            entity = "&lt;";
+            break;
+        case '>':
+            entity = "&gt;";
+            break;
+        case '"':
+            entity = in_attribute ? "&quot;" : 0;
+            break;
+        case '\n':
+            entity = in_attribute ? "&#10;" : 0;
+            break;
+        case '\r':
+            entity = "&#13;";
+            break;
+        case '\t':
+            entity = in_attribute ? "&#9;" : 0;
+            break;
+        default:
+            break;
+        }
+        if ( entity ) {
+            out_.write( str.data() + run, i - run );
+            out_ << entity;
+            run = i + 1;
+        }
+    }
+    out_.write( str.data() + run, str.size() - run );
+}
+
+}
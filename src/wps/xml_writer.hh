@@ -0,0 +1,81 @@
+/**
+ *   Copyright (C) 2012-2013 IFSTTAR (http://www.ifsttar.fr)
+ *   Copyright (C) 2012-2013 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   Streaming XML output
+ */
+
+#ifndef TEMPUS_XML_WRITER_HH
+#define TEMPUS_XML_WRITER_HH
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include <libxml/tree.h>
+
+namespace XML {
+///
+/// Writes XML elements directly to an output stream, without building a tree.
+///
+/// Attributes of an element must be written right after start(), before any child element or text.
+/// Values are escaped. Each start() must be matched by an end().
+class Writer {
+public:
+    explicit Writer( std::ostream& out ) : out_( out ), tag_open_( false ) {}
+
+    ///
+    /// Opens an element
+    Writer& start( const char* name );
+
+    ///
+    /// Adds an attribute to the element just opened
+    Writer& attr( const char* name, const std::string& value );
+    Writer& attr( const char* name, const char* value );
+
+    ///
+    /// Adds an attribute of any type that can be written to a std::ostream, without escaping (numbers)
+    template <class T>
+    Writer& attr( const char* name, const T& value ) {
+        out_ << ' ' << name << "=\"" << value << '"';
+        return *this;
+    }
+
+    ///
+    /// Adds a text child to the current element
+    Writer& text( const std::string& text );
+
+    ///
+    /// Closes the current element
+    Writer& end();
+
+    ///
+    /// Writes a libxml tree as a child of the current element (for services that still build a tree)
+    Writer& node( const xmlNode* node );
+
+private:
+    void close_tag();
+    void escape( const std::string& str, bool in_attribute );
+
+    std::ostream& out_;
+    std::vector<const char*> open_elements_;
+    // is the start tag of the last element still open (to add attributes) ?
+    bool tag_open_;
+};
+}
+
+#endif
@@ -0,0 +1,142 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+// ch_preprocess.hh has its own CHVertex and CHEdge types, its tests are then kept apart from the CH query tests
+
+#include <boost/test/unit_test.hpp>
+
+#include "ch_preprocess.hh"
+
+#include <queue>
+#include <limits>
+
+using namespace boost::unit_test ;
+using namespace Tempus;
+
+BOOST_AUTO_TEST_SUITE( tempus_ch_preprocess )
+
+typedef std::vector<std::vector<std::pair<uint32_t, TCost>>> Adjacency;
+
+///
+/// Dijkstra costs from origin, on arcs filtered by a predicate on (source, target)
+template <typename Filter>
+static std::vector<TCost> dijkstra_costs( const Adjacency& out, uint32_t origin, Filter filter )
+{
+    std::vector<TCost> costs( out.size(), std::numeric_limits<TCost>::max() );
+    typedef std::pair<TCost, uint32_t> QueueElement;
+    std::priority_queue<QueueElement, std::vector<QueueElement>, std::greater<QueueElement>> queue;
+    costs[origin] = 0;
+    queue.push( std::make_pair( 0, origin ) );
+    while ( !queue.empty() ) {
+        TCost c = queue.top().first;
+        uint32_t u = queue.top().second;
+        queue.pop();
+        if ( c > costs[u] ) {
+            continue;
+        }
+        for ( const auto& a : out[u] ) {
+            if ( filter( u, a.first ) && c + a.second < costs[a.first] ) {
+                costs[a.first] = c + a.second;
+                queue.push( std::make_pair( costs[a.first], a.first ) );
+            }
+        }
+    }
+    return costs;
+}
+
+BOOST_AUTO_TEST_CASE( testContraction )
+{
+    // a grid of 5x5 vertices with pseudo-random costs, contracted in the order of the vertex indices
+    const uint32_t w = 5, n = w * w;
+    uint32_t seed = 1;
+    auto random = [&seed]( uint32_t k ) {
+        seed = seed * 1103515245 + 12345;
+        return ( seed >> 16 ) % k;
+    };
+    CHGraph graph( n );
+    Adjacency out( n ), in( n );
+    auto add_arc = [&]( uint32_t u, uint32_t v ) {
+        TCost cost = 1 + random( 20 );
+        CHEdge e = add_edge( u, v, graph ).first;
+        graph[e].weight = cost;
+        out[u].push_back( std::make_pair( v, cost ) );
+    };
+    for ( uint32_t v = 0; v < n; v++ ) {
+        if ( v % w + 1 < w ) {
+            add_arc( v, v + 1 );
+            add_arc( v + 1, v );
+        }
+        if ( v + w < n ) {
+            add_arc( v, v + w );
+            add_arc( v + w, v );
+        }
+    }
+
+    // upward and downward arcs of the CH graph
+    Adjacency ch_out = out;
+    for ( const Shortcut& s : contract_graph( graph ) ) {
+        BOOST_CHECK( s.contracted < s.from && s.contracted < s.to );
+        ch_out[s.from].push_back( std::make_pair( s.to, s.cost ) );
+    }
+    Adjacency ch_in( n );
+    for ( uint32_t u = 0; u < n; u++ ) {
+        for ( const auto& a : ch_out[u] ) {
+            ch_in[a.first].push_back( std::make_pair( u, a.second ) );
+        }
+    }
+
+    // a CH query (upward searches from both ends) gives the same costs as a Dijkstra on the input graph
+    for ( uint32_t s = 0; s < n; s++ ) {
+        std::vector<TCost> expected = dijkstra_costs( out, s, []( uint32_t, uint32_t ) { return true; } );
+        std::vector<TCost> forward = dijkstra_costs( ch_out, s, []( uint32_t u, uint32_t v ) { return v > u; } );
+        for ( uint32_t t = 0; t < n; t++ ) {
+            std::vector<TCost> backward = dijkstra_costs( ch_in, t, []( uint32_t u, uint32_t v ) { return v > u; } );
+            TCost cost = std::numeric_limits<TCost>::max();
+            for ( uint32_t v = 0; v < n; v++ ) {
+                if ( forward[v] != std::numeric_limits<TCost>::max() && backward[v] != std::numeric_limits<TCost>::max() ) {
+                    cost = std::min( cost, forward[v] + backward[v] );
+                }
+            }
+            BOOST_CHECK_EQUAL( cost, expected[t] );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( testContractionHopLimit )
+{
+    // 1 -> 0 -> 2 costs 80, the witness path 1 -> 3 -> ... -> 65 -> 2 costs 64 with 64 arcs,
+    // which is the hop limit of the contraction. Vertex 0 is contracted first and needs no shortcut
+    const uint32_t hops = 64;
+    CHGraph graph( hops + 2 );
+    auto add_arc = [&graph]( uint32_t u, uint32_t v, TCost cost ) {
+        CHEdge e = add_edge( u, v, graph ).first;
+        graph[e].weight = cost;
+    };
+    add_arc( 1, 0, 40 );
+    add_arc( 0, 2, 40 );
+    uint32_t previous = 1;
+    for ( uint32_t v = 3; v < hops + 2; v++ ) {
+        add_arc( previous, v, 1 );
+        previous = v;
+    }
+    add_arc( previous, 2, 1 );
+
+    for ( const Shortcut& s : contract_graph( graph ) ) {
+        BOOST_CHECK( s.contracted != 0 );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
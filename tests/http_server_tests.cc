@@ -0,0 +1,168 @@
+/**
+ *   Copyright (C) 2012-2015 Oslandia <infos@oslandia.com>
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Library General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Library General Public License for more details.
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Tests of the request parsing and response conversion of the embedded HTTP server, no socket is opened
+
+#include <boost/test/unit_test.hpp>
+
+#include "http_server.hh"
+
+#include <string>
+
+using namespace boost::unit_test ;
+using namespace WPS;
+
+namespace
+{
+// status of the HttpError thrown while parsing the buffer, 0 if none
+int parse_error_status( const std::string& buffer )
+{
+    HttpRequest request;
+    try {
+        HttpServer::parse_request( buffer, request );
+    }
+    catch ( HttpError& e ) {
+        return e.status();
+    }
+    return 0;
+}
+}
+
+BOOST_AUTO_TEST_SUITE( tempus_wps_http_server )
+
+BOOST_AUTO_TEST_CASE( testParseRequest )
+{
+    HttpRequest request;
+    const std::string get = "GET /wps?service=wps&request=GetCapabilities HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    BOOST_CHECK_EQUAL( HttpServer::parse_request( get, request ), get.size() );
+    BOOST_CHECK_EQUAL( request.method, "GET" );
+    BOOST_CHECK_EQUAL( request.path, "/wps" );
+    BOOST_CHECK_EQUAL( request.query_string, "service=wps&request=GetCapabilities" );
+    BOOST_CHECK( request.keep_alive );
+    BOOST_CHECK( request.body.empty() );
+
+    HttpRequest request10;
+    const std::string get10 = "GET /wps HTTP/1.0\r\n\r\n";
+    BOOST_CHECK_EQUAL( HttpServer::parse_request( get10, request10 ), get10.size() );
+    BOOST_CHECK( !request10.keep_alive );
+    BOOST_CHECK_EQUAL( request10.query_string, "" );
+}
+
+BOOST_AUTO_TEST_CASE( testParsePipelinedRequests )
+{
+    const std::string post = "POST /wps HTTP/1.1\r\nContent-Type: text/xml\r\nContent-Length: 5\r\n\r\n<a/>\n";
+    const std::string get = "GET /wps?request=metrics HTTP/1.1\r\nConnection: close\r\n\r\n";
+    std::string buffer = post + get;
+
+    HttpRequest first;
+    const size_t size = HttpServer::parse_request( buffer, first );
+    BOOST_REQUIRE_EQUAL( size, post.size() );
+    BOOST_CHECK_EQUAL( first.method, "POST" );
+    BOOST_CHECK_EQUAL( first.content_type, "text/xml" );
+    BOOST_CHECK_EQUAL( first.body, "<a/>\n" );
+
+    buffer.erase( 0, size );
+    HttpRequest second;
+    BOOST_CHECK_EQUAL( HttpServer::parse_request( buffer, second ), get.size() );
+    BOOST_CHECK_EQUAL( second.method, "GET" );
+    BOOST_CHECK_EQUAL( second.query_string, "request=metrics" );
+    BOOST_CHECK( !second.keep_alive );
+}
+
+BOOST_AUTO_TEST_CASE( testParsePartialRequest )
+{
+    const std::string post = "POST /wps HTTP/1.1\r\nContent-Length: 10\r\nExpect: 100-continue\r\n\r\n0123456789";
+    const size_t header_size = post.size() - 10;
+
+    // the request is received byte after byte
+    for ( size_t n = 0; n < post.size(); n++ ) {
+        HttpRequest request;
+        BOOST_CHECK_EQUAL( HttpServer::parse_request( post.substr( 0, n ), request ), 0 );
+        if ( n >= header_size ) {
+            // headers are known before the body is complete
+            BOOST_CHECK( request.expect_continue );
+        }
+    }
+    HttpRequest request;
+    BOOST_CHECK_EQUAL( HttpServer::parse_request( post, request ), post.size() );
+    BOOST_CHECK_EQUAL( request.body, "0123456789" );
+}
+
+BOOST_AUTO_TEST_CASE( testParseBadRequests )
+{
+    BOOST_CHECK_EQUAL( parse_error_status( "GET /wps\r\n\r\n" ), 400 );
+    BOOST_CHECK_EQUAL( parse_error_status( "GET /wps HTTP/1.1\r\nno colon\r\n\r\n" ), 400 );
+    BOOST_CHECK_EQUAL( parse_error_status( "POST /wps HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n" ), 400 );
+
+    // bad Content-Length
+    BOOST_CHECK_EQUAL( parse_error_status( "POST /wps HTTP/1.1\r\nContent-Length: -1\r\n\r\n" ), 400 );
+    BOOST_CHECK_EQUAL( parse_error_status( "POST /wps HTTP/1.1\r\nContent-Length: +5\r\n\r\nabcde" ), 400 );
+    BOOST_CHECK_EQUAL( parse_error_status( "POST /wps HTTP/1.1\r\nContent-Length: ten\r\n\r\n" ), 400 );
+    BOOST_CHECK_EQUAL( parse_error_status( "POST /wps HTTP/1.1\r\nContent-Length:\r\n\r\n" ), 400 );
+    BOOST_CHECK_EQUAL( parse_error_status( "POST /wps HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n" ), 400 );
+    BOOST_CHECK_EQUAL( parse_error_status( "POST /wps HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\nab" ), 400 );
+    BOOST_CHECK_EQUAL( parse_error_status( "POST /wps HTTP/1.1\r\nContent-Length: 1000000000000\r\n\r\n" ), 413 );
+    // the same length twice is accepted
+    BOOST_CHECK_EQUAL( parse_error_status( "POST /wps HTTP/1.1\r\nContent-Length: 2\r\nContent-Length: 2\r\n\r\nab" ), 0 );
+
+    // headers too large, complete or not
+    const std::string large_header = "GET /wps HTTP/1.1\r\nX-Large: " + std::string( 16 * 1024, 'x' );
+    BOOST_CHECK_EQUAL( parse_error_status( large_header ), 431 );
+    BOOST_CHECK_EQUAL( parse_error_status( large_header + "\r\n\r\n" ), 431 );
+    // a large body is not a large header
+    const std::string large_body = std::string( 16 * 1024, 'x' );
+    BOOST_CHECK_EQUAL( parse_error_status( "POST /wps HTTP/1.1\r\nContent-Length: 16384\r\n\r\n" + large_body ), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( testCgiToHttp )
+{
+    // status line from the Status header
+    std::string http = HttpServer::cgi_to_http( "Status: 404 No such service\r\nContent-type: text/html\r\n\r\n<h2>no</h2>", true );
+    BOOST_CHECK_EQUAL( http, "HTTP/1.1 404 No such service\r\nContent-type: text/html\r\nContent-Length: 11\r\n\r\n<h2>no</h2>" );
+
+    // reason phrase of the status when the header has none, "\n" line endings
+    http = HttpServer::cgi_to_http( "Status: 503\nContent-type: text/html\n\nbusy", false );
+    BOOST_CHECK_EQUAL( http, "HTTP/1.1 503 Service Unavailable\r\nContent-type: text/html\r\nContent-Length: 4\r\nConnection: close\r\n\r\nbusy" );
+
+    // no Status header
+    http = HttpServer::cgi_to_http( "Content-type: text/xml\n\n<a/>", true );
+    BOOST_CHECK_EQUAL( http, "HTTP/1.1 200 OK\r\nContent-type: text/xml\r\nContent-Length: 4\r\n\r\n<a/>" );
+
+    // no body
+    http = HttpServer::cgi_to_http( "Content-type: text/xml\n", true );
+    BOOST_CHECK_EQUAL( http, "HTTP/1.1 200 OK\r\nContent-type: text/xml\r\nContent-Length: 0\r\n\r\n" );
+}
+
+BOOST_AUTO_TEST_CASE( testCgiToHttpInPlace )
+{
+    const std::string cgi = "Status: 400\r\nContent-type: text/xml\r\n\r\n<error/>";
+    const std::string expected = HttpServer::cgi_to_http( cgi, true );
+
+    // with room before the CGI response, the body is not moved
+    std::string buffer = std::string( 256, ' ' ) + cgi;
+    const char* body = buffer.data() + buffer.size() - 8;
+    size_t offset = HttpServer::cgi_to_http( buffer, 256, true );
+    BOOST_CHECK_EQUAL( buffer.substr( offset ), expected );
+    BOOST_CHECK_EQUAL( buffer.data() + buffer.size() - 8, body );
+
+    // without room
+    buffer = cgi;
+    offset = HttpServer::cgi_to_http( buffer, 0, true );
+    BOOST_CHECK_EQUAL( offset, 0 );
+    BOOST_CHECK_EQUAL( buffer, expected );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -22,6 +22,7 @@
 #include <boost/graph/dijkstra_shortest_paths.hpp>
 #include <boost/test/unit_test.hpp>
 #include <boost/format.hpp>
+#include <boost/property_map/function_property_map.hpp>
 #ifdef _WIN32
 #pragma warning(pop)
 #endif
@@ -32,10 +33,29 @@
 #include "utils/graph_db_link.hh"
 #include "multimodal_graph_builder.hh"
 #include "ch_routing_data.hh"
+#include "ch_bidirectional_search.hh"
+#include "ch_many_to_many.hh"
+#include "ch_phast.hh"
+#include "cch_routing_data.hh"
+#include "multi_profile_ch_routing_data.hh"
+#include "hub_label_routing_data.hh"
+#include "transit_node_routing_data.hh"
+#include "ch_closures.hh"
+#include "travel_time_function.hh"
+#include "td_ch_preprocess.hh"
+#include "td_ch_query.hh"
+#include "utils/d_ary_heap.hh"
+#include "result_cache.hh"
+#include "instrumentation.hh"
+#include "routing_data_builder.hh"
+#include "plugin.hh"
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <queue>
+#include <algorithm>
 
 static std::string g_db_options = getenv( "TEMPUS_DB_OPTIONS" ) ? getenv( "TEMPUS_DB_OPTIONS" ) : "";
 static std::string g_db_name = getenv( "TEMPUS_DB_NAME" ) ? getenv( "TEMPUS_DB_NAME" ) : "tempus_test_db";
@@ -113,6 +133,37 @@ BOOST_AUTO_TEST_CASE( testQueries )
     BOOST_CHECK_EQUAL( ( long )( 13 * 3600 + 52 * 60 + 45 ), t.n_secs );
 
 }
+
+BOOST_AUTO_TEST_CASE( testConnectionPool )
+{
+    std::cout << "DbTest::testConnectionPool()" << std::endl;
+    const std::string options = g_db_options + " dbname = " + g_db_name;
+    Db::ConnectionPool::instance().clear();
+
+    Db::Connection* first;
+    {
+        Db::PooledConnection pooled( options );
+        first = &*pooled;
+        std::vector<std::string> params( 1, "41" );
+        Db::Result res( pooled->exec_prepared( "test_increment", "SELECT $1::int + 1", params ) );
+        BOOST_CHECK_EQUAL( 42, res[0][0].as<int>() );
+    }
+    BOOST_CHECK_EQUAL( ( size_t )1, Db::ConnectionPool::instance().idle_connections( options ) );
+
+    {
+        // the idle connection is reused, with its prepared statement
+        Db::PooledConnection pooled( options );
+        BOOST_CHECK_EQUAL( first, &*pooled );
+        BOOST_CHECK_EQUAL( ( size_t )0, Db::ConnectionPool::instance().idle_connections( options ) );
+        std::vector<std::string> params( 1, "1" );
+        Db::Result res( pooled->exec_prepared( "test_increment", "SELECT $1::int + 1", params ) );
+        BOOST_CHECK_EQUAL( 2, res[0][0].as<int>() );
+
+        // a connection left in a transaction is not given back
+        pooled->exec( "BEGIN" );
+    }
+    BOOST_CHECK_EQUAL( ( size_t )0, Db::ConnectionPool::instance().idle_connections( options ) );
+}
 BOOST_AUTO_TEST_SUITE_END()
 
 
@@ -864,7 +915,15 @@ void test_ch( const std::vector<std::pair<uint32_t, uint32_t>>& edges_, int n_ve
         boost::tie( e, found ) = edge( eit->source(), eit->target(), graph );
         BOOST_CHECK( found );
         BOOST_CHECK_EQUAL( e.property().b.cost, eit->property().b.cost );
-        
+        BOOST_CHECK_EQUAL( e.index(), eit->index() );
+
+        // edges can be retrieved by their index
+        CHEdge ei = graph.edge_from_index( eit->index() );
+        BOOST_CHECK_EQUAL( ei.source(), eit->source() );
+        BOOST_CHECK_EQUAL( ei.target(), eit->target() );
+        BOOST_CHECK_EQUAL( ei.is_upward(), eit->is_upward() );
+        BOOST_CHECK_EQUAL( graph.edge_property( eit->index() ).b.cost, eit->property().b.cost );
+
         lastv = oit->first;
     }
     if ( oit->first != lastv )
@@ -918,5 +977,981 @@ BOOST_AUTO_TEST_CASE( testCHQuery )
     }
 }
 
+BOOST_AUTO_TEST_CASE( testCHSeededQuery )
+{
+    // every path goes through the highest vertex 4
+    std::vector<CHContractedEdge> contracted_edges;
+    contracted_edges.push_back( { 0, 4, 10, CHContractedEdge::NoMiddle, 1 } );
+    contracted_edges.push_back( { 1, 4, 1, CHContractedEdge::NoMiddle, 2 } );
+    contracted_edges.push_back( { 4, 2, 5, CHContractedEdge::NoMiddle, 3 } );
+    contracted_edges.push_back( { 4, 3, 1, CHContractedEdge::NoMiddle, 4 } );
+    std::vector<db_id_t> node_id = { 10, 11, 12, 13, 14 };
+    std::unique_ptr<RoutingData> rd = ch_routing_data_from_contraction( 5, contracted_edges, std::move( node_id ) );
+    const CHQuery& graph = static_cast<const CHRoutingData*>( rd.get() )->ch_query();
+
+    auto weight_map_fn = []( const CHEdge& e ) { return uint32_t( e.property().b.cost ); };
+    auto weight_map = boost::make_function_property_map<CHEdge, uint32_t, decltype(weight_map_fn)>( weight_map_fn );
+
+    std::vector<std::pair<CHVertex, uint32_t>> destinations = { { 2, 0 }, { 3, 10 } };
+    {
+        // 0 -> 4 -> 2 = 15, better than 0 -> 4 -> 3 (21) and 1 -> 4 -> 2 (26)
+        std::vector<std::pair<CHVertex, uint32_t>> origins = { { 0, 0 }, { 1, 20 } };
+        CHQueryStatistics stats;
+        uint32_t cost = 0;
+        auto path = bidirectional_ch_seeded_dijkstra( graph, origins, destinations, weight_map, cost, ch_query_workspace<CHVertex, uint32_t>(), stats );
+        BOOST_CHECK_EQUAL( cost, 15 );
+        BOOST_REQUIRE_EQUAL( path.size(), 2 );
+        BOOST_CHECK_EQUAL( path.front().source(), 0 );
+        BOOST_CHECK_EQUAL( path.back().target(), 2 );
+    }
+    {
+        // 1 -> 4 -> 2 = 8
+        std::vector<std::pair<CHVertex, uint32_t>> origins = { { 0, 0 }, { 1, 2 } };
+        CHQueryStatistics stats;
+        uint32_t cost = 0;
+        auto path = bidirectional_ch_seeded_dijkstra( graph, origins, destinations, weight_map, cost, ch_query_workspace<CHVertex, uint32_t>(), stats );
+        BOOST_CHECK_EQUAL( cost, 8 );
+        BOOST_REQUIRE_EQUAL( path.size(), 2 );
+        BOOST_CHECK_EQUAL( path.front().source(), 1 );
+    }
+    {
+        // a seed of both directions, the path has no edge
+        std::vector<std::pair<CHVertex, uint32_t>> origins = { { 3, 4 } };
+        CHQueryStatistics stats;
+        uint32_t cost = 0;
+        auto path = bidirectional_ch_seeded_dijkstra( graph, origins, destinations, weight_map, cost, ch_query_workspace<CHVertex, uint32_t>(), stats );
+        BOOST_CHECK_EQUAL( cost, 14 );
+        BOOST_CHECK( path.empty() );
+    }
+}
+
+///
+/// A grid of w x h vertices with pseudo-random costs, where some roads are one-way
+struct TestGrid
+{
+    uint32_t n;
+    std::vector<Point2D> coordinates;
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    std::vector<CCHArc> arcs;
+    std::vector<db_id_t> node_id;
+};
+
+static TestGrid test_grid( uint32_t w, uint32_t h, uint32_t seed )
+{
+    auto random = [&seed]( uint32_t k ) {
+        seed = seed * 1103515245 + 12345;
+        return ( seed >> 16 ) % k;
+    };
+    TestGrid g;
+    g.n = w * h;
+    for ( uint32_t v = 0; v < g.n; v++ ) {
+        g.coordinates.push_back( Point2D( float( v % w ), float( v / w ) ) );
+        g.node_id.push_back( 100 + v );
+    }
+    db_id_t section_id = 1;
+    auto add_road = [&]( uint32_t u, uint32_t v ) {
+        g.edges.push_back( std::make_pair( u, v ) );
+        g.arcs.push_back( { u, v, 100 + random( 900 ), section_id } );
+        if ( random( 5 ) != 0 ) {
+            g.arcs.push_back( { v, u, 100 + random( 900 ), section_id } );
+        }
+        section_id++;
+    };
+    for ( uint32_t y = 0; y < h; y++ ) {
+        for ( uint32_t x = 0; x < w; x++ ) {
+            if ( x + 1 < w ) {
+                add_road( y * w + x, y * w + x + 1 );
+            }
+            if ( y + 1 < h ) {
+                add_road( y * w + x, ( y + 1 ) * w + x );
+            }
+        }
+    }
+    return g;
+}
+
+///
+/// Costs from origin to every vertex by a plain Dijkstra on the arcs, max() for unreachable vertices
+static std::vector<uint32_t> dijkstra_costs( uint32_t n, const std::vector<CCHArc>& arcs, uint32_t origin )
+{
+    std::vector<uint32_t> costs( n, std::numeric_limits<uint32_t>::max() );
+    typedef std::pair<uint32_t, uint32_t> QueueElement;
+    std::priority_queue<QueueElement, std::vector<QueueElement>, std::greater<QueueElement>> queue;
+    costs[origin] = 0;
+    queue.push( std::make_pair( 0, origin ) );
+    while ( !queue.empty() ) {
+        uint32_t c = queue.top().first;
+        uint32_t u = queue.top().second;
+        queue.pop();
+        if ( c > costs[u] ) {
+            continue;
+        }
+        for ( const CCHArc& a : arcs ) {
+            if ( a.source == u && c + a.cost < costs[a.target] ) {
+                costs[a.target] = c + a.cost;
+                queue.push( std::make_pair( costs[a.target], a.target ) );
+            }
+        }
+    }
+    return costs;
+}
+
+///
+/// Checks a cost in the unit of the CH graph (see ch_many_to_many) against a fixed point cost
+static void check_ch_cost( float cost, uint32_t expected )
+{
+    if ( expected == std::numeric_limits<uint32_t>::max() ) {
+        BOOST_CHECK_EQUAL( cost, std::numeric_limits<float>::max() );
+    }
+    else {
+        BOOST_CHECK_CLOSE( cost, expected / 100.0, 0.001 );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( testCHManyToMany )
+{
+    TestGrid g = test_grid( 6, 6, 1 );
+    CCHTopology topology( g.coordinates, g.edges, g.node_id );
+    std::unique_ptr<CHRoutingData> rd = CCHMetric( topology, g.arcs ).routing_data();
+
+    std::vector<uint32_t> sources = { 0, 7, 20, 35 };
+    std::vector<uint32_t> targets = { 1, 14, 20, 29, 30 };
+    std::vector<CHVertex> ch_sources, ch_targets;
+    for ( uint32_t s : sources ) {
+        ch_sources.push_back( topology.rank( s ) );
+    }
+    for ( uint32_t t : targets ) {
+        ch_targets.push_back( topology.rank( t ) );
+    }
+
+    std::vector<float> table = ch_many_to_many( *rd, ch_sources, ch_targets );
+    BOOST_REQUIRE_EQUAL( table.size(), sources.size() * targets.size() );
+    for ( size_t i = 0; i < sources.size(); i++ ) {
+        std::vector<uint32_t> expected = dijkstra_costs( g.n, g.arcs, sources[i] );
+        for ( size_t j = 0; j < targets.size(); j++ ) {
+            check_ch_cost( table[i * targets.size() + j], expected[targets[j]] );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( testCHPhast )
+{
+    TestGrid g = test_grid( 6, 6, 2 );
+    CCHTopology topology( g.coordinates, g.edges, g.node_id );
+    std::unique_ptr<CHRoutingData> rd = CCHMetric( topology, g.arcs ).routing_data();
+    const uint32_t n = g.n;
+
+    CHPhast phast( *rd );
+    std::vector<float> costs;
+    for ( uint32_t s = 0; s < n; s++ ) {
+        phast.one_to_all( topology.rank( s ), costs );
+        BOOST_REQUIRE_EQUAL( costs.size(), n );
+        std::vector<uint32_t> expected = dijkstra_costs( n, g.arcs, s );
+        for ( uint32_t t = 0; t < n; t++ ) {
+            check_ch_cost( costs[topology.rank( t )], expected[t] );
+        }
+    }
+
+    // more sources than a batch
+    std::vector<uint32_t> sources = { 0, 3, 5, 8, 13, 17, 21, 26, 30, 35 };
+    std::vector<CHVertex> ch_sources;
+    for ( uint32_t s : sources ) {
+        ch_sources.push_back( topology.rank( s ) );
+    }
+    phast.many_to_all( ch_sources, costs );
+    BOOST_REQUIRE_EQUAL( costs.size(), sources.size() * n );
+    for ( size_t i = 0; i < sources.size(); i++ ) {
+        std::vector<uint32_t> expected = dijkstra_costs( n, g.arcs, sources[i] );
+        for ( uint32_t t = 0; t < n; t++ ) {
+            check_ch_cost( costs[i * n + topology.rank( t )], expected[t] );
+        }
+    }
+
+    // restricted to a few targets
+    std::vector<uint32_t> targets = { 2, 9, 19, 33 };
+    std::vector<CHVertex> ch_targets;
+    for ( uint32_t t : targets ) {
+        ch_targets.push_back( topology.rank( t ) );
+    }
+    CHRestrictedPhast rphast( *rd, ch_targets );
+    BOOST_CHECK( rphast.num_vertices() < n );
+    for ( uint32_t s = 0; s < n; s++ ) {
+        rphast.one_to_many( topology.rank( s ), costs );
+        BOOST_REQUIRE_EQUAL( costs.size(), targets.size() );
+        std::vector<uint32_t> expected = dijkstra_costs( n, g.arcs, s );
+        for ( size_t j = 0; j < targets.size(); j++ ) {
+            check_ch_cost( costs[j], expected[targets[j]] );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( testCCHCustomization )
+{
+    TestGrid g = test_grid( 6, 6, 3 );
+    CCHTopology topology( g.coordinates, g.edges, g.node_id );
+    BOOST_REQUIRE_EQUAL( topology.num_vertices(), g.n );
+
+    auto weight_map_fn = []( const CHEdge& e ) { return uint32_t( e.property().b.cost ); };
+    auto weight_map = boost::make_function_property_map<CHEdge, uint32_t, decltype(weight_map_fn)>( weight_map_fn );
+    auto check_metric = [&]( const std::vector<CCHArc>& arcs ) {
+        std::unique_ptr<CHRoutingData> rd = CCHMetric( topology, arcs ).routing_data();
+        for ( uint32_t s = 0; s < g.n; s++ ) {
+            std::vector<uint32_t> expected = dijkstra_costs( g.n, arcs, s );
+            for ( uint32_t t = 0; t < g.n; t++ ) {
+                CHQueryStatistics stats;
+                uint32_t cost = std::numeric_limits<uint32_t>::max();
+                bidirectional_ch_dijkstra( rd->ch_query(), topology.rank( s ), topology.rank( t ), weight_map, cost, ch_query_workspace<CHVertex, uint32_t>(), stats );
+                BOOST_CHECK_EQUAL( cost, expected[t] );
+            }
+        }
+    };
+    check_metric( g.arcs );
+
+    // new weights on the same topology: a road gets slower, another one is closed
+    std::vector<CCHArc> arcs = g.arcs;
+    arcs[3].cost *= 10;
+    arcs.erase( arcs.begin() + 7 );
+    check_metric( arcs );
+}
+
+BOOST_AUTO_TEST_CASE( testMultiProfileCH )
+{
+    TestGrid g = test_grid( 6, 6, 4 );
+    CCHTopology topology( g.coordinates, g.edges, g.node_id );
+
+    // a second profile with other costs, where some arcs cannot be used
+    std::vector<CCHArc> other_arcs;
+    for ( size_t i = 0; i < g.arcs.size(); i++ ) {
+        if ( i % 7 != 3 ) {
+            other_arcs.push_back( g.arcs[i] );
+            other_arcs.back().cost = 1000 - g.arcs[i].cost;
+        }
+    }
+    CCHMetric metric1( topology, g.arcs );
+    CCHMetric metric2( topology, other_arcs );
+    std::vector<CHProfile> profiles( 2 );
+    profiles[0].name = "first";
+    profiles[0].traffic_rules = TrafficRuleCar;
+    profiles[0].cost_id = CostId::CostDuration;
+    profiles[1].name = "second";
+    profiles[1].traffic_rules = TrafficRuleBicycle;
+    profiles[1].cost_id = CostId::CostDuration;
+    std::unique_ptr<MultiProfileCHRoutingData> rd = multi_profile_routing_data( topology, std::move( profiles ), { &metric1, &metric2 } );
+    BOOST_REQUIRE_EQUAL( rd->num_profiles(), 2 );
+
+    const std::vector<CCHArc>* arcs[] = { &g.arcs, &other_arcs };
+    for ( size_t p = 0; p < 2; p++ ) {
+        const CHProfile& profile = rd->profile( p );
+        // same weights as the CH plugin
+        auto weight_map_fn = [&profile]( const MultiProfileCHEdge& e ) {
+            uint32_t cost = profile.cost[e.property().index];
+            return cost == CHProfile::Infinity ? std::numeric_limits<float>::infinity() : float(cost / 100.0);
+        };
+        auto weight_map = boost::make_function_property_map<MultiProfileCHEdge, float, decltype(weight_map_fn)>( weight_map_fn );
+        for ( uint32_t s = 0; s < g.n; s++ ) {
+            std::vector<uint32_t> expected = dijkstra_costs( g.n, *arcs[p], s );
+            for ( uint32_t t = 0; t < g.n; t++ ) {
+                CHQueryStatistics stats;
+                float cost = std::numeric_limits<float>::max();
+                bidirectional_ch_dijkstra( rd->ch_query(), rd->vertex_from_id( 100 + s ).get(), rd->vertex_from_id( 100 + t ).get(),
+                                           weight_map, cost, ch_query_workspace<CHVertex, float>(), stats );
+                check_ch_cost( cost, expected[t] );
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( testHubLabels )
+{
+    // 4 is the highest vertex, 1 -> 3 is not a shortest path
+    std::vector<CHContractedEdge> contracted_edges;
+    contracted_edges.push_back( { 0, 4, 10, CHContractedEdge::NoMiddle, 1 } );
+    contracted_edges.push_back( { 0, 2, 3, CHContractedEdge::NoMiddle, 2 } );
+    contracted_edges.push_back( { 2, 4, 1, CHContractedEdge::NoMiddle, 3 } );
+    contracted_edges.push_back( { 1, 4, 1, CHContractedEdge::NoMiddle, 4 } );
+    contracted_edges.push_back( { 4, 3, 1, CHContractedEdge::NoMiddle, 5 } );
+    contracted_edges.push_back( { 1, 3, 5, CHContractedEdge::NoMiddle, 6 } );
+    contracted_edges.push_back( { 4, 2, 2, CHContractedEdge::NoMiddle, 7 } );
+    std::vector<db_id_t> node_id = { 10, 11, 12, 13, 14 };
+    std::unique_ptr<RoutingData> rd = ch_routing_data_from_contraction( 5, contracted_edges, std::move( node_id ) );
+    const CHQuery& graph = static_cast<const CHRoutingData*>( rd.get() )->ch_query();
+
+    std::unique_ptr<HubLabels> labels = build_hub_labels( graph );
+    BOOST_REQUIRE_EQUAL( labels->num_vertices(), 5 );
+
+    // the hub 3 is pruned from the forward label of 1
+    std::vector<HubLabels::Entry> label = labels->label( 1, CHDirection::Forward );
+    BOOST_REQUIRE_EQUAL( label.size(), 2 );
+    BOOST_CHECK_EQUAL( label[0].hub, 1 );
+    BOOST_CHECK_EQUAL( label[1].hub, 4 );
+    BOOST_CHECK_EQUAL( label[1].cost, 1 );
+
+    // same costs as a CH query
+    auto weight_map_fn = []( const CHEdge& e ) { return uint32_t( e.property().b.cost ); };
+    auto weight_map = boost::make_function_property_map<CHEdge, uint32_t, decltype(weight_map_fn)>( weight_map_fn );
+    auto check_costs = [&]( const HubLabels& hl ) {
+        for ( CHVertex s = 0; s < 5; s++ ) {
+            for ( CHVertex t = 0; t < 5; t++ ) {
+                CHQueryStatistics stats;
+                uint32_t cost = HubLabels::Infinity;
+                bidirectional_ch_dijkstra( graph, s, t, weight_map, cost, ch_query_workspace<CHVertex, uint32_t>(), stats );
+                BOOST_CHECK_EQUAL( hl.cost( s, t ), cost );
+            }
+        }
+    };
+    check_costs( *labels );
+    BOOST_CHECK_EQUAL( labels->cost( 1, 3 ), 2 );
+    BOOST_CHECK_EQUAL( labels->cost( 3, 0 ), HubLabels::Infinity );
+
+    // mapped from a file, at an offset
+    const std::string filename = "test_hub_labels.bin";
+    {
+        std::ofstream ofs( filename, std::ios::binary );
+        const uint64_t padding = 0;
+        ofs.write( reinterpret_cast<const char*>( &padding ), sizeof( uint64_t ) );
+        labels->write( ofs );
+    }
+    {
+        HubLabels mapped( filename, sizeof( uint64_t ), labels->size() );
+        check_costs( mapped );
+    }
+    // truncated regions are rejected before anything is read past them
+    BOOST_CHECK_THROW( HubLabels( filename, sizeof( uint64_t ), 8 ), std::runtime_error );
+    BOOST_CHECK_THROW( HubLabels( filename, sizeof( uint64_t ), 32 ), std::runtime_error );
+    BOOST_CHECK_THROW( HubLabels( filename, sizeof( uint64_t ), labels->size() - 1 ), std::runtime_error );
+    BOOST_CHECK_THROW( HubLabels( filename, sizeof( uint64_t ), labels->size() + 8 ), std::runtime_error );
+    {
+        // a header with too many vertices for the region
+        std::ofstream ofs( filename, std::ios::binary );
+        const uint64_t header[] = { 1000000, 0, 0, 0 };
+        ofs.write( reinterpret_cast<const char*>( header ), sizeof( header ) );
+    }
+    BOOST_CHECK_THROW( HubLabels( filename, 0, 4 * sizeof( uint64_t ) ), std::runtime_error );
+    std::remove( filename.c_str() );
+}
+
+BOOST_AUTO_TEST_CASE( testTransitNodes )
+{
+    std::vector<CHContractedEdge> contracted_edges;
+    contracted_edges.push_back( { 0, 4, 10, CHContractedEdge::NoMiddle, 1 } );
+    contracted_edges.push_back( { 0, 2, 3, CHContractedEdge::NoMiddle, 2 } );
+    contracted_edges.push_back( { 2, 4, 1, CHContractedEdge::NoMiddle, 3 } );
+    contracted_edges.push_back( { 1, 4, 1, CHContractedEdge::NoMiddle, 4 } );
+    contracted_edges.push_back( { 4, 3, 1, CHContractedEdge::NoMiddle, 5 } );
+    contracted_edges.push_back( { 1, 3, 5, CHContractedEdge::NoMiddle, 6 } );
+    contracted_edges.push_back( { 4, 2, 5, CHContractedEdge::NoMiddle, 7 } );
+    contracted_edges.push_back( { 1, 2, 4, CHContractedEdge::NoMiddle, 8 } );
+    std::vector<db_id_t> node_id = { 10, 11, 12, 13, 14 };
+    std::unique_ptr<RoutingData> rd = ch_routing_data_from_contraction( 5, contracted_edges, std::move( node_id ) );
+    const CHQuery& graph = static_cast<const CHRoutingData*>( rd.get() )->ch_query();
+
+    auto weight_map_fn = []( const CHEdge& e ) { return uint32_t( e.property().b.cost ); };
+    auto weight_map = boost::make_function_property_map<CHEdge, uint32_t, decltype(weight_map_fn)>( weight_map_fn );
+
+    // from no transit node (CH searches only) to every vertex as transit node (table only)
+    for ( uint32_t k = 0; k <= 5; k++ ) {
+        std::unique_ptr<TransitNodeRoutingData> tnr = build_transit_nodes( graph, k );
+        BOOST_REQUIRE_EQUAL( tnr->num_transit_nodes(), k );
+        for ( CHVertex s = 0; s < 5; s++ ) {
+            for ( CHVertex t = 0; t < 5; t++ ) {
+                CHQueryStatistics stats;
+                uint32_t cost = TransitNodeRoutingData::Infinity;
+                bidirectional_ch_dijkstra( graph, s, t, weight_map, cost, ch_query_workspace<CHVertex, uint32_t>(), stats );
+                BOOST_CHECK_EQUAL( tnr->cost( graph, s, t ), cost );
+            }
+        }
+    }
+
+    // 3 and 4 are transit nodes
+    std::unique_ptr<TransitNodeRoutingData> tnr = build_transit_nodes( graph, 2 );
+    BOOST_CHECK( tnr->is_transit_node( 3 ) );
+    BOOST_CHECK( !tnr->is_transit_node( 2 ) );
+    // 1 -> 3 is reached through 4, 3 is not an access node of 1
+    TransitNodeRoutingData::AccessNodeRange access = tnr->access_nodes( 1, CHDirection::Forward );
+    BOOST_REQUIRE_EQUAL( access.second - access.first, 1 );
+    BOOST_CHECK_EQUAL( access.first->transit, 1 );
+    BOOST_CHECK_EQUAL( access.first->cost, 1 );
+    bool local = true;
+    BOOST_CHECK_EQUAL( tnr->cost( graph, 1, 3, &local ), 2 );
+    BOOST_CHECK( !local );
+    // 1 -> 2 is shorter than 1 -> 4 -> 2 and below the transit nodes
+    BOOST_CHECK_EQUAL( tnr->cost( graph, 1, 2, &local ), 4 );
+    BOOST_CHECK( local );
+}
+
+BOOST_AUTO_TEST_CASE( testCHClosures )
+{
+    // road: A -> B -> C (1 + 1), A -> D -> C (5 + 5)
+    // order: B = 0, D = 1, A = 2, C = 3. B is contracted with the shortcut A -> C,
+    // that is a witness for A -> D -> C when D is contracted
+    std::vector<CHContractedEdge> contracted_edges;
+    contracted_edges.push_back( { 2, 0, 1, CHContractedEdge::NoMiddle, 1 } );
+    contracted_edges.push_back( { 0, 3, 1, CHContractedEdge::NoMiddle, 2 } );
+    contracted_edges.push_back( { 2, 1, 5, CHContractedEdge::NoMiddle, 3 } );
+    contracted_edges.push_back( { 1, 3, 5, CHContractedEdge::NoMiddle, 4 } );
+    contracted_edges.push_back( { 2, 3, 2, 0, 0 } );
+    std::vector<db_id_t> node_id = { 10, 11, 12, 13 };
+    std::unique_ptr<RoutingData> rd = ch_routing_data_from_contraction( 4, contracted_edges, std::move( node_id ) );
+    const CHRoutingData& ch_data = *static_cast<const CHRoutingData*>( rd.get() );
+
+    CHClosureIndex index( ch_data );
+    std::shared_ptr<const CHClosure> closure = index.close( { 1 } );
+    // A -> B and the shortcut
+    BOOST_CHECK_EQUAL( closure->num_closed_edges(), 2 );
+
+    uint32_t cost = 0;
+    bool fallback = false;
+    std::list<CHEdge> path = ch_query_with_closure( ch_data, index, *closure, 2, 3, cost, &fallback );
+    BOOST_CHECK( fallback );
+    BOOST_CHECK_EQUAL( cost, 10 );
+    BOOST_REQUIRE_EQUAL( path.size(), 2 );
+    BOOST_CHECK_EQUAL( path.front().target(), 1 );
+
+    // unaffected
+    path = ch_query_with_closure( ch_data, index, *closure, 1, 3, cost, &fallback );
+    BOOST_CHECK( !fallback );
+    BOOST_CHECK_EQUAL( cost, 5 );
+
+    // no path
+    cost = 0;
+    path = ch_query_with_closure( ch_data, index, *index.close( { 1, 3 } ), 2, 3, cost, &fallback );
+    BOOST_CHECK( path.empty() );
+    BOOST_CHECK_EQUAL( cost, 0 );
+
+    // without closure
+    path = ch_query_with_closure( ch_data, index, *index.close( {} ), 2, 3, cost, &fallback );
+    BOOST_CHECK( !fallback );
+    BOOST_CHECK_EQUAL( cost, 2 );
+}
+
+BOOST_AUTO_TEST_CASE( testCHClosuresDijkstra )
+{
+    TestGrid g = test_grid( 6, 6, 5 );
+    CCHTopology topology( g.coordinates, g.edges, g.node_id );
+    std::unique_ptr<CHRoutingData> rd = CCHMetric( topology, g.arcs ).routing_data();
+    CHClosureIndex index( *rd );
+
+    const std::vector<std::vector<db_id_t>> closed_sections = { { 1 }, { 8, 9, 20 }, { 3, 14, 25, 36, 47 } };
+    for ( const std::vector<db_id_t>& sections : closed_sections ) {
+        std::shared_ptr<const CHClosure> closure = index.close( sections );
+        // the same graph without the arcs of the closed sections
+        std::vector<CCHArc> open_arcs;
+        for ( const CCHArc& a : g.arcs ) {
+            if ( std::find( sections.begin(), sections.end(), a.db_id ) == sections.end() ) {
+                open_arcs.push_back( a );
+            }
+        }
+        size_t fallbacks = 0;
+        for ( uint32_t s = 0; s < g.n; s++ ) {
+            std::vector<uint32_t> expected = dijkstra_costs( g.n, open_arcs, s );
+            for ( uint32_t t = 0; t < g.n; t++ ) {
+                uint32_t cost = std::numeric_limits<uint32_t>::max();
+                bool fallback = false;
+                std::list<CHEdge> path = ch_query_with_closure( *rd, index, *closure, topology.rank( s ), topology.rank( t ), cost, &fallback );
+                BOOST_CHECK_EQUAL( cost, expected[t] );
+                for ( const CHEdge& e : path ) {
+                    BOOST_CHECK( !closure->is_closed( e.index() ) );
+                }
+                fallbacks += fallback ? 1 : 0;
+            }
+        }
+        BOOST_CHECK( fallbacks > 0 );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+BOOST_AUTO_TEST_SUITE( tempus_core_travel_time_function )
+
+BOOST_AUTO_TEST_CASE( testTravelTimeFunction )
+{
+    // 10 min, except between 8:00 and 9:00 where it rises up to 30 min
+    std::vector<TravelTimeFunction::Point> pts = { {0.0, 10.0}, {480.0, 10.0}, {510.0, 30.0}, {540.0, 10.0} };
+    TravelTimeFunction f( std::move( pts ) );
+    BOOST_CHECK_CLOSE( f( 0.0 ), 10.0, 0.01 );
+    BOOST_CHECK_CLOSE( f( 495.0 ), 20.0, 0.01 );
+    BOOST_CHECK_CLOSE( f( 510.0 ), 30.0, 0.01 );
+    BOOST_CHECK_CLOSE( f( 1440.0 + 510.0 ), 30.0, 0.01 );
+    BOOST_CHECK_CLOSE( f.min(), 10.0, 0.01 );
+    BOOST_CHECK_CLOSE( f.max(), 30.0, 0.01 );
+
+    TravelTimeFunction g( 5.0 );
+    TravelTimeFunction fg = f.link( g );
+    BOOST_CHECK_CLOSE( fg( 495.0 ), 25.0, 0.01 );
+    BOOST_CHECK_CLOSE( fg( 1000.0 ), 15.0, 0.01 );
+
+    // g followed by f
+    TravelTimeFunction gf = g.link( f );
+    BOOST_CHECK_CLOSE( gf( 505.0 ), 35.0, 0.01 );
+
+    TravelTimeFunction c( 20.0 );
+    TravelTimeFunction m = f.merge( c );
+    BOOST_CHECK_CLOSE( m( 0.0 ), 10.0, 0.01 );
+    BOOST_CHECK_CLOSE( m( 510.0 ), 20.0, 0.01 );
+    BOOST_CHECK_CLOSE( m( 495.0 ), 20.0, 0.01 );
+    BOOST_CHECK( m.dominates( f ) );
+    BOOST_CHECK( m.dominates( c ) );
+    BOOST_CHECK( !f.dominates( c ) );
+    BOOST_CHECK( !c.dominates( f ) );
+}
+
+///
+/// Earliest arrival time by a time-dependent Dijkstra on the input edges
+static float td_dijkstra( uint32_t n, const std::vector<TDCHInputEdge>& edges, uint32_t origin, uint32_t destination, float departure )
+{
+    std::vector<float> arrival( n, std::numeric_limits<float>::max() );
+    typedef std::pair<float, uint32_t> QueueElement;
+    std::priority_queue<QueueElement, std::vector<QueueElement>, std::greater<QueueElement>> queue;
+    arrival[origin] = departure;
+    queue.push( std::make_pair( departure, origin ) );
+    while ( !queue.empty() ) {
+        float t = queue.top().first;
+        uint32_t u = queue.top().second;
+        queue.pop();
+        if ( t > arrival[u] ) {
+            continue;
+        }
+        for ( const TDCHInputEdge& e : edges ) {
+            if ( e.source == u && e.ttf.arrival( t ) < arrival[e.target] ) {
+                arrival[e.target] = e.ttf.arrival( t );
+                queue.push( std::make_pair( arrival[e.target], e.target ) );
+            }
+        }
+    }
+    return arrival[destination];
+}
+
+BOOST_AUTO_TEST_CASE( testTDCHQuery )
+{
+    // a grid of 3x3 vertices, with a peak hour between 8:00 and 9:00 on some of its edges
+    // and an isolated vertex 9
+    auto peak = []( float base, float extra ) {
+        std::vector<TravelTimeFunction::Point> pts = { {0.0, base}, {480.0, base}, {510.0, base + extra}, {540.0, base} };
+        return TravelTimeFunction( std::move( pts ) );
+    };
+    const uint32_t n = 10;
+    std::vector<TDCHInputEdge> edges;
+    db_id_t section_id = 1;
+    auto add_road = [&]( uint32_t u, uint32_t v, const TravelTimeFunction& f ) {
+        edges.push_back( { u, v, section_id, f } );
+        edges.push_back( { v, u, section_id, f } );
+        section_id++;
+    };
+    add_road( 0, 1, peak( 5.0, 20.0 ) );
+    add_road( 1, 2, TravelTimeFunction( 6.0 ) );
+    add_road( 3, 4, peak( 4.0, 25.0 ) );
+    add_road( 4, 5, peak( 3.0, 10.0 ) );
+    add_road( 6, 7, TravelTimeFunction( 8.0 ) );
+    add_road( 7, 8, peak( 2.0, 28.0 ) );
+    add_road( 0, 3, TravelTimeFunction( 7.0 ) );
+    add_road( 3, 6, peak( 6.0, 5.0 ) );
+    add_road( 1, 4, peak( 2.0, 15.0 ) );
+    add_road( 4, 7, TravelTimeFunction( 9.0 ) );
+    add_road( 2, 5, peak( 5.0, 12.0 ) );
+    add_road( 5, 8, TravelTimeFunction( 4.0 ) );
+    // parallel sections whose travel time functions cross: 0 -> 1 is faster by this one during the peak hour
+    edges.push_back( { 0, 1, section_id++, TravelTimeFunction( 12.0 ) } );
+
+    TDCHContraction contraction = td_contract_graph( n, edges, []( uint32_t v ) { return db_id_t( 100 + v ); } );
+    std::unique_ptr<TDCHRoutingData> rd = td_ch_routing_data( contraction, []( uint32_t v ) { return db_id_t( 100 + v ); } );
+
+    const float departures[] = { 0.0, 470.0, 490.0, 505.0, 520.0, 600.0, 1430.0 };
+    Deadline deadline;
+    for ( uint32_t s = 0; s < n; s++ ) {
+        for ( uint32_t t = 0; t < n; t++ ) {
+            if ( s == t ) {
+                continue;
+            }
+            for ( float departure : departures ) {
+                const float expected = td_dijkstra( n, edges, s, t, departure );
+                size_t iterations = 0;
+                std::vector<TDCHPathStep> path = td_ch_query( *rd, rd->vertex_from_id( 100 + s ).get(), rd->vertex_from_id( 100 + t ).get(), departure, iterations, deadline );
+                if ( expected == std::numeric_limits<float>::max() ) {
+                    BOOST_CHECK( path.empty() );
+                    continue;
+                }
+                BOOST_REQUIRE( !path.empty() );
+                float arrival = departure;
+                for ( const TDCHPathStep& step : path ) {
+                    BOOST_CHECK_CLOSE( step.departure, arrival, 0.01 );
+                    arrival += step.duration;
+                }
+                BOOST_CHECK_CLOSE( arrival, expected, 0.01 );
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( tempus_core_d_ary_heap )
+
+BOOST_AUTO_TEST_CASE( testDAryHeap )
+{
+    DAryHeap<uint32_t, float> heap( 100 );
+    for ( uint32_t i = 0; i < 100; i++ ) {
+        heap.push( i, float( (i * 37) % 101 ) );
+    }
+    BOOST_CHECK( heap.contains( 42 ) );
+    heap.decrease( 42, -1.0 );
+    heap.push_or_decrease( 43, -0.5 );
+    BOOST_CHECK_EQUAL( heap.top(), 42 );
+    heap.pop();
+    BOOST_CHECK( !heap.contains( 42 ) );
+    BOOST_CHECK_EQUAL( heap.top(), 43 );
+
+    float last = -1.0;
+    size_t n = 0;
+    while ( !heap.empty() ) {
+        BOOST_CHECK( heap.top_key() >= last );
+        last = heap.top_key();
+        heap.pop();
+        n++;
+    }
+    BOOST_CHECK_EQUAL( n, 99 );
+
+    // reuse after clear
+    heap.push( 5, 1.0 );
+    heap.push( 6, 0.0 );
+    heap.clear();
+    BOOST_CHECK( heap.empty() );
+    BOOST_CHECK( !heap.contains( 5 ) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( tempus_core_result_cache )
+
+namespace
+{
+struct CacheTestPlugin : public Plugin
+{
+    CacheTestPlugin( const RoutingData* rd ) : Plugin( "cache_test", cache_test_options() ), rd_( rd ) {}
+    std::unique_ptr<PluginRequest> request( const VariantMap& ) const { return std::unique_ptr<PluginRequest>(); }
+    const RoutingData* routing_data() const { return rd_; }
+
+    static VariantMap cache_test_options() {
+        VariantMap options;
+        options["db/options"] = Variant::from_string( "" );
+        options["db/schema"] = Variant::from_string( "tempus" );
+        return options;
+    }
+    const RoutingData* rd_;
+};
+
+ResultCache::Entry cache_test_entry( size_t num_roadmaps )
+{
+    ResultCache::Entry entry;
+    std::shared_ptr<Result> result( new Result( num_roadmaps ) );
+    entry.result = result;
+    entry.metrics["time_s"] = Variant::from_float( 1.0 );
+    return entry;
+}
+}
+
+BOOST_AUTO_TEST_CASE( testResultCacheKey )
+{
+    RoutingData rd1( "test" ), rd2( "test" );
+    CacheTestPlugin p1( &rd1 ), p2( &rd2 );
+    BOOST_CHECK( rd1.serial() != rd2.serial() );
+
+    Request::Step origin, destination;
+    origin.set_location( 1 );
+    destination.set_location( 2 );
+    Request::TimeConstraint tc;
+    tc.set_type( Request::TimeConstraint::ConstraintAfter );
+    tc.set_date_time( DateTime( boost::gregorian::date( 2014, 6, 18 ), boost::posix_time::time_duration( 8, 30, 12 ) ) );
+    destination.set_constraint( tc );
+    Request r1( origin, destination );
+    r1.add_allowed_mode( 1 );
+    r1.add_allowed_mode( 3 );
+
+    // same minute, modes in another order
+    tc.set_date_time( DateTime( boost::gregorian::date( 2014, 6, 18 ), boost::posix_time::time_duration( 8, 30, 47 ) ) );
+    destination.set_constraint( tc );
+    Request r2( origin, destination );
+    r2.add_allowed_mode( 3 );
+    r2.add_allowed_mode( 1 );
+
+    VariantMap options;
+    options["verbose"] = Variant::from_bool( false );
+    BOOST_CHECK_EQUAL( ResultCache::key( p1, options, r1 ), ResultCache::key( p1, options, r2 ) );
+
+    // other routing data
+    BOOST_CHECK( ResultCache::key( p1, options, r1 ) != ResultCache::key( p2, options, r1 ) );
+
+    // other options
+    VariantMap options2( options );
+    options2["verbose"] = Variant::from_bool( true );
+    BOOST_CHECK( ResultCache::key( p1, options, r1 ) != ResultCache::key( p1, options2, r1 ) );
+
+    // next minute
+    tc.set_date_time( DateTime( boost::gregorian::date( 2014, 6, 18 ), boost::posix_time::time_duration( 8, 31, 0 ) ) );
+    destination.set_constraint( tc );
+    Request r3( origin, destination );
+    r3.add_allowed_mode( 1 );
+    r3.add_allowed_mode( 3 );
+    BOOST_CHECK( ResultCache::key( p1, options, r1 ) != ResultCache::key( p1, options, r3 ) );
+}
+
+BOOST_AUTO_TEST_CASE( testResultCacheLRU )
+{
+    ResultCache::Entry entry;
+
+    // disabled by default
+    ResultCache disabled;
+    BOOST_CHECK( !disabled.enabled() );
+    disabled.insert( "a", cache_test_entry( 1 ) );
+    BOOST_CHECK( !disabled.find( "a", entry ) );
+
+    // a single shard, room for about 3 entries
+    const size_t entry_size = sizeof( void* ) * 16 + ResultCache::result_size( *cache_test_entry( 1 ).result );
+    ResultCache cache( 3 * entry_size + entry_size / 2, 0.0, 1 );
+    cache.insert( "a", cache_test_entry( 1 ) );
+    cache.insert( "b", cache_test_entry( 1 ) );
+    cache.insert( "c", cache_test_entry( 1 ) );
+    BOOST_CHECK( cache.find( "a", entry ) );
+    BOOST_CHECK_EQUAL( entry.result->size(), 1 );
+    BOOST_CHECK_EQUAL( entry.metrics["time_s"].as<double>(), 1.0 );
+
+    // "b" is the least recently used
+    cache.insert( "d", cache_test_entry( 1 ) );
+    BOOST_CHECK( !cache.find( "b", entry ) );
+    BOOST_CHECK( cache.find( "a", entry ) );
+    BOOST_CHECK( cache.find( "c", entry ) );
+    BOOST_CHECK( cache.find( "d", entry ) );
+
+    ResultCache::Statistics stats = cache.statistics();
+    BOOST_CHECK_EQUAL( stats.entries, 3 );
+    BOOST_CHECK_EQUAL( stats.evictions, 1 );
+    BOOST_CHECK_EQUAL( stats.hits, 4 );
+    BOOST_CHECK_EQUAL( stats.misses, 1 );
+    BOOST_CHECK( stats.bytes <= 3 * entry_size + entry_size / 2 );
+
+    // larger than the budget
+    cache.insert( "e", cache_test_entry( 1000 ) );
+    BOOST_CHECK( !cache.find( "e", entry ) );
+
+    cache.clear();
+    BOOST_CHECK( !cache.find( "a", entry ) );
+    BOOST_CHECK_EQUAL( cache.statistics().entries, 0 );
+
+    // time to live
+    cache.configure( 3 * entry_size, 0.05 );
+    cache.insert( "a", cache_test_entry( 1 ) );
+    BOOST_CHECK( cache.find( "a", entry ) );
+    boost::this_thread::sleep_for( boost::chrono::milliseconds( 100 ) );
+    BOOST_CHECK( !cache.find( "a", entry ) );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
+BOOST_AUTO_TEST_SUITE( tempus_core_instrumentation )
+
+BOOST_AUTO_TEST_CASE( testLatencyHistogram )
+{
+    // buckets are contiguous and cover every value
+    for ( uint64_t v = 0; v < 100000; v++ ) {
+        const size_t b = LatencyHistogram::bucket( v );
+        BOOST_CHECK( v <= LatencyHistogram::bucket_upper_bound( b ) );
+        BOOST_CHECK( b == 0 || v > LatencyHistogram::bucket_upper_bound( b - 1 ) );
+    }
+    BOOST_CHECK_EQUAL( LatencyHistogram::bucket_upper_bound( LatencyHistogram::bucket( uint64_t(-1) ) ), uint64_t(-1) );
+
+    LatencyHistogram h;
+    BOOST_CHECK_EQUAL( h.quantile( 0.5 ), 0 );
+    for ( uint64_t v = 1; v <= 1000; v++ ) {
+        h.record( v );
+    }
+    BOOST_CHECK_EQUAL( h.count(), 1000 );
+    BOOST_CHECK_EQUAL( h.sum(), 500500 );
+    BOOST_CHECK_EQUAL( h.max(), 1000 );
+    // relative error of at most 1/8
+    BOOST_CHECK( h.quantile( 0.5 ) >= 500 && h.quantile( 0.5 ) <= 500 * 9 / 8 );
+    BOOST_CHECK( h.quantile( 0.99 ) >= 990 && h.quantile( 0.99 ) <= 1000 );
+    BOOST_CHECK_EQUAL( h.quantile( 1.0 ), 1000 );
+}
+
+BOOST_AUTO_TEST_CASE( testInstrumentationScopes )
+{
+    // no current request, nothing is recorded
+    {
+        Instrumentation::ScopedPhase phase( Instrumentation::SearchPhase );
+    }
+
+    {
+        Instrumentation::RequestScope scope( "test_request" );
+        Instrumentation::set_label( "test_plugin" );
+        Instrumentation::ScopedPhase search( Instrumentation::SearchPhase );
+        {
+            Instrumentation::ScopedPhase roadmap( Instrumentation::RoadmapPhase );
+            boost::this_thread::sleep_for( boost::chrono::milliseconds( 20 ) );
+        }
+        scope.set_error();
+    }
+
+    const Instrumentation::Counters& c = Instrumentation::counters( "test_plugin" );
+    BOOST_CHECK_EQUAL( c.requests.count(), 1 );
+    BOOST_CHECK_EQUAL( c.errors.load(), 1 );
+    BOOST_CHECK_EQUAL( c.phases[Instrumentation::SearchPhase].count(), 1 );
+    BOOST_CHECK_EQUAL( c.phases[Instrumentation::RoadmapPhase].count(), 1 );
+    BOOST_CHECK( c.phases[Instrumentation::RoadmapPhase].max() >= 20000 );
+    // self time of the search phase
+    BOOST_CHECK( c.phases[Instrumentation::SearchPhase].max() < 20000 );
+    BOOST_CHECK_EQUAL( Instrumentation::counters( "test_request" ).requests.count(), 0 );
+
+    std::ostringstream ostr;
+    Instrumentation::write_text( ostr );
+    BOOST_CHECK( ostr.str().find( "tempus_requests_total{label=\"test_plugin\"} 1" ) != std::string::npos );
+    BOOST_CHECK( ostr.str().find( "tempus_latency_seconds_count{label=\"test_plugin\",phase=\"roadmap\"} 1" ) != std::string::npos );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( tempus_core_routing_data_reload )
+
+namespace
+{
+struct ReloadTestBuilder : public RoutingDataBuilder
+{
+    ReloadTestBuilder() : RoutingDataBuilder( "reload_test" ) {}
+    std::unique_ptr<RoutingData> pg_import( const std::string&, ProgressionCallback&, const VariantMap& ) const
+    {
+        return std::unique_ptr<RoutingData>( new RoutingData( "reload_test" ) );
+    }
+};
+REGISTER_BUILDER( ReloadTestBuilder )
+}
+
+BOOST_AUTO_TEST_CASE( testRoutingDataReload )
+{
+    VariantMap options;
+    options["db/options"] = Variant::from_string( "" );
+    std::shared_ptr<const RoutingData> h1 = routing_data_handle( "reload_test", null_progression_callback, options );
+    BOOST_REQUIRE( h1 );
+    BOOST_CHECK_EQUAL( load_routing_data( "reload_test", null_progression_callback, options ), h1.get() );
+
+    std::shared_ptr<const RoutingData> h2 = reload_routing_data( "reload_test", null_progression_callback, options );
+    BOOST_REQUIRE( h2 );
+    BOOST_CHECK( h2 != h1 );
+    BOOST_CHECK( h2->serial() != h1->serial() );
+    // new loads get the new data
+    BOOST_CHECK_EQUAL( routing_data_handle( "reload_test", null_progression_callback, options ), h2 );
+
+    // the previous data are freed with their last handle
+    std::weak_ptr<const RoutingData> w1( h1 );
+    BOOST_CHECK( !w1.expired() );
+    h1.reset();
+    BOOST_CHECK( w1.expired() );
+
+    BOOST_CHECK( !reload_routing_data( "no_such_builder", null_progression_callback, options ) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( tempus_core_deadline )
+
+namespace
+{
+struct DeadlineTestPlugin : public Plugin
+{
+    DeadlineTestPlugin( const VariantMap& options ) : Plugin( "deadline_test", options ) {}
+    std::unique_ptr<PluginRequest> request( const VariantMap& options ) const;
+    const RoutingData* routing_data() const { return nullptr; }
+};
+
+// a search that never ends before its deadline
+struct DeadlineTestRequest : public PluginRequest
+{
+    DeadlineTestRequest( const Plugin* plugin, const VariantMap& options ) : PluginRequest( plugin, options ) {}
+    std::unique_ptr<Result> process( const Request& )
+    {
+        const auto give_up = Deadline::Clock::now() + std::chrono::seconds( 5 );
+        while ( Deadline::Clock::now() < give_up ) {
+            check_deadline();
+        }
+        return std::unique_ptr<Result>( new Result() );
+    }
+};
+
+std::unique_ptr<PluginRequest> DeadlineTestPlugin::request( const VariantMap& options ) const
+{
+    return std::unique_ptr<PluginRequest>( new DeadlineTestRequest( this, options ) );
+}
+}
+
+BOOST_AUTO_TEST_CASE( testDeadline )
+{
+    // no deadline
+    Deadline d;
+    BOOST_CHECK( !d.has_timeout() );
+    BOOST_CHECK( !d.expired() );
+    for ( unsigned i = 0; i < 4 * Deadline::CheckPeriod; i++ ) {
+        d.check();
+    }
+
+    d.start( 0.02 );
+    BOOST_CHECK( d.has_timeout() );
+    BOOST_CHECK( !d.expired() );
+    boost::this_thread::sleep_for( boost::chrono::milliseconds( 50 ) );
+    BOOST_CHECK( d.expired() );
+    // the clock is only read every CheckPeriod calls
+    for ( unsigned i = 0; i < Deadline::CheckPeriod - 1; i++ ) {
+        d.check();
+    }
+    BOOST_CHECK_THROW( d.check(), DeadlineExceeded );
+
+    // cancellation, a new start clears it
+    d.start( 0.0 );
+    d.cancel();
+    BOOST_CHECK( d.expired() );
+    d.start( 0.0 );
+    BOOST_CHECK( !d.cancelled() );
+}
+
+BOOST_AUTO_TEST_CASE( testRequestTimeout )
+{
+    Request::Step origin, destination;
+    origin.set_location( 1 );
+    destination.set_location( 2 );
+    Request::TimeConstraint tc;
+    tc.set_type( Request::TimeConstraint::ConstraintAfter );
+    tc.set_date_time( DateTime( boost::gregorian::date( 2014, 6, 18 ), boost::posix_time::time_duration( 8, 30, 0 ) ) );
+    destination.set_constraint( tc );
+    Request request( origin, destination );
+
+    // timeout of the plugin
+    VariantMap plugin_options;
+    plugin_options["db/options"] = Variant::from_string( "" );
+    plugin_options["db/schema"] = Variant::from_string( "tempus" );
+    plugin_options["request/timeout"] = Variant::from_float( 0.05 );
+    DeadlineTestPlugin plugin( plugin_options );
+    BOOST_CHECK_EQUAL( plugin.request_timeout(), 0.05 );
+
+    std::unique_ptr<PluginRequest> plugin_request( plugin.request( VariantMap() ) );
+    BOOST_CHECK_THROW( plugin_request->process_cached( request ), DeadlineExceeded );
+    BOOST_CHECK( plugin_request->metrics()["timeout"].as<bool>() );
+
+    // a request cannot extend the timeout of the plugin
+    VariantMap longer;
+    longer["request/timeout"] = Variant::from_float( 60.0 );
+    plugin_request = plugin.request( longer );
+    BOOST_CHECK_THROW( plugin_request->process_cached( request ), DeadlineExceeded );
+
+    // timeout of the request, in a batch
+    VariantMap no_timeout;
+    no_timeout["db/options"] = Variant::from_string( "" );
+    no_timeout["db/schema"] = Variant::from_string( "tempus" );
+    DeadlineTestPlugin plugin2( no_timeout );
+    VariantMap options;
+    options["request/timeout"] = Variant::from_float( 0.05 );
+    std::vector<Plugin::BatchResult> results = plugin2.process_batch( std::vector<Request>( 2, request ), options, 1 );
+    BOOST_REQUIRE_EQUAL( results.size(), 2 );
+    for ( const Plugin::BatchResult& r : results ) {
+        BOOST_CHECK( !r.result );
+        BOOST_CHECK_EQUAL( r.error, "Request timeout" );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()